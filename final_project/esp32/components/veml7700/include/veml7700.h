@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include "esp_err.h"
 #include "i2cdev.h"
+#include "veml7700_lux.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -12,28 +13,6 @@ extern "C" {
 // Adres urządzenia I2C (0x10 - 7-bitowy adres slave)
 #define VEML7700_I2C_ADDR 0x10
 
-/**
- * @brief Czas integracji (Integration Time) - bity 9:6 w ALS_CONF_0 
- */
-typedef enum {
-    VEML7700_IT_100MS = 0x00,
-    VEML7700_IT_200MS = 0x01,
-    VEML7700_IT_400MS = 0x02,
-    VEML7700_IT_800MS = 0x03,
-    VEML7700_IT_50MS  = 0x08,
-    VEML7700_IT_25MS  = 0x0C
-} veml7700_it_t;
-
-/**
- * @brief Wzmocnienie (Gain) - bity 12:11 w ALS_CONF_0 
- */
-typedef enum {
-    VEML7700_GAIN_1   = 0x00, // x1
-    VEML7700_GAIN_2   = 0x01, // x2
-    VEML7700_GAIN_1_8 = 0x02, // x1/8
-    VEML7700_GAIN_1_4 = 0x03  // x1/4
-} veml7700_gain_t;
-
 /**
  * @brief Persistence protection (ALS_PERS) - bity 5:4 w ALS_CONF_0.
  * Liczba pomiarów poza progiem wymagana do wyzwolenia przerwania.
@@ -74,8 +53,25 @@ typedef struct {
     veml7700_pers_t persistence;
     bool interrupt_enable;
     bool shutdown;
+    bool psm_enable;
+    veml7700_psm_mode_t psm_mode;
+    bool lux_thresholds;   // progi w luksach (veml7700_set_lux_thresholds), przeliczane przy zmianie gain/IT
+    float low_lux;
+    float high_lux;
 } veml7700_handle_t;
 
+/**
+ * @brief Wynik pomiaru z automatycznym doborem zakresu (veml7700_read_lux_auto()).
+ */
+typedef struct {
+    float lux;
+    uint16_t raw;          // ALS w końcowej konfiguracji
+    veml7700_gain_t gain;  // konfiguracja, w której wykonano pomiar (zostaje ustawiona)
+    veml7700_it_t integration_time;
+    bool confident;        // raw w 100..10000 (albo skrajna konfiguracja bez nasycenia)
+    uint8_t reads;         // liczba odczytów ALS (1 gdy bieżąca konfiguracja była dobra)
+} veml7700_auto_result_t;
+
 
 esp_err_t veml7700_init_desc(veml7700_handle_t *handle, i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio);
 /**
@@ -112,9 +108,19 @@ esp_err_t veml7700_set_power_saving(veml7700_handle_t *handle, bool enable, veml
  */
 esp_err_t veml7700_set_interrupts(veml7700_handle_t *handle, bool enable, uint16_t high_threshold, uint16_t low_threshold);
 
+/**
+ * @brief Progi przerwania w luksach (-INFINITY / INFINITY = brak progu).
+ *
+ * Czujnik porównuje RAW po każdym pomiarze (także w trybie PSM, bez udziału MCU) i ustawia flagi
+ * w rejestrze 0x06. Progi są przeliczane na RAW dla bieżącego gain/IT i programowane ponownie
+ * przy każdej zmianie konfiguracji, więc auto-range ich nie psuje. Wyłącza progi RAW z
+ * veml7700_set_interrupts().
+ */
+esp_err_t veml7700_set_lux_thresholds(veml7700_handle_t *handle, bool enable, float low_lux, float high_lux);
+
 /**
  * @brief Odczytuje status przerwania (Rejestr 0x06).
- * Pozwala sprawdzić, który próg został przekroczony.
+ * Pozwala sprawdzić, który próg został przekroczony. Odczyt kasuje flagi.
  */
 esp_err_t veml7700_get_interrupt_status(veml7700_handle_t *handle, veml7700_interrupt_status_t *status);
 
@@ -131,7 +137,8 @@ esp_err_t veml7700_read_white_raw(veml7700_handle_t *handle, uint16_t *raw_white
 /**
  * @brief Konwertuje surowe ALS (RAW) na luks [lx].
  *
- * Ta funkcja nie wykonuje odczytu z I2C – tylko przelicza.
+ * Ta funkcja nie wykonuje odczytu z I2C – tylko przelicza. Liczy we float
+ * (veml7700_raw_to_lux_f()), wynik rozszerzany do double dla zgodności API.
  *
  * @param raw Surowa wartość ALS (np. z veml7700_read_als_raw()).
  * @param gain Gain użyty podczas tego pomiaru.
@@ -149,6 +156,19 @@ esp_err_t veml7700_convert_als_raw_to_lux(uint16_t raw, veml7700_gain_t gain, ve
  */
 esp_err_t veml7700_read_lux(veml7700_handle_t *handle, double *lux);
 
+/**
+ * @brief Pomiar z automatycznym doborem gain i czasu integracji (jedno wywołanie).
+ *
+ * Drabina konfiguracji wg noty aplikacyjnej VEML7700: start od G1/8 IT100, przy słabym świetle
+ * najpierw rośnie gain (1/4, 1, 2), potem czas integracji (200, 400, 800 ms); przy silnym świetle
+ * czas integracji maleje (50, 25 ms). Zamiast przechodzić ją krok po kroku, z bieżącego odczytu
+ * szacujemy natężenie i od razu wybieramy najczulszy stopień, dla którego oczekiwany raw <= 10000.
+ * Ponowny odczyt tylko gdy bieżąca konfiguracja była poza zakresem (nasycenie => najmniej czuły
+ * stopień i jeszcze jedna próba). Na czas ponownych pomiarów PSM jest wyłączany, żeby wynik był
+ * gotowy po jednym czasie integracji, a nie po cyklu PSM (do 4 s), potem przywracany.
+ */
+esp_err_t veml7700_read_lux_auto(veml7700_handle_t *handle, veml7700_auto_result_t *out);
+
 /**
  * @brief Rozbudowany Auto-Gain.
  * Iteracyjnie dostosowuje wzmocnienie, aby wartość surowa mieściła się w optymalnym zakresie (100 - 10000).
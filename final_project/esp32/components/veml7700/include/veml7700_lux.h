@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdint.h>
+
+// Przeliczanie RAW -> lux bez zależności od ESP-IDF (używane też przez narzędzie hostowe
+// tools/bench_conversions.c).
+//
+// ESP32 ma sprzętowe FPU tylko dla float - double jest emulowany programowo, a pow() to wywołanie
+// biblioteczne. Dlatego całość liczona jest we float: rozdzielczość z tablicy (gain, IT) liczonej
+// w czasie kompilacji, wielomian korekcji w schemacie Hornera (3 mnożenia + 3 dodawania zamiast
+// 4x pow()). Względna różnica względem wersji double z pow() <= 1e-6 dla wszystkich RAW/gain/IT
+// (sprawdzane w bench_conversions).
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Czas integracji (Integration Time) - bity 9:6 w ALS_CONF_0
+ */
+typedef enum {
+    VEML7700_IT_100MS = 0x00,
+    VEML7700_IT_200MS = 0x01,
+    VEML7700_IT_400MS = 0x02,
+    VEML7700_IT_800MS = 0x03,
+    VEML7700_IT_50MS  = 0x08,
+    VEML7700_IT_25MS  = 0x0C
+} veml7700_it_t;
+
+/**
+ * @brief Wzmocnienie (Gain) - bity 12:11 w ALS_CONF_0
+ */
+typedef enum {
+    VEML7700_GAIN_1   = 0x00, // x1
+    VEML7700_GAIN_2   = 0x01, // x2
+    VEML7700_GAIN_1_8 = 0x02, // x1/8
+    VEML7700_GAIN_1_4 = 0x03  // x1/4
+} veml7700_gain_t;
+
+// Współczynniki korekcji nieliniowości (nota aplikacyjna VEML7700)
+#define VEML7700_CORR_C4  6.0135e-13f
+#define VEML7700_CORR_C3 -9.3924e-9f
+#define VEML7700_CORR_C2  8.1488e-5f
+#define VEML7700_CORR_C1  1.0023f
+
+// Rozdzielczość [lx/count] = 0.0042 * (800 / IT[ms]) * (2 / gain)
+#define VEML7700_RES(g, it_ms) (0.0042f * (800.0f / (it_ms)) * (2.0f / (g)))
+
+// Wiersz tablicy dla jednego gain, indeks = kod IT (4 bity); nieużywane kody jak IT 100 ms
+#define VEML7700_RES_ROW(g) {                                                   \
+    VEML7700_RES(g, 100), VEML7700_RES(g, 200), VEML7700_RES(g, 400), VEML7700_RES(g, 800), \
+    VEML7700_RES(g, 100), VEML7700_RES(g, 100), VEML7700_RES(g, 100), VEML7700_RES(g, 100), \
+    VEML7700_RES(g, 50),  VEML7700_RES(g, 100), VEML7700_RES(g, 100), VEML7700_RES(g, 100), \
+    VEML7700_RES(g, 25),  VEML7700_RES(g, 100), VEML7700_RES(g, 100), VEML7700_RES(g, 100), \
+}
+
+// Indeks wiersza = kod gain (2 bity)
+static const float k_veml7700_resolution[4][16] = {
+    [VEML7700_GAIN_1]   = VEML7700_RES_ROW(1.0f),
+    [VEML7700_GAIN_2]   = VEML7700_RES_ROW(2.0f),
+    [VEML7700_GAIN_1_8] = VEML7700_RES_ROW(0.125f),
+    [VEML7700_GAIN_1_4] = VEML7700_RES_ROW(0.25f),
+};
+
+/**
+ * @brief Rozdzielczość [lx/count] dla danej konfiguracji (odczyt z tablicy).
+ */
+static inline float veml7700_resolution(veml7700_gain_t gain, veml7700_it_t it) {
+    return k_veml7700_resolution[(unsigned)gain & 0x3u][(unsigned)it & 0xFu];
+}
+
+/**
+ * @brief RAW -> lux (z korekcją nieliniowości), float.
+ */
+static inline float veml7700_raw_to_lux_f(uint16_t raw, veml7700_gain_t gain, veml7700_it_t it) {
+    float x = (float)raw * veml7700_resolution(gain, it);
+    return (((VEML7700_CORR_C4 * x + VEML7700_CORR_C3) * x + VEML7700_CORR_C2) * x + VEML7700_CORR_C1) * x;
+}
+
+/**
+ * @brief Odwrotność veml7700_raw_to_lux_f(): największy RAW, dla którego lux(RAW) <= `lux`.
+ *
+ * Wielomian korekcji jest rosnący, więc wystarcza wyszukiwanie binarne (16 kroków).
+ * 0 gdy `lux` <= 0, 0xFFFF gdy `lux` jest poza zakresem tej konfiguracji.
+ */
+static inline uint16_t veml7700_lux_to_raw(float lux, veml7700_gain_t gain, veml7700_it_t it) {
+    if (!(lux > 0.0f)) return 0;
+    uint32_t lo = 0, hi = 0xFFFF;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi + 1) / 2;
+        if (veml7700_raw_to_lux_f((uint16_t)mid, gain, it) <= lux) lo = mid;
+        else hi = mid - 1;
+    }
+    return (uint16_t)lo;
+}
+
+#ifdef __cplusplus
+}
+#endif
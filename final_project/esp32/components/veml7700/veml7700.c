@@ -1,15 +1,12 @@
 #include "veml7700.h"
 #include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
 #include <math.h>
 #include <string.h> // dla memset
 
 static const char *TAG = "VEML7700";
 
-#define VEML7700_CORR_C4  6.0135e-13
-#define VEML7700_CORR_C3 -9.3924e-9
-#define VEML7700_CORR_C2  8.1488e-5
-#define VEML7700_CORR_C1  1.0023
-
 #define REG_ALS_CONF_0 0x00
 #define REG_ALS_WH     0x01
 #define REG_ALS_WL     0x02
@@ -58,6 +55,18 @@ static esp_err_t update_conf_register(veml7700_handle_t *handle) {
     return write_register(handle, REG_ALS_CONF_0, conf_val);
 }
 
+// Progi w luksach -> RAW dla bieżącego gain/IT (przerwanie gdy RAW > WH lub RAW < WL)
+static esp_err_t write_lux_thresholds(veml7700_handle_t *handle) {
+    uint16_t high = veml7700_lux_to_raw(handle->high_lux, handle->gain, handle->integration_time); // INFINITY => 0xFFFF
+    uint16_t low = 0;
+    if (handle->low_lux > 0) {
+        low = veml7700_lux_to_raw(handle->low_lux, handle->gain, handle->integration_time);
+        if (low < 0xFFFF && veml7700_raw_to_lux_f(low, handle->gain, handle->integration_time) < handle->low_lux) low++;
+    }
+    CHECK(write_register(handle, REG_ALS_WH, high));
+    return write_register(handle, REG_ALS_WL, low);
+}
+
 // --- Public API ---
 
 esp_err_t veml7700_init_desc(veml7700_handle_t *handle, i2c_port_t port, gpio_num_t sda_gpio, gpio_num_t scl_gpio) {
@@ -88,6 +97,11 @@ esp_err_t veml7700_init(veml7700_handle_t *handle) {
     handle->persistence = VEML7700_PERS_1;
     handle->interrupt_enable = false;
     handle->shutdown = false;
+    handle->psm_enable = false;
+    handle->psm_mode = VEML7700_PSM_MODE_1;
+    handle->lux_thresholds = false;
+    handle->low_lux = -INFINITY;
+    handle->high_lux = INFINITY;
 
     return update_conf_register(handle);
 }
@@ -109,6 +123,8 @@ esp_err_t veml7700_set_config(veml7700_handle_t *handle, veml7700_gain_t gain, v
     handle->gain = gain;
     handle->integration_time = it;
     handle->persistence = pers;
+    // Nowe progi RAW przed nową konfiguracją - kolejny pomiar porównywany jest już z właściwymi
+    if (handle->lux_thresholds) CHECK(write_lux_thresholds(handle));
     return update_conf_register(handle);
 }
 
@@ -121,12 +137,28 @@ esp_err_t veml7700_set_power_saving(veml7700_handle_t *handle, bool enable, veml
     uint16_t psm_val = 0;
     psm_val |= (mode << 1);
     psm_val |= (enable ? 1 : 0);
-    return write_register(handle, REG_POWER_SAV, psm_val);
+    esp_err_t err = write_register(handle, REG_POWER_SAV, psm_val);
+    if (err == ESP_OK) {
+        handle->psm_enable = enable;
+        handle->psm_mode = mode;
+    }
+    return err;
 }
 
 esp_err_t veml7700_set_interrupts(veml7700_handle_t *handle, bool enable, uint16_t high_threshold, uint16_t low_threshold) {
     CHECK(write_register(handle, REG_ALS_WH, high_threshold));
     CHECK(write_register(handle, REG_ALS_WL, low_threshold));
+    handle->lux_thresholds = false;
+    handle->interrupt_enable = enable;
+    return update_conf_register(handle);
+}
+
+esp_err_t veml7700_set_lux_thresholds(veml7700_handle_t *handle, bool enable, float low_lux, float high_lux) {
+    CHECK_ARG(handle);
+    handle->lux_thresholds = enable;
+    handle->low_lux = low_lux;
+    handle->high_lux = high_lux;
+    if (enable) CHECK(write_lux_thresholds(handle));
     handle->interrupt_enable = enable;
     return update_conf_register(handle);
 }
@@ -147,26 +179,6 @@ esp_err_t veml7700_read_white_raw(veml7700_handle_t *handle, uint16_t *raw_white
     return read_register(handle, REG_WHITE, raw_white);
 }
 
-static double get_resolution(veml7700_gain_t gain, veml7700_it_t it) {
-    double gain_factor = 1.0;
-    switch(gain) {
-        case VEML7700_GAIN_2:   gain_factor = 2.0;   break;
-        case VEML7700_GAIN_1:   gain_factor = 1.0;   break;
-        case VEML7700_GAIN_1_4: gain_factor = 0.25;  break;
-        case VEML7700_GAIN_1_8: gain_factor = 0.125; break;
-    }
-    double it_ms = 100.0;
-    switch(it) {
-        case VEML7700_IT_25MS:  it_ms = 25.0;  break;
-        case VEML7700_IT_50MS:  it_ms = 50.0;  break;
-        case VEML7700_IT_100MS: it_ms = 100.0; break;
-        case VEML7700_IT_200MS: it_ms = 200.0; break;
-        case VEML7700_IT_400MS: it_ms = 400.0; break;
-        case VEML7700_IT_800MS: it_ms = 800.0; break;
-    }
-    return 0.0042 * (800.0 / it_ms) * (2.0 / gain_factor);
-}
-
 static veml7700_gain_t get_auto_gain_for_raw(veml7700_gain_t current_gain, uint16_t raw) {
     veml7700_gain_t new_gain = current_gain;
 
@@ -191,19 +203,7 @@ static veml7700_gain_t get_auto_gain_for_raw(veml7700_gain_t current_gain, uint1
 esp_err_t veml7700_convert_als_raw_to_lux(uint16_t raw, veml7700_gain_t gain, veml7700_it_t it, double *lux) {
     if (lux == NULL) return ESP_ERR_INVALID_ARG;
 
-    // Obliczenie podstawowej rozdzielczości (Gain/IT)
-    double resolution = get_resolution(gain, it);
-
-    // Wstępne obliczenie luksów
-    double lux_linear = raw * resolution;
-
-    // Korekcja nieliniowości
-    double lux_corrected = (VEML7700_CORR_C4 * pow(lux_linear, 4)) +
-                           (VEML7700_CORR_C3 * pow(lux_linear, 3)) +
-                           (VEML7700_CORR_C2 * pow(lux_linear, 2)) +
-                           (VEML7700_CORR_C1 * lux_linear);
-
-    *lux = lux_corrected;
+    *lux = veml7700_raw_to_lux_f(raw, gain, it);
     return ESP_OK;
 }
 
@@ -260,4 +260,113 @@ esp_err_t veml7700_auto_adjust_gain(veml7700_handle_t *handle) {
     }
 
     return ESP_OK;
-}
\ No newline at end of file
+}
+
+// --- Auto-range (gain x czas integracji) ---
+
+#define AUTO_RAW_LOW  100
+#define AUTO_RAW_HIGH 10000
+#define AUTO_RAW_SATURATED 65535
+#define AUTO_MAX_READS 3
+
+typedef struct {
+    veml7700_gain_t gain;
+    veml7700_it_t it;
+    uint16_t it_ms;
+} auto_step_t;
+
+// Drabina z noty aplikacyjnej, od najmniej do najbardziej czułej konfiguracji
+static const auto_step_t k_auto_ladder[] = {
+    { VEML7700_GAIN_1_8, VEML7700_IT_25MS,  25 },
+    { VEML7700_GAIN_1_8, VEML7700_IT_50MS,  50 },
+    { VEML7700_GAIN_1_8, VEML7700_IT_100MS, 100 },
+    { VEML7700_GAIN_1_4, VEML7700_IT_100MS, 100 },
+    { VEML7700_GAIN_1,   VEML7700_IT_100MS, 100 },
+    { VEML7700_GAIN_2,   VEML7700_IT_100MS, 100 },
+    { VEML7700_GAIN_2,   VEML7700_IT_200MS, 200 },
+    { VEML7700_GAIN_2,   VEML7700_IT_400MS, 400 },
+    { VEML7700_GAIN_2,   VEML7700_IT_800MS, 800 },
+};
+#define AUTO_LADDER_LEN (sizeof(k_auto_ladder) / sizeof(k_auto_ladder[0]))
+
+static uint16_t it_to_ms(veml7700_it_t it) {
+    for (size_t i = 0; i < AUTO_LADDER_LEN; i++) {
+        if (k_auto_ladder[i].it == it) return k_auto_ladder[i].it_ms;
+    }
+    return 100;
+}
+
+// Najczulszy stopień, w którym światło `lux_linear` da raw <= AUTO_RAW_HIGH
+static size_t auto_pick_step(float lux_linear) {
+    size_t best = 0;
+    for (size_t i = 0; i < AUTO_LADDER_LEN; i++) {
+        float expected_raw = lux_linear / veml7700_resolution(k_auto_ladder[i].gain, k_auto_ladder[i].it);
+        if (expected_raw <= AUTO_RAW_HIGH) best = i;
+    }
+    return best;
+}
+
+esp_err_t veml7700_read_lux_auto(veml7700_handle_t *handle, veml7700_auto_result_t *out) {
+    CHECK_ARG(handle && out);
+    memset(out, 0, sizeof(*out));
+
+    bool psm_restore = false;
+    bool at_edge = false;
+    esp_err_t err = ESP_OK;
+    uint16_t raw = 0;
+
+    while (1) {
+        err = veml7700_read_als_raw(handle, &raw);
+        if (err != ESP_OK) break;
+        out->reads++;
+
+        bool in_range = raw >= AUTO_RAW_LOW && raw <= AUTO_RAW_HIGH;
+        if (in_range || out->reads >= AUTO_MAX_READS) break;
+
+        size_t step;
+        if (raw >= AUTO_RAW_SATURATED) {
+            step = 0; // nasycenie: wartości nie da się oszacować, najmniej czuła konfiguracja
+        } else {
+            float lux_linear = raw * veml7700_resolution(handle->gain, handle->integration_time);
+            step = auto_pick_step(lux_linear);
+        }
+        const auto_step_t *next = &k_auto_ladder[step];
+        if (next->gain == handle->gain && next->it == handle->integration_time) {
+            at_edge = true; // skraj drabiny: lepszej konfiguracji nie ma
+            break;
+        }
+
+        if (handle->psm_enable && !psm_restore) {
+            err = veml7700_set_power_saving(handle, false, handle->psm_mode);
+            if (err != ESP_OK) break;
+            handle->psm_enable = true; // zapamiętane do przywrócenia
+            psm_restore = true;
+        }
+        err = veml7700_set_config(handle, next->gain, next->it, handle->persistence);
+        if (err != ESP_OK) break;
+
+        // Nowy wynik po pełnym czasie integracji (+ zapas na start pomiaru)
+        uint32_t wait_ms = next->it_ms + next->it_ms / 8 + 3;
+        vTaskDelay(pdMS_TO_TICKS(wait_ms) + 1);
+    }
+
+    if (psm_restore) {
+        esp_err_t psm_err = veml7700_set_power_saving(handle, true, handle->psm_mode);
+        if (err == ESP_OK) err = psm_err;
+    }
+    if (err != ESP_OK) return err;
+
+    out->raw = raw;
+    out->gain = handle->gain;
+    out->integration_time = handle->integration_time;
+    // Poza 100..10000 na skraju drabiny wynik jest nadal najlepszy możliwy (korekcja nieliniowości
+    // poniżej); niepewny jest tylko przy nasyceniu albo gdy zabrakło prób na dobór zakresu.
+    bool in_range = raw >= AUTO_RAW_LOW && raw <= AUTO_RAW_HIGH;
+    out->confident = raw < AUTO_RAW_SATURATED && (in_range || at_edge);
+    if (!out->confident) {
+        ESP_LOGD(TAG, "Lux uncertain after auto-range (raw=%u, gain=%d, it=%u ms)", (unsigned)raw,
+                 (int)out->gain, (unsigned)it_to_ms(out->integration_time));
+    }
+    out->lux = veml7700_raw_to_lux_f(raw, out->gain, out->integration_time);
+    return ESP_OK;
+}
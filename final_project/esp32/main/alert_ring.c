@@ -0,0 +1,130 @@
+#include "alert_ring.h"
+
+#include <string.h>
+
+static void ring_write(alert_ring_t *r, size_t pos, const uint8_t *src, size_t len) {
+    pos %= r->cap;
+    size_t first = r->cap - pos;
+    if (first > len) first = len;
+    memcpy(r->buf + pos, src, first);
+    memcpy(r->buf, src + first, len - first);
+}
+
+static void ring_read(const alert_ring_t *r, size_t pos, uint8_t *dst, size_t len) {
+    pos %= r->cap;
+    size_t first = r->cap - pos;
+    if (first > len) first = len;
+    memcpy(dst, r->buf + pos, first);
+    memcpy(dst + first, r->buf, len - first);
+}
+
+static void read_header(const alert_ring_t *r, uint16_t *len, uint16_t *id) {
+    uint8_t h[ALERT_RING_ENTRY_HEADER_SIZE];
+    ring_read(r, r->head, h, sizeof(h));
+    *len = (uint16_t)(h[0] | (h[1] << 8));
+    *id = (uint16_t)(h[2] | (h[3] << 8));
+}
+
+static void drop_head(alert_ring_t *r) {
+    uint16_t len, id;
+    read_header(r, &len, &id);
+    size_t size = ALERT_RING_ENTRY_HEADER_SIZE + len;
+    r->head = (r->head + size) % r->cap;
+    r->used -= size;
+    r->count--;
+}
+
+void alert_ring_init(alert_ring_t *r, uint8_t *buf, size_t cap, alert_ring_policy_t policy) {
+    memset(r, 0, sizeof(*r));
+    r->buf = buf;
+    r->cap = cap;
+    r->policy = policy;
+    portMUX_INITIALIZE(&r->mux);
+}
+
+bool alert_ring_push(alert_ring_t *r, const void *data, size_t len) {
+    size_t size = ALERT_RING_ENTRY_HEADER_SIZE + len;
+    if (!r->buf || len > UINT16_MAX || size > r->cap) {
+        portENTER_CRITICAL(&r->mux);
+        r->dropped++;
+        portEXIT_CRITICAL(&r->mux);
+        return false;
+    }
+
+    portENTER_CRITICAL(&r->mux);
+    if (r->cap - r->used < size) {
+        if (r->policy == ALERT_RING_DROP_NEWEST) {
+            r->dropped++;
+            portEXIT_CRITICAL(&r->mux);
+            return false;
+        }
+        while (r->cap - r->used < size) {
+            drop_head(r);
+            r->dropped++;
+        }
+    }
+
+    uint16_t id = r->next_id++;
+    uint8_t h[ALERT_RING_ENTRY_HEADER_SIZE] = {(uint8_t)len, (uint8_t)(len >> 8), (uint8_t)id, (uint8_t)(id >> 8)};
+    size_t tail = r->head + r->used;
+    ring_write(r, tail, h, sizeof(h));
+    ring_write(r, tail + sizeof(h), data, len);
+    r->used += size;
+    r->count++;
+    if (r->used > r->high_water) r->high_water = r->used;
+    portEXIT_CRITICAL(&r->mux);
+    return true;
+}
+
+size_t alert_ring_peek(alert_ring_t *r, void *out, size_t out_cap, uint16_t *id) {
+    size_t n = 0;
+    portENTER_CRITICAL(&r->mux);
+    if (r->count > 0) {
+        uint16_t len, entry_id;
+        read_header(r, &len, &entry_id);
+        if (len <= out_cap) {
+            ring_read(r, r->head + ALERT_RING_ENTRY_HEADER_SIZE, out, len);
+            if (id) *id = entry_id;
+            n = len;
+        }
+    }
+    portEXIT_CRITICAL(&r->mux);
+    return n;
+}
+
+bool alert_ring_pop(alert_ring_t *r, uint16_t id) {
+    bool popped = false;
+    portENTER_CRITICAL(&r->mux);
+    if (r->count > 0) {
+        uint16_t len, entry_id;
+        read_header(r, &len, &entry_id);
+        if (entry_id == id) {
+            drop_head(r);
+            popped = true;
+        }
+    }
+    portEXIT_CRITICAL(&r->mux);
+    return popped;
+}
+
+uint16_t alert_ring_count(alert_ring_t *r) {
+    portENTER_CRITICAL(&r->mux);
+    uint16_t n = r->count;
+    portEXIT_CRITICAL(&r->mux);
+    return n;
+}
+
+size_t alert_ring_high_water(alert_ring_t *r) {
+    portENTER_CRITICAL(&r->mux);
+    size_t n = r->high_water;
+    portEXIT_CRITICAL(&r->mux);
+    return n;
+}
+
+uint32_t alert_ring_take_dropped(alert_ring_t *r) {
+    portENTER_CRITICAL(&r->mux);
+    uint32_t n = r->dropped;
+    r->dropped = 0;
+    portEXIT_CRITICAL(&r->mux);
+    return n;
+}
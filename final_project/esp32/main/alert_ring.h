@@ -0,0 +1,74 @@
+#ifndef ALERT_RING_H
+#define ALERT_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+// Kolejka FIFO wiadomości zmiennej długości w pierścieniu bajtów (bez alokacji na stercie).
+//
+// Wpis zajmuje 4 B nagłówka (u16 długość, u16 id) + dane, bez wyrównania; wpis może
+// zawijać się przez koniec bufora. Dzięki temu krótkie alerty nie rezerwują miejsca
+// na najdłuższy możliwy rekord.
+//
+// Gdy brakuje miejsca, zależnie od polityki odrzucany jest nowy wpis (DROP_NEWEST)
+// albo usuwane są najstarsze (DROP_OLDEST); oba przypadki zwiększają licznik `dropped`.
+// Odczyt jest dwuetapowy: alert_ring_peek() + alert_ring_pop(id) po udanym wysłaniu,
+// przy czym pop usuwa wpis tylko jeśli w międzyczasie nie został nadpisany.
+//
+// Funkcje są bezpieczne do wołania z wielu tasków (sekcja krytyczna na czas kopiowania).
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ALERT_RING_ENTRY_HEADER_SIZE 4
+
+typedef enum {
+    ALERT_RING_DROP_NEWEST = 0,
+    ALERT_RING_DROP_OLDEST,
+} alert_ring_policy_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t head;          // początek najstarszego wpisu
+    size_t used;          // zajęte bajty (z nagłówkami)
+    size_t high_water;    // maks. `used` od startu
+    uint16_t count;
+    uint16_t next_id;
+    uint32_t dropped;
+    alert_ring_policy_t policy;
+    portMUX_TYPE mux;
+} alert_ring_t;
+
+// Inicjalizacja statyczna (bufor gotowy przed startem schedulera / innych modułów)
+#define ALERT_RING_INITIALIZER(storage, size, drop_policy) \
+    { .buf = (storage), .cap = (size), .policy = (drop_policy), .mux = portMUX_INITIALIZER_UNLOCKED }
+
+void alert_ring_init(alert_ring_t *r, uint8_t *buf, size_t cap, alert_ring_policy_t policy);
+
+// Dopisuje wpis; false gdy został odrzucony (brak miejsca przy DROP_NEWEST lub wpis większy niż bufor).
+bool alert_ring_push(alert_ring_t *r, const void *data, size_t len);
+
+// Kopiuje najstarszy wpis do `out` (bez usuwania). Zwraca długość; 0 gdy pusty lub `out_cap` za małe.
+size_t alert_ring_peek(alert_ring_t *r, void *out, size_t out_cap, uint16_t *id);
+
+// Usuwa najstarszy wpis, jeśli nadal jest to wpis `id` zwrócony przez alert_ring_peek().
+bool alert_ring_pop(alert_ring_t *r, uint16_t id);
+
+uint16_t alert_ring_count(alert_ring_t *r);
+
+// Najwyższe zajęcie bufora w bajtach (z nagłówkami) od startu
+size_t alert_ring_high_water(alert_ring_t *r);
+
+// Liczba odrzuconych wpisów od ostatniego wywołania (licznik jest zerowany).
+uint32_t alert_ring_take_dropped(alert_ring_t *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ALERT_RING_H
@@ -10,6 +10,7 @@
 #include "cJSON.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 
 #include <math.h>
 
@@ -21,22 +22,27 @@
 #include "mqtt_app.h"
 #include "wifi_prov.h" // DODANE
 #include "esp_sntp.h"
+#include "esp_timer.h"
 
 #include "alert_limiter.h"
+#include "command_worker.h"
+#include "water_monitor.h"
+#include "threshold_engine.h"
+#include "automation.h"
+#include "pump_ctrl.h"
+#include "irrigation.h"
+#include "settings_store.h"
+#include "telemetry_log.h"
 
 #define TAG "MAIN_APP"
 #define PUBLISH_INTERVAL_MS 10000
-#define PUMP_GPIO 2
-#define AUTO_WATER_COOLDOWN_MS (30 * 60 * 1000) // 30 minut cooldownu
+#define AUTO_WATER_COOLDOWN_MS (30 * 60 * 1000) // domyślny cooldown reguł automatyzacji
+#define MAX_WATERING_DURATION_S 60 // command/water i reguły automatyzacji
 
+// Koniec ostatniego podlewania (zegar ścienny, ms): pisze task pump_evt, czyta publisher_task.
+// 64 bity na 32-bitowym ESP32 - odczyt i zapis pod s_water_time_mux, żeby nie rozerwać wartości.
 static int64_t last_water_time = 0;
-
-typedef struct {
-    int duration;
-    char source[10]; // "auto" or "manual"
-} watering_req_t;
-
-static QueueHandle_t watering_req_queue = NULL;
+static portMUX_TYPE s_water_time_mux = portMUX_INITIALIZER_UNLOCKED;
 
 
 // Domyślne progi - "otwarte" (brak alertów)
@@ -52,8 +58,33 @@ typedef struct {
     float light_max;
     int watering_duration_sec; // NOWE POLA
     int measurement_interval_sec;
+    int telemetry_encoding; // telemetry_encoding_t
+    float hysteresis[TELEMETRY_FIELD_COUNT]; // powrót z alertu dopiero o tyle za progiem (indeks = bit pola)
+    uint32_t dwell_sec[TELEMETRY_FIELD_COUNT]; // alert, gdy wartość jest za progiem co najmniej tyle
 } device_settings_t; // Było sensor_thresholds_t
 
+// Pola zapisywane w NVS (settings_store). Tag to stały identyfikator w zapisie: nowe pole = nowy tag,
+// zmiana typu/znaczenia = nowy tag, usuniętych tagów nie używamy ponownie.
+#define SETTINGS_SCHEMA_VERSION 1
+static const settings_field_t k_settings_fields[] = {
+    SETTINGS_FIELD(1, device_settings_t, temp_min, 0),
+    SETTINGS_FIELD(2, device_settings_t, temp_max, 0),
+    SETTINGS_FIELD(3, device_settings_t, hum_min, 0),
+    SETTINGS_FIELD(4, device_settings_t, hum_max, 0),
+    SETTINGS_FIELD(5, device_settings_t, soil_min, 0),
+    SETTINGS_FIELD(6, device_settings_t, soil_max, 0),
+    SETTINGS_FIELD(7, device_settings_t, light_min, 0),
+    SETTINGS_FIELD(8, device_settings_t, light_max, 0),
+    SETTINGS_FIELD(9, device_settings_t, watering_duration_sec, 0),
+    SETTINGS_FIELD(10, device_settings_t, measurement_interval_sec, 0),
+    SETTINGS_FIELD(11, device_settings_t, telemetry_encoding, 0),
+    SETTINGS_FIELD(12, device_settings_t, hysteresis, SETTINGS_FIELD_ARRAY),
+    SETTINGS_FIELD(13, device_settings_t, dwell_sec, SETTINGS_FIELD_ARRAY),
+};
+
+// Domyślna histereza progów (gleba, temp., wilgotność, ciśnienie, światło, woda)
+#define DEFAULT_HYSTERESIS { 2.0f, 0.5f, 2.0f, 0.0f, 0.0f, 0.0f }
+
 // Domyślne ustawienia
 static device_settings_t settings = {
     .temp_min = -INFINITY,
@@ -65,19 +96,59 @@ static device_settings_t settings = {
     .light_min = -INFINITY,
     .light_max = INFINITY,
     .watering_duration_sec = 5, // Domyślnie 5 sekund
-    .measurement_interval_sec = 60 // Domyślnie 60 sekund
+    .measurement_interval_sec = 60, // Domyślnie 60 sekund
+    .telemetry_encoding = TELEMETRY_ENCODING_JSON,
+    .hysteresis = DEFAULT_HYSTERESIS,
 };
 
-// Flagi stanów alarmowych (zapobiega spamowaniu alertami)
-static bool alert_temp_so_far = false;
-static bool alert_temp_high_so_far = false;
-static bool alert_hum_so_far = false;
-static bool alert_hum_high_so_far = false;
-static bool alert_soil_so_far = false;
-static bool alert_soil_high_so_far = false;
-static bool alert_light_so_far = false;
-static bool alert_light_high_so_far = false;
-static bool alert_water_so_far = false;
+static const float k_default_hysteresis[TELEMETRY_FIELD_COUNT] = DEFAULT_HYSTERESIS;
+
+// settings zmienia tylko command_worker (pod s_settings_lock); inne taski i zapis w NVS czytają pod tym samym lockiem
+static SemaphoreHandle_t s_settings_lock = NULL;
+
+static void settings_snapshot(device_settings_t *out) {
+    xSemaphoreTake(s_settings_lock, portMAX_DELAY);
+    *out = settings;
+    xSemaphoreGive(s_settings_lock);
+}
+
+// Nazwy pól telemetrii (indeks = bit TELEMETRY_FIELD_*), jak w JSON telemetrii
+static const char *const k_field_names[TELEMETRY_FIELD_COUNT] = {
+    "soil_moisture_pct", "air_temperature_c", "air_humidity_pct", "pressure_hpa", "light_lux", "water_tank_ok",
+};
+
+// Reguły progowe; limit/histereza/dwell z ustawień (build_threshold_rules)
+enum {
+    RULE_TEMP_LOW, RULE_TEMP_HIGH,
+    RULE_HUM_LOW, RULE_HUM_HIGH,
+    RULE_SOIL_LOW, RULE_SOIL_HIGH,
+    RULE_LIGHT_LOW, RULE_LIGHT_HIGH,
+    RULE_WATER,
+    RULE_COUNT
+};
+
+#define FIELD_IDX(f) ((uint8_t)__builtin_ctz(f))
+
+static const threshold_rule_t k_rule_templates[RULE_COUNT] = {
+    [RULE_TEMP_LOW]   = { .field = FIELD_IDX(TELEMETRY_FIELD_TEMP), .cmp = THRESHOLD_CMP_LT, .code = "temperature_low", .fmt = "Temp %.1f C < min %.1f C" },
+    [RULE_TEMP_HIGH]  = { .field = FIELD_IDX(TELEMETRY_FIELD_TEMP), .cmp = THRESHOLD_CMP_GT, .code = "temperature_high", .fmt = "Temp %.1f C > max %.1f C" },
+    [RULE_HUM_LOW]    = { .field = FIELD_IDX(TELEMETRY_FIELD_HUM), .cmp = THRESHOLD_CMP_LT, .code = "humidity_low", .fmt = "Hum %.1f %% < min %.1f %%" },
+    [RULE_HUM_HIGH]   = { .field = FIELD_IDX(TELEMETRY_FIELD_HUM), .cmp = THRESHOLD_CMP_GT, .code = "humidity_high", .fmt = "Hum %.1f %% > max %.1f %%" },
+    [RULE_SOIL_LOW]   = { .field = FIELD_IDX(TELEMETRY_FIELD_SOIL), .cmp = THRESHOLD_CMP_LT, .code = "soil_moisture_low", .fmt = "Soil %.0f %% < min %.0f %%" },
+    [RULE_SOIL_HIGH]  = { .field = FIELD_IDX(TELEMETRY_FIELD_SOIL), .cmp = THRESHOLD_CMP_GT, .code = "soil_moisture_high", .fmt = "Soil %.0f %% > max %.0f %%" },
+    [RULE_LIGHT_LOW]  = { .field = FIELD_IDX(TELEMETRY_FIELD_LIGHT), .cmp = THRESHOLD_CMP_LT, .code = "light_low", .fmt = "Light %.1f lux < min %.1f lux" },
+    [RULE_LIGHT_HIGH] = { .field = FIELD_IDX(TELEMETRY_FIELD_LIGHT), .cmp = THRESHOLD_CMP_GT, .code = "light_high", .fmt = "Light %.1f lux > max %.1f lux" },
+    [RULE_WATER]      = { .field = FIELD_IDX(TELEMETRY_FIELD_WATER), .cmp = THRESHOLD_CMP_GT, .limit = 0.5f, .code = "water_level_critical", .fmt = "Refill water tank!" },
+};
+
+// Reguły i ich stan - z check_thresholds (publisher/command_worker) i callbacków czujników, pod s_rules_lock
+static threshold_rule_t s_rules[RULE_COUNT];
+static threshold_state_t s_rule_state[RULE_COUNT];
+static threshold_engine_t s_thresholds;
+static SemaphoreHandle_t s_rules_lock = NULL;
+
+// Progi światła porównuje VEML7700 (alerty z on_light_threshold); false = porównanie w check_thresholds
+static bool s_light_hw_thresholds = false;
 
 static bool value_available_float(float v) {
     return !isnan(v) && !isinf(v);
@@ -87,40 +158,50 @@ static bool value_available_soil(int v) {
     return v != INT_MIN && v != INT_MAX;
 }
 
-static void save_settings_to_nvs(void) {
-    nvs_handle_t my_handle;
-    esp_err_t err = nvs_open("storage", NVS_READWRITE, &my_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error (%s) opening NVS handle!", esp_err_to_name(err));
-    } else {
-        err = nvs_set_blob(my_handle, "settings", &settings, sizeof(settings));
-        if (err != ESP_OK) {
-             ESP_LOGE(TAG, "Failed to save settings to NVS!");
-        } else {
-             err = nvs_commit(my_handle);
-             if (err == ESP_OK) {
-                 ESP_LOGI(TAG, "Settings saved to NVS");
-             }
-        }
-        nvs_close(my_handle);
+static float soil_limit(int v) {
+    if (v == INT_MIN) return -INFINITY;
+    if (v == INT_MAX) return INFINITY;
+    return (float)v;
+}
+
+// Przelicza tabelę reguł z ustawień; stan reguł (alerty aktywne) zostaje
+static void build_threshold_rules(void) {
+    xSemaphoreTake(s_rules_lock, portMAX_DELAY);
+    memcpy(s_rules, k_rule_templates, sizeof(s_rules));
+    s_rules[RULE_TEMP_LOW].limit = settings.temp_min;
+    s_rules[RULE_TEMP_HIGH].limit = settings.temp_max;
+    s_rules[RULE_HUM_LOW].limit = settings.hum_min;
+    s_rules[RULE_HUM_HIGH].limit = settings.hum_max;
+    s_rules[RULE_SOIL_LOW].limit = soil_limit(settings.soil_min);
+    s_rules[RULE_SOIL_HIGH].limit = soil_limit(settings.soil_max);
+    s_rules[RULE_LIGHT_LOW].limit = settings.light_min;
+    s_rules[RULE_LIGHT_HIGH].limit = settings.light_max;
+    if (s_light_hw_thresholds) {
+        s_rules[RULE_LIGHT_LOW].flags |= THRESHOLD_RULE_EXTERNAL;
+        s_rules[RULE_LIGHT_HIGH].flags |= THRESHOLD_RULE_EXTERNAL;
+    }
+    for (size_t i = 0; i < RULE_WATER; i++) {
+        s_rules[i].hysteresis = settings.hysteresis[s_rules[i].field];
+        s_rules[i].dwell_ms = settings.dwell_sec[s_rules[i].field] * 1000;
     }
+    xSemaphoreGive(s_rules_lock);
 }
 
-static void load_settings_from_nvs(void) {
-    nvs_handle_t my_handle;
-    esp_err_t err = nvs_open("storage", NVS_READWRITE, &my_handle);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Error (%s) opening NVS handle! Using defaults.", esp_err_to_name(err));
-    } else {
-        size_t required_size = sizeof(settings);
-        err = nvs_get_blob(my_handle, "settings", &settings, &required_size);
-        if (err != ESP_OK) {
-             ESP_LOGW(TAG, "No settings found in NVS. Using defaults.");
-        } else {
-             ESP_LOGI(TAG, "Settings loaded from NVS");
-        }
-        nvs_close(my_handle);
+static const settings_store_config_t k_settings_store = {
+    .key = "settings_rec",
+    .legacy_key = "settings", // surowa struktura sprzed settings_store
+    .version = SETTINGS_SCHEMA_VERSION,
+    .data = &settings,
+    .lock = &s_settings_lock,
+    .fields = k_settings_fields,
+    .field_count = sizeof(k_settings_fields) / sizeof(k_settings_fields[0]),
+};
+
+static telemetry_fields_mask_t field_from_name(const char *s) {
+    for (int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+        if (strcmp(s, k_field_names[i]) == 0) return 1u << i;
     }
+    return 0;
 }
 
 static telemetry_fields_mask_t parse_fields_mask_from_json(cJSON *root) {
@@ -129,15 +210,7 @@ static telemetry_fields_mask_t parse_fields_mask_from_json(cJSON *root) {
 
     // Wspieramy: {"field":"air_temperature_c"} lub {"fields":["air_temperature_c", ...]}
     cJSON *field = cJSON_GetObjectItem(root, "field");
-    if (cJSON_IsString(field) && field->valuestring) {
-        const char *s = field->valuestring;
-        if (strcmp(s, "soil_moisture_pct") == 0) mask |= TELEMETRY_FIELD_SOIL;
-        else if (strcmp(s, "air_temperature_c") == 0) mask |= TELEMETRY_FIELD_TEMP;
-        else if (strcmp(s, "air_humidity_pct") == 0) mask |= TELEMETRY_FIELD_HUM;
-        else if (strcmp(s, "pressure_hpa") == 0) mask |= TELEMETRY_FIELD_PRESS;
-        else if (strcmp(s, "light_lux") == 0) mask |= TELEMETRY_FIELD_LIGHT;
-        else if (strcmp(s, "water_tank_ok") == 0) mask |= TELEMETRY_FIELD_WATER;
-    }
+    if (cJSON_IsString(field) && field->valuestring) mask |= field_from_name(field->valuestring);
 
     cJSON *fields = cJSON_GetObjectItem(root, "fields");
     if (cJSON_IsArray(fields)) {
@@ -145,13 +218,7 @@ static telemetry_fields_mask_t parse_fields_mask_from_json(cJSON *root) {
         for (int i = 0; i < n; i++) {
             cJSON *it = cJSON_GetArrayItem(fields, i);
             if (!cJSON_IsString(it) || !it->valuestring) continue;
-            const char *s = it->valuestring;
-            if (strcmp(s, "soil_moisture_pct") == 0) mask |= TELEMETRY_FIELD_SOIL;
-            else if (strcmp(s, "air_temperature_c") == 0) mask |= TELEMETRY_FIELD_TEMP;
-            else if (strcmp(s, "air_humidity_pct") == 0) mask |= TELEMETRY_FIELD_HUM;
-            else if (strcmp(s, "pressure_hpa") == 0) mask |= TELEMETRY_FIELD_PRESS;
-            else if (strcmp(s, "light_lux") == 0) mask |= TELEMETRY_FIELD_LIGHT;
-            else if (strcmp(s, "water_tank_ok") == 0) mask |= TELEMETRY_FIELD_WATER;
+            mask |= field_from_name(it->valuestring);
         }
     }
 
@@ -160,177 +227,198 @@ static telemetry_fields_mask_t parse_fields_mask_from_json(cJSON *root) {
     return mask;
 }
 
-void check_thresholds(telemetry_data_t *data) {
-    if (!mqtt_app_is_connected()) return;
+static uint32_t max_age_from_json(const cJSON *v) {
+    double ms = v->valuedouble;
+    if (ms < 0) return 0;
+    if (ms > UINT32_MAX) return UINT32_MAX;
+    return (uint32_t)ms;
+}
 
-    // 1. Temperatura
-    if (value_available_float(data->temp) && data->temp < settings.temp_min) {
-        if (!alert_temp_so_far) {
-            char msg[64];
-            snprintf(msg, sizeof(msg), "Temp %.1f C < min %.1f C", data->temp, settings.temp_min);
-            mqtt_app_send_alert("temperature_low", msg);
-            alert_temp_so_far = true;
+// Dopuszczalny wiek próbki: {"max_age_ms":5000} dla wszystkich pól albo
+// {"max_age_ms":{"light_lux":60000,"air_temperature_c":0}}; brak = CONFIG_SENSOR_READ_MAX_AGE_MS.
+static void parse_max_age_from_json(cJSON *root, uint32_t max_age_ms[TELEMETRY_FIELD_COUNT]) {
+    for (int i = 0; i < TELEMETRY_FIELD_COUNT; i++) max_age_ms[i] = CONFIG_SENSOR_READ_MAX_AGE_MS;
+
+    cJSON *age = root ? cJSON_GetObjectItem(root, "max_age_ms") : NULL;
+    if (cJSON_IsNumber(age)) {
+        for (int i = 0; i < TELEMETRY_FIELD_COUNT; i++) max_age_ms[i] = max_age_from_json(age);
+    } else if (cJSON_IsObject(age)) {
+        const cJSON *it;
+        cJSON_ArrayForEach(it, age) {
+            telemetry_fields_mask_t f = it->string ? field_from_name(it->string) : 0;
+            if (!f || !cJSON_IsNumber(it)) continue;
+            max_age_ms[__builtin_ctz(f)] = max_age_from_json(it);
         }
-    } else {
-        alert_temp_so_far = false;
     }
+}
 
-    if (value_available_float(data->temp) && data->temp > settings.temp_max) {
-        if (!alert_temp_high_so_far) {
-            char msg[64];
-            snprintf(msg, sizeof(msg), "Temp %.1f C > max %.1f C", data->temp, settings.temp_max);
-            mqtt_app_send_alert("temperature_high", msg);
-            alert_temp_high_so_far = true;
-        }
-    } else {
-        alert_temp_high_so_far = false;
-    }
+static void send_threshold_alert(const threshold_rule_t *rule, float value, void *ctx) {
+    char msg[64];
+    snprintf(msg, sizeof(msg), rule->fmt, value, rule->limit);
+    mqtt_app_send_alert(rule->code, msg);
+}
 
-    // 2. Wilgotność
-    if (value_available_float(data->humidity) && data->humidity < settings.hum_min) {
-        if (!alert_hum_so_far) {
-            char msg[64];
-            snprintf(msg, sizeof(msg), "Hum %.1f %% < min %.1f %%", data->humidity, settings.hum_min);
-            mqtt_app_send_alert("humidity_low", msg);
-            alert_hum_so_far = true;
-        }
-    } else {
-        alert_hum_so_far = false;
-    }
+void check_thresholds(telemetry_data_t *data) {
+    if (!mqtt_app_is_connected()) return;
 
-    if (value_available_float(data->humidity) && data->humidity > settings.hum_max) {
-        if (!alert_hum_high_so_far) {
-            char msg[64];
-            snprintf(msg, sizeof(msg), "Hum %.1f %% > max %.1f %%", data->humidity, settings.hum_max);
-            mqtt_app_send_alert("humidity_high", msg);
-            alert_hum_high_so_far = true;
-        }
-    } else {
-        alert_hum_high_so_far = false;
-    }
+    float values[TELEMETRY_FIELD_COUNT];
+    threshold_engine_values(data, values);
 
-    // 3. Gleba
-    if (value_available_soil(data->soil_moisture) && data->soil_moisture < settings.soil_min) {
-        if (!alert_soil_so_far) {
-            char msg[64];
-            snprintf(msg, sizeof(msg), "Soil %d %% < min %d %%", data->soil_moisture, settings.soil_min);
-            mqtt_app_send_alert("soil_moisture_low", msg);
-            alert_soil_so_far = true;
-        }
-    } else {
-        alert_soil_so_far = false;
-    }
+    xSemaphoreTake(s_rules_lock, portMAX_DELAY);
+    threshold_engine_eval(&s_thresholds, values, esp_log_timestamp(), send_threshold_alert, NULL);
+    xSemaphoreGive(s_rules_lock);
+}
 
-    if (value_available_soil(data->soil_moisture) && data->soil_moisture > settings.soil_max) {
-        if (!alert_soil_high_so_far) {
-            char msg[64];
-            snprintf(msg, sizeof(msg), "Soil %d %% > max %d %%", data->soil_moisture, settings.soil_max);
-            mqtt_app_send_alert("soil_moisture_high", msg);
-            alert_soil_high_so_far = true;
-        }
-    } else {
-        alert_soil_high_so_far = false;
-    }
+// Zdarzenie progu z VEML7700 (task light_int). Powrót do przedziału (z histerezą) wykrywa
+// check_thresholds - reguły światła są wtedy THRESHOLD_RULE_EXTERNAL.
+static void on_light_threshold(bool high, float lux) {
+    if (!mqtt_app_is_connected()) return;
 
-    // 4. Światło
-    if (value_available_float(data->light_lux) && data->light_lux < settings.light_min) {
-        if (!alert_light_so_far) {
-            char msg[64];
-            snprintf(msg, sizeof(msg), "Light %.1f lux < min %.1f lux", data->light_lux, settings.light_min);
-            mqtt_app_send_alert("light_low", msg);
-            alert_light_so_far = true;
-        }
-    } else {
-        alert_light_so_far = false;
-    }
+    size_t rule = high ? RULE_LIGHT_HIGH : RULE_LIGHT_LOW;
+    xSemaphoreTake(s_rules_lock, portMAX_DELAY);
+    if (threshold_engine_trigger(&s_thresholds, rule)) send_threshold_alert(&s_rules[rule], lux, NULL);
+    xSemaphoreGive(s_rules_lock);
+}
 
-    if (value_available_float(data->light_lux) && data->light_lux > settings.light_max) {
-        if (!alert_light_high_so_far) {
-            char msg[64];
-            snprintf(msg, sizeof(msg), "Light %.1f lux > max %.1f lux", data->light_lux, settings.light_max);
-            mqtt_app_send_alert("light_high", msg);
-            alert_light_high_so_far = true;
-        }
-    } else {
-        alert_light_high_so_far = false;
-    }
+// Programuje light_min/light_max w czujniku; bez VEML7700 zostaje porównanie w check_thresholds
+static void apply_light_thresholds(void) {
+    s_light_hw_thresholds = sensors_set_light_thresholds(settings.light_min, settings.light_max, on_light_threshold) == ESP_OK;
+    build_threshold_rules();
+    xSemaphoreTake(s_rules_lock, portMAX_DELAY);
+    threshold_engine_clear(&s_thresholds, RULE_LIGHT_LOW);
+    threshold_engine_clear(&s_thresholds, RULE_LIGHT_HIGH);
+    xSemaphoreGive(s_rules_lock);
+}
 
-    // 5. Woda
-    if (data->water_ok == 1) { // 1 = ALARM
-        if (!alert_water_so_far) {
-            mqtt_app_send_alert("water_level_critical", "Refill water tank!");
-            alert_water_so_far = true;
-        }
-    } else {
-         alert_water_so_far = false;
+// Zbiornik opróżnił się / napełnił (task water_mon). Pompy wyłączamy tu, od razu - alerty
+// o przerwanym podlewaniu idą zdarzeniami pump_ctrl.
+static void on_water_level_changed(bool empty) {
+    if (!empty) {
+        xSemaphoreTake(s_rules_lock, portMAX_DELAY);
+        threshold_engine_clear(&s_thresholds, RULE_WATER);
+        xSemaphoreGive(s_rules_lock);
+        return;
     }
-}
+    pump_ctrl_abort_all();
 
-static void watering_task(void *pvParameters) {
-    watering_req_t req;
-    while (xQueueReceive(watering_req_queue, &req, portMAX_DELAY) == pdTRUE) {
-        char details[64];
-        snprintf(details, sizeof(details), "{\"duration\":%d,\"source\":\"%s\"}", req.duration, req.source);
-        
-        // Alert notify start
-        // Uwaga: wysyłanie alertu jest thread-safe (używa kolejki wewnętrznej w mqtt_app)
-        if (strcmp(req.source, "auto") == 0) {
-            mqtt_app_send_alert2_details("auto_watering_started", "info", "system", "Auto-watering started", details);
-        } else {
-            mqtt_app_send_alert2("command.watering_started", "info", "command", "Watering started");
-        }
+    if (!mqtt_app_is_connected()) return;
+    xSemaphoreTake(s_rules_lock, portMAX_DELAY);
+    if (threshold_engine_trigger(&s_thresholds, RULE_WATER)) send_threshold_alert(&s_rules[RULE_WATER], 1.0f, NULL);
+    xSemaphoreGive(s_rules_lock);
+}
 
-        ESP_LOGI(TAG, "START PODLEWANIA (%s, %d s)", req.source, req.duration);
-        gpio_set_level(PUMP_GPIO, 1);
-        
-        // Delay blokujący (teraz blokujemy TYLKO ten task, nie MQTT)
-        vTaskDelay(pdMS_TO_TICKS(req.duration * 1000));
-        
-        gpio_set_level(PUMP_GPIO, 0);
-        ESP_LOGI(TAG, "STOP PODLEWANIA");
-
-        // Alert notify stop
-        if (strcmp(req.source, "auto") == 0) {
-            mqtt_app_send_alert2("auto_watering_finished", "info", "system", "Auto-watering finished");
-        } else {
-            mqtt_app_send_alert2("command.watering_finished", "info", "command", "Watering finished");
-        }
+static const char *const k_pump_event_names[] = {
+    [PUMP_EVT_QUEUED] = "queued",
+    [PUMP_EVT_STARTED] = "started",
+    [PUMP_EVT_FINISHED] = "finished",
+    [PUMP_EVT_CANCELLED] = "cancelled",
+    [PUMP_EVT_PREEMPTED] = "preempted",
+    [PUMP_EVT_DROPPED] = "dropped",
+    [PUMP_EVT_ABORTED] = "aborted",
+    [PUMP_EVT_SKIPPED] = "skipped",
+};
 
+// Zdarzenia sterownika pomp (task pump_evt): stan na pump/state + dotychczasowe alerty podlewania
+static void on_pump_event(const pump_event_t *e) {
+    bool manual = (e->prio == PUMP_PRIO_MANUAL);
+    bool ended = e->type == PUMP_EVT_FINISHED || e->type == PUMP_EVT_CANCELLED ||
+                 e->type == PUMP_EVT_PREEMPTED || e->type == PUMP_EVT_ABORTED;
+    int64_t mono_ms = esp_timer_get_time() / 1000;
+    if (e->type == PUMP_EVT_STARTED) irrigation_on_pump_start(e->zone, mono_ms, e->job_id, e->duration_ms);
+    if (ended) {
+        irrigation_on_pump_stop(e->zone, mono_ms, e->job_id, e->ran_ms);
         struct timeval tv;
         gettimeofday(&tv, NULL);
-        last_water_time = (int64_t)tv.tv_sec * 1000 + (tv.tv_usec / 1000);
+        int64_t now = (int64_t)tv.tv_sec * 1000 + (tv.tv_usec / 1000);
+        portENTER_CRITICAL(&s_water_time_mux);
+        last_water_time = now;
+        portEXIT_CRITICAL(&s_water_time_mux);
     }
-}
 
-static void perform_watering(int duration, const char* source) {
-    if (watering_req_queue) {
-        watering_req_t req;
-        req.duration = duration;
-        strlcpy(req.source, source, sizeof(req.source));
-        
-        if (xQueueSend(watering_req_queue, &req, 0) != pdTRUE) {
-            ESP_LOGW(TAG, "Watering queue full! Ignored request source=%s", source);
-        } else {
-            ESP_LOGI(TAG, "Watering request queued (source=%s, duration=%d)", source, duration);
-        }
+    char json[192];
+    snprintf(json, sizeof(json),
+             "{\"zone\":%u,\"event\":\"%s\",\"source\":\"%s\",\"job\":%lu,\"duration_ms\":%lu,\"ran_ms\":%lu,\"queued\":%u,\"active\":%u}",
+             e->zone, k_pump_event_names[e->type], manual ? "manual" : "auto", (unsigned long)e->job_id,
+             (unsigned long)e->duration_ms, (unsigned long)e->ran_ms, e->queued, e->active);
+    mqtt_app_publish_to_subpath("pump/state", json, 1);
+
+    char details[96];
+    snprintf(details, sizeof(details), "{\"duration\":%lu,\"source\":\"%s\",\"zone\":%u}",
+             (unsigned long)(e->duration_ms / 1000), manual ? "manual" : "auto", e->zone);
+    switch (e->type) {
+        case PUMP_EVT_STARTED:
+            if (manual) mqtt_app_send_alert2("command.watering_started", "info", "command", "Watering started");
+            else mqtt_app_send_alert2_details("auto_watering_started", "info", "system", "Auto-watering started", details);
+            break;
+        case PUMP_EVT_FINISHED:
+            if (manual) mqtt_app_send_alert2("command.watering_finished", "info", "command", "Watering finished");
+            else mqtt_app_send_alert2("auto_watering_finished", "info", "system", "Auto-watering finished");
+            break;
+        case PUMP_EVT_CANCELLED:
+            mqtt_app_send_alert2_details("watering.cancelled", "info", "command", "Watering cancelled", details);
+            break;
+        case PUMP_EVT_PREEMPTED:
+            mqtt_app_send_alert2_details("watering.preempted", "info", "system", "Watering preempted by higher priority request", details);
+            break;
+        case PUMP_EVT_DROPPED:
+            mqtt_app_send_alert2_details("watering.dropped", "warning", "system", "Queued watering dropped for higher priority request", details);
+            break;
+        case PUMP_EVT_ABORTED:
+            mqtt_app_send_alert2_details("watering.aborted_tank_empty", "warning", "system", "Watering aborted: water tank empty", details);
+            break;
+        case PUMP_EVT_SKIPPED:
+            mqtt_app_send_alert2_details("watering.skipped_tank_empty", "warning", "system", "Watering skipped: water tank empty", details);
+            break;
+        default:
+            break;
     }
 }
 
 void publish_settings(void) {
     if (!mqtt_app_is_connected()) return;
 
+    device_settings_t set;
+    settings_snapshot(&set);
+
     cJSON *root = cJSON_CreateObject();
-    if (value_available_float(settings.temp_min)) cJSON_AddNumberToObject(root, "temp_min", settings.temp_min);
-    if (value_available_float(settings.temp_max)) cJSON_AddNumberToObject(root, "temp_max", settings.temp_max);
-    if (value_available_float(settings.hum_min)) cJSON_AddNumberToObject(root, "hum_min", settings.hum_min);
-    if (value_available_float(settings.hum_max)) cJSON_AddNumberToObject(root, "hum_max", settings.hum_max);
-    if (value_available_soil(settings.soil_min)) cJSON_AddNumberToObject(root, "soil_min", settings.soil_min);
-    if (value_available_soil(settings.soil_max)) cJSON_AddNumberToObject(root, "soil_max", settings.soil_max);
-    if (value_available_float(settings.light_min)) cJSON_AddNumberToObject(root, "light_min", settings.light_min);
-    if (value_available_float(settings.light_max)) cJSON_AddNumberToObject(root, "light_max", settings.light_max);
+    if (value_available_float(set.temp_min)) cJSON_AddNumberToObject(root, "temp_min", set.temp_min);
+    if (value_available_float(set.temp_max)) cJSON_AddNumberToObject(root, "temp_max", set.temp_max);
+    if (value_available_float(set.hum_min)) cJSON_AddNumberToObject(root, "hum_min", set.hum_min);
+    if (value_available_float(set.hum_max)) cJSON_AddNumberToObject(root, "hum_max", set.hum_max);
+    if (value_available_soil(set.soil_min)) cJSON_AddNumberToObject(root, "soil_min", set.soil_min);
+    if (value_available_soil(set.soil_max)) cJSON_AddNumberToObject(root, "soil_max", set.soil_max);
+    if (value_available_float(set.light_min)) cJSON_AddNumberToObject(root, "light_min", set.light_min);
+    if (value_available_float(set.light_max)) cJSON_AddNumberToObject(root, "light_max", set.light_max);
     
-    cJSON_AddNumberToObject(root, "watering_duration_sec", settings.watering_duration_sec);
-    cJSON_AddNumberToObject(root, "measurement_interval_sec", settings.measurement_interval_sec);
+    cJSON_AddNumberToObject(root, "watering_duration_sec", set.watering_duration_sec);
+    cJSON_AddNumberToObject(root, "measurement_interval_sec", set.measurement_interval_sec);
+    cJSON_AddStringToObject(root, "telemetry_encoding", set.telemetry_encoding == TELEMETRY_ENCODING_BINARY ? "binary" : "json");
+
+    // Histereza i czas utrzymania progów dla pól z progami (ciśnienie i woda ich nie mają)
+    cJSON *hyst = cJSON_AddObjectToObject(root, "hysteresis");
+    cJSON *dwell = cJSON_AddObjectToObject(root, "dwell_sec");
+    for (int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+        if ((1u << i) & (TELEMETRY_FIELD_PRESS | TELEMETRY_FIELD_WATER)) continue;
+        cJSON_AddNumberToObject(hyst, k_field_names[i], set.hysteresis[i]);
+        cJSON_AddNumberToObject(dwell, k_field_names[i], set.dwell_sec[i]);
+    }
+
+    // Zapisy ustawień w NVS (zmiany są łączone - backend może wysyłać ustawienia wielokrotnie)
+    settings_store_stats_t store;
+    settings_store_get_stats(&store);
+    cJSON *st = cJSON_AddObjectToObject(root, "settings_store");
+    cJSON_AddNumberToObject(st, "schema", SETTINGS_SCHEMA_VERSION);
+    cJSON_AddNumberToObject(st, "nvs_writes", store.writes);
+    cJSON_AddNumberToObject(st, "nvs_writes_avoided", store.writes_avoided);
+
+    // Wyuczony model podlewania (tylko do odczytu)
+    irrigation_model_t model;
+    irrigation_get_model(0, &model);
+    cJSON *irr = cJSON_AddObjectToObject(root, "irrigation");
+    cJSON_AddNumberToObject(irr, "gain_pct_per_s", model.gain);
+    cJSON_AddNumberToObject(irr, "decay_pct_per_h", model.decay);
+    cJSON_AddNumberToObject(irr, "soak_s", model.soak_s);
+    cJSON_AddNumberToObject(irr, "doses", model.doses);
 
     char *json_str = cJSON_PrintUnformatted(root);
     if (json_str) {
@@ -341,216 +429,431 @@ void publish_settings(void) {
     cJSON_Delete(root);
 }
 
-void process_incoming_data(const char *topic, const char *payload, int len) {
-    // Sprawdzenie czy to komenda czy progi
-    if (strstr(topic, "/command/water")) {
-        ESP_LOGI(TAG, "Odebrano komendę podlewania: %s", payload);
-        cJSON *root = cJSON_Parse(payload);
-        if (root) {
-            int duration = settings.watering_duration_sec; // Domyślnie z ustawień
-            cJSON *d = cJSON_GetObjectItem(root, "duration");
-            if (cJSON_IsNumber(d)) duration = d->valueint;
-
-            int requested = duration;
-            const int max_duration_s = 60;
-            if (duration < 1) duration = 1;
-            if (duration > max_duration_s) duration = max_duration_s;
-
-            if (requested != duration) {
-                uint32_t suppressed = 0;
-                if (alert_limiter_allow("command.watering_duration_clamped", esp_log_timestamp(), 10 * 1000, &suppressed)) {
-                    char details[128];
-                    snprintf(details, sizeof(details), "{\"requested\":%d,\"used\":%d,\"suppressed\":%lu}", requested, duration, (unsigned long)suppressed);
-                    mqtt_app_send_alert2_details("command.watering_duration_clamped", "warning", "command", "Watering duration clamped", details);
-                }
-            }
+// Wspólne pola komendy: adres odpowiedzi i opcjonalne "id" z payloadu
+static void command_init(command_t *cmd, const char *name, command_exec_t exec, cJSON *root, const mqtt_reply_to_t *reply_to) {
+    memset(cmd, 0, sizeof(*cmd));
+    cmd->name = name;
+    cmd->exec = exec;
+    cmd->reply_to = *reply_to;
+    cJSON *id = root ? cJSON_GetObjectItem(root, "id") : NULL;
+    if (cJSON_IsString(id) && id->valuestring) strlcpy(cmd->id, id->valuestring, sizeof(cmd->id));
+}
+
+// Wykonanie komend (task command_worker)
+
+static void exec_command_water(const command_t *cmd) {
+    if (water_monitor_is_empty()) {
+        command_worker_respond(cmd, "rejected", "{\"reason\":\"tank_empty\"}");
+        return;
+    }
+    uint32_t job = 0;
+    bool started = false;
+    esp_err_t err = pump_ctrl_submit(cmd->arg.water.zone, PUMP_PRIO_MANUAL, (uint32_t)cmd->arg.water.duration_s * 1000, &job, &started);
+
+    char result[64];
+    snprintf(result, sizeof(result), "{\"duration\":%d,\"zone\":%d,\"job\":%lu}", cmd->arg.water.duration_s,
+             cmd->arg.water.zone, (unsigned long)job);
+    if (err != ESP_OK) {
+        command_worker_respond(cmd, "busy", result); // kolejka strefy pełna zleceń ręcznych
+        return;
+    }
+    // Start czekający na wolną pompę (budżet zasilania) - "queued"; dalej zdarzenia na pump/state.
+    // Brak wody w trakcie podlewania zgłasza water_monitor (on_water_level_changed)
+    command_worker_respond(cmd, started ? "started" : "queued", result);
+}
+
+static void exec_command_stop(const command_t *cmd) {
+    char result[32];
+    snprintf(result, sizeof(result), "{\"stopped\":%d}", pump_ctrl_stop(cmd->arg.water.zone));
+    command_worker_respond(cmd, "done", result);
+}
+
+static void exec_command_read(const command_t *cmd) {
+    telemetry_data_t data;
+    uint32_t age_ms = 0;
+    sensors_read_fresh(&cmd->arg.read, &data, &age_ms);
+    sensors_resolve_raw(&data, 1);
+    check_thresholds(&data);
+    mqtt_app_send_telemetry_masked(&data, cmd->arg.read.fields);
+
+    char result[32];
+    snprintf(result, sizeof(result), "{\"age_ms\":%lu}", (unsigned long)age_ms);
+    command_worker_respond(cmd, "done", result);
+}
+
+static void exec_settings_reset(const command_t *cmd) {
+    // Przywrócenie domyślnych
+    xSemaphoreTake(s_settings_lock, portMAX_DELAY);
+    settings.temp_min = -INFINITY;
+    settings.temp_max = INFINITY;
+    settings.hum_min = -INFINITY;
+    settings.hum_max = INFINITY;
+    settings.soil_min = INT_MIN;
+    settings.soil_max = INT_MAX;
+    settings.light_min = -INFINITY;
+    settings.light_max = INFINITY;
+    settings.watering_duration_sec = 5;
+    settings.measurement_interval_sec = 60;
+    settings.telemetry_encoding = TELEMETRY_ENCODING_JSON;
+    memcpy(settings.hysteresis, k_default_hysteresis, sizeof(settings.hysteresis));
+    memset(settings.dwell_sec, 0, sizeof(settings.dwell_sec));
+    xSemaphoreGive(s_settings_lock);
+    mqtt_app_set_telemetry_encoding(TELEMETRY_ENCODING_JSON);
+    apply_light_thresholds();
+
+    settings_store_mark_dirty();
+    ESP_LOGI(TAG, "Ustawienia zresetowane do domyślnych.");
+    publish_settings();
+    command_worker_respond(cmd, "done", NULL);
+}
+
+// Payload sparsowany w handle_settings; walidacja i zmiana tutaj, po kolei z settings/reset -
+// częściowy update zawsze liczony od ostatnio zastosowanych ustawień
+static void exec_settings_update(const command_t *cmd) {
+    cJSON *root = cmd->arg.json;
+    device_settings_t new_set = settings;
 
-            perform_watering(duration, "manual");
+    bool has_temp_min = false, has_temp_max = false;
+    bool has_hum_min = false, has_hum_max = false;
+    bool has_soil_min = false, has_soil_max = false;
+    bool has_light_min = false, has_light_max = false;
+
+    cJSON *item;
+
+    item = cJSON_GetObjectItem(root, "temp_min");
+    if (cJSON_IsNumber(item)) {
+        new_set.temp_min = (float)item->valuedouble;
+        has_temp_min = true;
+    }
+    item = cJSON_GetObjectItem(root, "temp_max");
+    if (cJSON_IsNumber(item)) {
+        new_set.temp_max = (float)item->valuedouble;
+        has_temp_max = true;
+    }
+
+    item = cJSON_GetObjectItem(root, "hum_min");
+    if (cJSON_IsNumber(item)) {
+        new_set.hum_min = (float)item->valuedouble;
+        has_hum_min = true;
+    }
+    item = cJSON_GetObjectItem(root, "hum_max");
+    if (cJSON_IsNumber(item)) {
+        new_set.hum_max = (float)item->valuedouble;
+        has_hum_max = true;
+    }
+
+    item = cJSON_GetObjectItem(root, "soil_min");
+    if (cJSON_IsNumber(item)) {
+        new_set.soil_min = item->valueint;
+        has_soil_min = true;
+    }
+    item = cJSON_GetObjectItem(root, "soil_max");
+    if (cJSON_IsNumber(item)) {
+        new_set.soil_max = item->valueint;
+        has_soil_max = true;
+    }
+
+    item = cJSON_GetObjectItem(root, "light_min");
+    if (cJSON_IsNumber(item)) {
+        new_set.light_min = (float)item->valuedouble;
+        has_light_min = true;
+    }
+    item = cJSON_GetObjectItem(root, "light_max");
+    if (cJSON_IsNumber(item)) {
+        new_set.light_max = (float)item->valuedouble;
+        has_light_max = true;
+    }
+
+    // Czas podlewania
+    item = cJSON_GetObjectItem(root, "watering_duration_sec");
+    if (cJSON_IsNumber(item)) {
+        new_set.watering_duration_sec = item->valueint;
+    }
+
+    // Częstotliwość pomiarów
+    item = cJSON_GetObjectItem(root, "measurement_interval_sec");
+    if (cJSON_IsNumber(item)) {
+        new_set.measurement_interval_sec = item->valueint;
+    }
 
-            // Po podlewaniu sprawdź wodę
-            int w_ok;
-            sensors_get_water_status(&w_ok);
-            if (w_ok == 1) {
-                mqtt_app_send_alert("water_level_critical", "Refill water tank!");
+    // Kodowanie telemetrii: "json" | "binary"
+    item = cJSON_GetObjectItem(root, "telemetry_encoding");
+    if (cJSON_IsString(item)) {
+        if (strcmp(item->valuestring, "binary") == 0) new_set.telemetry_encoding = TELEMETRY_ENCODING_BINARY;
+        else if (strcmp(item->valuestring, "json") == 0) new_set.telemetry_encoding = TELEMETRY_ENCODING_JSON;
+    }
+
+    // Histereza / czas utrzymania per pole: {"hysteresis":{"air_temperature_c":0.5},"dwell_sec":{"soil_moisture_pct":600}}
+    const cJSON *it;
+    cJSON *hyst = cJSON_GetObjectItem(root, "hysteresis");
+    if (cJSON_IsObject(hyst)) {
+        cJSON_ArrayForEach(it, hyst) {
+            telemetry_fields_mask_t f = it->string ? field_from_name(it->string) : 0;
+            if (f && cJSON_IsNumber(it) && it->valuedouble >= 0) new_set.hysteresis[FIELD_IDX(f)] = (float)it->valuedouble;
+        }
+    }
+    cJSON *dwell = cJSON_GetObjectItem(root, "dwell_sec");
+    if (cJSON_IsObject(dwell)) {
+        cJSON_ArrayForEach(it, dwell) {
+            telemetry_fields_mask_t f = it->string ? field_from_name(it->string) : 0;
+            if (f && cJSON_IsNumber(it) && it->valueint >= 0) {
+                new_set.dwell_sec[FIELD_IDX(f)] = it->valueint > 86400 ? 86400 : (uint32_t)it->valueint;
             }
+        }
+    }
+
+    // Semantyka przedziału: jeśli podano tylko min => max = +inf; jeśli tylko max => min = -inf
+    if (has_temp_min && !has_temp_max) new_set.temp_max = INFINITY;
+    if (has_temp_max && !has_temp_min) new_set.temp_min = -INFINITY;
+
+    if (has_hum_min && !has_hum_max) new_set.hum_max = INFINITY;
+    if (has_hum_max && !has_hum_min) new_set.hum_min = -INFINITY;
+
+    if (has_soil_min && !has_soil_max) new_set.soil_max = INT_MAX;
+    if (has_soil_max && !has_soil_min) new_set.soil_min = INT_MIN;
+
+    if (has_light_min && !has_light_max) new_set.light_max = INFINITY;
+    if (has_light_max && !has_light_min) new_set.light_min = -INFINITY;
+
+    // Walidacja: min <= max. Jeśli nie, odrzucamy cały update i zostawiamy poprzednie progi.
+    bool valid = true;
+    if (new_set.temp_min > new_set.temp_max) valid = false;
+    if (new_set.hum_min > new_set.hum_max) valid = false;
+    if (new_set.soil_min > new_set.soil_max) valid = false;
+    if (new_set.light_min > new_set.light_max) valid = false;
+
+    if (new_set.watering_duration_sec < 1) new_set.watering_duration_sec = 1;
+    if (new_set.measurement_interval_sec < 5) new_set.measurement_interval_sec = 5; // Min 5 sekund
+
+    if (!valid) {
+        ESP_LOGW(TAG,
+                 "Odrzucono update ustawień (min > max). Otrzymano: T[%.2f..%.2f], H[%.2f..%.2f], S[%d..%d], L[%.2f..%.2f]",
+                 new_set.temp_min, new_set.temp_max,
+                 new_set.hum_min, new_set.hum_max,
+                 new_set.soil_min, new_set.soil_max,
+                 new_set.light_min, new_set.light_max);
+
+        uint32_t suppressed = 0;
+        if (alert_limiter_allow("settings.rejected", esp_log_timestamp(), 10 * 1000, &suppressed)) {
+            char details[256];
+            snprintf(details, sizeof(details),
+                     "{\"temp\":[%.1f,%.1f],\"hum\":[%.1f,%.1f],\"soil\":[%d,%d],\"light\":[%.1f,%.1f],\"suppressed\":%lu}",
+                     new_set.temp_min, new_set.temp_max,
+                     new_set.hum_min, new_set.hum_max,
+                     new_set.soil_min, new_set.soil_max,
+                     new_set.light_min, new_set.light_max,
+                     (unsigned long)suppressed);
+            mqtt_app_send_alert2_details("settings.rejected", "warning", "command", "Rejected settings update (min > max)", details);
+        }
+        command_worker_respond(cmd, "rejected", "{\"reason\":\"min_gt_max\"}");
+    } else {
+        xSemaphoreTake(s_settings_lock, portMAX_DELAY);
+        settings = new_set;
+        xSemaphoreGive(s_settings_lock);
+        mqtt_app_set_telemetry_encoding((telemetry_encoding_t)new_set.telemetry_encoding);
+        apply_light_thresholds();
+        ESP_LOGI(TAG, "Zaktualizowano ustawienia.");
+        settings_store_mark_dirty();
+        publish_settings(); // send back new state
+        command_worker_respond(cmd, "done", NULL);
+    }
+    cJSON_Delete(root);
+}
+
+// Kompilacja reguł i zapis w NVS; kształt payloadu ("rules" jako tablica <= AUTOMATION_RULES_MAX)
+// sprawdził już handle_automation
+static void exec_automation(const command_t *cmd) {
+    cJSON *root = cmd->arg.json;
+    cJSON *list = cJSON_GetObjectItem(root, "rules");
+
+    automation_rule_t rules[AUTOMATION_RULES_MAX];
+    size_t n = 0, code_bytes = 0;
+    char result[128];
+    const cJSON *it;
+    cJSON_ArrayForEach(it, list) {
+        cJSON *when = cJSON_GetObjectItem(it, "when");
+        cJSON *water = cJSON_GetObjectItem(it, "water_sec");
+        cJSON *cooldown = cJSON_GetObjectItem(it, "cooldown_min");
+        automation_rule_t *r = &rules[n];
+
+        size_t pos = 0;
+        rule_vm_err_t err = cJSON_IsString(when) ? rule_vm_compile(when->valuestring, &r->prog, &pos) : RULE_VM_ERR_SYNTAX;
+        if (err != RULE_VM_OK) {
+            snprintf(result, sizeof(result), "{\"reason\":\"compile_error\",\"rule\":%u,\"error\":\"%s\",\"pos\":%u}",
+                     (unsigned)n, rule_vm_strerror(err), (unsigned)pos);
+            command_worker_respond(cmd, "rejected", result);
             cJSON_Delete(root);
-        } else {
-            uint32_t suppressed = 0;
-            if (alert_limiter_allow("command.invalid_json", esp_log_timestamp(), 10 * 1000, &suppressed)) {
-                char details[128];
-                snprintf(details, sizeof(details), "{\"topic\":\"water\",\"len\":%d,\"suppressed\":%lu}", len, (unsigned long)suppressed);
-                mqtt_app_send_alert2_details("command.invalid_json", "warning", "command", "Invalid JSON for command/water", details);
-            }
+            return;
         }
-    } 
-    else if (strstr(topic, "/command/read")) {
-        ESP_LOGI(TAG, "Odebrano komendę odczytu: %s", payload);
-        cJSON *root = cJSON_Parse(payload);
-        if (!root) {
+        int water_sec = cJSON_IsNumber(water) ? water->valueint : settings.watering_duration_sec;
+        int cooldown_min = cJSON_IsNumber(cooldown) ? cooldown->valueint : AUTO_WATER_COOLDOWN_MS / 60000;
+        r->water_sec = (uint16_t)(water_sec < 1 ? 1 : water_sec > MAX_WATERING_DURATION_S ? MAX_WATERING_DURATION_S : water_sec);
+        r->cooldown_min = (uint16_t)(cooldown_min < 0 ? 0 : cooldown_min > 10080 ? 10080 : cooldown_min);
+        code_bytes += r->prog.len;
+        n++;
+    }
+    cJSON_Delete(root);
+
+    esp_err_t err = automation_set(rules, n);
+    snprintf(result, sizeof(result), "{\"rules\":%u,\"code_bytes\":%u,\"saved\":%s}", (unsigned)n,
+             (unsigned)code_bytes, err == ESP_OK ? "true" : "false");
+    command_worker_respond(cmd, "done", result);
+}
+
+// --- Obsługa wiadomości przychodzących (rejestrowane w mqtt_app, dopasowanie po dokładnym topicu) ---
+// `payload` nie jest zakończony '\0' - parsujemy z długością. Komendy tylko walidujemy
+// i przekazujemy do command_worker, żeby nie blokować taska MQTT.
+
+static void handle_command_water(const char *payload, int len, const mqtt_reply_to_t *reply_to) {
+    ESP_LOGI(TAG, "Odebrano komendę podlewania: %.*s", len, payload);
+    cJSON *root = cJSON_ParseWithLength(payload, len);
+    if (root) {
+        device_settings_t set;
+        settings_snapshot(&set);
+        int duration = set.watering_duration_sec; // Domyślnie z ustawień
+        cJSON *d = cJSON_GetObjectItem(root, "duration");
+        if (cJSON_IsNumber(d)) duration = d->valueint;
+
+        int requested = duration;
+        if (duration < 1) duration = 1;
+        if (duration > MAX_WATERING_DURATION_S) duration = MAX_WATERING_DURATION_S;
+
+        if (requested != duration) {
             uint32_t suppressed = 0;
-            if (alert_limiter_allow("command.invalid_json", esp_log_timestamp(), 10 * 1000, &suppressed)) {
+            if (alert_limiter_allow("command.watering_duration_clamped", esp_log_timestamp(), 10 * 1000, &suppressed)) {
                 char details[128];
-                snprintf(details, sizeof(details), "{\"topic\":\"read\",\"len\":%d,\"suppressed\":%lu}", len, (unsigned long)suppressed);
-                mqtt_app_send_alert2_details("command.invalid_json", "warning", "command", "Invalid JSON for command/read; defaulting to all fields", details);
+                snprintf(details, sizeof(details), "{\"requested\":%d,\"used\":%d,\"suppressed\":%lu}", requested, duration, (unsigned long)suppressed);
+                mqtt_app_send_alert2_details("command.watering_duration_clamped", "warning", "command", "Watering duration clamped", details);
             }
         }
-        telemetry_fields_mask_t mask = parse_fields_mask_from_json(root);
 
-        telemetry_data_t data;
-        sensors_read(&data);
-        check_thresholds(&data);
-        mqtt_app_send_telemetry_masked(&data, mask);
+        command_t cmd;
+        command_init(&cmd, "water", exec_command_water, root, reply_to);
+        cJSON *zone = cJSON_GetObjectItem(root, "zone");
+        cmd.arg.water.zone = cJSON_IsNumber(zone) ? zone->valueint : 0;
+        cmd.arg.water.duration_s = duration;
+        cJSON_Delete(root);
+        if (cmd.arg.water.zone < 0 || cmd.arg.water.zone >= pump_ctrl_zone_count()) {
+            command_worker_respond(&cmd, "rejected", "{\"reason\":\"invalid_zone\"}");
+            return;
+        }
+        command_worker_submit(COMMAND_PRIO_HIGH, &cmd);
+    } else {
+        uint32_t suppressed = 0;
+        if (alert_limiter_allow("command.invalid_json", esp_log_timestamp(), 10 * 1000, &suppressed)) {
+            char details[128];
+            snprintf(details, sizeof(details), "{\"topic\":\"water\",\"len\":%d,\"suppressed\":%lu}", len, (unsigned long)suppressed);
+            mqtt_app_send_alert2_details("command.invalid_json", "warning", "command", "Invalid JSON for command/water", details);
+        }
+        command_t cmd;
+        command_init(&cmd, "water", exec_command_water, NULL, reply_to);
+        command_worker_respond(&cmd, "rejected", "{\"reason\":\"invalid_json\"}");
+    }
+}
 
-        if (root) cJSON_Delete(root);
+static void handle_command_read(const char *payload, int len, const mqtt_reply_to_t *reply_to) {
+    ESP_LOGI(TAG, "Odebrano komendę odczytu: %.*s", len, payload);
+    cJSON *root = cJSON_ParseWithLength(payload, len);
+    if (!root) {
+        uint32_t suppressed = 0;
+        if (alert_limiter_allow("command.invalid_json", esp_log_timestamp(), 10 * 1000, &suppressed)) {
+            char details[128];
+            snprintf(details, sizeof(details), "{\"topic\":\"read\",\"len\":%d,\"suppressed\":%lu}", len, (unsigned long)suppressed);
+            mqtt_app_send_alert2_details("command.invalid_json", "warning", "command", "Invalid JSON for command/read; defaulting to all fields", details);
+        }
     }
-    else if (strstr(topic, "/settings/reset")) {
-        ESP_LOGI(TAG, "Odebrano komendę RESET ustawień.");
-        // Przywrócenie domyślnych
-        settings.temp_min = -INFINITY;
-        settings.temp_max = INFINITY;
-        settings.hum_min = -INFINITY;
-        settings.hum_max = INFINITY;
-        settings.soil_min = INT_MIN;
-        settings.soil_max = INT_MAX;
-        settings.light_min = -INFINITY;
-        settings.light_max = INFINITY;
-        settings.watering_duration_sec = 5;
-        settings.measurement_interval_sec = 60;
-        
-        save_settings_to_nvs();
-        ESP_LOGI(TAG, "Ustawienia zresetowane do domyślnych.");
-        publish_settings();
-    }
-    else if (strstr(topic, "/settings/get")) {
-        ESP_LOGI(TAG, "Odebrano żądanie GET ustawień.");
-        publish_settings();
-    }
-    else if (strstr(topic, "/settings")) {
-        ESP_LOGI(TAG, "Odebrano nowe ustawienia: %s", payload);
-        cJSON *root = cJSON_Parse(payload);
-        if (root) {
-            device_settings_t new_set = settings;
-
-            bool has_temp_min = false, has_temp_max = false;
-            bool has_hum_min = false, has_hum_max = false;
-            bool has_soil_min = false, has_soil_max = false;
-            bool has_light_min = false, has_light_max = false;
-
-            cJSON *item;
-
-            item = cJSON_GetObjectItem(root, "temp_min");
-            if (cJSON_IsNumber(item)) {
-                new_set.temp_min = (float)item->valuedouble;
-                has_temp_min = true;
-            }
-            item = cJSON_GetObjectItem(root, "temp_max");
-            if (cJSON_IsNumber(item)) {
-                new_set.temp_max = (float)item->valuedouble;
-                has_temp_max = true;
-            }
 
-            item = cJSON_GetObjectItem(root, "hum_min");
-            if (cJSON_IsNumber(item)) {
-                new_set.hum_min = (float)item->valuedouble;
-                has_hum_min = true;
-            }
-            item = cJSON_GetObjectItem(root, "hum_max");
-            if (cJSON_IsNumber(item)) {
-                new_set.hum_max = (float)item->valuedouble;
-                has_hum_max = true;
-            }
+    command_t cmd;
+    command_init(&cmd, "read", exec_command_read, root, reply_to);
+    cmd.arg.read.requested_us = esp_timer_get_time();
+    cmd.arg.read.fields = parse_fields_mask_from_json(root);
+    parse_max_age_from_json(root, cmd.arg.read.max_age_ms);
+    command_worker_submit(COMMAND_PRIO_LOW, &cmd);
 
-            item = cJSON_GetObjectItem(root, "soil_min");
-            if (cJSON_IsNumber(item)) {
-                new_set.soil_min = item->valueint;
-                has_soil_min = true;
-            }
-            item = cJSON_GetObjectItem(root, "soil_max");
-            if (cJSON_IsNumber(item)) {
-                new_set.soil_max = item->valueint;
-                has_soil_max = true;
-            }
+    if (root) cJSON_Delete(root);
+}
 
-            item = cJSON_GetObjectItem(root, "light_min");
-            if (cJSON_IsNumber(item)) {
-                new_set.light_min = (float)item->valuedouble;
-                has_light_min = true;
-            }
-            item = cJSON_GetObjectItem(root, "light_max");
-            if (cJSON_IsNumber(item)) {
-                new_set.light_max = (float)item->valuedouble;
-                has_light_max = true;
-            }
+// {"zone":N} zatrzymuje strefę i czyści jej kolejkę; bez "zone" (albo niepoprawny JSON) - wszystkie strefy
+static void handle_command_stop(const char *payload, int len, const mqtt_reply_to_t *reply_to) {
+    ESP_LOGI(TAG, "Odebrano komendę zatrzymania: %.*s", len, payload);
+    cJSON *root = cJSON_ParseWithLength(payload, len);
 
-            // Czas podlewania
-            item = cJSON_GetObjectItem(root, "watering_duration_sec");
-            if (cJSON_IsNumber(item)) {
-                new_set.watering_duration_sec = item->valueint;
-            }
+    command_t cmd;
+    command_init(&cmd, "stop", exec_command_stop, root, reply_to);
+    cJSON *zone = root ? cJSON_GetObjectItem(root, "zone") : NULL;
+    cmd.arg.water.zone = cJSON_IsNumber(zone) ? zone->valueint : PUMP_ZONE_ALL;
+    if (root) cJSON_Delete(root);
 
-            // Częstotliwość pomiarów
-            item = cJSON_GetObjectItem(root, "measurement_interval_sec");
-            if (cJSON_IsNumber(item)) {
-                new_set.measurement_interval_sec = item->valueint;
-            }
+    if (cmd.arg.water.zone != PUMP_ZONE_ALL && (cmd.arg.water.zone < 0 || cmd.arg.water.zone >= pump_ctrl_zone_count())) {
+        command_worker_respond(&cmd, "rejected", "{\"reason\":\"invalid_zone\"}");
+        return;
+    }
+    command_worker_submit(COMMAND_PRIO_HIGH, &cmd);
+}
 
-            // Semantyka przedziału: jeśli podano tylko min => max = +inf; jeśli tylko max => min = -inf
-            if (has_temp_min && !has_temp_max) new_set.temp_max = INFINITY;
-            if (has_temp_max && !has_temp_min) new_set.temp_min = -INFINITY;
-
-            if (has_hum_min && !has_hum_max) new_set.hum_max = INFINITY;
-            if (has_hum_max && !has_hum_min) new_set.hum_min = -INFINITY;
-
-            if (has_soil_min && !has_soil_max) new_set.soil_max = INT_MAX;
-            if (has_soil_max && !has_soil_min) new_set.soil_min = INT_MIN;
-
-            if (has_light_min && !has_light_max) new_set.light_max = INFINITY;
-            if (has_light_max && !has_light_min) new_set.light_min = -INFINITY;
-
-            // Walidacja: min <= max. Jeśli nie, odrzucamy cały update i zostawiamy poprzednie progi.
-            bool valid = true;
-            if (new_set.temp_min > new_set.temp_max) valid = false;
-            if (new_set.hum_min > new_set.hum_max) valid = false;
-            if (new_set.soil_min > new_set.soil_max) valid = false;
-            if (new_set.light_min > new_set.light_max) valid = false;
-
-            if (new_set.watering_duration_sec < 1) new_set.watering_duration_sec = 1;
-            if (new_set.measurement_interval_sec < 5) new_set.measurement_interval_sec = 5; // Min 5 sekund
-
-            if (!valid) {
-                ESP_LOGW(TAG,
-                         "Odrzucono update ustawień (min > max). Otrzymano: T[%.2f..%.2f], H[%.2f..%.2f], S[%d..%d], L[%.2f..%.2f]",
-                         new_set.temp_min, new_set.temp_max,
-                         new_set.hum_min, new_set.hum_max,
-                         new_set.soil_min, new_set.soil_max,
-                         new_set.light_min, new_set.light_max);
-
-                uint32_t suppressed = 0;
-                if (alert_limiter_allow("settings.rejected", esp_log_timestamp(), 10 * 1000, &suppressed)) {
-                    char details[256];
-                    snprintf(details, sizeof(details),
-                             "{\"temp\":[%.1f,%.1f],\"hum\":[%.1f,%.1f],\"soil\":[%d,%d],\"light\":[%.1f,%.1f],\"suppressed\":%lu}",
-                             new_set.temp_min, new_set.temp_max,
-                             new_set.hum_min, new_set.hum_max,
-                             new_set.soil_min, new_set.soil_max,
-                             new_set.light_min, new_set.light_max,
-                             (unsigned long)suppressed);
-                    mqtt_app_send_alert2_details("settings.rejected", "warning", "command", "Rejected settings update (min > max)", details);
-                }
-            } else {
-                settings = new_set;
-                ESP_LOGI(TAG, "Zaktualizowano ustawienia.");
-                save_settings_to_nvs();
-                publish_settings(); // send back new state
-            }
-            cJSON_Delete(root);
-        } else {
-            uint32_t suppressed = 0;
-            if (alert_limiter_allow("settings.invalid_json", esp_log_timestamp(), 10 * 1000, &suppressed)) {
-                char details[96];
-                snprintf(details, sizeof(details), "{\"len\":%d,\"suppressed\":%lu}", len, (unsigned long)suppressed);
-                mqtt_app_send_alert2_details("settings.invalid_json", "warning", "settings", "Invalid JSON for settings", details);
-            }
+static void handle_settings_reset(const char *payload, int len, const mqtt_reply_to_t *reply_to) {
+    ESP_LOGI(TAG, "Odebrano komendę RESET ustawień.");
+    cJSON *root = cJSON_ParseWithLength(payload, len); // opcjonalne "id"
+
+    command_t cmd;
+    command_init(&cmd, "settings_reset", exec_settings_reset, root, reply_to);
+    command_worker_submit(COMMAND_PRIO_NORMAL, &cmd);
+
+    if (root) cJSON_Delete(root);
+}
+
+// Reguły automatyzacji: {"rules":[{"when":"soil < 30 && hour >= 19","water_sec":10,"cooldown_min":30}]}.
+// Wszystkie reguły zastępują poprzednie; pusta lista = powrót do kryterium soil_min.
+static void handle_automation(const char *payload, int len, const mqtt_reply_to_t *reply_to) {
+    ESP_LOGI(TAG, "Odebrano reguły automatyzacji: %.*s", len, payload);
+    cJSON *root = cJSON_ParseWithLength(payload, len);
+
+    command_t cmd;
+    command_init(&cmd, "automation", exec_automation, root, reply_to);
+
+    cJSON *list = root ? cJSON_GetObjectItem(root, "rules") : NULL;
+    if (!cJSON_IsArray(list) || cJSON_GetArraySize(list) > AUTOMATION_RULES_MAX) {
+        command_worker_respond(&cmd, "rejected", root ? "{\"reason\":\"invalid_rules\"}" : "{\"reason\":\"invalid_json\"}");
+        if (root) cJSON_Delete(root);
+        return;
+    }
+    cmd.arg.json = root; // zwalnia exec_automation
+    if (command_worker_submit(COMMAND_PRIO_NORMAL, &cmd) != ESP_OK) cJSON_Delete(root);
+}
+
+static void handle_settings_get(const char *payload, int len, const mqtt_reply_to_t *reply_to) {
+    ESP_LOGI(TAG, "Odebrano żądanie GET ustawień.");
+    publish_settings();
+}
+
+static void handle_settings(const char *payload, int len, const mqtt_reply_to_t *reply_to) {
+    ESP_LOGI(TAG, "Odebrano nowe ustawienia: %.*s", len, payload);
+    cJSON *root = cJSON_ParseWithLength(payload, len);
+    if (root) {
+        command_t cmd;
+        command_init(&cmd, "settings", exec_settings_update, root, reply_to);
+        cmd.arg.json = root; // zwalnia exec_settings_update
+        if (command_worker_submit(COMMAND_PRIO_NORMAL, &cmd) != ESP_OK) cJSON_Delete(root);
+    } else {
+        uint32_t suppressed = 0;
+        if (alert_limiter_allow("settings.invalid_json", esp_log_timestamp(), 10 * 1000, &suppressed)) {
+            char details[96];
+            snprintf(details, sizeof(details), "{\"len\":%d,\"suppressed\":%lu}", len, (unsigned long)suppressed);
+            mqtt_app_send_alert2_details("settings.invalid_json", "warning", "settings", "Invalid JSON for settings", details);
+        }
+    }
+}
+
+// Podlewanie automatyczne w strefie 0. Zlecenie automatyczne, które już pracuje lub czeka, nie jest dublowane.
+static void auto_watering(int duration_s) {
+    esp_err_t err = pump_ctrl_submit(0, PUMP_PRIO_AUTO, (uint32_t)duration_s * 1000, NULL, NULL);
+    if (err == ESP_ERR_NO_MEM) {
+        ESP_LOGW(TAG, "Kolejka strefy 0 pełna - auto-podlewanie pominięte");
+        uint32_t suppressed = 0;
+        if (alert_limiter_allow("watering.queue_full", esp_log_timestamp(), 10 * 60 * 1000, &suppressed)) {
+            char details[64];
+            snprintf(details, sizeof(details), "{\"zone\":0,\"suppressed\":%lu}", (unsigned long)suppressed);
+            mqtt_app_send_alert2_details("watering.queue_full", "warning", "system", "Auto-watering skipped: zone queue full", details);
         }
     }
 }
@@ -560,35 +863,59 @@ TaskHandle_t publisher_task_handle = NULL;
 
 void publisher_task(void *pvParameters) {
     while (1) {
-        telemetry_data_t data;
+        telemetry_data_t data, rec;
+        device_settings_t set;
+        settings_snapshot(&set);
         
-        // 1. Odczyt sensorów
-        sensors_read(&data);
+        // 1. Odczyt sensorów (czujniki z własnym okresem - ostatnia próbka z tła).
+        // Offline BME280 zapisuje surowe rejestry - kompensacja hurtem dopiero przy wysyłce backlogu.
+        // Log na flashu trzyma wartości skompensowane, więc z nim surowy zapis nic nie daje.
+        sensors_set_bme_raw_capture(!mqtt_app_is_connected() && !telemetry_log_is_ready());
+        sensors_read_scheduled(&rec);
+        // Progi, reguły i model gleby liczą na wartościach skompensowanych - surowy zapis zmienia tylko rekord backlogu
+        data = rec;
+        sensors_resolve_raw(&data, 1);
 
         // 2. Weryfikacja progów
         check_thresholds(&data);
 
         // 3. Wysłanie danych (lub buforowanie jeśli offline)
         // Usunięto sprawdzenie mqtt_app_is_connected(), aby pozwolić na buforowanie wewnątrz funkcji
-        mqtt_app_send_telemetry(&data);
+        mqtt_app_send_telemetry(&rec);
 
         // Autopodlewanie logic
         struct timeval tv;
         gettimeofday(&tv, NULL);
         int64_t now = (int64_t)tv.tv_sec * 1000 + (tv.tv_usec / 1000);
 
-        // Uruchom tylko jeśli mamy poprawny odczyt gleby i zdefiniowany próg
-        if (data.soil_moisture != -1 && settings.soil_min > -1000) {  // -1000 to bezpieczny margines od -INFINITY/INT_MIN
-            if (data.soil_moisture < settings.soil_min) {
-                if (now - last_water_time > AUTO_WATER_COOLDOWN_MS) {
-                     ESP_LOGW(TAG, "Auto-watering triggered! Soil: %d%% < Min: %d%%", data.soil_moisture, settings.soil_min);
-                     perform_watering(settings.watering_duration_sec, "auto"); // Czas z ustawień
-                }
+        // Model odpowiedzi gleby (strefa 0 - jedyny czujnik wilgotności)
+        int64_t mono_ms = esp_timer_get_time() / 1000;
+        if (data.soil_moisture != -1) irrigation_on_sample(0, mono_ms, data.soil_moisture);
+
+        // Reguły użytkownika (bajtkod z NVS) zastępują kryterium soil_min
+        int rule_water_sec = 0;
+        portENTER_CRITICAL(&s_water_time_mux);
+        int64_t last_water = last_water_time;
+        portEXIT_CRITICAL(&s_water_time_mux);
+        int rule = automation_eval(&data, now, last_water, &rule_water_sec);
+        if (rule >= 0) {
+            ESP_LOGW(TAG, "Auto-watering triggered by rule %d (%d s)", rule, rule_water_sec);
+            auto_watering(rule_water_sec);
+        } else if (automation_count() == 0 && data.soil_moisture != -1 && set.soil_min > -1000) {
+            // Bez reguł: tylko jeśli mamy poprawny odczyt gleby i zdefiniowany próg (-1000 to bezpieczny margines od -INFINITY/INT_MIN).
+            // Dawka z modelu odpowiedzi gleby (watering_duration_sec = dawka próbna przed pierwszą obserwacją).
+            int band_hi = value_available_soil(set.soil_max) && set.soil_max > set.soil_min
+                              ? set.soil_max : set.soil_min + CONFIG_IRRIGATION_BAND_PCT;
+            int dose_s = irrigation_dose(0, mono_ms, data.soil_moisture, set.soil_min, band_hi,
+                                         set.watering_duration_sec, MAX_WATERING_DURATION_S);
+            if (dose_s > 0) {
+                ESP_LOGW(TAG, "Auto-watering triggered! Soil: %d%% < Min: %d%%, dose %d s", data.soil_moisture, set.soil_min, dose_s);
+                auto_watering(dose_s);
             }
         }
 
         // Oblicz interwał
-        int interval_ms = settings.measurement_interval_sec * 1000;
+        int interval_ms = set.measurement_interval_sec * 1000;
         
         // Adaptacyjny interwał przy braku połączenia (oszczędzanie bufora)
         int buffered_count = mqtt_app_get_consecutive_buffered_count();
@@ -607,10 +934,14 @@ void app_main(void)
 {
     ESP_LOGI(TAG, "Start systemu Smart Garden");
 
-    // Konfiguracja GPIO pompy
-    gpio_reset_pin(PUMP_GPIO);
-    gpio_set_direction(PUMP_GPIO, GPIO_MODE_OUTPUT);
-    gpio_set_level(PUMP_GPIO, 0);
+    s_rules_lock = xSemaphoreCreateMutex();
+    s_settings_lock = xSemaphoreCreateMutex();
+    threshold_engine_init(&s_thresholds, s_rules, s_rule_state, RULE_COUNT);
+
+    // Pompy wyłączone jak najwcześniej po starcie (GPIO/LEDC wszystkich stref)
+    if (pump_ctrl_init(on_pump_event) != ESP_OK) {
+        ESP_LOGE(TAG, "Błąd inicjalizacji sterownika pomp!");
+    }
 
     // Inicjalizacja usług systemowych
     ESP_ERROR_CHECK(nvs_flash_init());
@@ -618,12 +949,17 @@ void app_main(void)
     ESP_ERROR_CHECK(esp_event_loop_create_default());
     
     // Wczytanie ustawień z NVS
-    load_settings_from_nvs();
+    settings_store_init(&k_settings_store);
+    automation_load();
+    irrigation_init();
+    if (settings.telemetry_encoding != TELEMETRY_ENCODING_BINARY) settings.telemetry_encoding = TELEMETRY_ENCODING_JSON;
+    mqtt_app_set_telemetry_encoding((telemetry_encoding_t)settings.telemetry_encoding);
 
     // Inicjalizacja sensorów (Wcześniej niż WiFi/BLE, żeby uniknąć zakłóceń przy starcie I2C)
     if (sensors_init() != ESP_OK) {
         ESP_LOGE(TAG, "Błąd inicjalizacji sensorów!");
     }
+    apply_light_thresholds();
 
     // Inicjalizacja Provisioningu i WiFi
     wifi_prov_init();
@@ -667,12 +1003,21 @@ void app_main(void)
     strftime(strftime_buf, sizeof(strftime_buf), "%c", &timeinfo);
     ESP_LOGI(TAG, "Aktualny czas: %s", strftime_buf);
 
-    // Start MQTT
-    mqtt_app_start(process_incoming_data);
+    // Monitor wody i wykonawca komend - przed MQTT, bo komendy mogą przyjść zaraz po połączeniu
+    water_monitor_set_callback(on_water_level_changed);
+    if (command_worker_start() != ESP_OK) {
+        ESP_LOGE(TAG, "Błąd startu command_worker!");
+    }
 
-    // Kolejka i task podlewania
-    watering_req_queue = xQueueCreate(5, sizeof(watering_req_t));
-    xTaskCreate(watering_task, "watering_task", 4096, NULL, 5, NULL);
+    // Start MQTT (obsługa topiców rejestrowana przed startem - subskrypcje przy każdym połączeniu)
+    mqtt_app_register_handler("command/water", handle_command_water);
+    mqtt_app_register_handler("command/read", handle_command_read);
+    mqtt_app_register_handler("command/stop", handle_command_stop);
+    mqtt_app_register_handler("settings", handle_settings);
+    mqtt_app_register_handler("settings/get", handle_settings_get);
+    mqtt_app_register_handler("settings/reset", handle_settings_reset);
+    mqtt_app_register_handler("automation", handle_automation);
+    mqtt_app_start();
 
     // Start zadania głównego (pomiary)
     xTaskCreate(publisher_task, "publisher_task", 4096, NULL, 5, &publisher_task_handle);
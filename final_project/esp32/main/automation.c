@@ -0,0 +1,155 @@
+#include "automation.h"
+
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "AUTOMATION";
+
+#define NVS_NAMESPACE "storage"
+#define NVS_KEY       "auto_rules"
+#define RULE_HDR_SIZE 6 // len, stack, water_sec (2), cooldown_min (2)
+#define BLOB_MAX      (1 + AUTOMATION_RULES_MAX * (RULE_HDR_SIZE + RULE_VM_CODE_MAX))
+
+static automation_rule_t s_rules[AUTOMATION_RULES_MAX];
+static size_t s_count = 0;
+static SemaphoreHandle_t s_lock = NULL;
+
+static void lock(void) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+}
+
+static void unlock(void) {
+    xSemaphoreGive(s_lock);
+}
+
+// Zapis w NVS tylko z użytą częścią bajtkodu: [n] + n * [len, stack, water_sec, cooldown_min, code...]
+static size_t serialize(const automation_rule_t *rules, size_t n, uint8_t *buf) {
+    size_t off = 0;
+    buf[off++] = (uint8_t)n;
+    for (size_t i = 0; i < n; i++) {
+        const automation_rule_t *r = &rules[i];
+        buf[off++] = r->prog.len;
+        buf[off++] = r->prog.stack;
+        buf[off++] = (uint8_t)r->water_sec;
+        buf[off++] = (uint8_t)(r->water_sec >> 8);
+        buf[off++] = (uint8_t)r->cooldown_min;
+        buf[off++] = (uint8_t)(r->cooldown_min >> 8);
+        memcpy(&buf[off], r->prog.code, r->prog.len);
+        off += r->prog.len;
+    }
+    return off;
+}
+
+static size_t deserialize(const uint8_t *buf, size_t len, automation_rule_t *rules) {
+    if (len < 1) return 0;
+    size_t n = buf[0] < AUTOMATION_RULES_MAX ? buf[0] : AUTOMATION_RULES_MAX;
+    size_t off = 1, count = 0;
+    for (size_t i = 0; i < n && off + RULE_HDR_SIZE <= len; i++) {
+        automation_rule_t r = {0};
+        r.prog.len = buf[off];
+        r.prog.stack = buf[off + 1];
+        r.water_sec = (uint16_t)(buf[off + 2] | buf[off + 3] << 8);
+        r.cooldown_min = (uint16_t)(buf[off + 4] | buf[off + 5] << 8);
+        off += RULE_HDR_SIZE;
+        if (r.prog.len > RULE_VM_CODE_MAX || off + r.prog.len > len) break;
+        memcpy(r.prog.code, &buf[off], r.prog.len);
+        off += r.prog.len;
+
+        if (rule_vm_verify(&r.prog) != RULE_VM_OK) {
+            ESP_LOGE(TAG, "Reguła %u w NVS uszkodzona - pominięta", (unsigned)i);
+            continue;
+        }
+        rules[count++] = r;
+    }
+    return count;
+}
+
+esp_err_t automation_load(void) {
+    if (!s_lock) s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &h);
+    if (err != ESP_OK) return err;
+
+    uint8_t buf[BLOB_MAX];
+    size_t len = sizeof(buf);
+    err = nvs_get_blob(h, NVS_KEY, buf, &len);
+    nvs_close(h);
+    if (err != ESP_OK) return err;
+
+    lock();
+    s_count = deserialize(buf, len, s_rules);
+    unlock();
+    ESP_LOGI(TAG, "Reguły automatyzacji: %u (%u B)", (unsigned)s_count, (unsigned)len);
+    return ESP_OK;
+}
+
+esp_err_t automation_set(const automation_rule_t *rules, size_t n) {
+    if (n > AUTOMATION_RULES_MAX) return ESP_ERR_INVALID_ARG;
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+
+    uint8_t buf[BLOB_MAX];
+    size_t len = serialize(rules, n, buf);
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(h, NVS_KEY, buf, len);
+        if (err == ESP_OK) err = nvs_commit(h);
+        nvs_close(h);
+    }
+    if (err != ESP_OK) ESP_LOGE(TAG, "Zapis reguł w NVS nieudany: %s", esp_err_to_name(err));
+
+    // Reguły działają także wtedy, gdy zapis się nie udał (do restartu)
+    lock();
+    memcpy(s_rules, rules, n * sizeof(*rules));
+    s_count = n;
+    unlock();
+    return err;
+}
+
+size_t automation_count(void) {
+    return s_count;
+}
+
+int automation_eval(const telemetry_data_t *data, int64_t now_ms, int64_t last_water_ms, int *water_sec) {
+    if (!s_lock || s_count == 0) return -1;
+
+    float vars[RULE_VAR_COUNT];
+    vars[RULE_VAR_SOIL] = data->soil_moisture >= 0 ? (float)data->soil_moisture : NAN;
+    vars[RULE_VAR_TEMP] = data->temp;
+    vars[RULE_VAR_HUM] = data->humidity;
+    vars[RULE_VAR_PRESS] = data->pressure;
+    vars[RULE_VAR_LIGHT] = data->light_lux;
+    vars[RULE_VAR_TANK_EMPTY] = data->water_ok >= 0 ? (float)data->water_ok : NAN;
+    vars[RULE_VAR_SINCE_WATER] = last_water_ms > 0 ? (float)(now_ms - last_water_ms) / 60000.0f : INFINITY;
+
+    // Czas lokalny tylko po synchronizacji SNTP (wcześniej zegar stoi w 1970)
+    time_t t = (time_t)(now_ms / 1000);
+    struct tm tm;
+    localtime_r(&t, &tm);
+    bool synced = tm.tm_year >= (2020 - 1900);
+    vars[RULE_VAR_HOUR] = synced ? (float)tm.tm_hour : NAN;
+    vars[RULE_VAR_MINUTE] = synced ? (float)tm.tm_min : NAN;
+    vars[RULE_VAR_WDAY] = synced ? (float)tm.tm_wday : NAN;
+
+    int hit = -1;
+    lock();
+    for (size_t i = 0; i < s_count; i++) {
+        const automation_rule_t *r = &s_rules[i];
+        if (last_water_ms > 0 && now_ms - last_water_ms < (int64_t)r->cooldown_min * 60000) continue;
+        if (rule_vm_eval(&r->prog, vars)) {
+            hit = (int)i;
+            *water_sec = r->water_sec;
+            break;
+        }
+    }
+    unlock();
+    return hit;
+}
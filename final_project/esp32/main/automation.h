@@ -0,0 +1,43 @@
+#ifndef AUTOMATION_H
+#define AUTOMATION_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "common_defs.h"
+#include "rule_vm.h"
+
+// Reguły automatycznego podlewania: warunek (bajtkod rule_vm) + czas podlewania + odstęp od
+// poprzedniego podlewania. Skompilowane programy trzymane w NVS ("storage"/"auto_rules"),
+// ewaluowane po każdym odczycie w cyklu telemetrii. Bez reguł działa stare kryterium
+// soil < soil_min z app_main.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUTOMATION_RULES_MAX 4
+
+typedef struct {
+    rule_program_t prog;
+    uint16_t water_sec;
+    uint16_t cooldown_min; // od ostatniego podlewania (dowolnego źródła)
+} automation_rule_t;
+
+// Wczytuje i weryfikuje reguły z NVS (uszkodzone są pomijane); wołać raz przy starcie, przed pozostałymi
+esp_err_t automation_load(void);
+
+// Zastępuje wszystkie reguły (n == 0 = brak) i zapisuje w NVS
+esp_err_t automation_set(const automation_rule_t *rules, size_t n);
+
+size_t automation_count(void);
+
+// Pierwsza reguła, której warunek jest spełniony, a cooldown minął; -1 = żadna.
+// `last_water_ms` = czas ostatniego podlewania (ms epoki, 0 = nie było).
+int automation_eval(const telemetry_data_t *data, int64_t now_ms, int64_t last_water_ms, int *water_sec);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // AUTOMATION_H
@@ -0,0 +1,73 @@
+#include "bmp280_comp.h"
+
+#include "bmp280_scale.h"
+
+// Jedna paczka; tablice pośrednie na stosie (~0.5 KB)
+static void compensate_chunk(const bmp280_calib_t *cal, const uint8_t *raw, size_t n,
+                             float *restrict temperature_c, float *restrict pressure_hpa, float *restrict humidity) {
+    int32_t adc_p[BMP280_BATCH_CHUNK];
+    int32_t adc_h[BMP280_BATCH_CHUNK];
+    int32_t fine[BMP280_BATCH_CHUNK];
+
+    // Rozpakowanie + temperatura (i t_fine dla pozostałych)
+    const int32_t t1 = cal->T1, t2 = cal->T2, t3 = cal->T3;
+    for (size_t i = 0; i < n; i++) {
+        const uint8_t *r = raw + i * BMP280_RAW_SAMPLE_SIZE;
+        int32_t adc_t = (int32_t)r[3] << 12 | (int32_t)r[4] << 4 | r[5] >> 4;
+        adc_p[i] = (int32_t)r[0] << 12 | (int32_t)r[1] << 4 | r[2] >> 4;
+        adc_h[i] = (int32_t)r[6] << 8 | r[7];
+
+        int32_t var1 = (((adc_t >> 3) - (t1 << 1)) * t2) >> 11;
+        int32_t d = (adc_t >> 4) - t1;
+        int32_t var2 = (((d * d) >> 12) * t3) >> 14;
+        fine[i] = var1 + var2;
+        temperature_c[i] = bmp280_scale_temperature_c((fine[i] * 5 + 128) >> 8);
+    }
+
+    // Ciśnienie (64 bity i dzielenie - jak w datasheecie)
+    for (size_t i = 0; i < n; i++) {
+        int64_t var1 = (int64_t)fine[i] - 128000;
+        int64_t var2 = var1 * var1 * (int64_t)cal->P6;
+        var2 = var2 + ((var1 * (int64_t)cal->P5) << 17);
+        var2 = var2 + (((int64_t)cal->P4) << 35);
+        var1 = ((var1 * var1 * (int64_t)cal->P3) >> 8) + ((var1 * (int64_t)cal->P2) << 12);
+        var1 = (((int64_t)1 << 47) + var1) * ((int64_t)cal->P1) >> 33;
+
+        uint32_t fixed = 0;
+        if (var1 != 0) {
+            int64_t p = 1048576 - adc_p[i];
+            p = (((p << 31) - var2) * 3125) / var1;
+            int64_t v1 = ((int64_t)cal->P9 * (p >> 13) * (p >> 13)) >> 25;
+            int64_t v2 = ((int64_t)cal->P8 * p) >> 19;
+            fixed = (uint32_t)(((p + v1 + v2) >> 8) + ((int64_t)cal->P7 << 4));
+        }
+        pressure_hpa[i] = bmp280_scale_pressure_hpa(fixed);
+    }
+
+    if (!humidity) return;
+    if (!cal->has_humidity) {
+        for (size_t i = 0; i < n; i++) humidity[i] = 0.0f;
+        return;
+    }
+
+    // Wilgotność
+    const int32_t h1 = cal->H1, h2 = cal->H2, h3 = cal->H3, h4 = cal->H4, h5 = cal->H5, h6 = cal->H6;
+    for (size_t i = 0; i < n; i++) {
+        int32_t v = fine[i] - (int32_t)76800;
+        v = ((((adc_h[i] << 14) - (h4 << 20) - (h5 * v)) + (int32_t)16384) >> 15) *
+            (((((((v * h6) >> 10) * (((v * h3) >> 11) + (int32_t)32768)) >> 10) + (int32_t)2097152) * h2 + 8192) >> 14);
+        v = v - (((((v >> 15) * (v >> 15)) >> 7) * h1) >> 4);
+        v = v < 0 ? 0 : v;
+        v = v > 419430400 ? 419430400 : v;
+        humidity[i] = bmp280_scale_humidity((uint32_t)(v >> 12));
+    }
+}
+
+void bmp280_compensate_batch(const bmp280_calib_t *cal, const uint8_t *raw, size_t n,
+                             float *temperature_c, float *pressure_hpa, float *humidity) {
+    for (size_t off = 0; off < n; off += BMP280_BATCH_CHUNK) {
+        size_t m = n - off < BMP280_BATCH_CHUNK ? n - off : BMP280_BATCH_CHUNK;
+        compensate_chunk(cal, raw + off * BMP280_RAW_SAMPLE_SIZE, m, temperature_c + off, pressure_hpa + off,
+                         humidity ? humidity + off : NULL);
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef BMP280_COMP_H
+#define BMP280_COMP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Kompensacja BMP280/BME280 dla wielu surowych próbek naraz (leniwa kompensacja backlogu).
+//
+// Surowa próbka to 8 bajtów z rejestrów 0xF7..0xFE (press[3], temp[3], hum[2]) - tak jak czyta je
+// bmp280_read_fixed(). Algorytm całkowitoliczbowy z datasheetu, wynik identyczny z
+// bmp280_read_fixed() + bmp280_scale_*() (sprawdzane w tools/bench_bme280_batch.c).
+//
+// Obliczenia idą w paczkach po BMP280_BATCH_CHUNK próbek, osobnymi pętlami po tablicach
+// (rozpakowanie + temperatura, ciśnienie, wilgotność) bez rozgałęzień w ciele pętli, więc
+// kompilator może je wektoryzować (host) albo przynajmniej trzymać współczynniki w rejestrach.
+// Bez zależności od ESP-IDF.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BMP280_RAW_SAMPLE_SIZE 8
+#define BMP280_BATCH_CHUNK 32
+
+// Kopia współczynników kalibracji z bmp280_t (odczytywana z czujnika raz, przy init)
+typedef struct {
+    uint16_t T1;
+    int16_t T2, T3;
+    uint16_t P1;
+    int16_t P2, P3, P4, P5, P6, P7, P8, P9;
+    uint8_t H1;
+    int16_t H2;
+    uint8_t H3;
+    int16_t H4, H5;
+    int8_t H6;
+    bool has_humidity; // BME280
+} bmp280_calib_t;
+
+// `raw` = n próbek po BMP280_RAW_SAMPLE_SIZE bajtów. Wyniki: degC, hPa, %RH (`humidity` może być
+// NULL; bez wilgotności w kalibracji zapisywane jest 0).
+void bmp280_compensate_batch(const bmp280_calib_t *cal, const uint8_t *raw, size_t n,
+                             float *temperature_c, float *pressure_hpa, float *humidity);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BMP280_COMP_H
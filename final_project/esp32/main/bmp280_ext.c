@@ -0,0 +1,74 @@
+#include "bmp280_ext.h"
+
+#include <string.h>
+
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+
+#define BMP280_POLL_STEP_US 1000
+
+static uint32_t oversampling_factor(BMP280_Oversampling os) {
+    return os == BMP280_SKIPPED ? 0 : 1u << (os - 1); // x1, x2, x4, x8, x16
+}
+
+uint32_t bmp280_forced_measurement_time_us(const bmp280_t *dev, const bmp280_params_t *params) {
+    uint32_t t = 1250 + 2300 * oversampling_factor(params->oversampling_temperature);
+
+    uint32_t osrs_p = oversampling_factor(params->oversampling_pressure);
+    if (osrs_p) t += 2300 * osrs_p + 575;
+
+    if (dev->id == BME280_CHIP_ID) {
+        uint32_t osrs_h = oversampling_factor(params->oversampling_humidity);
+        if (osrs_h) t += 2300 * osrs_h + 575;
+    }
+    return t;
+}
+
+esp_err_t bmp280_wait_measurement_done(bmp280_t *dev, uint32_t timeout_us) {
+    int64_t deadline = esp_timer_get_time() + timeout_us;
+    while (1) {
+        bool busy = false;
+        esp_err_t err = bmp280_is_measuring(dev, &busy);
+        if (err != ESP_OK) return err;
+        if (!busy) return ESP_OK;
+        if (esp_timer_get_time() >= deadline) return ESP_ERR_TIMEOUT;
+        esp_rom_delay_us(BMP280_POLL_STEP_US);
+    }
+}
+
+esp_err_t bmp280_read_scaled(bmp280_t *dev, float *temperature_c, float *pressure_hpa, float *humidity) {
+    if (!dev || !temperature_c || !pressure_hpa) return ESP_ERR_INVALID_ARG;
+
+    int32_t fixed_t;
+    uint32_t fixed_p, fixed_h = 0;
+    esp_err_t err = bmp280_read_fixed(dev, &fixed_t, &fixed_p, humidity ? &fixed_h : NULL);
+    if (err != ESP_OK) return err;
+
+    *temperature_c = bmp280_scale_temperature_c(fixed_t);
+    *pressure_hpa = bmp280_scale_pressure_hpa(fixed_p);
+    if (humidity) *humidity = bmp280_scale_humidity(fixed_h);
+    return ESP_OK;
+}
+
+esp_err_t bmp280_read_raw(bmp280_t *dev, uint8_t raw[BMP280_RAW_SAMPLE_SIZE]) {
+    if (!dev || !raw) return ESP_ERR_INVALID_ARG;
+
+    // Jeden odczyt sekwencyjny, żeby wartości pochodziły z tego samego pomiaru
+    size_t size = dev->id == BME280_CHIP_ID ? BMP280_RAW_SAMPLE_SIZE : 6;
+    memset(raw, 0, BMP280_RAW_SAMPLE_SIZE);
+    I2C_DEV_TAKE_MUTEX(&dev->i2c_dev);
+    esp_err_t err = i2c_dev_read_reg(&dev->i2c_dev, 0xf7, raw, size);
+    I2C_DEV_GIVE_MUTEX(&dev->i2c_dev);
+    return err;
+}
+
+void bmp280_get_calib(const bmp280_t *dev, bmp280_calib_t *out) {
+    *out = (bmp280_calib_t){
+        .T1 = dev->dig_T1, .T2 = dev->dig_T2, .T3 = dev->dig_T3,
+        .P1 = dev->dig_P1, .P2 = dev->dig_P2, .P3 = dev->dig_P3, .P4 = dev->dig_P4, .P5 = dev->dig_P5,
+        .P6 = dev->dig_P6, .P7 = dev->dig_P7, .P8 = dev->dig_P8, .P9 = dev->dig_P9,
+        .H1 = dev->dig_H1, .H2 = dev->dig_H2, .H3 = dev->dig_H3, .H4 = dev->dig_H4, .H5 = dev->dig_H5,
+        .H6 = dev->dig_H6,
+        .has_humidity = dev->id == BME280_CHIP_ID,
+    };
+}
@@ -0,0 +1,44 @@
+#ifndef BMP280_EXT_H
+#define BMP280_EXT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "bmp280.h"
+#include "bmp280_scale.h"
+#include "bmp280_comp.h"
+
+// Rozszerzenia sterownika bmp280 (esp-idf-lib) dla trybu FORCED - bez modyfikacji managed_components.
+//
+// Czas pomiaru liczony wg datasheetu BME280 (dodatek B, "maximum measurement time"):
+//   t_max [us] = 1250 + 2300 * osrs_t + (2300 * osrs_p + 575) + (2300 * osrs_h + 575)
+// gdzie osrs_x to krotność oversamplingu (1..16), a pomiar wyłączony (SKIPPED) nie wnosi nic.
+// Ten sam wzór daje wartości maksymalne z tabeli BMP280 (bez wilgotności). Filtr IIR działa na
+// wynikach kolejnych pomiarów i nie wydłuża pojedynczej konwersji.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maksymalny czas pomiaru FORCED dla danych parametrów (wilgotność tylko dla BME280)
+uint32_t bmp280_forced_measurement_time_us(const bmp280_t *dev, const bmp280_params_t *params);
+
+// Czeka na koniec konwersji odpytując rejestr statusu (co ~1 ms, maks. `timeout_us`).
+// ESP_ERR_TIMEOUT gdy czujnik nadal mierzy.
+esp_err_t bmp280_wait_measurement_done(bmp280_t *dev, uint32_t timeout_us);
+
+// Jak bmp280_read_float(), ale z ciśnieniem od razu w hPa (skalowanie z bmp280_scale.h).
+// `humidity` opcjonalne (tylko BME280).
+esp_err_t bmp280_read_scaled(bmp280_t *dev, float *temperature_c, float *pressure_hpa, float *humidity);
+
+// Surowe bajty wyniku (rejestry 0xF7..0xFE) bez kompensacji - do bmp280_compensate_batch().
+// Dla BMP280 (bez wilgotności) czytane jest 6 bajtów, ostatnie 2 są zerowane.
+esp_err_t bmp280_read_raw(bmp280_t *dev, uint8_t raw[BMP280_RAW_SAMPLE_SIZE]);
+
+// Współczynniki kalibracji z uchwytu (wczytane przez bmp280_init())
+void bmp280_get_calib(const bmp280_t *dev, bmp280_calib_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BMP280_EXT_H
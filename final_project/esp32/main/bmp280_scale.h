@@ -0,0 +1,42 @@
+#ifndef BMP280_SCALE_H
+#define BMP280_SCALE_H
+
+#include <stdint.h>
+
+// Skalowanie wyników bmp280_read_fixed() do jednostek telemetrii.
+//
+// Kompensacja w sterowniku jest całkowitoliczbowa (datasheet); skalowanie jest takie jak w
+// bmp280_read_float() + dzielenie przez 100 (Pa -> hPa) w sensors.c, więc wynik jest bit w bit
+// ten sam co wcześniej. Mnożenie przez odwrotność (1/100, 1/25600) nie dało zysku: w
+// bench_conversions ścieżka BME wyszła 0.9x, a dla 1/100 wynik różni się o 1 ULP.
+// Bez zależności od ESP-IDF - używane też przez narzędzie hostowe.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 0.01 degC -> degC
+static inline float bmp280_scale_temperature_c(int32_t fixed) {
+    return (float)fixed / 100;
+}
+
+// Pa w formacie Q24.8 -> Pa
+static inline float bmp280_scale_pressure_pa(uint32_t fixed) {
+    return (float)fixed / 256;
+}
+
+// Pa w formacie Q24.8 -> hPa
+static inline float bmp280_scale_pressure_hpa(uint32_t fixed) {
+    return (float)fixed / 256 / 100.0f;
+}
+
+// %RH w formacie Q22.10 -> %RH
+static inline float bmp280_scale_humidity(uint32_t fixed) {
+    return (float)fixed / 1024;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BMP280_SCALE_H
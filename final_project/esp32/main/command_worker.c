@@ -0,0 +1,91 @@
+#include "command_worker.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "alert_limiter.h"
+#include "json_writer.h"
+
+static const char *TAG = "CMD_WORKER";
+
+#define COMMAND_WORKER_STACK 4096
+#define COMMAND_WORKER_PRIO 4
+#define COMMAND_RESPONSE_BUF_SIZE 384
+
+// Osobna kolejka na każdy priorytet; liczba powiadomień taska = liczba komend w kolejkach.
+static QueueHandle_t s_queues[COMMAND_PRIO_COUNT];
+static TaskHandle_t s_task = NULL;
+
+static void command_worker_task(void *arg) {
+    command_t cmd;
+    while (1) {
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+
+        for (int p = 0; p < COMMAND_PRIO_COUNT; p++) {
+            if (xQueueReceive(s_queues[p], &cmd, 0) == pdTRUE) {
+                ESP_LOGI(TAG, "Wykonuję komendę %s (id=%s, prio=%d)", cmd.name, cmd.id[0] ? cmd.id : "-", p);
+                cmd.exec(&cmd);
+                break;
+            }
+        }
+    }
+}
+
+esp_err_t command_worker_start(void) {
+    if (s_task) return ESP_OK;
+
+    for (int p = 0; p < COMMAND_PRIO_COUNT; p++) {
+        s_queues[p] = xQueueCreate(COMMAND_QUEUE_DEPTH, sizeof(command_t));
+        if (!s_queues[p]) return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(command_worker_task, "command_worker", COMMAND_WORKER_STACK, NULL, COMMAND_WORKER_PRIO, &s_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t command_worker_submit(command_prio_t prio, const command_t *cmd) {
+    if (!cmd || !cmd->exec || prio >= COMMAND_PRIO_COUNT) return ESP_ERR_INVALID_ARG;
+    if (!s_task) return ESP_ERR_INVALID_STATE;
+
+    if (xQueueSend(s_queues[prio], cmd, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Kolejka komend pełna - odrzucam %s", cmd->name);
+        command_worker_respond(cmd, "rejected", "{\"reason\":\"queue_full\"}");
+
+        uint32_t suppressed = 0;
+        if (alert_limiter_allow("command.queue_full", esp_log_timestamp(), 10 * 1000, &suppressed)) {
+            char details[128];
+            snprintf(details, sizeof(details), "{\"command\":\"%s\",\"depth\":%d,\"suppressed\":%lu}",
+                     cmd->name, COMMAND_QUEUE_DEPTH, (unsigned long)suppressed);
+            mqtt_app_send_alert2_details("command.queue_full", "warning", "command", "Command rejected: queue full", details);
+        }
+        return ESP_ERR_NO_MEM;
+    }
+    xTaskNotifyGive(s_task);
+    return ESP_OK;
+}
+
+void command_worker_respond(const command_t *cmd, const char *status, const char *result_json) {
+    char buf[COMMAND_RESPONSE_BUF_SIZE];
+    json_writer_t w;
+    json_writer_init(&w, buf, sizeof(buf));
+
+    json_writer_begin_object(&w, NULL);
+    json_writer_string(&w, "command", cmd->name);
+    if (cmd->id[0]) json_writer_string(&w, "id", cmd->id);
+    json_writer_string(&w, "status", status);
+    if (result_json) json_writer_raw_object(&w, "result", result_json);
+    json_writer_end_object(&w);
+
+    size_t len = 0;
+    const char *json = json_writer_finish(&w, &len);
+    if (!json) {
+        ESP_LOGE(TAG, "Odpowiedź na %s nie mieści się w buforze", cmd->name);
+        return;
+    }
+    mqtt_app_send_response(&cmd->reply_to, json, (int)len);
+}
@@ -0,0 +1,66 @@
+#ifndef COMMAND_WORKER_H
+#define COMMAND_WORKER_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "common_defs.h"
+#include "mqtt_app.h"
+#include "sensor_registry.h"
+
+// Wykonywanie komend poza taskiem MQTT.
+//
+// Handler MQTT tylko parsuje i waliduje payload, a komendę (z adresem odpowiedzi) wrzuca do
+// ograniczonej kolejki z priorytetami; task command_worker wykonuje je po kolei, zawsze zaczynając
+// od najwyższego niepustego priorytetu (w obrębie priorytetu FIFO). Dzięki temu wolne operacje
+// (odczyt czujników ~100+ ms) nie blokują keepalive'ów i kolejnych wiadomości przychodzących.
+//
+// Odpowiedź (JSON: command, id, status, opcjonalnie result) idzie przez mqtt_app_send_response().
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define COMMAND_QUEUE_DEPTH 4 // na każdy priorytet
+#define COMMAND_ID_MAX 40     // "id" z payloadu (np. UUID) - korelacja dla klientów bez MQTT5
+
+typedef enum {
+    COMMAND_PRIO_HIGH = 0, // sterowanie pompą
+    COMMAND_PRIO_NORMAL,   // zmiany ustawień i reguł automatyzacji
+    COMMAND_PRIO_LOW,      // odczyty na żądanie
+    COMMAND_PRIO_COUNT,
+} command_prio_t;
+
+typedef struct command command_t;
+
+// Wykonanie komendy (w tasku command_worker); powinno zakończyć się command_worker_respond().
+typedef void (*command_exec_t)(const command_t *cmd);
+
+struct command {
+    command_exec_t exec;
+    const char *name; // stała, np. "water"
+    union {
+        struct {
+            int duration_s;
+            int zone; // PUMP_ZONE_ALL w command/stop = wszystkie
+        } water;
+        sensor_read_request_t read;
+        struct cJSON *json; // sparsowany payload; zwalnia exec (przy błędzie submit - wywołujący)
+    } arg;
+    char id[COMMAND_ID_MAX]; // "" = brak
+    mqtt_reply_to_t reply_to;
+};
+
+esp_err_t command_worker_start(void);
+
+// Kopiuje komendę do kolejki. Przy pełnej kolejce odpowiada od razu statusem "rejected"
+// i zwraca ESP_ERR_NO_MEM.
+esp_err_t command_worker_submit(command_prio_t prio, const command_t *cmd);
+
+// Wysyła odpowiedź na komendę; `result_json` to JSON-object albo NULL.
+void command_worker_respond(const command_t *cmd, const char *status, const char *result_json);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // COMMAND_WORKER_H
@@ -14,8 +14,12 @@ typedef uint32_t telemetry_fields_mask_t;
 #define TELEMETRY_FIELD_LIGHT  (1u << 4)
 #define TELEMETRY_FIELD_WATER  (1u << 5)
 
+#define TELEMETRY_FIELD_COUNT  6 // bity 0..5 powyżej
+
 #define TELEMETRY_FIELDS_ALL (TELEMETRY_FIELD_SOIL | TELEMETRY_FIELD_TEMP | TELEMETRY_FIELD_HUM | TELEMETRY_FIELD_PRESS | TELEMETRY_FIELD_LIGHT | TELEMETRY_FIELD_WATER)
 
+#define TELEMETRY_BME_RAW_SIZE 8
+
 typedef struct {
     // Dla pól opcjonalnych używamy wartości specjalnych:
     // - float: NaN oznacza "niedostępne"
@@ -27,6 +31,10 @@ typedef struct {
     float light_lux;
     int16_t water_ok; // 0 = OK, 1 = ALARM
     int64_t timestamp;
+    // Offline BME280 zapisuje surowe rejestry 0xF7..0xFE zamiast temp/humidity/pressure (NaN);
+    // kompensacja hurtem przy wysyłce (sensors_resolve_raw()).
+    bool bme_raw_pending;
+    uint8_t bme_raw[TELEMETRY_BME_RAW_SIZE];
 } telemetry_data_t;
 
 typedef struct {
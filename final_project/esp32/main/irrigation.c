@@ -0,0 +1,257 @@
+#include "irrigation.h"
+
+#include <math.h>
+#include <string.h>
+#include "esp_log.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "IRRIGATION";
+
+#define NVS_NAMESPACE        "storage"
+#define NVS_KEY              "irr_model"
+#define MODEL_VERSION        1
+
+#define IRR_ALPHA            0.3f  // waga nowej obserwacji
+#define IRR_SOAK_DEFAULT_S   900   // przed pierwszą obserwacją
+#define IRR_SOAK_MAX_MS      ((int64_t)CONFIG_IRRIGATION_SOAK_MAX_MIN * 60000)
+#define IRR_PEAK_DROP        1     // % poniżej szczytu = szczyt minął
+#define IRR_DECAY_WINDOW_MS  (60LL * 60 * 1000)
+#define IRR_DECAY_SAVE_EVERY 6     // decay zmienia się powoli - nie zapisujemy co godzinę
+#define IRR_GAIN_MIN         0.01f
+#define IRR_GAIN_MAX         20.0f
+#define IRR_DOSE_GRACE_MS    60000 // ponad zlecony czas; potem koniec zlecenia uznajemy za utracony
+
+typedef enum {
+    IRR_IDLE = 0,
+    IRR_DOSING,  // pompa pracuje
+    IRR_SOAKING, // po podlewaniu, szukamy szczytu wilgotności
+} irr_phase_t;
+
+typedef struct {
+    irrigation_model_t m;
+    irr_phase_t phase;
+    uint32_t job_id;   // zlecenie pompy, które pracuje
+    int64_t dose_end_ms; // najpóźniejszy koniec tego zlecenia (zlecony czas + IRR_DOSE_GRACE_MS)
+    int last_soil;     // -1 = brak próbki
+    int baseline;      // wilgotność przed serią podlewań
+    float pump_s;      // sekundy pompy w serii (podlewania bez próbki pomiędzy)
+    int64_t stop_ms;   // koniec ostatniego podlewania, 0 = nie było
+    bool sampled;      // jest próbka po stop_ms
+    int peak;
+    int64_t peak_ms;
+    int anchor;        // decay: punkt odniesienia
+    int64_t anchor_ms; // 0 = brak
+} irr_zone_t;
+
+static irr_zone_t s_zones[IRRIGATION_ZONES_MAX];
+static SemaphoreHandle_t s_lock = NULL;
+
+static void lock(void) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+}
+
+static void unlock(void) {
+    xSemaphoreGive(s_lock);
+}
+
+static float ewma(float old, float obs, uint16_t n) {
+    return n == 0 ? obs : old + IRR_ALPHA * (obs - old);
+}
+
+static void save_models(void) {
+    uint8_t buf[1 + IRRIGATION_ZONES_MAX * sizeof(irrigation_model_t)];
+    buf[0] = MODEL_VERSION;
+    lock();
+    for (int i = 0; i < IRRIGATION_ZONES_MAX; i++) {
+        memcpy(&buf[1 + i * sizeof(irrigation_model_t)], &s_zones[i].m, sizeof(irrigation_model_t));
+    }
+    unlock();
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(h, NVS_KEY, buf, sizeof(buf));
+        if (err == ESP_OK) err = nvs_commit(h);
+        nvs_close(h);
+    }
+    if (err != ESP_OK) ESP_LOGE(TAG, "Zapis modelu w NVS nieudany: %s", esp_err_to_name(err));
+}
+
+// Szczyt po podlewaniu minął (albo limit czasu): obserwacja gain i soak_s. Zwraca true, gdy model się zmienił.
+static bool finish_soak_locked(irr_zone_t *z, int zone) {
+    bool updated = false;
+    int rise = z->peak - z->baseline;
+    if (z->baseline >= 0 && z->pump_s >= 1.0f && rise > 0) {
+        float gain = (float)rise / z->pump_s;
+        gain = gain < IRR_GAIN_MIN ? IRR_GAIN_MIN : gain > IRR_GAIN_MAX ? IRR_GAIN_MAX : gain;
+        float soak_s = (float)(z->peak_ms - z->stop_ms) / 1000.0f;
+        z->m.gain = ewma(z->m.gain, gain, z->m.doses);
+        z->m.soak_s = ewma(z->m.soak_s, soak_s, z->m.doses);
+        if (z->m.doses < UINT16_MAX) z->m.doses++;
+        updated = true;
+        ESP_LOGI(TAG, "Strefa %d: +%d%% po %.1f s pompy, szczyt po %.0f s -> gain %.3f %%/s, soak %.0f s (n=%u)",
+                 zone, rise, z->pump_s, soak_s, z->m.gain, z->m.soak_s, z->m.doses);
+    } else {
+        ESP_LOGW(TAG, "Strefa %d: brak przyrostu po podlewaniu (%d -> %d%%) - model bez zmian", zone, z->baseline, z->peak);
+    }
+    z->phase = IRR_IDLE;
+    z->pump_s = 0;
+    z->anchor = z->peak;
+    z->anchor_ms = z->peak_ms;
+    return updated;
+}
+
+// Brak zdarzenia końca zlecenia (np. pełna kolejka zdarzeń pump_ctrl): bez tego strefa zostałaby
+// w IRR_DOSING na zawsze. Czas pracy nieznany - seria bez obserwacji, decay liczony od nowa.
+static void check_dose_lost_locked(irr_zone_t *z, int zone, int64_t now_ms) {
+    if (z->phase != IRR_DOSING || now_ms < z->dose_end_ms) return;
+    ESP_LOGW(TAG, "Strefa %d: brak końca zlecenia %lu - model bez zmian", zone, (unsigned long)z->job_id);
+    z->phase = IRR_IDLE;
+    z->pump_s = 0;
+    z->anchor_ms = 0;
+}
+
+esp_err_t irrigation_init(void) {
+    if (!s_lock) s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+
+    for (int i = 0; i < IRRIGATION_ZONES_MAX; i++) {
+        s_zones[i] = (irr_zone_t){ .last_soil = -1, .baseline = -1, .m.soak_s = IRR_SOAK_DEFAULT_S };
+    }
+
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &h);
+    if (err != ESP_OK) return err;
+
+    uint8_t buf[1 + IRRIGATION_ZONES_MAX * sizeof(irrigation_model_t)];
+    size_t len = sizeof(buf);
+    err = nvs_get_blob(h, NVS_KEY, buf, &len);
+    nvs_close(h);
+    if (err != ESP_OK) return err;
+    if (len != sizeof(buf) || buf[0] != MODEL_VERSION) {
+        ESP_LOGW(TAG, "Model w NVS w innym formacie - uczenie od nowa");
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    lock();
+    for (int i = 0; i < IRRIGATION_ZONES_MAX; i++) {
+        irrigation_model_t m;
+        memcpy(&m, &buf[1 + i * sizeof(m)], sizeof(m));
+        // gain dzieli w irrigation_dose; bez obserwacji (doses == 0) zostaje 0 i nie jest używany
+        bool gain_ok = m.doses ? (m.gain >= IRR_GAIN_MIN && m.gain <= IRR_GAIN_MAX) : m.gain == 0;
+        if (!gain_ok || !(m.soak_s >= 0) || !(m.decay == m.decay)) continue;
+        s_zones[i].m = m;
+        if (m.doses) ESP_LOGI(TAG, "Strefa %d: gain %.3f %%/s, decay %.2f %%/h, soak %.0f s (n=%u)", i, m.gain, m.decay, m.soak_s, m.doses);
+    }
+    unlock();
+    return ESP_OK;
+}
+
+void irrigation_on_sample(int zone, int64_t now_ms, int soil) {
+    if (!s_lock || zone < 0 || zone >= IRRIGATION_ZONES_MAX || soil < 0) return;
+
+    bool save = false;
+    irr_zone_t *z = &s_zones[zone];
+    lock();
+    z->last_soil = soil;
+    check_dose_lost_locked(z, zone, now_ms);
+    switch (z->phase) {
+        case IRR_DOSING:
+            break;
+        case IRR_SOAKING:
+            if (!z->sampled || soil > z->peak) {
+                z->peak = soil;
+                z->peak_ms = now_ms;
+                z->sampled = true;
+            }
+            if (soil <= z->peak - IRR_PEAK_DROP || now_ms - z->stop_ms >= IRR_SOAK_MAX_MS) {
+                save = finish_soak_locked(z, zone);
+            }
+            break;
+        case IRR_IDLE:
+            // Wysychanie: spadek od punktu odniesienia, najwyżej co IRR_DECAY_WINDOW_MS; wzrost (deszcz) = nowy punkt
+            if (z->anchor_ms == 0 || soil > z->anchor) {
+                z->anchor = soil;
+                z->anchor_ms = now_ms;
+            } else if (now_ms - z->anchor_ms >= IRR_DECAY_WINDOW_MS) {
+                float rate = (float)(z->anchor - soil) * 3600000.0f / (float)(now_ms - z->anchor_ms);
+                z->m.decay = ewma(z->m.decay, rate, z->m.decays);
+                if (z->m.decays < UINT16_MAX) z->m.decays++;
+                save = (z->m.decays % IRR_DECAY_SAVE_EVERY) == 0;
+                z->anchor = soil;
+                z->anchor_ms = now_ms;
+            }
+            break;
+    }
+    unlock();
+    if (save) save_models();
+}
+
+void irrigation_on_pump_start(int zone, int64_t now_ms, uint32_t job_id, uint32_t duration_ms) {
+    if (!s_lock || zone < 0 || zone >= IRRIGATION_ZONES_MAX) return;
+
+    irr_zone_t *z = &s_zones[zone];
+    lock();
+    // Kolejne podlewanie przed pierwszą próbką po poprzednim (np. wyparcie auto przez ręczne) - jedna seria
+    if (!(z->phase == IRR_SOAKING && !z->sampled)) {
+        z->baseline = z->last_soil;
+        z->pump_s = 0;
+    }
+    z->phase = IRR_DOSING;
+    z->job_id = job_id;
+    z->dose_end_ms = now_ms + duration_ms + IRR_DOSE_GRACE_MS;
+    unlock();
+}
+
+void irrigation_on_pump_stop(int zone, int64_t now_ms, uint32_t job_id, uint32_t ran_ms) {
+    if (!s_lock || zone < 0 || zone >= IRRIGATION_ZONES_MAX) return;
+
+    irr_zone_t *z = &s_zones[zone];
+    lock();
+    if (z->phase == IRR_DOSING && z->job_id == job_id) {
+        z->pump_s += (float)ran_ms / 1000.0f;
+        z->stop_ms = now_ms;
+        z->phase = IRR_SOAKING;
+        z->sampled = false;
+        z->peak = z->baseline;
+        z->peak_ms = now_ms;
+    }
+    unlock();
+}
+
+int irrigation_dose(int zone, int64_t now_ms, int soil, int lo, int hi, int probe_s, int max_s) {
+    if (!s_lock || zone < 0 || zone >= IRRIGATION_ZONES_MAX || soil < 0 || soil >= lo) return 0;
+
+    irr_zone_t *z = &s_zones[zone];
+    int sec = 0;
+    lock();
+    check_dose_lost_locked(z, zone, now_ms);
+    float soak_s = z->m.doses ? z->m.soak_s : IRR_SOAK_DEFAULT_S;
+    // Następna dawka dopiero, gdy poprzednia wsiąknęła (wynik widać w wilgotności)
+    bool soaked = z->stop_ms == 0 || now_ms - z->stop_ms >= (int64_t)(soak_s * 1000.0f);
+    if (z->phase == IRR_IDLE && soaked) {
+        if (z->m.doses == 0) {
+            sec = probe_s;
+        } else {
+            // Środek pasma plus to, co wyschnie, zanim dawka wsiąknie
+            if (hi < lo) hi = lo;
+            float aim = (float)(lo + hi) / 2.0f + z->m.decay * soak_s / 3600.0f;
+            if (aim > hi) aim = (float)hi;
+            sec = (int)ceilf((aim - (float)soil) / z->m.gain);
+        }
+    }
+    unlock();
+
+    if (sec == 0) return 0;
+    return sec < 1 ? 1 : sec > max_s ? max_s : sec;
+}
+
+void irrigation_get_model(int zone, irrigation_model_t *out) {
+    memset(out, 0, sizeof(*out));
+    if (!s_lock || zone < 0 || zone >= IRRIGATION_ZONES_MAX) return;
+    lock();
+    *out = s_zones[zone].m;
+    unlock();
+}
@@ -0,0 +1,52 @@
+#ifndef IRRIGATION_H
+#define IRRIGATION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Podlewanie w pętli zamkniętej z modelem odpowiedzi gleby, uczonym per strefa.
+//
+// Po każdym podlewaniu (także ręcznym) kolejne próbki wilgotności wyznaczają szczyt:
+// przyrost / sekundy pompy = `gain`, czas od końca podlewania do szczytu = `soak_s`. Między
+// podlewaniami spadek wilgotności na godzinę = `decay`. Obserwacje wchodzą średnią wykładniczą
+// (O(1) na próbkę), model zapisywany w NVS ("storage"/"irr_model") po każdej dawce.
+//
+// Dawka = czas pompy do środka pasma docelowego (z poprawką na wysychanie w czasie wsiąkania);
+// kolejna dawka dopiero po wsiąknięciu poprzedniej. Przed pierwszą obserwacją - dawka próbna.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define IRRIGATION_ZONES_MAX 4
+
+typedef struct {
+    float gain;       // % wilgotności na sekundę pompy
+    float decay;      // % na godzinę (wysychanie)
+    float soak_s;     // od końca podlewania do szczytu wilgotności
+    uint16_t doses;   // obserwacje gain/soak_s
+    uint16_t decays;  // obserwacje decay
+} irrigation_model_t;
+
+// Wczytuje modele z NVS; wołać raz przy starcie, przed pozostałymi
+esp_err_t irrigation_init(void);
+
+// Czasy `now_ms` - monotoniczne (esp_timer), nie zegar ścienny
+void irrigation_on_sample(int zone, int64_t now_ms, int soil);
+// `job_id` z pump_ctrl - koniec innego zlecenia (np. usuniętego z kolejki) nie zamyka podlewania.
+// Bez końca zlecenia do `duration_ms` + margines podlewanie jest zamykane bez obserwacji.
+void irrigation_on_pump_start(int zone, int64_t now_ms, uint32_t job_id, uint32_t duration_ms);
+void irrigation_on_pump_stop(int zone, int64_t now_ms, uint32_t job_id, uint32_t ran_ms);
+
+// Czas dawki (s) do środka pasma [lo, hi], w [1, max_s]; 0 = nie teraz (wilgotno, pompa pracuje,
+// poprzednia dawka jeszcze wsiąka). `probe_s` = dawka, gdy model nie ma jeszcze obserwacji.
+int irrigation_dose(int zone, int64_t now_ms, int soil, int lo, int hi, int probe_s, int max_s);
+
+void irrigation_get_model(int zone, irrigation_model_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // IRRIGATION_H
@@ -0,0 +1,379 @@
+#include "json_writer.h"
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Bufor ---
+
+static void put(json_writer_t *w, const char *s, size_t n) {
+    if (w->overflow) return;
+    // Zawsze zostawiamy 1 bajt na terminator.
+    if (w->len + n >= w->cap) {
+        w->overflow = true;
+        return;
+    }
+    memcpy(w->buf + w->len, s, n);
+    w->len += n;
+}
+
+static void put_char(json_writer_t *w, char c) {
+    put(w, &c, 1);
+}
+
+// Escapowanie jak w cJSON (print_string_ptr): bajty >= 0x80 przechodzą bez zmian.
+static void put_escaped_byte(json_writer_t *w, unsigned char c) {
+    switch (c) {
+        case '\"': put(w, "\\\"", 2); return;
+        case '\\': put(w, "\\\\", 2); return;
+        case '\b': put(w, "\\b", 2); return;
+        case '\f': put(w, "\\f", 2); return;
+        case '\n': put(w, "\\n", 2); return;
+        case '\r': put(w, "\\r", 2); return;
+        case '\t': put(w, "\\t", 2); return;
+        default: break;
+    }
+    if (c < 32) {
+        static const char hex[] = "0123456789abcdef";
+        char esc[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0x0F] };
+        put(w, esc, sizeof(esc));
+        return;
+    }
+    put_char(w, (char)c);
+}
+
+static void put_quoted(json_writer_t *w, const char *s) {
+    put_char(w, '\"');
+    if (s) {
+        for (const unsigned char *p = (const unsigned char *)s; *p; p++) {
+            put_escaped_byte(w, *p);
+        }
+    }
+    put_char(w, '\"');
+}
+
+// Przecinek przed kolejnym elementem bieżącego poziomu.
+static void put_separator(json_writer_t *w) {
+    uint32_t bit = 1u << w->depth;
+    if (w->has_items & bit) {
+        put_char(w, ',');
+    }
+    w->has_items |= bit;
+}
+
+static void put_prefix(json_writer_t *w, const char *key) {
+    put_separator(w);
+    if (key) {
+        put_quoted(w, key);
+        put_char(w, ':');
+    }
+}
+
+// --- Liczby (zgodnie z cJSON print_number) ---
+
+static void put_uint64(json_writer_t *w, uint64_t v) {
+    char tmp[21];
+    size_t i = sizeof(tmp);
+    do {
+        tmp[--i] = (char)('0' + (v % 10));
+        v /= 10;
+    } while (v);
+    put(w, &tmp[i], sizeof(tmp) - i);
+}
+
+static void put_int64(json_writer_t *w, int64_t v) {
+    if (v < 0) {
+        put_char(w, '-');
+        put_uint64(w, (uint64_t)0 - (uint64_t)v);
+    } else {
+        put_uint64(w, (uint64_t)v);
+    }
+}
+
+static int saturate_to_int(double d) {
+    if (d >= INT_MAX) return INT_MAX;
+    if (d <= (double)INT_MIN) return INT_MIN;
+    return (int)d;
+}
+
+static bool doubles_equal(double a, double b) {
+    double max_val = fabs(a) > fabs(b) ? fabs(a) : fabs(b);
+    return fabs(a - b) <= max_val * DBL_EPSILON;
+}
+
+static void put_number(json_writer_t *w, double d) {
+    if (isnan(d) || isinf(d)) {
+        put(w, "null", 4);
+        return;
+    }
+
+    int as_int = saturate_to_int(d);
+    if (d == (double)as_int) {
+        put_int64(w, as_int);
+        return;
+    }
+
+    // Szybka ścieżka: wartości z co najwyżej 2 miejscami po przecinku (telemetria po round2).
+    // Dla |n| < 1e15 "%1.15g" daje dokładnie zapis n/100 bez zer końcowych, więc składamy go ręcznie
+    // zamiast przechodzić przez printf/dtoa.
+    if (fabs(d) < 1e13) {
+        long long n = llround(d * 100.0);
+        if ((double)n / 100.0 == d) {
+            uint64_t mag = n < 0 ? (uint64_t)0 - (uint64_t)n : (uint64_t)n;
+            if (n < 0) put_char(w, '-');
+            put_uint64(w, mag / 100);
+            unsigned frac = (unsigned)(mag % 100);
+            if (frac != 0) {
+                char f[3] = { '.', (char)('0' + frac / 10), (char)('0' + frac % 10) };
+                put(w, f, (frac % 10) ? 3 : 2);
+            }
+            return;
+        }
+    }
+
+    char tmp[32];
+    int n = snprintf(tmp, sizeof(tmp), "%1.15g", d);
+    if (!doubles_equal(strtod(tmp, NULL), d)) {
+        n = snprintf(tmp, sizeof(tmp), "%1.17g", d);
+    }
+    if (n > 0) put(w, tmp, (size_t)n);
+}
+
+// --- API ---
+
+void json_writer_init(json_writer_t *w, char *buf, size_t cap) {
+    w->buf = buf;
+    w->cap = cap;
+    w->len = 0;
+    w->overflow = (buf == NULL || cap == 0);
+    w->depth = 0;
+    w->has_items = 0;
+    if (!w->overflow) buf[0] = '\0';
+}
+
+static void open_container(json_writer_t *w, const char *key, char c) {
+    put_prefix(w, key);
+    if (w->depth + 1 >= JSON_WRITER_MAX_DEPTH) {
+        w->overflow = true;
+        return;
+    }
+    put_char(w, c);
+    w->depth++;
+    w->has_items &= ~(1u << w->depth);
+}
+
+static void close_container(json_writer_t *w, char c) {
+    if (w->depth == 0) {
+        w->overflow = true;
+        return;
+    }
+    w->depth--;
+    put_char(w, c);
+}
+
+void json_writer_begin_object(json_writer_t *w, const char *key) { open_container(w, key, '{'); }
+void json_writer_end_object(json_writer_t *w) { close_container(w, '}'); }
+void json_writer_begin_array(json_writer_t *w, const char *key) { open_container(w, key, '['); }
+void json_writer_end_array(json_writer_t *w) { close_container(w, ']'); }
+
+void json_writer_string(json_writer_t *w, const char *key, const char *value) {
+    put_prefix(w, key);
+    put_quoted(w, value);
+}
+
+void json_writer_number(json_writer_t *w, const char *key, double value) {
+    put_prefix(w, key);
+    put_number(w, value);
+}
+
+void json_writer_int64(json_writer_t *w, const char *key, int64_t value) {
+    put_prefix(w, key);
+    // cJSON trzyma liczby jako double: powyżej 1e15 wraca notacja wykładnicza.
+    if (value > -1000000000000000LL && value < 1000000000000000LL) {
+        put_int64(w, value);
+    } else {
+        put_number(w, (double)value);
+    }
+}
+
+void json_writer_bool(json_writer_t *w, const char *key, bool value) {
+    put_prefix(w, key);
+    if (value) put(w, "true", 4);
+    else put(w, "false", 5);
+}
+
+void json_writer_null(json_writer_t *w, const char *key) {
+    put_prefix(w, key);
+    put(w, "null", 4);
+}
+
+// --- Normalizacja gotowego JSON-a (semantyka cJSON_Parse + cJSON_PrintUnformatted) ---
+
+static const char *skip_ws(const char *p) {
+    while (*p && (unsigned char)*p <= 32) p++;
+    return p;
+}
+
+static int parse_hex4(const char *p) {
+    int v = 0;
+    for (int i = 0; i < 4; i++) {
+        char c = p[i];
+        v <<= 4;
+        if (c >= '0' && c <= '9') v |= c - '0';
+        else if (c >= 'a' && c <= 'f') v |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') v |= c - 'A' + 10;
+        else return -1;
+    }
+    return v;
+}
+
+// Przepisuje string JSON (od otwierającego cudzysłowu) po odkodowaniu i ponownym escapowaniu.
+// Zwraca wskaźnik za zamykającym cudzysłowem albo NULL przy błędzie.
+static const char *copy_string(json_writer_t *w, const char *p) {
+    if (*p != '\"') return NULL;
+    p++;
+    bool terminated = false; // cJSON obcina string na znaku \u0000
+    put_char(w, '\"');
+    while (*p && *p != '\"') {
+        if (*p != '\\') {
+            if (!terminated) put_escaped_byte(w, (unsigned char)*p);
+            p++;
+            continue;
+        }
+        p++;
+        unsigned char c;
+        switch (*p) {
+            case 'b': c = '\b'; break;
+            case 'f': c = '\f'; break;
+            case 'n': c = '\n'; break;
+            case 'r': c = '\r'; break;
+            case 't': c = '\t'; break;
+            case '\"': case '\\': case '/': c = (unsigned char)*p; break;
+            case 'u': {
+                int first = parse_hex4(p + 1);
+                if (first < 0 || (first >= 0xDC00 && first <= 0xDFFF)) return NULL;
+                p += 4;
+                uint32_t cp = (uint32_t)first;
+                if (first >= 0xD800 && first <= 0xDBFF) {
+                    if (p[1] != '\\' || p[2] != 'u') return NULL;
+                    int second = parse_hex4(p + 3);
+                    if (second < 0xDC00 || second > 0xDFFF) return NULL;
+                    p += 6;
+                    cp = 0x10000 + ((((uint32_t)first & 0x3FF) << 10) | ((uint32_t)second & 0x3FF));
+                }
+                unsigned char utf8[4];
+                size_t n;
+                if (cp < 0x80) { utf8[0] = (unsigned char)cp; n = 1; }
+                else if (cp < 0x800) { utf8[0] = 0xC0 | (cp >> 6); utf8[1] = 0x80 | (cp & 0x3F); n = 2; }
+                else if (cp < 0x10000) { utf8[0] = 0xE0 | (cp >> 12); utf8[1] = 0x80 | ((cp >> 6) & 0x3F); utf8[2] = 0x80 | (cp & 0x3F); n = 3; }
+                else { utf8[0] = 0xF0 | (cp >> 18); utf8[1] = 0x80 | ((cp >> 12) & 0x3F); utf8[2] = 0x80 | ((cp >> 6) & 0x3F); utf8[3] = 0x80 | (cp & 0x3F); n = 4; }
+                for (size_t i = 0; i < n && !terminated; i++) {
+                    if (utf8[i] == 0) terminated = true;
+                    else put_escaped_byte(w, utf8[i]);
+                }
+                p++;
+                continue;
+            }
+            default:
+                return NULL;
+        }
+        if (!terminated) put_escaped_byte(w, c);
+        p++;
+    }
+    if (*p != '\"') return NULL;
+    put_char(w, '\"');
+    return p + 1;
+}
+
+static const char *copy_value(json_writer_t *w, const char *p, int depth);
+
+static const char *copy_number(json_writer_t *w, const char *p) {
+    char tmp[64];
+    size_t n = 0;
+    while (n < sizeof(tmp) - 1 && p[n] && strchr("0123456789+-eE.", p[n])) {
+        tmp[n] = p[n];
+        n++;
+    }
+    tmp[n] = '\0';
+    char *end = NULL;
+    double d = strtod(tmp, &end);
+    if (end == tmp) return NULL;
+    put_number(w, d);
+    return p + (end - tmp);
+}
+
+static const char *copy_container(json_writer_t *w, const char *p, int depth, bool is_object) {
+    if (depth >= JSON_WRITER_MAX_DEPTH) return NULL;
+    const char close = is_object ? '}' : ']';
+    put_char(w, is_object ? '{' : '[');
+    p = skip_ws(p + 1);
+    if (*p == close) {
+        put_char(w, close);
+        return p + 1;
+    }
+    for (bool first = true;; first = false) {
+        if (!first) put_char(w, ',');
+        p = skip_ws(p);
+        if (is_object) {
+            p = copy_string(w, p);
+            if (!p) return NULL;
+            p = skip_ws(p);
+            if (*p != ':') return NULL;
+            put_char(w, ':');
+            p = skip_ws(p + 1);
+        }
+        p = copy_value(w, p, depth + 1);
+        if (!p) return NULL;
+        p = skip_ws(p);
+        if (*p != ',') break;
+        p++;
+    }
+    if (*p != close) return NULL;
+    put_char(w, close);
+    return p + 1;
+}
+
+static const char *copy_value(json_writer_t *w, const char *p, int depth) {
+    if (strncmp(p, "null", 4) == 0) { put(w, "null", 4); return p + 4; }
+    if (strncmp(p, "false", 5) == 0) { put(w, "false", 5); return p + 5; }
+    if (strncmp(p, "true", 4) == 0) { put(w, "true", 4); return p + 4; }
+    if (*p == '\"') return copy_string(w, p);
+    if (*p == '-' || (*p >= '0' && *p <= '9')) return copy_number(w, p);
+    if (*p == '[') return copy_container(w, p, depth, false);
+    if (*p == '{') return copy_container(w, p, depth, true);
+    return NULL;
+}
+
+bool json_writer_raw_object(json_writer_t *w, const char *key, const char *json) {
+    put_prefix(w, key);
+
+    const size_t saved_len = w->len;
+    const bool saved_overflow = w->overflow;
+
+    const char *p = json;
+    if (p && strncmp(p, "\xEF\xBB\xBF", 3) == 0) p += 3;
+    if (p) p = skip_ws(p);
+
+    // Jak cJSON_Parse: dane za domkniętym obiektem są ignorowane.
+    if (p && *p == '{' && copy_container(w, p, w->depth + 1, true) != NULL) {
+        return true;
+    }
+
+    w->len = saved_len;
+    w->overflow = saved_overflow;
+    put(w, "null", 4);
+    return false;
+}
+
+const char *json_writer_finish(json_writer_t *w, size_t *out_len) {
+    if (w->overflow || w->depth != 0) {
+        if (out_len) *out_len = 0;
+        return NULL;
+    }
+    w->buf[w->len] = '\0';
+    if (out_len) *out_len = w->len;
+    return w->buf;
+}
@@ -0,0 +1,58 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Strumieniowy generator JSON do bufora o stałym rozmiarze (bez alokacji na stercie).
+//
+// Wynik jest bajtowo zgodny z cJSON_PrintUnformatted dla tych samych wywołań
+// (formatowanie liczb, escapowanie stringów, kolejność pól), więc może zastąpić
+// drzewa cJSON w ścieżkach publikacji bez zmian po stronie backendu.
+//
+// Klucz `key` podajemy dla pól obiektu; dla elementów tablicy i dla korzenia przekazujemy NULL.
+// Przepełnienie bufora jest "lepkie": kolejne wywołania są ignorowane,
+// a json_writer_finish() zwraca NULL.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define JSON_WRITER_MAX_DEPTH 8
+
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+    bool overflow;
+    uint8_t depth;
+    uint32_t has_items; // bit n = poziom n ma już co najmniej jeden element (potrzebny przecinek)
+} json_writer_t;
+
+void json_writer_init(json_writer_t *w, char *buf, size_t cap);
+
+void json_writer_begin_object(json_writer_t *w, const char *key);
+void json_writer_end_object(json_writer_t *w);
+void json_writer_begin_array(json_writer_t *w, const char *key);
+void json_writer_end_array(json_writer_t *w);
+
+void json_writer_string(json_writer_t *w, const char *key, const char *value);
+// Liczba w formacie cJSON (NaN/Inf => null, wartości całkowite bez części ułamkowej).
+void json_writer_number(json_writer_t *w, const char *key, double value);
+void json_writer_int64(json_writer_t *w, const char *key, int64_t value);
+void json_writer_bool(json_writer_t *w, const char *key, bool value);
+void json_writer_null(json_writer_t *w, const char *key);
+
+// Wstawia gotowy JSON-object (np. `details`) po normalizacji do postaci cJSON_PrintUnformatted.
+// Jeśli `json` nie jest poprawnym obiektem, wstawia null i zwraca false.
+bool json_writer_raw_object(json_writer_t *w, const char *key, const char *json);
+
+// Zwraca zakończony zerem bufor (lub NULL przy przepełnieniu / niedomkniętej strukturze).
+const char *json_writer_finish(json_writer_t *w, size_t *out_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // JSON_WRITER_H
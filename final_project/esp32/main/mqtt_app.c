@@ -1,11 +1,12 @@
 #include "mqtt_app.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include "esp_log.h"
 #include "mqtt_client.h"
-#include "cJSON.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "freertos/event_groups.h"
 #include "esp_event.h"
 #include "esp_mac.h"
@@ -14,8 +15,12 @@
 #include "sensors.h"
 
 #include "alert_limiter.h"
-
-#include "alert_limiter.h"
+#include "alert_ring.h"
+#include "json_writer.h"
+#include "telemetry_log.h"
+#include "telemetry_raw.h"
+#include "telemetry_codec.h"
+#include "telemetry_tsz.h"
 
 #include <math.h>
 #include <sys/time.h>
@@ -23,15 +28,28 @@
 static const char *TAG = "MQTT_APP";
 
 #define QUEUE_SIZE 50
-#define ALERT_QUEUE_SIZE 20
 
-#define PREINIT_ALERTS_MAX 12
+// Bufor alertów offline (także sprzed startu klienta MQTT); typowy alert zajmuje ~80-120 B
+#define ALERT_RING_BYTES 8192
+
+// Publikacje odłożone z taska MQTT (odpowiedzi na komendy, settings/state) - patrz s_publish_lock
+#define DEFERRED_RING_BYTES 3072
+#define DEFERRED_PAYLOAD_MAX 1024
+#define DEFERRED_TOPIC_MAX (MQTT_TOPIC_MAX + 32 > MQTT_RESPONSE_TOPIC_MAX ? MQTT_TOPIC_MAX + 32 : MQTT_RESPONSE_TOPIC_MAX)
+#define DEFERRED_RECORD_MAX (2 + DEFERRED_TOPIC_MAX + 1 + MQTT_CORRELATION_MAX + DEFERRED_PAYLOAD_MAX)
+
+// Bufory (stos) dla serializacji JSON - zastępują drzewa cJSON i alokacje na stercie
+#define TELEMETRY_JSON_BUF_SIZE 384
+#define CAPABILITIES_JSON_BUF_SIZE 896
+#define ALERT_JSON_BUF_SIZE 1024
+
+#define JSON_CONTENT_TYPE "application/json"
+
+// Miejsce na domknięcie paczki telemetrii: `],"count":NNNN}`
+#define TELEMETRY_BATCH_TAIL_RESERVE 24
 
 static esp_mqtt_client_handle_t client = NULL;
 static bool is_connected = false;
-static QueueHandle_t telemetry_queue = NULL;
-static QueueHandle_t alert_queue = NULL;
-static mqtt_data_callback_t data_callback = NULL;
 
 static char s_user_id[WIFI_PROV_MAX_USER_ID] = {0};
 static char s_device_id[13] = {0};
@@ -39,105 +57,527 @@ static char s_broker_uri[WIFI_PROV_MAX_BROKER_LEN] = {0};
 static char s_mqtt_login[WIFI_PROV_MAX_MQTT_LOGIN] = {0};
 static char s_mqtt_pass[WIFI_PROV_MAX_MQTT_PASS] = {0};
 
+// Topiki garden/{user}/{device}/<suffix> liczone raz w mqtt_load_runtime_config()
+typedef enum {
+    TOPIC_TELEMETRY = 0,
+    TOPIC_TELEMETRY_BATCH,
+    TOPIC_TELEMETRY_BIN,
+    TOPIC_TELEMETRY_TSZ,
+    TOPIC_ALERT,
+    TOPIC_CAPABILITIES,
+    TOPIC_SETTINGS_STATE,
+    TOPIC_COMMAND_RESPONSE,
+    TOPIC_COUNT,
+} mqtt_topic_id_t;
+
+static const char *const k_topic_suffix[TOPIC_COUNT] = {
+    [TOPIC_TELEMETRY] = "telemetry",
+    [TOPIC_TELEMETRY_BATCH] = "telemetry/batch",
+    [TOPIC_TELEMETRY_BIN] = "telemetry/bin",
+    [TOPIC_TELEMETRY_TSZ] = "telemetry/tsz",
+    [TOPIC_ALERT] = "alert",
+    [TOPIC_CAPABILITIES] = "capabilities",
+    [TOPIC_SETTINGS_STATE] = "settings/state",
+    [TOPIC_COMMAND_RESPONSE] = "command/response",
+};
+
+// Aliasy MQTT5 (0 = bez aliasu) dla topiców publikowanych cyklicznie z QoS 0.
+// Mapowanie alias -> topic istnieje tylko w obrębie jednego połączenia, a outbox esp-mqtt ponawia
+// wiadomości QoS 1/2 po ponownym połączeniu bajt w bajt - skrócona forma byłaby wtedy błędem
+// protokołu, a pełna nazwa + alias to tylko 3 B więcej. Dlatego QoS 1/2 idzie zawsze bez aliasu.
+static const uint16_t k_topic_alias[TOPIC_COUNT] = {
+    [TOPIC_SETTINGS_STATE] = 1,
+};
+
+// publish_locked(): właściwości MQTT5 odrzucone (alias > Topic Alias Maximum brokera, brak pamięci) - nic nie wysłano
+#define PUBLISH_ERR_PROPERTY (-3)
+
+#define MQTT_TOPIC_MAX (sizeof("garden///") + WIFI_PROV_MAX_USER_ID + 12 + 16)
+
+static char s_topic_prefix[MQTT_TOPIC_MAX] = {0}; // garden/{user}/{device}/
+static char s_topics[TOPIC_COUNT][MQTT_TOPIC_MAX];
+static bool s_alias_established[TOPIC_COUNT]; // alias wysłany z pełną nazwą w bieżącym połączeniu
+static bool s_alias_disabled = false;         // broker odrzucił alias (Topic Alias Maximum)
+static volatile bool s_alias_reset = false;   // nowe połączenie - aliasy do ustanowienia od nowa
+
+static mqtt_app_stats_t s_stats;
+
+// --- Routing wiadomości przychodzących ---
+// Tablica tras suffix -> handler wypełniana przed startem (potem tylko czytana z taska MQTT).
+// Topic dopasowywany dokładnie: prefiks urządzenia + suffix, bez kopiowania i bez strstr.
+#define MQTT_ROUTES_MAX 8
+
+typedef struct {
+    const char *suffix;
+    size_t suffix_len;
+    mqtt_command_handler_t handler;
+} mqtt_route_t;
+
+static mqtt_route_t s_routes[MQTT_ROUTES_MAX];
+static size_t s_route_count = 0;
+static size_t s_topic_prefix_len = 0;
+
+// Wiadomości dłuższe niż bufor wejściowy klienta (CONFIG_MQTT_BUFFER_SIZE) przychodzą w kilku
+// zdarzeniach MQTT_EVENT_DATA (current_data_offset / total_data_len). Składamy je w stałej puli
+// buforów; wiadomość mieszcząca się w jednym zdarzeniu idzie do handlera bez kopiowania.
+// esp-mqtt dostarcza fragmenty jednej wiadomości kolejno, więc wystarcza jeden bufor.
+#define MQTT_RX_POOL_SIZE 1
+#define MQTT_RX_MAX_PAYLOAD 2048
+
+typedef struct {
+    bool busy;
+    const mqtt_route_t *route;
+    int total_len;
+    int received;
+    mqtt_reply_to_t reply_to;
+    char buf[MQTT_RX_MAX_PAYLOAD];
+} mqtt_rx_slot_t;
+
+static mqtt_rx_slot_t s_rx_pool[MQTT_RX_POOL_SIZE];
+static mqtt_rx_slot_t *s_rx_active = NULL; // wiadomość w trakcie składania (fragmenty przychodzą po kolei)
+
+// Limity pól alertu (z terminatorem); dłuższe wartości są obcinane
+#define ALERT_CODE_MAX 48
+#define ALERT_SEVERITY_MAX 10
+#define ALERT_SUBSYSTEM_MAX 16
+#define ALERT_MESSAGE_MAX 128
+#define ALERT_DETAILS_MAX 256
+
+// Zakodowany alert (tak jest trzymany w buforze): i64 timestamp (LE), potem code, severity,
+// subsystem, message i details, każde zakończone NUL (puste details = brak).
+#define ALERT_RECORD_MAX_SIZE (8 + ALERT_CODE_MAX + ALERT_SEVERITY_MAX + ALERT_SUBSYSTEM_MAX + \
+                               ALERT_MESSAGE_MAX + ALERT_DETAILS_MAX)
+
+// Widok na zakodowany alert (wskaźniki do bufora rekordu)
 typedef struct {
     int64_t timestamp_ms;
-    char code[48];
-    char severity[10];
-    char subsystem[16];
-    char message[128];
-    bool has_details;
-    char details_json[256];
+    const char *code;
+    const char *severity;
+    const char *subsystem;
+    const char *message;
+    const char *details_json; // NULL = brak
 } mqtt_alert_record_t;
 
-static mqtt_alert_record_t s_preinit_alerts[PREINIT_ALERTS_MAX];
-static size_t s_preinit_alerts_count = 0;
+static uint8_t s_alert_ring_buf[ALERT_RING_BYTES];
+static alert_ring_t s_alert_ring = ALERT_RING_INITIALIZER(s_alert_ring_buf, sizeof(s_alert_ring_buf), ALERT_RING_DROP_NEWEST);
 
 static bool s_telemetry_buffering = false;
 static uint32_t s_telemetry_dropped = 0;
-static uint32_t s_alert_dropped = 0;
 static int s_consecutive_buffered_count = 0;
 
-int mqtt_app_get_consecutive_buffered_count(void) {
-    return s_consecutive_buffered_count;
+// Bufor paczki telemetrii (używany wyłącznie z taska backlog_drain_task)
+static char s_batch_buf[CONFIG_TELEMETRY_BATCH_MAX_BYTES];
+
+static telemetry_encoding_t s_telemetry_encoding = TELEMETRY_ENCODING_JSON;
+
+// Ustawienie właściwości MQTT5 i publish muszą iść parą (publikują różne taski).
+// Kolejność blokad: s_publish_lock, potem blokada API esp-mqtt (brana w set_publish_property i publish).
+// Task MQTT wywołuje handler zdarzeń z zajętą blokadą API, więc nie może czekać na s_publish_lock
+// (zakleszczenie z taskiem, który trzyma s_publish_lock i czeka na blokadę API). Publikacje z tego
+// taska (alerty, capabilities, odpowiedzi na komendy) są odkładane i wysyła je backlog_drain_task.
+static SemaphoreHandle_t s_publish_lock = NULL;
+static TaskHandle_t s_mqtt_task = NULL; // task klienta MQTT (ustawiany w handlerze zdarzeń)
+
+// Rekord: u8 topic (mqtt_topic_id_t, TOPIC_COUNT = topic podany wprost), u8 qos, topic zakończony NUL
+// (pusty dla topiców z k_topic_suffix), u8 długość correlation data, correlation data, payload.
+static uint8_t s_deferred_ring_buf[DEFERRED_RING_BYTES];
+static alert_ring_t s_deferred_ring = ALERT_RING_INITIALIZER(s_deferred_ring_buf, sizeof(s_deferred_ring_buf), ALERT_RING_DROP_NEWEST);
+static uint8_t s_deferred_out[DEFERRED_RECORD_MAX]; // tylko backlog_drain_task
+
+// --- Wysyłanie backlogu (alerty + telemetria) w tle, w tempie potwierdzeń brokera ---
+//
+// backlog_drain_task wysyła po jednej wiadomości (alert lub paczka/blok telemetrii), trzymając
+// maks. CONFIG_TELEMETRY_DRAIN_WINDOW niepotwierdzonych wiadomości w locie. Rekordy są zwalniane
+// z bufora dopiero po MQTT_EVENT_PUBLISHED (PUBACK/PUBCOMP) - po kolei, więc rozłączenie w trakcie
+// nie gubi danych. Niepotwierdzone wiadomości zostają w outboxie klienta i są ponawiane przez
+// esp-mqtt po ponownym połączeniu; MQTT_EVENT_DELETED (wygaśnięcie w outboxie) lub brak potwierdzenia
+// przez DRAIN_ACK_TIMEOUT_MS cofa wysyłanie do najstarszego niepotwierdzonego rekordu.
+// Przy dużym outboxie (np. wolne łącze) wysyłanie czeka na potwierdzenia zamiast dokładać kolejne wiadomości.
+
+#define DRAIN_ACK_TIMEOUT_MS    60000
+#define DRAIN_IDLE_POLL_MS      5000
+#define DRAIN_ACK_QUEUE_SIZE    16
+
+#define DRAIN_EVT_CONNECTED     (1u << 0)
+#define DRAIN_EVT_ACK           (1u << 1)
+#define DRAIN_EVT_DEFERRED      (1u << 2) // publikacja odłożona z taska MQTT
+#define DRAIN_EVT_CAPABILITIES  (1u << 3)
+
+typedef struct {
+    int msg_id;
+    bool ok;              // false = wiadomość usunięta z outboxa bez potwierdzenia
+} drain_ack_t;
+
+typedef struct {
+    int msg_id;
+    uint32_t end;         // pozycja za ostatnim rekordem wiadomości (telemetria) / id wpisu w s_alert_ring
+    bool alert;
+    bool acked;
+    TickType_t sent_at;
+} drain_unit_t;
+
+static TaskHandle_t s_drain_task = NULL;
+static QueueHandle_t s_ack_queue = NULL;
+
+// Stan poniżej należy wyłącznie do backlog_drain_task
+static drain_unit_t s_inflight[CONFIG_TELEMETRY_DRAIN_WINDOW];
+static size_t s_inflight_head = 0;
+static size_t s_inflight_count = 0;
+static uint32_t s_drain_next = 0;     // pozycja następnego rekordu do wysłania
+static bool s_alert_inflight = false; // najstarszy alert z s_alert_ring czeka na potwierdzenie
+static uint32_t s_drain_sent = 0;     // wiadomości wysłane od ostatniego opróżnienia backlogu
+static uint8_t s_drain_alert[ALERT_RECORD_MAX_SIZE];
+
+static void drain_notify(uint32_t events);
+static void drain_on_ack(int msg_id, bool ok);
+static void backlog_drain_task(void *arg);
+
+// Zapasowy bufor offline w RAM (gdy brak partycji telemetry_log): pierścień z pozycjami absolutnymi,
+// tak jak w logu na flashu, żeby wysyłanie z potwierdzeniami działało tak samo dla obu wariantów.
+// Rekordy w zwartej postaci telemetry_raw_rec_t - BME280 jako surowe rejestry, kompensowane przy wysyłce.
+static telemetry_raw_rec_t s_ram_backlog[QUEUE_SIZE];
+static uint32_t s_ram_first = 0; // pozycja najstarszego rekordu
+static uint32_t s_ram_end = 0;   // pozycja za najnowszym rekordem
+static SemaphoreHandle_t s_ram_lock = NULL;
+
+// Rekordy odczytane z pierścienia i skompensowane hurtem (tylko backlog_drain_task)
+#define RAM_DECODE_CACHE 8
+static telemetry_data_t s_ram_cache[RAM_DECODE_CACHE];
+static uint32_t s_ram_cache_pos = 0;
+static uint32_t s_ram_cache_count = 0;
+
+// Bufor offline: trwały log na flashu (telemetry_log), a gdy partycji brak - pierścień w RAM.
+static bool backlog_push(const telemetry_data_t *rec) {
+    if (telemetry_log_is_ready()) {
+        // Log trzyma wartości skompensowane; surowy BME280 tylko z odczytu sprzed gotowości logu
+        telemetry_data_t resolved;
+        if (rec->bme_raw_pending) {
+            resolved = *rec;
+            sensors_resolve_raw(&resolved, 1);
+            rec = &resolved;
+        }
+        return telemetry_log_append(rec) == ESP_OK;
+    }
+    if (!s_ram_lock) return false;
+
+    xSemaphoreTake(s_ram_lock, portMAX_DELAY);
+    bool ok = (s_ram_end - s_ram_first) < QUEUE_SIZE;
+    if (ok) telemetry_raw_pack(rec, &s_ram_backlog[s_ram_end++ % QUEUE_SIZE]);
+    xSemaphoreGive(s_ram_lock);
+    return ok;
 }
 
-static int64_t get_time_ms(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return (int64_t)tv.tv_sec * 1000 + (tv.tv_usec / 1000);
+static uint32_t backlog_first(void) {
+    if (telemetry_log_is_ready()) return telemetry_log_first();
+    return s_ram_first;
 }
 
-static void enqueue_preinit_alert(const mqtt_alert_record_t *rec) {
-    if (!rec) return;
-    if (s_preinit_alerts_count >= PREINIT_ALERTS_MAX) {
+static bool backlog_read(uint32_t pos, telemetry_data_t *rec) {
+    if (telemetry_log_is_ready()) return telemetry_log_read(pos, rec);
+    if (!s_ram_lock) return false;
+
+    if (pos - s_ram_cache_pos < s_ram_cache_count) {
+        *rec = s_ram_cache[pos - s_ram_cache_pos];
+        return true;
+    }
+
+    // Kolejne rekordy od `pos` rozpakowane i skompensowane jednym wywołaniem
+    xSemaphoreTake(s_ram_lock, portMAX_DELAY);
+    uint32_t n = 0;
+    if (pos >= s_ram_first) {
+        while (n < RAM_DECODE_CACHE && pos + n < s_ram_end) {
+            telemetry_raw_unpack(&s_ram_backlog[(pos + n) % QUEUE_SIZE], &s_ram_cache[n]);
+            n++;
+        }
+    }
+    xSemaphoreGive(s_ram_lock);
+
+    sensors_resolve_raw(s_ram_cache, n);
+    s_ram_cache_pos = pos;
+    s_ram_cache_count = n;
+    if (n == 0) return false;
+    *rec = s_ram_cache[0];
+    return true;
+}
+
+// Zwalnia rekordy o pozycjach < upto (potwierdzone przez broker)
+static void backlog_release(uint32_t upto) {
+    if (telemetry_log_is_ready()) {
+        (void)telemetry_log_release(upto);
         return;
     }
-    s_preinit_alerts[s_preinit_alerts_count++] = *rec;
+    if (!s_ram_lock) return;
+
+    xSemaphoreTake(s_ram_lock, portMAX_DELAY);
+    if (upto > s_ram_end) upto = s_ram_end;
+    if (upto > s_ram_first) s_ram_first = upto;
+    xSemaphoreGive(s_ram_lock);
+}
+
+static uint32_t backlog_count(void) {
+    if (telemetry_log_is_ready()) return telemetry_log_count();
+    return s_ram_end - s_ram_first;
 }
 
-static void publish_alert_record(const mqtt_alert_record_t *rec) {
-    if (!client || !rec) return;
+static uint32_t backlog_capacity(void) {
+    return telemetry_log_is_ready() ? telemetry_log_capacity() : QUEUE_SIZE;
+}
 
-    char topic[256];
-    snprintf(topic, sizeof(topic), "garden/%s/%s/alert", s_user_id, s_device_id);
+// Rekordy nadpisane w trwałym logu (drop-oldest) liczymy tak samo jak odrzucone z pełnej kolejki.
+static void report_telemetry_dropped(void) {
+    uint32_t suppressed = 0;
+    if (alert_limiter_allow("telemetry.buffer_full_dropped", esp_log_timestamp(), 60 * 1000, &suppressed)) {
+        char details[160];
+        snprintf(details, sizeof(details), "{\"dropped\":%lu,\"queue_size\":%lu,\"suppressed\":%lu}",
+                 (unsigned long)s_telemetry_dropped, (unsigned long)backlog_capacity(), (unsigned long)suppressed);
+        mqtt_app_send_alert2_details("telemetry.buffer_full_dropped", "error", "telemetry", "Telemetry dropped: offline queue full", details);
+        s_telemetry_dropped = 0;
+    }
+}
 
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "device", s_device_id);
-    cJSON_AddStringToObject(root, "user", s_user_id);
-    cJSON_AddNumberToObject(root, "timestamp", rec->timestamp_ms);
+// Publish z właściwościami MQTT5 content-type / payload-format-indicator / topic alias (s_publish_lock trzymany).
+// `reply_to` (może być NULL) dokłada correlation data odpowiedzi na komendę.
+static int publish_locked(const char *topic, uint16_t alias, bool short_form, const char *data, int len, int qos,
+                          int retain, const char *content_type, const mqtt_reply_to_t *reply_to) {
+    esp_mqtt5_publish_property_config_t props = {
+        .payload_format_indicator = (strcmp(content_type, JSON_CONTENT_TYPE) == 0), // 1 = UTF-8
+        .content_type = content_type,
+        .topic_alias = alias,
+    };
+    if (reply_to && reply_to->correlation_len > 0) {
+        props.correlation_data = (const char *)reply_to->correlation;
+        props.correlation_data_len = reply_to->correlation_len;
+    }
+    if (esp_mqtt5_client_set_publish_property(client, &props) != ESP_OK) return PUBLISH_ERR_PROPERTY;
+    int msg_id = esp_mqtt_client_publish(client, short_form ? "" : topic, data, len, qos, retain);
+    if (msg_id >= 0) {
+        size_t topic_len = strlen(topic);
+        s_stats.messages++;
+        s_stats.payload_bytes += (uint32_t)len;
+        s_stats.topic_bytes += short_form ? 0 : (uint32_t)topic_len;
+        if (short_form) s_stats.alias_saved_bytes += (uint32_t)topic_len;
+    }
+    return msg_id;
+}
 
-    // Back-compat
-    cJSON_AddStringToObject(root, "type", rec->code);
-    cJSON_AddStringToObject(root, "msg", rec->message);
+static int publish_typed(mqtt_topic_id_t id, const char *data, int len, int qos, int retain, const char *content_type) {
+    if (s_publish_lock) xSemaphoreTake(s_publish_lock, portMAX_DELAY);
 
-    // v2
-    cJSON_AddStringToObject(root, "code", rec->code);
-    cJSON_AddStringToObject(root, "severity", rec->severity);
-    cJSON_AddStringToObject(root, "subsystem", rec->subsystem);
-    cJSON_AddStringToObject(root, "message", rec->message);
-
-    if (rec->has_details && rec->details_json[0] != '\0') {
-        cJSON *details = cJSON_Parse(rec->details_json);
-        if (cJSON_IsObject(details)) {
-            cJSON_AddItemToObject(root, "details", details);
-        } else {
-            if (details) cJSON_Delete(details);
-            cJSON_AddNullToObject(root, "details");
-        }
-    } else {
-        cJSON_AddNullToObject(root, "details");
+    // Aliasy trzeba ustanowić od nowa w każdym połączeniu
+    if (s_alias_reset) {
+        s_alias_reset = false;
+        memset(s_alias_established, 0, sizeof(s_alias_established));
+        s_alias_disabled = false;
     }
 
-    char *json_str = cJSON_PrintUnformatted(root);
-    if (json_str) {
-        esp_mqtt_client_publish(client, topic, json_str, 0, 2, 0);
-        free(json_str);
+    uint16_t alias = (s_alias_disabled || qos != 0) ? 0 : k_topic_alias[id];
+    bool short_form = alias && s_alias_established[id];
+    int msg_id = publish_locked(s_topics[id], alias, short_form, data, len, qos, retain, content_type, NULL);
+    if (msg_id == PUBLISH_ERR_PROPERTY && alias) {
+        // Alias powyżej Topic Alias Maximum brokera - pełne nazwy do końca połączenia
+        ESP_LOGW(TAG, "Broker nie przyjmuje aliasu %u - wysyłanie pełnych nazw topiców", alias);
+        s_alias_disabled = true;
+        msg_id = publish_locked(s_topics[id], 0, false, data, len, qos, retain, content_type, NULL);
+    } else if (msg_id >= 0 && alias && is_connected) {
+        s_alias_established[id] = true;
     }
+    if (msg_id == PUBLISH_ERR_PROPERTY) {
+        ESP_LOGE(TAG, "Nie można ustawić właściwości publikacji na %s", s_topics[id]);
+    }
+
+    if (s_publish_lock) xSemaphoreGive(s_publish_lock);
+    return msg_id;
+}
 
-    cJSON_Delete(root);
+// Publish na topic podany wprost (bez aliasu)
+static int publish_plain(const char *topic, const char *data, int len, int qos, const mqtt_reply_to_t *reply_to) {
+    if (s_publish_lock) xSemaphoreTake(s_publish_lock, portMAX_DELAY);
+    int msg_id = publish_locked(topic, 0, false, data, len, qos, 0, JSON_CONTENT_TYPE, reply_to);
+    if (s_publish_lock) xSemaphoreGive(s_publish_lock);
+    return msg_id;
 }
 
-static void send_or_buffer_alert(const mqtt_alert_record_t *rec) {
-    if (!rec) return;
+static bool in_mqtt_task(void) {
+    return s_mqtt_task != NULL && xTaskGetCurrentTaskHandle() == s_mqtt_task;
+}
 
-    // If MQTT client not started yet, keep a small preinit buffer.
-    if (!client) {
-        enqueue_preinit_alert(rec);
+// Odkłada publikację JSON z taska MQTT do backlog_drain_task. `topic` = NULL dla topiców z k_topic_suffix.
+// Bufor rekordu statyczny - wołane wyłącznie z taska MQTT.
+static void defer_publish(mqtt_topic_id_t id, const char *topic, const char *data, int len, int qos,
+                          const mqtt_reply_to_t *reply_to) {
+    static uint8_t rec[DEFERRED_RECORD_MAX];
+    size_t topic_len = topic ? strlen(topic) : 0;
+    uint8_t corr_len = reply_to ? (uint8_t)reply_to->correlation_len : 0;
+    if (len < 0 || len > DEFERRED_PAYLOAD_MAX || topic_len >= DEFERRED_TOPIC_MAX) {
+        ESP_LOGE(TAG, "Wiadomość z taska MQTT za duża (%d B) - pominięto", len);
         return;
     }
 
-    if (is_connected) {
-        publish_alert_record(rec);
+    size_t off = 0;
+    rec[off++] = (uint8_t)id;
+    rec[off++] = (uint8_t)qos;
+    memcpy(&rec[off], topic ? topic : "", topic_len + 1);
+    off += topic_len + 1;
+    rec[off++] = corr_len;
+    if (corr_len > 0) memcpy(&rec[off], reply_to->correlation, corr_len);
+    off += corr_len;
+    memcpy(&rec[off], data, (size_t)len);
+    off += (size_t)len;
+
+    if (!alert_ring_push(&s_deferred_ring, rec, off)) {
+        ESP_LOGW(TAG, "Bufor odłożonych wiadomości pełny - pominięto (%d B)", len);
         return;
     }
+    drain_notify(DRAIN_EVT_DEFERRED);
+}
 
-    if (alert_queue) {
-        if (xQueueSend(alert_queue, rec, 0) != pdTRUE) {
-            s_alert_dropped++;
+// Wysyła publikacje odłożone z taska MQTT (backlog_drain_task). Wiadomość, której nie udało się
+// wysłać, jest porzucana - tak jak przy publikacji bezpośredniej.
+static void deferred_flush(void) {
+    uint16_t id = 0;
+    size_t len = 0;
+    while (is_connected && (len = alert_ring_peek(&s_deferred_ring, s_deferred_out, sizeof(s_deferred_out), &id)) > 0) {
+        const uint8_t *rec = s_deferred_out;
+        mqtt_topic_id_t topic_id = (mqtt_topic_id_t)rec[0];
+        int qos = rec[1];
+        const char *topic = (const char *)&rec[2];
+        size_t off = 2 + strlen(topic) + 1;
+        mqtt_reply_to_t reply_to = {.correlation_len = rec[off++]};
+        memcpy(reply_to.correlation, &rec[off], reply_to.correlation_len);
+        off += reply_to.correlation_len;
+        const char *data = (const char *)&rec[off];
+        int data_len = (int)(len - off);
+
+        int msg_id = topic_id < TOPIC_COUNT
+                         ? publish_typed(topic_id, data, data_len, qos, 0, JSON_CONTENT_TYPE)
+                         : publish_plain(topic, data, data_len, qos, reply_to.correlation_len ? &reply_to : NULL);
+        if (msg_id < 0) {
+            ESP_LOGW(TAG, "Nie udało się wysłać odłożonej wiadomości na %s",
+                     topic_id < TOPIC_COUNT ? s_topics[topic_id] : topic);
         }
+        (void)alert_ring_pop(&s_deferred_ring, id);
+    }
+}
+
+void mqtt_app_get_stats(mqtt_app_stats_t *out) {
+    if (!out) return;
+    if (s_publish_lock) xSemaphoreTake(s_publish_lock, portMAX_DELAY);
+    *out = s_stats;
+    if (s_publish_lock) xSemaphoreGive(s_publish_lock);
+}
+
+void mqtt_app_set_telemetry_encoding(telemetry_encoding_t encoding) {
+    if (encoding == s_telemetry_encoding) return;
+    s_telemetry_encoding = encoding;
+    ESP_LOGI(TAG, "Kodowanie telemetrii: %s", encoding == TELEMETRY_ENCODING_BINARY ? "binary" : "json");
+    if (is_connected) mqtt_app_publish_capabilities();
+}
+
+telemetry_encoding_t mqtt_app_get_telemetry_encoding(void) {
+    return s_telemetry_encoding;
+}
+
+int mqtt_app_get_consecutive_buffered_count(void) {
+    return s_consecutive_buffered_count;
+}
+
+static int64_t get_time_ms(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (int64_t)tv.tv_sec * 1000 + (tv.tv_usec / 1000);
+}
+
+static void put_alert_str(uint8_t *buf, size_t *off, const char *s, size_t max) {
+    size_t n = strnlen(s, max - 1);
+    memcpy(buf + *off, s, n);
+    buf[*off + n] = '\0';
+    *off += n + 1;
+}
+
+static const char *get_alert_str(const uint8_t *buf, size_t len, size_t *off) {
+    if (*off >= len) return "";
+    const char *s = (const char *)buf + *off;
+    *off += strnlen(s, len - *off) + 1;
+    return s;
+}
+
+// Koduje alert do `buf` (min. ALERT_RECORD_MAX_SIZE B); zwraca długość rekordu.
+static size_t alert_encode(uint8_t *buf, int64_t timestamp_ms, const char *code, const char *severity,
+                           const char *subsystem, const char *message, const char *details_json) {
+    size_t off = 0;
+    for (int i = 0; i < 8; i++) buf[off++] = (uint8_t)((uint64_t)timestamp_ms >> (8 * i));
+    put_alert_str(buf, &off, code, ALERT_CODE_MAX);
+    put_alert_str(buf, &off, severity, ALERT_SEVERITY_MAX);
+    put_alert_str(buf, &off, subsystem, ALERT_SUBSYSTEM_MAX);
+    put_alert_str(buf, &off, message, ALERT_MESSAGE_MAX);
+    put_alert_str(buf, &off, details_json ? details_json : "", ALERT_DETAILS_MAX);
+    return off;
+}
+
+static void alert_decode(const uint8_t *buf, size_t len, mqtt_alert_record_t *rec) {
+    uint64_t ts = 0;
+    for (int i = 0; i < 8 && i < (int)len; i++) ts |= (uint64_t)buf[i] << (8 * i);
+    size_t off = 8;
+    rec->timestamp_ms = (int64_t)ts;
+    rec->code = get_alert_str(buf, len, &off);
+    rec->severity = get_alert_str(buf, len, &off);
+    rec->subsystem = get_alert_str(buf, len, &off);
+    rec->message = get_alert_str(buf, len, &off);
+    rec->details_json = get_alert_str(buf, len, &off);
+    if (rec->details_json[0] == '\0') rec->details_json = NULL;
+}
+
+// Zwraca msg_id publikacji (<0 błąd, 0 = alert pominięty, bo nie mieści się w buforze)
+static int publish_alert_record(const mqtt_alert_record_t *rec) {
+    if (!client || !rec) return -1;
+
+    char json_buf[ALERT_JSON_BUF_SIZE];
+    json_writer_t w;
+    json_writer_init(&w, json_buf, sizeof(json_buf));
+
+    json_writer_begin_object(&w, NULL);
+    json_writer_string(&w, "device", s_device_id);
+    json_writer_string(&w, "user", s_user_id);
+    json_writer_int64(&w, "timestamp", rec->timestamp_ms);
+
+    // Back-compat
+    json_writer_string(&w, "type", rec->code);
+    json_writer_string(&w, "msg", rec->message);
+
+    // v2
+    json_writer_string(&w, "code", rec->code);
+    json_writer_string(&w, "severity", rec->severity);
+    json_writer_string(&w, "subsystem", rec->subsystem);
+    json_writer_string(&w, "message", rec->message);
+
+    if (rec->details_json) {
+        json_writer_raw_object(&w, "details", rec->details_json);
     } else {
-        enqueue_preinit_alert(rec);
+        json_writer_null(&w, "details");
+    }
+    json_writer_end_object(&w);
+
+    size_t json_len = 0;
+    const char *json_str = json_writer_finish(&w, &json_len);
+    if (!json_str) {
+        ESP_LOGE(TAG, "Alert JSON too large (code=%s)", rec->code);
+        return 0;
     }
+    return publish_typed(TOPIC_ALERT, json_str, (int)json_len, 2, 0, JSON_CONTENT_TYPE);
+}
+
+static void send_or_buffer_alert(const uint8_t *buf, size_t len) {
+    if (client && is_connected && !in_mqtt_task()) {
+        mqtt_alert_record_t rec;
+        alert_decode(buf, len, &rec);
+        (void)publish_alert_record(&rec);
+        return;
+    }
+
+    // Przed startem klienta, offline i z taska MQTT alert czeka w buforze (wysyła go backlog_drain_task).
+    // Przy pełnym buforze odrzucamy nowy alert (licznik zgłaszany po połączeniu).
+    (void)alert_ring_push(&s_alert_ring, buf, len);
+    if (is_connected) drain_notify(DRAIN_EVT_DEFERRED);
 }
 
 static void mac_to_hex(char *out, size_t out_len) {
@@ -172,6 +612,12 @@ static void mqtt_load_runtime_config(void) {
     strlcpy(s_mqtt_login, cfg.mqtt_login, sizeof(s_mqtt_login));
     strlcpy(s_mqtt_pass, cfg.mqtt_pass, sizeof(s_mqtt_pass));
 
+    snprintf(s_topic_prefix, sizeof(s_topic_prefix), "garden/%s/%s/", s_user_id, s_device_id);
+    s_topic_prefix_len = strlen(s_topic_prefix);
+    for (int i = 0; i < TOPIC_COUNT; i++) {
+        snprintf(s_topics[i], sizeof(s_topics[i]), "%s%s", s_topic_prefix, k_topic_suffix[i]);
+    }
+
     ESP_LOGI(TAG, "MQTT cfg: broker=%s user_id=%s device_id=%s mqtt_login=%s", s_broker_uri, s_user_id, s_device_id, s_mqtt_login);
 }
 
@@ -179,12 +625,144 @@ static bool mqtt_has_required_config(void) {
     return (s_broker_uri[0] != '\0' && s_user_id[0] != '\0' && s_mqtt_login[0] != '\0' && s_mqtt_pass[0] != '\0');
 }
 
+esp_err_t mqtt_app_register_handler(const char *suffix, mqtt_command_handler_t handler) {
+    if (!suffix || !handler) return ESP_ERR_INVALID_ARG;
+    if (s_route_count >= MQTT_ROUTES_MAX) return ESP_ERR_NO_MEM;
+
+    s_routes[s_route_count++] = (mqtt_route_t){
+        .suffix = suffix,
+        .suffix_len = strlen(suffix),
+        .handler = handler,
+    };
+    return ESP_OK;
+}
+
+static const mqtt_route_t *route_find(const char *topic, int topic_len) {
+    if (topic_len <= (int)s_topic_prefix_len || memcmp(topic, s_topic_prefix, s_topic_prefix_len) != 0) {
+        return NULL;
+    }
+    const char *suffix = topic + s_topic_prefix_len;
+    size_t suffix_len = (size_t)topic_len - s_topic_prefix_len;
+    for (size_t i = 0; i < s_route_count; i++) {
+        if (s_routes[i].suffix_len == suffix_len && memcmp(s_routes[i].suffix, suffix, suffix_len) == 0) {
+            return &s_routes[i];
+        }
+    }
+    return NULL;
+}
+
+static void report_inbound_too_large(int topic_len, int total_len) {
+    uint32_t suppressed = 0;
+    if (alert_limiter_allow("mqtt.inbound_too_large", esp_log_timestamp(), 60 * 1000, &suppressed)) {
+        char details[128];
+        snprintf(details, sizeof(details), "{\"topic_len\":%d,\"payload_len\":%d,\"max_len\":%d,\"suppressed\":%lu}",
+                 topic_len, total_len, MQTT_RX_MAX_PAYLOAD, (unsigned long)suppressed);
+        mqtt_app_send_alert2_details("mqtt.inbound_too_large", "error", "mqtt", "Dropped inbound MQTT message (too large)", details);
+    }
+}
+
+// Kopiuje Response Topic / Correlation Data z żądania (za długie pola są pomijane - odpowiedź pójdzie na /command/response)
+static void reply_to_from_event(esp_mqtt_event_handle_t event, mqtt_reply_to_t *out) {
+    memset(out, 0, sizeof(*out));
+    const esp_mqtt5_event_property_t *prop = event->property;
+    if (!prop) return;
+
+    if (prop->response_topic && prop->response_topic_len > 0) {
+        if (prop->response_topic_len < (int)sizeof(out->response_topic)) {
+            memcpy(out->response_topic, prop->response_topic, prop->response_topic_len);
+            out->response_topic[prop->response_topic_len] = '\0';
+        } else {
+            ESP_LOGW(TAG, "Response topic za długi (%d B) - pomijam", prop->response_topic_len);
+        }
+    }
+    if (prop->correlation_data && prop->correlation_data_len > 0) {
+        if (prop->correlation_data_len <= sizeof(out->correlation)) {
+            memcpy(out->correlation, prop->correlation_data, prop->correlation_data_len);
+            out->correlation_len = prop->correlation_data_len;
+        } else {
+            ESP_LOGW(TAG, "Correlation data za długie (%u B) - pomijam", (unsigned)prop->correlation_data_len);
+        }
+    }
+}
+
+static void rx_slot_release(mqtt_rx_slot_t *slot) {
+    slot->busy = false;
+    if (s_rx_active == slot) s_rx_active = NULL;
+}
+
+// Obsługa MQTT_EVENT_DATA. Topic jest ustawiony tylko w pierwszym fragmencie wiadomości.
+static void handle_inbound_data(esp_mqtt_event_handle_t event) {
+    if (event->current_data_offset == 0) {
+        ESP_LOGI(TAG, "Odebrano dane na temat: %.*s (%d B)", event->topic_len, event->topic, event->total_data_len);
+
+        // Poprzednia wiadomość urwana (np. rozłączenie w trakcie) - porzucamy ją
+        if (s_rx_active) {
+            ESP_LOGW(TAG, "Porzucono niekompletną wiadomość (%d/%d B)", s_rx_active->received, s_rx_active->total_len);
+            rx_slot_release(s_rx_active);
+        }
+
+        const mqtt_route_t *route = route_find(event->topic, event->topic_len);
+        if (!route) {
+            ESP_LOGW(TAG, "Brak obsługi dla topicu: %.*s", event->topic_len, event->topic);
+            return;
+        }
+
+        // Cała wiadomość w jednym zdarzeniu: handler dostaje bufor klienta MQTT
+        if (event->data_len == event->total_data_len) {
+            mqtt_reply_to_t reply_to;
+            reply_to_from_event(event, &reply_to);
+            route->handler(event->data, event->data_len, &reply_to);
+            return;
+        }
+
+        if (event->total_data_len > MQTT_RX_MAX_PAYLOAD) {
+            report_inbound_too_large(event->topic_len, event->total_data_len);
+            return;
+        }
+
+        mqtt_rx_slot_t *slot = NULL;
+        for (size_t i = 0; i < MQTT_RX_POOL_SIZE; i++) {
+            if (!s_rx_pool[i].busy) {
+                slot = &s_rx_pool[i];
+                break;
+            }
+        }
+        if (!slot) {
+            ESP_LOGW(TAG, "Brak wolnego bufora na wiadomość (%d B)", event->total_data_len);
+            return;
+        }
+
+        slot->busy = true;
+        slot->route = route;
+        slot->total_len = event->total_data_len;
+        slot->received = 0;
+        reply_to_from_event(event, &slot->reply_to);
+        s_rx_active = slot;
+    }
+
+    // Kolejny fragment: musi pasować do składanej wiadomości (inaczej została już porzucona)
+    mqtt_rx_slot_t *slot = s_rx_active;
+    if (!slot || event->current_data_offset != slot->received ||
+        event->data_len > slot->total_len - slot->received) {
+        return;
+    }
+
+    memcpy(slot->buf + slot->received, event->data, event->data_len);
+    slot->received += event->data_len;
+    if (slot->received == slot->total_len) {
+        slot->route->handler(slot->buf, slot->total_len, &slot->reply_to);
+        rx_slot_release(slot);
+    }
+}
+
 static void mqtt5_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data) {
     esp_mqtt_event_handle_t event = event_data;
-    
+    s_mqtt_task = xTaskGetCurrentTaskHandle();
+
     switch ((esp_mqtt_event_id_t)event_id) {
     case MQTT_EVENT_CONNECTED:
         ESP_LOGI(TAG, "MQTT Połączono");
+        s_alias_reset = true;
         is_connected = true;
         s_consecutive_buffered_count = 0; // Reset adaptive interval counter
         
@@ -203,82 +781,43 @@ static void mqtt5_event_handler(void *handler_args, esp_event_base_t base, int32
             }
         }
         
-        // 1. Subskrypcja komend (rozdzielone topici)
-        char topic[256];
-        snprintf(topic, sizeof(topic), "garden/%s/%s/command/water", s_user_id, s_device_id);
-        esp_mqtt_client_subscribe(client, topic, 1);
-        ESP_LOGI(TAG, "Subskrypcja: %s", topic);
-
-        snprintf(topic, sizeof(topic), "garden/%s/%s/command/read", s_user_id, s_device_id);
-        esp_mqtt_client_subscribe(client, topic, 1);
-        ESP_LOGI(TAG, "Subskrypcja: %s", topic);
-
-        // 2. Subskrypcja settings
-        snprintf(topic, sizeof(topic), "garden/%s/%s/settings", s_user_id, s_device_id);
-        esp_mqtt_client_subscribe(client, topic, 1);
-        ESP_LOGI(TAG, "Subskrypcja: %s", topic);
-
-        snprintf(topic, sizeof(topic), "garden/%s/%s/settings/get", s_user_id, s_device_id);
-        esp_mqtt_client_subscribe(client, topic, 1);
-        ESP_LOGI(TAG, "Subskrypcja: %s", topic);
-
-        snprintf(topic, sizeof(topic), "garden/%s/%s/settings/reset", s_user_id, s_device_id);
-        esp_mqtt_client_subscribe(client, topic, 1);
-        ESP_LOGI(TAG, "Subskrypcja: %s", topic);
-
-        // 3. Publikacja capabilities (retained)
-        mqtt_app_publish_capabilities();
-
-        // 3b. Flush preinit alerts -> alert_queue
-        if (alert_queue && s_preinit_alerts_count > 0) {
-            for (size_t i = 0; i < s_preinit_alerts_count; i++) {
-                (void)xQueueSend(alert_queue, &s_preinit_alerts[i], 0);
-            }
-            s_preinit_alerts_count = 0;
+        // 1. Subskrypcja komend i 2. settings (topici zarejestrowanych handlerów)
+        for (size_t i = 0; i < s_route_count; i++) {
+            char topic[MQTT_TOPIC_MAX + 32];
+            snprintf(topic, sizeof(topic), "%s%s", s_topic_prefix, s_routes[i].suffix);
+            esp_mqtt_client_subscribe(client, topic, 1);
+            ESP_LOGI(TAG, "Subskrypcja: %s", topic);
         }
 
-        // 3c. Opróżnianie bufora alertów
-        if (alert_queue != NULL) {
-            mqtt_alert_record_t buffered_alert;
-            UBaseType_t alerts_waiting = uxQueueMessagesWaiting(alert_queue);
-            if (alerts_waiting > 0) {
-                ESP_LOGI(TAG, "Wysyłanie %d zbuforowanych alertów...", alerts_waiting);
-                while (xQueueReceive(alert_queue, &buffered_alert, 0) == pdTRUE) {
-                    publish_alert_record(&buffered_alert);
-                    vTaskDelay(pdMS_TO_TICKS(20));
-                }
-            }
+        // 3. Publikacja capabilities (retained; wysyła backlog_drain_task)
+        mqtt_app_publish_capabilities();
+
+        // 3b. Zbuforowane alerty wysyła backlog_drain_task
+        if (alert_ring_count(&s_alert_ring) > 0) {
+            ESP_LOGI(TAG, "Zbuforowane alerty: %u (maks. zajęcie bufora %u/%u B)", alert_ring_count(&s_alert_ring),
+                     (unsigned)alert_ring_high_water(&s_alert_ring), (unsigned)sizeof(s_alert_ring_buf));
         }
 
         // Jeśli w trybie offline zabrakło miejsca na alerty, zgłoś to po odzyskaniu łączności.
-        if (s_alert_dropped > 0) {
+        uint32_t alerts_dropped = alert_ring_take_dropped(&s_alert_ring);
+        if (alerts_dropped > 0) {
             uint32_t suppressed = 0;
             if (alert_limiter_allow("alert.buffer_full_dropped", esp_log_timestamp(), 60 * 1000, &suppressed)) {
                 char msg[96];
-                snprintf(msg, sizeof(msg), "Dropped %lu alerts while offline", (unsigned long)s_alert_dropped);
+                snprintf(msg, sizeof(msg), "Dropped %lu alerts while offline", (unsigned long)alerts_dropped);
                 char details[160];
-                snprintf(details, sizeof(details), "{\"dropped\":%lu,\"queue_size\":%d,\"suppressed\":%lu}",
-                         (unsigned long)s_alert_dropped, ALERT_QUEUE_SIZE, (unsigned long)suppressed);
+                snprintf(details, sizeof(details), "{\"dropped\":%lu,\"buffer_bytes\":%u,\"high_water_bytes\":%u,\"suppressed\":%lu}",
+                         (unsigned long)alerts_dropped, (unsigned)sizeof(s_alert_ring_buf),
+                         (unsigned)alert_ring_high_water(&s_alert_ring), (unsigned long)suppressed);
                 mqtt_app_send_alert2_details("alert.buffer_full_dropped", "error", "mqtt", msg, details);
             }
-            s_alert_dropped = 0;
         }
 
         // Reset stanu offline telemetry po reconnect
         s_telemetry_buffering = false;
 
-        // 4. Opróżnianie bufora
-        if (telemetry_queue != NULL) {
-            telemetry_data_t buffered_data;
-            UBaseType_t items_waiting = uxQueueMessagesWaiting(telemetry_queue);
-            if (items_waiting > 0) {
-                ESP_LOGI(TAG, "Wysyłanie %d zbuforowanych rekordów...", items_waiting);
-                while (xQueueReceive(telemetry_queue, &buffered_data, 0) == pdTRUE) {
-                    mqtt_app_send_telemetry(&buffered_data);
-                    vTaskDelay(pdMS_TO_TICKS(50));
-                }
-            }
-        }
+        // 4. Opróżnianie buforów alertów i telemetrii w tle (backlog_drain_task)
+        drain_notify(DRAIN_EVT_CONNECTED);
         break;
 
     case MQTT_EVENT_DISCONNECTED:
@@ -295,30 +834,17 @@ static void mqtt5_event_handler(void *handler_args, esp_event_base_t base, int32
         }
         break;
     
+    case MQTT_EVENT_PUBLISHED:
+        drain_on_ack(event->msg_id, true);
+        break;
+
+    case MQTT_EVENT_DELETED:
+        ESP_LOGW(TAG, "Wiadomość %d wygasła w outboxie bez potwierdzenia", event->msg_id);
+        drain_on_ack(event->msg_id, false);
+        break;
+
     case MQTT_EVENT_DATA:
-        ESP_LOGI(TAG, "Odebrano dane na temat: %.*s", event->topic_len, event->topic);
-        if (data_callback) {
-            // Przekazujemy temat i dane do głównej aplikacji (z terminatorem null dla wygody)
-            char *topic_str = strndup(event->topic, event->topic_len);
-            char *payload_str = strndup(event->data, event->data_len);
-
-            if (topic_str && payload_str) {
-                data_callback(topic_str, payload_str, event->data_len);
-                free(topic_str);
-                free(payload_str);
-            } else {
-                free(topic_str);
-                free(payload_str);
-
-                uint32_t suppressed = 0;
-                if (alert_limiter_allow("mqtt.inbound_oom_drop", esp_log_timestamp(), 60 * 1000, &suppressed)) {
-                    char details[128];
-                    snprintf(details, sizeof(details), "{\"topic_len\":%d,\"payload_len\":%d,\"suppressed\":%lu}",
-                             event->topic_len, event->data_len, (unsigned long)suppressed);
-                    mqtt_app_send_alert2_details("mqtt.inbound_oom_drop", "error", "mqtt", "Dropped inbound MQTT message (OOM)", details);
-                }
-            }
-        }
+        handle_inbound_data(event);
         break;
 
     case MQTT_EVENT_ERROR:
@@ -339,9 +865,7 @@ static void mqtt5_event_handler(void *handler_args, esp_event_base_t base, int32
     }
 }
 
-void mqtt_app_start(mqtt_data_callback_t cb) {
-    data_callback = cb;
-
+void mqtt_app_start(void) {
     mqtt_load_runtime_config();
 
     if (!mqtt_has_required_config()) {
@@ -351,14 +875,17 @@ void mqtt_app_start(mqtt_data_callback_t cb) {
         return;
     }
     
-    telemetry_queue = xQueueCreate(QUEUE_SIZE, sizeof(telemetry_data_t));
-    if (telemetry_queue == NULL) {
-        ESP_LOGE(TAG, "Błąd tworzenia kolejki!");
+    s_ram_lock = xSemaphoreCreateMutex();
+    if (s_ram_lock == NULL) {
+        ESP_LOGE(TAG, "Błąd tworzenia bufora telemetrii!");
     }
+    (void)telemetry_log_init(); // bez partycji zostaje pierścień w RAM
 
-    alert_queue = xQueueCreate(ALERT_QUEUE_SIZE, sizeof(mqtt_alert_record_t));
-    if (alert_queue == NULL) {
-        ESP_LOGE(TAG, "Błąd tworzenia kolejki alertów!");
+    s_publish_lock = xSemaphoreCreateMutex();
+
+    s_ack_queue = xQueueCreate(DRAIN_ACK_QUEUE_SIZE, sizeof(drain_ack_t));
+    if (s_ack_queue == NULL || xTaskCreate(backlog_drain_task, "backlog_drain", 4096, NULL, 4, &s_drain_task) != pdPASS) {
+        ESP_LOGE(TAG, "Błąd tworzenia taska wysyłania backlogu!");
     }
 
     esp_mqtt_client_config_t mqtt5_cfg = {
@@ -386,28 +913,56 @@ static double round2(double v) {
     return round(v * 100.0) / 100.0;
 }
 
-static void add_number_or_null(cJSON *obj, const char *key, bool include, bool available, double v) {
+static void add_number_or_null(json_writer_t *w, const char *key, bool include, bool available, double v) {
     if (!include || !available || isnan(v)) {
-        cJSON_AddNullToObject(obj, key);
+        json_writer_null(w, key);
         return;
     }
-    cJSON_AddNumberToObject(obj, key, round2(v));
+    json_writer_number(w, key, round2(v));
 }
 
-static void add_int_or_null(cJSON *obj, const char *key, bool include, bool available, int v) {
+static void add_int_or_null(json_writer_t *w, const char *key, bool include, bool available, int v) {
     if (!include || !available || v < 0) {
-        cJSON_AddNullToObject(obj, key);
+        json_writer_null(w, key);
         return;
     }
-    cJSON_AddNumberToObject(obj, key, v);
+    json_writer_int64(w, key, v);
 }
 
-static void add_bool_or_null(cJSON *obj, const char *key, bool include, bool available, bool v) {
+static void add_bool_or_null(json_writer_t *w, const char *key, bool include, bool available, bool v) {
     if (!include || !available) {
-        cJSON_AddNullToObject(obj, key);
+        json_writer_null(w, key);
         return;
     }
-    cJSON_AddBoolToObject(obj, key, v);
+    json_writer_bool(w, key, v);
+}
+
+static void write_telemetry_sensors(json_writer_t *w, const telemetry_data_t *data, telemetry_fields_mask_t fields_mask) {
+    json_writer_begin_object(w, "sensors");
+    telemetry_fields_mask_t available = sensors_get_available_fields_mask();
+
+    bool inc_soil = (fields_mask & TELEMETRY_FIELD_SOIL) != 0;
+    bool inc_temp = (fields_mask & TELEMETRY_FIELD_TEMP) != 0;
+    bool inc_hum = (fields_mask & TELEMETRY_FIELD_HUM) != 0;
+    bool inc_press = (fields_mask & TELEMETRY_FIELD_PRESS) != 0;
+    bool inc_light = (fields_mask & TELEMETRY_FIELD_LIGHT) != 0;
+    bool inc_water = (fields_mask & TELEMETRY_FIELD_WATER) != 0;
+
+    bool av_soil = (available & TELEMETRY_FIELD_SOIL) != 0;
+    bool av_temp = (available & TELEMETRY_FIELD_TEMP) != 0;
+    bool av_hum = (available & TELEMETRY_FIELD_HUM) != 0;
+    bool av_press = (available & TELEMETRY_FIELD_PRESS) != 0;
+    bool av_light = (available & TELEMETRY_FIELD_LIGHT) != 0;
+    bool av_water = (available & TELEMETRY_FIELD_WATER) != 0;
+
+    add_int_or_null(w, "soil_moisture_pct", inc_soil, av_soil, data->soil_moisture);
+    add_number_or_null(w, "air_temperature_c", inc_temp, av_temp, data->temp);
+    add_number_or_null(w, "air_humidity_pct", inc_hum, av_hum, data->humidity);
+    add_number_or_null(w, "pressure_hpa", inc_press, av_press, data->pressure);
+    add_number_or_null(w, "light_lux", inc_light, av_light, data->light_lux);
+    add_bool_or_null(w, "water_tank_ok", inc_water, av_water, (data->water_ok == 0));
+
+    json_writer_end_object(w);
 }
 
 void mqtt_app_send_alert(const char* type, const char* message) {
@@ -420,21 +975,10 @@ void mqtt_app_send_alert2(const char* code, const char* severity, const char* su
 }
 
 void mqtt_app_send_alert2_details(const char* code, const char* severity, const char* subsystem, const char* message, const char* details_json) {
-    mqtt_alert_record_t rec;
-    memset(&rec, 0, sizeof(rec));
-
-    rec.timestamp_ms = get_time_ms();
-    strlcpy(rec.code, code ? code : "unknown", sizeof(rec.code));
-    strlcpy(rec.severity, severity ? severity : "warning", sizeof(rec.severity));
-    strlcpy(rec.subsystem, subsystem ? subsystem : "app", sizeof(rec.subsystem));
-    strlcpy(rec.message, message ? message : "", sizeof(rec.message));
-
-    if (details_json && details_json[0] != '\0') {
-        rec.has_details = true;
-        strlcpy(rec.details_json, details_json, sizeof(rec.details_json));
-    }
-
-    send_or_buffer_alert(&rec);
+    uint8_t buf[ALERT_RECORD_MAX_SIZE];
+    size_t len = alert_encode(buf, get_time_ms(), code ? code : "unknown", severity ? severity : "warning",
+                              subsystem ? subsystem : "app", message ? message : "", details_json);
+    send_or_buffer_alert(buf, len);
 }
 
 void mqtt_app_send_telemetry(telemetry_data_t *data) {
@@ -449,118 +993,394 @@ void mqtt_app_send_telemetry_masked(telemetry_data_t *data, telemetry_fields_mas
             uint32_t suppressed = 0;
             if (alert_limiter_allow("telemetry.buffering_started", esp_log_timestamp(), 5 * 60 * 1000, &suppressed)) {
                 char details[128];
-                snprintf(details, sizeof(details), "{\"queue_size\":%d,\"suppressed\":%lu}", QUEUE_SIZE, (unsigned long)suppressed);
+                snprintf(details, sizeof(details), "{\"queue_size\":%lu,\"suppressed\":%lu}",
+                         (unsigned long)backlog_capacity(), (unsigned long)suppressed);
                 mqtt_app_send_alert2_details("telemetry.buffering_started", "warning", "telemetry", "MQTT offline. Buffering telemetry.", details);
             }
         }
 
-        if (telemetry_queue) {
-            if (xQueueSend(telemetry_queue, data, 0) == pdTRUE) {
-                s_consecutive_buffered_count++; // Increment count
-                ESP_LOGW(TAG, "Offline. Zbuforowano dane (ts: %lu) [Count: %d]", data->timestamp, s_consecutive_buffered_count);
-            } else {
-                ESP_LOGE(TAG, "Offline. Bufor pełny!");
-                s_telemetry_dropped++;
-
-                uint32_t suppressed = 0;
-                if (alert_limiter_allow("telemetry.buffer_full_dropped", esp_log_timestamp(), 60 * 1000, &suppressed)) {
-                    char details[160];
-                    snprintf(details, sizeof(details), "{\"dropped\":%lu,\"queue_size\":%d,\"suppressed\":%lu}",
-                             (unsigned long)s_telemetry_dropped, QUEUE_SIZE, (unsigned long)suppressed);
-                    mqtt_app_send_alert2_details("telemetry.buffer_full_dropped", "error", "telemetry", "Telemetry dropped: offline queue full", details);
-                    s_telemetry_dropped = 0;
-                }
+        if (backlog_push(data)) {
+            s_consecutive_buffered_count++; // Increment count
+            ESP_LOGW(TAG, "Offline. Zbuforowano dane (ts: %lu) [Count: %d]", data->timestamp, s_consecutive_buffered_count);
+            uint32_t overwritten = telemetry_log_take_dropped();
+            if (overwritten > 0) {
+                ESP_LOGE(TAG, "Offline. Bufor pełny - nadpisano %lu najstarszych rekordów", (unsigned long)overwritten);
+                s_telemetry_dropped += overwritten;
+                report_telemetry_dropped();
             }
+        } else {
+            ESP_LOGE(TAG, "Offline. Bufor pełny!");
+            s_telemetry_dropped++;
+            report_telemetry_dropped();
         }
         return;
     }
 
-    // Jeśli jest połączenie, wysyłamy
-    char topic[256];
-    snprintf(topic, sizeof(topic), "garden/%s/%s/telemetry", s_user_id, s_device_id);
+    // Jeśli jest połączenie, wysyłamy (próbka złapana jeszcze offline - kompensacja teraz)
+    if (data->bme_raw_pending) sensors_resolve_raw(data, 1);
+    if (s_telemetry_encoding == TELEMETRY_ENCODING_BINARY) {
+        uint8_t frame[TELEMETRY_CODEC_HEADER_SIZE + TELEMETRY_CODEC_RECORD_MAX_SIZE];
+        size_t frame_len = telemetry_codec_begin(frame, sizeof(frame));
+        frame_len = telemetry_codec_append(frame, sizeof(frame), frame_len, data,
+                                           fields_mask & sensors_get_available_fields_mask());
+        publish_typed(TOPIC_TELEMETRY_BIN, (const char *)frame, (int)frame_len, 1, 0, TELEMETRY_CODEC_CONTENT_TYPE);
+        s_consecutive_buffered_count = 0; // Reset count
+        return;
+    }
 
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "device", s_device_id);
-    cJSON_AddStringToObject(root, "user", s_user_id);
-    cJSON_AddNumberToObject(root, "timestamp", data->timestamp);
+    char json_buf[TELEMETRY_JSON_BUF_SIZE];
+    json_writer_t w;
+    json_writer_init(&w, json_buf, sizeof(json_buf));
 
-    cJSON *sensors = cJSON_CreateObject();
-    telemetry_fields_mask_t available = sensors_get_available_fields_mask();
+    json_writer_begin_object(&w, NULL);
+    json_writer_string(&w, "device", s_device_id);
+    json_writer_string(&w, "user", s_user_id);
+    json_writer_int64(&w, "timestamp", data->timestamp);
 
-    bool inc_soil = (fields_mask & TELEMETRY_FIELD_SOIL) != 0;
-    bool inc_temp = (fields_mask & TELEMETRY_FIELD_TEMP) != 0;
-    bool inc_hum = (fields_mask & TELEMETRY_FIELD_HUM) != 0;
-    bool inc_press = (fields_mask & TELEMETRY_FIELD_PRESS) != 0;
-    bool inc_light = (fields_mask & TELEMETRY_FIELD_LIGHT) != 0;
-    bool inc_water = (fields_mask & TELEMETRY_FIELD_WATER) != 0;
+    write_telemetry_sensors(&w, data, fields_mask);
+    json_writer_end_object(&w);
 
-    bool av_soil = (available & TELEMETRY_FIELD_SOIL) != 0;
-    bool av_temp = (available & TELEMETRY_FIELD_TEMP) != 0;
-    bool av_hum = (available & TELEMETRY_FIELD_HUM) != 0;
-    bool av_press = (available & TELEMETRY_FIELD_PRESS) != 0;
-    bool av_light = (available & TELEMETRY_FIELD_LIGHT) != 0;
-    bool av_water = (available & TELEMETRY_FIELD_WATER) != 0;
+    size_t json_len = 0;
+    const char *json_str = json_writer_finish(&w, &json_len);
+    if (!json_str) {
+        ESP_LOGE(TAG, "Telemetry JSON too large");
+        return;
+    }
+    publish_typed(TOPIC_TELEMETRY, json_str, (int)json_len, 1, 0, JSON_CONTENT_TYPE);
+    s_consecutive_buffered_count = 0; // Reset count
+}
+
+static void drain_notify(uint32_t events) {
+    if (s_drain_task) xTaskNotify(s_drain_task, events, eSetBits);
+}
 
-    add_int_or_null(sensors, "soil_moisture_pct", inc_soil, av_soil, data->soil_moisture);
-    add_number_or_null(sensors, "air_temperature_c", inc_temp, av_temp, data->temp);
-    add_number_or_null(sensors, "air_humidity_pct", inc_hum, av_hum, data->humidity);
-    add_number_or_null(sensors, "pressure_hpa", inc_press, av_press, data->pressure);
-    add_number_or_null(sensors, "light_lux", inc_light, av_light, data->light_lux);
-    add_bool_or_null(sensors, "water_tank_ok", inc_water, av_water, (data->water_ok == 0));
+// Wołane z handlera zdarzeń MQTT dla każdego PUBLISHED/DELETED (także spoza backlogu - te są ignorowane)
+static void drain_on_ack(int msg_id, bool ok) {
+    if (!s_ack_queue || msg_id <= 0) return;
+    drain_ack_t ack = {.msg_id = msg_id, .ok = ok};
+    if (xQueueSend(s_ack_queue, &ack, 0) != pdTRUE) {
+        // Zgubione potwierdzenie kończy się ponownym wysłaniem po DRAIN_ACK_TIMEOUT_MS
+        ESP_LOGW(TAG, "Kolejka potwierdzeń pełna (msg_id=%d)", msg_id);
+    }
+    drain_notify(DRAIN_EVT_ACK);
+}
 
-    cJSON_AddItemToObject(root, "sensors", sensors);
+static drain_unit_t *drain_unit(size_t i) {
+    return &s_inflight[(s_inflight_head + i) % CONFIG_TELEMETRY_DRAIN_WINDOW];
+}
 
-    char *json_str = cJSON_PrintUnformatted(root);
-    esp_mqtt_client_publish(client, topic, json_str, 0, 1, 0);
-    s_consecutive_buffered_count = 0; // Reset count
+static void drain_track(int msg_id, uint32_t end, bool alert) {
+    drain_unit_t *u = drain_unit(s_inflight_count++);
+    u->msg_id = msg_id;
+    u->end = end;
+    u->alert = alert;
+    u->acked = (msg_id == 0); // nic nie zostało wysłane - zwalniamy od razu
+    u->sent_at = xTaskGetTickCount();
+    s_drain_sent++;
+}
+
+// Porzuca śledzenie wiadomości w locie i wysyła ponownie od najstarszego niepotwierdzonego rekordu.
+static void drain_rewind(void) {
+    ESP_LOGW(TAG, "Brak potwierdzenia %u wiadomości - ponowne wysyłanie backlogu", (unsigned)s_inflight_count);
+    s_inflight_count = 0;
+    s_alert_inflight = false;
+    s_drain_next = backlog_first();
+}
+
+static void drain_process_acks(void) {
+    bool failed = false;
+    drain_ack_t ack;
+    while (xQueueReceive(s_ack_queue, &ack, 0) == pdTRUE) {
+        for (size_t i = 0; i < s_inflight_count; i++) {
+            drain_unit_t *u = drain_unit(i);
+            if (u->msg_id != ack.msg_id || u->acked) continue;
+            if (ack.ok) {
+                u->acked = true;
+            } else {
+                failed = true;
+            }
+            break;
+        }
+    }
+
+    // Zwalniamy tylko potwierdzony początek okna, żeby w buforze nie powstały dziury
+    while (s_inflight_count > 0 && drain_unit(0)->acked) {
+        drain_unit_t *u = drain_unit(0);
+        if (u->alert) {
+            (void)alert_ring_pop(&s_alert_ring, (uint16_t)u->end);
+            s_alert_inflight = false;
+        } else {
+            backlog_release(u->end);
+        }
+        s_inflight_head = (s_inflight_head + 1) % CONFIG_TELEMETRY_DRAIN_WINDOW;
+        s_inflight_count--;
+    }
+
+    if (!failed && s_inflight_count > 0 && is_connected &&
+        (xTaskGetTickCount() - drain_unit(0)->sent_at) > pdMS_TO_TICKS(DRAIN_ACK_TIMEOUT_MS)) {
+        failed = true;
+    }
+    if (failed) drain_rewind();
+}
 
-    cJSON_Delete(root);
-    free(json_str);
+// Blok telemetry_tsz z flasha, wysyłany bez dekodowania na garden/{user}/{device}/telemetry/tsz.
+static int publish_backlog_tsz(uint32_t pos, uint32_t *end) {
+    uint8_t *frame = (uint8_t *)s_batch_buf;
+    uint16_t count = 0, skip = 0;
+    size_t len = telemetry_log_read_block(pos, frame + TELEMETRY_TSZ_FRAME_HEADER_SIZE,
+                                          sizeof(s_batch_buf) - TELEMETRY_TSZ_FRAME_HEADER_SIZE, &count, &skip);
+    if (len == 0) return 0;
+
+    frame[0] = TELEMETRY_TSZ_VERSION;
+    frame[1] = (uint8_t)skip;
+    frame[2] = (uint8_t)count;
+    frame[3] = (uint8_t)(count >> 8);
+    frame[4] = (uint8_t)sensors_get_available_fields_mask();
+    int msg_id = publish_typed(TOPIC_TELEMETRY_TSZ, (const char *)frame, (int)(len + TELEMETRY_TSZ_FRAME_HEADER_SIZE), 1,
+                               0, TELEMETRY_TSZ_CONTENT_TYPE);
+    if (msg_id < 0) {
+        ESP_LOGE(TAG, "Publikacja bloku telemetrii nie powiodła się (%u rekordów)", count - skip);
+        return msg_id;
+    }
+    *end = pos + count - skip;
+    return msg_id;
+}
+
+// Wariant binarny: wiele rekordów w jednej ramce telemetry_codec na garden/{user}/{device}/telemetry/bin.
+static int publish_backlog_binary(uint32_t pos, uint32_t *end) {
+    if (telemetry_log_is_ready()) return publish_backlog_tsz(pos, end);
+
+    uint8_t *frame = (uint8_t *)s_batch_buf;
+    size_t frame_len = telemetry_codec_begin(frame, sizeof(s_batch_buf));
+    uint32_t p = pos;
+    telemetry_data_t rec;
+    while (p - pos < CONFIG_TELEMETRY_BATCH_MAX_RECORDS && backlog_read(p, &rec)) {
+        size_t next = telemetry_codec_append(frame, sizeof(s_batch_buf), frame_len, &rec, TELEMETRY_FIELDS_ALL);
+        if (next == 0) break;
+        frame_len = next;
+        p++;
+    }
+    if (p == pos) return 0;
+
+    int msg_id = publish_typed(TOPIC_TELEMETRY_BIN, (const char *)frame, (int)frame_len, 1, 0, TELEMETRY_CODEC_CONTENT_TYPE);
+    if (msg_id < 0) {
+        ESP_LOGE(TAG, "Publikacja paczki telemetrii nie powiodła się (%lu rekordów)", (unsigned long)(p - pos));
+        return msg_id;
+    }
+    *end = p;
+    return msg_id;
+}
+
+// Paczka JSON na garden/{user}/{device}/telemetry/batch.
+// Jedna paczka to maks. CONFIG_TELEMETRY_BATCH_MAX_RECORDS rekordów i CONFIG_TELEMETRY_BATCH_MAX_BYTES bajtów.
+static int publish_backlog_json(uint32_t pos, uint32_t *end) {
+    json_writer_t w;
+    json_writer_init(&w, s_batch_buf, sizeof(s_batch_buf));
+
+    json_writer_begin_object(&w, NULL);
+    json_writer_string(&w, "device", s_device_id);
+    json_writer_string(&w, "user", s_user_id);
+    json_writer_begin_array(&w, "records");
+
+    uint32_t p = pos;
+    telemetry_data_t rec;
+    while (p - pos < CONFIG_TELEMETRY_BATCH_MAX_RECORDS && backlog_read(p, &rec)) {
+        // Rekord dopisujemy "na próbę" - jeśli się nie zmieści, wracamy do stanu sprzed niego.
+        json_writer_t checkpoint = w;
+        json_writer_begin_object(&w, NULL);
+        json_writer_int64(&w, "timestamp", rec.timestamp);
+        write_telemetry_sensors(&w, &rec, TELEMETRY_FIELDS_ALL);
+        json_writer_end_object(&w);
+        if (w.overflow || w.len + TELEMETRY_BATCH_TAIL_RESERVE >= w.cap) {
+            w = checkpoint;
+            break;
+        }
+        p++;
+    }
+
+    if (p == pos) {
+        if (backlog_read(pos, &rec)) {
+            // Pojedynczy rekord większy niż paczka - nie blokujemy bufora.
+            ESP_LOGE(TAG, "Rekord telemetrii nie mieści się w paczce (max %d B) - pominięto", CONFIG_TELEMETRY_BATCH_MAX_BYTES);
+            *end = pos + 1;
+        }
+        return 0;
+    }
+
+    json_writer_end_array(&w);
+    json_writer_int64(&w, "count", (int64_t)(p - pos));
+    json_writer_end_object(&w);
+
+    size_t json_len = 0;
+    const char *json_str = json_writer_finish(&w, &json_len);
+    if (!json_str) {
+        ESP_LOGE(TAG, "Telemetry batch JSON too large");
+        *end = p;
+        return 0;
+    }
+    int msg_id = publish_typed(TOPIC_TELEMETRY_BATCH, json_str, (int)json_len, 1, 0, JSON_CONTENT_TYPE);
+    if (msg_id < 0) {
+        ESP_LOGE(TAG, "Publikacja paczki telemetrii nie powiodła się (%lu rekordów)", (unsigned long)(p - pos));
+        return msg_id;
+    }
+    *end = p;
+    return msg_id;
+}
+
+// Dokłada wiadomości do okna, dopóki jest połączenie, miejsce w oknie i w outboxie.
+static void drain_fill(void) {
+    while (is_connected && s_inflight_count < CONFIG_TELEMETRY_DRAIN_WINDOW) {
+        if (esp_mqtt_client_get_outbox_size(client) > CONFIG_TELEMETRY_DRAIN_OUTBOX_MAX_BYTES) break;
+
+        // Najpierw alerty (po jednym w locie - zdejmowane z kolejki po potwierdzeniu)
+        uint16_t alert_id = 0;
+        size_t alert_len = s_alert_inflight ? 0 : alert_ring_peek(&s_alert_ring, s_drain_alert, sizeof(s_drain_alert), &alert_id);
+        if (alert_len > 0) {
+            mqtt_alert_record_t rec;
+            alert_decode(s_drain_alert, alert_len, &rec);
+            int msg_id = publish_alert_record(&rec);
+            if (msg_id < 0) break;
+            drain_track(msg_id, alert_id, true);
+            s_alert_inflight = true;
+            continue;
+        }
+
+        uint32_t first = backlog_first();
+        if (s_drain_next < first) s_drain_next = first; // rekordy nadpisane w międzyczasie
+        uint32_t end = s_drain_next;
+        int msg_id = (s_telemetry_encoding == TELEMETRY_ENCODING_BINARY) ? publish_backlog_binary(s_drain_next, &end)
+                                                                          : publish_backlog_json(s_drain_next, &end);
+        if (end == s_drain_next) break; // brak danych lub błąd publikacji
+        drain_track(msg_id, end, false);
+        s_drain_next = end;
+    }
+}
+
+static void backlog_drain_task(void *arg) {
+    (void)arg;
+    for (;;) {
+        uint32_t events = 0;
+        xTaskNotifyWait(0, UINT32_MAX, &events, pdMS_TO_TICKS(DRAIN_IDLE_POLL_MS));
+
+        if (events & DRAIN_EVT_CONNECTED) {
+            // Czas na potwierdzenie liczymy od nowa - outbox ponawia wysyłkę po połączeniu
+            TickType_t now = xTaskGetTickCount();
+            for (size_t i = 0; i < s_inflight_count; i++) drain_unit(i)->sent_at = now;
+            uint32_t waiting = backlog_count();
+            if (waiting > 0) ESP_LOGI(TAG, "Wysyłanie %lu zbuforowanych rekordów (paczki)...", (unsigned long)waiting);
+        }
+
+        if ((events & DRAIN_EVT_CAPABILITIES) && is_connected) mqtt_app_publish_capabilities();
+        deferred_flush();
+        drain_process_acks();
+        drain_fill();
+
+        if (s_drain_sent > 0 && s_inflight_count == 0) {
+            ESP_LOGI(TAG, "Wysłano zbuforowane dane w %lu wiadomościach", (unsigned long)s_drain_sent);
+            s_drain_sent = 0;
+        }
+    }
 }
 
 void mqtt_app_publish_capabilities(void) {
     if (!client) return;
     if (s_user_id[0] == '\0' || s_device_id[0] == '\0') return;
-
-    char topic[256];
-    snprintf(topic, sizeof(topic), "garden/%s/%s/capabilities", s_user_id, s_device_id);
+    if (in_mqtt_task()) {
+        drain_notify(DRAIN_EVT_CAPABILITIES);
+        return;
+    }
 
     telemetry_fields_mask_t available = sensors_get_available_fields_mask();
 
-    cJSON *root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "device", s_device_id);
-    cJSON_AddStringToObject(root, "user", s_user_id);
-    cJSON_AddNumberToObject(root, "timestamp", get_time_ms());
-
-    cJSON *fields = cJSON_CreateArray();
-    if (available & TELEMETRY_FIELD_SOIL) cJSON_AddItemToArray(fields, cJSON_CreateString("soil_moisture_pct"));
-    if (available & TELEMETRY_FIELD_TEMP) cJSON_AddItemToArray(fields, cJSON_CreateString("air_temperature_c"));
-    if (available & TELEMETRY_FIELD_HUM) cJSON_AddItemToArray(fields, cJSON_CreateString("air_humidity_pct"));
-    if (available & TELEMETRY_FIELD_PRESS) cJSON_AddItemToArray(fields, cJSON_CreateString("pressure_hpa"));
-    if (available & TELEMETRY_FIELD_LIGHT) cJSON_AddItemToArray(fields, cJSON_CreateString("light_lux"));
-    if (available & TELEMETRY_FIELD_WATER) cJSON_AddItemToArray(fields, cJSON_CreateString("water_tank_ok"));
-    cJSON_AddItemToObject(root, "fields", fields);
-
-    cJSON *measured = cJSON_CreateObject();
-    cJSON_AddBoolToObject(measured, "soil_moisture_pct", (available & TELEMETRY_FIELD_SOIL) != 0);
-    cJSON_AddBoolToObject(measured, "air_temperature_c", (available & TELEMETRY_FIELD_TEMP) != 0);
-    cJSON_AddBoolToObject(measured, "air_humidity_pct", (available & TELEMETRY_FIELD_HUM) != 0);
-    cJSON_AddBoolToObject(measured, "pressure_hpa", (available & TELEMETRY_FIELD_PRESS) != 0);
-    cJSON_AddBoolToObject(measured, "light_lux", (available & TELEMETRY_FIELD_LIGHT) != 0);
-    cJSON_AddBoolToObject(measured, "water_tank_ok", (available & TELEMETRY_FIELD_WATER) != 0);
-    cJSON_AddItemToObject(root, "measured", measured);
-
-    char *json_str = cJSON_PrintUnformatted(root);
+    char json_buf[CAPABILITIES_JSON_BUF_SIZE];
+    json_writer_t w;
+    json_writer_init(&w, json_buf, sizeof(json_buf));
+
+    json_writer_begin_object(&w, NULL);
+    json_writer_string(&w, "device", s_device_id);
+    json_writer_string(&w, "user", s_user_id);
+    json_writer_int64(&w, "timestamp", get_time_ms());
+
+    json_writer_begin_array(&w, "fields");
+    if (available & TELEMETRY_FIELD_SOIL) json_writer_string(&w, NULL, "soil_moisture_pct");
+    if (available & TELEMETRY_FIELD_TEMP) json_writer_string(&w, NULL, "air_temperature_c");
+    if (available & TELEMETRY_FIELD_HUM) json_writer_string(&w, NULL, "air_humidity_pct");
+    if (available & TELEMETRY_FIELD_PRESS) json_writer_string(&w, NULL, "pressure_hpa");
+    if (available & TELEMETRY_FIELD_LIGHT) json_writer_string(&w, NULL, "light_lux");
+    if (available & TELEMETRY_FIELD_WATER) json_writer_string(&w, NULL, "water_tank_ok");
+    json_writer_end_array(&w);
+
+    json_writer_begin_object(&w, "measured");
+    json_writer_bool(&w, "soil_moisture_pct", (available & TELEMETRY_FIELD_SOIL) != 0);
+    json_writer_bool(&w, "air_temperature_c", (available & TELEMETRY_FIELD_TEMP) != 0);
+    json_writer_bool(&w, "air_humidity_pct", (available & TELEMETRY_FIELD_HUM) != 0);
+    json_writer_bool(&w, "pressure_hpa", (available & TELEMETRY_FIELD_PRESS) != 0);
+    json_writer_bool(&w, "light_lux", (available & TELEMETRY_FIELD_LIGHT) != 0);
+    json_writer_bool(&w, "water_tank_ok", (available & TELEMETRY_FIELD_WATER) != 0);
+    json_writer_end_object(&w);
+
+    // Obsługiwane kodowania telemetrii i aktualnie używane (backend dobiera dekoder po topicu)
+    json_writer_begin_array(&w, "encodings");
+    json_writer_string(&w, NULL, "json");
+    json_writer_string(&w, NULL, "binary");
+    json_writer_string(&w, NULL, "tsz");
+    json_writer_end_array(&w);
+    json_writer_string(&w, "telemetry_encoding", s_telemetry_encoding == TELEMETRY_ENCODING_BINARY ? "binary" : "json");
+    json_writer_string(&w, "telemetry_content_type",
+                       s_telemetry_encoding == TELEMETRY_ENCODING_BINARY ? TELEMETRY_CODEC_CONTENT_TYPE : JSON_CONTENT_TYPE);
+
+    mqtt_app_stats_t stats;
+    mqtt_app_get_stats(&stats);
+    json_writer_begin_object(&w, "mqtt_stats");
+    json_writer_int64(&w, "messages", stats.messages);
+    json_writer_int64(&w, "payload_bytes", stats.payload_bytes);
+    json_writer_int64(&w, "topic_bytes", stats.topic_bytes);
+    json_writer_int64(&w, "alias_saved_bytes", stats.alias_saved_bytes);
+    json_writer_end_object(&w);
+    json_writer_end_object(&w);
+
+    size_t json_len = 0;
+    const char *json_str = json_writer_finish(&w, &json_len);
+    if (!json_str) {
+        ESP_LOGE(TAG, "Capabilities JSON too large");
+        return;
+    }
     // retained=1 aby backend mógł odczytać stan po subskrypcji
-    esp_mqtt_client_publish(client, topic, json_str, 0, 1, 1);
-
-    cJSON_Delete(root);
-    free(json_str);
+    publish_typed(TOPIC_CAPABILITIES, json_str, (int)json_len, 1, 1, JSON_CONTENT_TYPE);
 }
 
 void mqtt_app_publish_to_subpath(const char* subpath, const char* data, int qos) {
     if (!client || !is_connected) return;
-    char topic[256];
-    snprintf(topic, sizeof(topic), "garden/%s/%s/%s", s_user_id, s_device_id, subpath);
-    esp_mqtt_client_publish(client, topic, data, 0, qos, 0);
+    for (int i = 0; i < TOPIC_COUNT; i++) {
+        if (strcmp(subpath, k_topic_suffix[i]) == 0) {
+            if (in_mqtt_task()) {
+                defer_publish((mqtt_topic_id_t)i, NULL, data, (int)strlen(data), qos, NULL);
+            } else {
+                publish_typed((mqtt_topic_id_t)i, data, (int)strlen(data), qos, 0, JSON_CONTENT_TYPE);
+            }
+            return;
+        }
+    }
+
+    char topic[MQTT_TOPIC_MAX + 32];
+    snprintf(topic, sizeof(topic), "%s%s", s_topic_prefix, subpath);
+    if (in_mqtt_task()) {
+        defer_publish(TOPIC_COUNT, topic, data, (int)strlen(data), qos, NULL);
+    } else {
+        publish_plain(topic, data, (int)strlen(data), qos, NULL);
+    }
+}
+
+void mqtt_app_send_response(const mqtt_reply_to_t *reply_to, const char *json, int len) {
+    if (!client || !is_connected || !reply_to) return;
+
+    const char *topic = reply_to->response_topic[0] ? reply_to->response_topic : s_topics[TOPIC_COMMAND_RESPONSE];
+    if (in_mqtt_task()) {
+        defer_publish(TOPIC_COUNT, topic, json, len, 1, reply_to);
+        return;
+    }
+    int msg_id = publish_plain(topic, json, len, 1, reply_to);
+    if (msg_id < 0) {
+        ESP_LOGW(TAG, "Nie udało się wysłać odpowiedzi na %s", topic);
+    }
 }
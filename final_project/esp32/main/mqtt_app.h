@@ -2,13 +2,47 @@
 #define MQTT_APP_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
 #include "common_defs.h"
 
-// Typ funkcji zwrotnej do obsługi przychodzących wiadomości (komendy, progi)
-typedef void (*mqtt_data_callback_t)(const char *topic, const char *payload, int len);
+// Kodowanie telemetrii (wybierane per urządzenie w ustawieniach)
+typedef enum {
+    TELEMETRY_ENCODING_JSON = 0,
+    TELEMETRY_ENCODING_BINARY = 1, // ramka z telemetry_codec.h na topic /telemetry/bin
+} telemetry_encoding_t;
 
-// Start modułu MQTT
-void mqtt_app_start(mqtt_data_callback_t cb);
+// Liczniki publikacji od startu (wysyłane też w capabilities jako "mqtt_stats")
+typedef struct {
+    uint32_t messages;
+    uint32_t payload_bytes;
+    uint32_t topic_bytes;       // bajty nazw topiców faktycznie wysłane
+    uint32_t alias_saved_bytes; // bajty nazw topiców zastąpione aliasem MQTT5
+} mqtt_app_stats_t;
+
+#define MQTT_RESPONSE_TOPIC_MAX 128
+#define MQTT_CORRELATION_MAX 64
+
+// Adres odpowiedzi z żądania MQTT5 (Response Topic / Correlation Data).
+// Pusty `response_topic` = nadawca go nie podał (np. klient MQTT 3.1.1) - odpowiedź idzie na /command/response.
+typedef struct {
+    char response_topic[MQTT_RESPONSE_TOPIC_MAX];
+    uint8_t correlation[MQTT_CORRELATION_MAX];
+    uint16_t correlation_len;
+} mqtt_reply_to_t;
+
+// Obsługa przychodzącej wiadomości na zarejestrowany topic (komendy, progi).
+// `payload` NIE jest zakończony '\0' i jest ważny tylko na czas wywołania (bufor klienta MQTT),
+// tak samo `reply_to` (handler kopiuje go, jeśli odpowiada później).
+typedef void (*mqtt_command_handler_t)(const char *payload, int len, const mqtt_reply_to_t *reply_to);
+
+// Rejestruje obsługę topicu garden/{user}/{device}/<suffix> (dopasowanie dokładne).
+// Wywoływać przed mqtt_app_start(); `suffix` musi być stałą (nie jest kopiowany).
+// ESP_ERR_NO_MEM gdy tablica tras jest pełna.
+esp_err_t mqtt_app_register_handler(const char *suffix, mqtt_command_handler_t handler);
+
+// Start modułu MQTT (subskrybuje topici zarejestrowanych handlerów przy każdym połączeniu)
+void mqtt_app_start(void);
 
 // Wysyłanie telemetrii (obsługuje buforowanie offline)
 void mqtt_app_send_telemetry(telemetry_data_t *data);
@@ -17,6 +51,12 @@ void mqtt_app_send_telemetry(telemetry_data_t *data);
 // Wysyłanie telemetrii z maską pól (pozostałe pola będą ustawione na null)
 void mqtt_app_send_telemetry_masked(telemetry_data_t *data, telemetry_fields_mask_t fields_mask);
 
+// Ustawia kodowanie telemetrii; przy zmianie ponownie publikuje capabilities
+void mqtt_app_set_telemetry_encoding(telemetry_encoding_t encoding);
+telemetry_encoding_t mqtt_app_get_telemetry_encoding(void);
+
+void mqtt_app_get_stats(mqtt_app_stats_t *out);
+
 // Zwraca ilosc zbuforowanych pakietow z rzedu
 int mqtt_app_get_consecutive_buffered_count(void);
 
@@ -38,6 +78,10 @@ void mqtt_app_send_alert2(const char* code, const char* severity, const char* su
 // `details_json` powinien być JSON-em typu object (np. {"reason":201,"suppressed":3}), albo NULL.
 void mqtt_app_send_alert2_details(const char* code, const char* severity, const char* subsystem, const char* message, const char* details_json);
 
+// Publikuje odpowiedź JSON (QoS 1) na response topic żądania z jego correlation data,
+// a gdy żądanie go nie miało - na garden/{user}/{device}/command/response.
+void mqtt_app_send_response(const mqtt_reply_to_t *reply_to, const char *json, int len);
+
 // Publikuje wiadomość na podścieżkę (np. "settings/state") względem garden/{user}/{device}/...
 void mqtt_app_publish_to_subpath(const char* subpath, const char* data, int qos);
 
@@ -0,0 +1,348 @@
+#include "pump_ctrl.h"
+
+#include <string.h>
+#include "driver/gpio.h"
+#include "driver/ledc.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include "water_monitor.h"
+
+static const char *TAG = "PUMP_CTRL";
+
+#define PUMP_ZONE_COUNT     CONFIG_PUMP_ZONE_COUNT
+#define PUMP_MAX_ACTIVE     CONFIG_PUMP_MAX_ACTIVE
+#define PUMP_SOFT_START_MS  CONFIG_PUMP_SOFT_START_MS
+#define PUMP_PWM_MODE       LEDC_LOW_SPEED_MODE
+#define PUMP_PWM_TIMER      LEDC_TIMER_1
+#define PUMP_PWM_FREQ_HZ    20000 // poza pasmem słyszalnym (silnik nie piszczy)
+#define PUMP_PWM_BITS       LEDC_TIMER_10_BIT
+#define PUMP_PWM_DUTY_ON    (1u << 10) // 100% (LEDC przyjmuje 2^bits jako pełne wypełnienie)
+#define PUMP_EVT_QUEUE_LEN  16
+#define PUMP_EVT_STACK      4096
+#define PUMP_EVT_PRIO       4
+
+_Static_assert(PUMP_ZONE_COUNT <= PUMP_ZONES_MAX, "CONFIG_PUMP_ZONE_COUNT > PUMP_ZONES_MAX");
+
+static const gpio_num_t k_zone_gpio[PUMP_ZONE_COUNT] = {
+    CONFIG_PUMP_ZONE0_GPIO,
+#if PUMP_ZONE_COUNT >= 2
+    CONFIG_PUMP_ZONE1_GPIO,
+#endif
+#if PUMP_ZONE_COUNT >= 3
+    CONFIG_PUMP_ZONE2_GPIO,
+#endif
+#if PUMP_ZONE_COUNT >= 4
+    CONFIG_PUMP_ZONE3_GPIO,
+#endif
+};
+
+typedef struct {
+    uint32_t id;
+    uint32_t duration_ms;
+    pump_prio_t prio;
+    int64_t queued_us; // kolejność między strefami czekającymi na wolne miejsce
+} pump_job_t;
+
+typedef struct {
+    esp_timer_handle_t timer;
+    bool running;
+    pump_job_t cur;
+    int64_t started_us;
+    pump_job_t queue[PUMP_QUEUE_DEPTH]; // priorytet malejąco, w obrębie priorytetu FIFO
+    uint8_t queued;
+} pump_zone_t;
+
+static pump_zone_t s_zones[PUMP_ZONE_COUNT];
+static int s_active = 0;
+static uint32_t s_next_id = 0;
+static SemaphoreHandle_t s_lock = NULL;
+static QueueHandle_t s_evt_queue = NULL;
+static pump_event_cb_t s_cb = NULL;
+static uint32_t s_evt_lost = 0;
+
+static void lock(void) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+}
+
+static void unlock(void) {
+    xSemaphoreGive(s_lock);
+}
+
+static int zone_index(const pump_zone_t *z) {
+    return (int)(z - s_zones);
+}
+
+// Bez blokowania - pod s_lock wołają też esp_timer i water_mon
+static void emit_locked(pump_event_type_t type, const pump_zone_t *z, const pump_job_t *job, uint32_t ran_ms) {
+    pump_event_t evt = {
+        .type = type,
+        .zone = (uint8_t)zone_index(z),
+        .queued = z->queued,
+        .active = (uint8_t)s_active,
+        .prio = job->prio,
+        .job_id = job->id,
+        .duration_ms = job->duration_ms,
+        .ran_ms = ran_ms,
+    };
+    if (!s_evt_queue || xQueueSend(s_evt_queue, &evt, 0) != pdTRUE) s_evt_lost++;
+}
+
+static void output_on(int zone) {
+    ledc_channel_t ch = (ledc_channel_t)zone;
+    if (PUMP_SOFT_START_MS > 0) {
+        // ledc_stop() zostawia w rejestrze wypełnienie 100% - bez zera fade startowałby od pełnej mocy
+        ledc_set_duty(PUMP_PWM_MODE, ch, 0);
+        ledc_update_duty(PUMP_PWM_MODE, ch);
+        ledc_set_fade_time_and_start(PUMP_PWM_MODE, ch, PUMP_PWM_DUTY_ON, PUMP_SOFT_START_MS, LEDC_FADE_NO_WAIT);
+    } else {
+        ledc_set_duty(PUMP_PWM_MODE, ch, PUMP_PWM_DUTY_ON);
+        ledc_update_duty(PUMP_PWM_MODE, ch);
+    }
+}
+
+static void output_off(int zone) {
+    ledc_channel_t ch = (ledc_channel_t)zone;
+    if (PUMP_SOFT_START_MS > 0) ledc_fade_stop(PUMP_PWM_MODE, ch); // przerwany rozruch nie może dokończyć narastania
+    ledc_stop(PUMP_PWM_MODE, ch, 0);
+}
+
+static void stop_locked(pump_zone_t *z, pump_event_type_t reason) {
+    if (!z->running) return;
+    esp_timer_stop(z->timer);
+    output_off(zone_index(z));
+    z->running = false;
+    if (--s_active == 0) water_monitor_set_armed(false);
+
+    uint32_t ran_ms = (uint32_t)((esp_timer_get_time() - z->started_us) / 1000);
+    ESP_LOGI(TAG, "Strefa %d: STOP zlecenia %lu po %lu ms (%d)", zone_index(z), (unsigned long)z->cur.id,
+             (unsigned long)ran_ms, (int)reason);
+    emit_locked(reason, z, &z->cur, ran_ms);
+}
+
+// Zdejmuje zlecenie z czoła kolejki i uruchamia je (jest wolne miejsce w budżecie)
+static void start_head_locked(pump_zone_t *z) {
+    pump_job_t job = z->queue[0];
+    memmove(&z->queue[0], &z->queue[1], (size_t)(z->queued - 1) * sizeof(pump_job_t));
+    z->queued--;
+
+    if (water_monitor_is_empty()) {
+        ESP_LOGW(TAG, "Strefa %d: brak wody - pomijam zlecenie %lu", zone_index(z), (unsigned long)job.id);
+        emit_locked(PUMP_EVT_SKIPPED, z, &job, 0);
+        return;
+    }
+
+    z->cur = job;
+    z->running = true;
+    z->started_us = esp_timer_get_time();
+    if (s_active++ == 0) water_monitor_set_armed(true);
+    output_on(zone_index(z));
+    esp_timer_start_once(z->timer, (uint64_t)job.duration_ms * 1000);
+
+    ESP_LOGI(TAG, "Strefa %d: START zlecenia %lu (%s, %lu ms), pracuje %d/%d", zone_index(z), (unsigned long)job.id,
+             job.prio == PUMP_PRIO_MANUAL ? "manual" : "auto", (unsigned long)job.duration_ms, s_active, PUMP_MAX_ACTIVE);
+    emit_locked(PUMP_EVT_STARTED, z, &job, 0);
+}
+
+// Uruchamia czekające zlecenia, dopóki jest miejsce albo ktoś ma niższy priorytet do wyparcia
+static void dispatch_locked(void) {
+    while (1) {
+        // Najważniejsze czekające zlecenie: priorytet, potem najdłużej czekające
+        pump_zone_t *best = NULL;
+        for (int i = 0; i < PUMP_ZONE_COUNT; i++) {
+            pump_zone_t *z = &s_zones[i];
+            if (!z->queued) continue;
+            if (z->running && z->cur.prio >= z->queue[0].prio) continue;
+            if (!best || z->queue[0].prio > best->queue[0].prio ||
+                (z->queue[0].prio == best->queue[0].prio && z->queue[0].queued_us < best->queue[0].queued_us)) {
+                best = z;
+            }
+        }
+        if (!best) return;
+
+        if (best->running) {
+            stop_locked(best, PUMP_EVT_PREEMPTED); // ta sama strefa: zwalnia też miejsce w budżecie
+        } else if (s_active >= PUMP_MAX_ACTIVE) {
+            // Budżet wyczerpany: wypieramy pompę o niższym priorytecie, pracującą najkrócej
+            pump_zone_t *victim = NULL;
+            for (int i = 0; i < PUMP_ZONE_COUNT; i++) {
+                pump_zone_t *z = &s_zones[i];
+                if (!z->running || z->cur.prio >= best->queue[0].prio) continue;
+                if (!victim || z->started_us > victim->started_us) victim = z;
+            }
+            if (!victim) return;
+            stop_locked(victim, PUMP_EVT_PREEMPTED);
+        }
+        start_head_locked(best);
+    }
+}
+
+static void zone_timer_cb(void *arg) {
+    pump_zone_t *z = (pump_zone_t *)arg;
+    lock();
+    // Spóźnione wywołanie po stop/start innego zlecenia - nowe jeszcze nie doszło do końca
+    if (z->running && esp_timer_get_time() - z->started_us >= (int64_t)z->cur.duration_ms * 1000) {
+        stop_locked(z, PUMP_EVT_FINISHED);
+        dispatch_locked();
+    }
+    unlock();
+}
+
+static void pump_evt_task(void *arg) {
+    pump_event_t evt;
+    while (xQueueReceive(s_evt_queue, &evt, portMAX_DELAY) == pdTRUE) {
+        uint32_t lost = s_evt_lost;
+        if (lost) {
+            s_evt_lost = 0;
+            ESP_LOGW(TAG, "Utracono %lu zdarzeń pomp (pełna kolejka)", (unsigned long)lost);
+        }
+        pump_event_cb_t cb = s_cb;
+        if (cb) cb(&evt);
+    }
+}
+
+esp_err_t pump_ctrl_init(pump_event_cb_t cb) {
+    if (s_lock) return ESP_OK;
+    s_cb = cb;
+
+    s_lock = xSemaphoreCreateMutex();
+    s_evt_queue = xQueueCreate(PUMP_EVT_QUEUE_LEN, sizeof(pump_event_t));
+    if (!s_lock || !s_evt_queue) return ESP_ERR_NO_MEM;
+
+    const ledc_timer_config_t timer_cfg = {
+        .speed_mode = PUMP_PWM_MODE,
+        .duty_resolution = PUMP_PWM_BITS,
+        .timer_num = PUMP_PWM_TIMER,
+        .freq_hz = PUMP_PWM_FREQ_HZ,
+        .clk_cfg = LEDC_AUTO_CLK,
+    };
+    esp_err_t err = ledc_timer_config(&timer_cfg);
+    if (err != ESP_OK) return err;
+
+    for (int i = 0; i < PUMP_ZONE_COUNT; i++) {
+        const ledc_channel_config_t ch_cfg = {
+            .gpio_num = k_zone_gpio[i],
+            .speed_mode = PUMP_PWM_MODE,
+            .channel = (ledc_channel_t)i,
+            .intr_type = LEDC_INTR_DISABLE,
+            .timer_sel = PUMP_PWM_TIMER,
+            .duty = 0,
+            .hpoint = 0,
+        };
+        err = ledc_channel_config(&ch_cfg);
+        if (err != ESP_OK) return err;
+        ledc_stop(PUMP_PWM_MODE, (ledc_channel_t)i, 0);
+
+        const esp_timer_create_args_t timer_args = {
+            .callback = zone_timer_cb,
+            .arg = &s_zones[i],
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "pump_zone",
+        };
+        err = esp_timer_create(&timer_args, &s_zones[i].timer);
+        if (err != ESP_OK) return err;
+    }
+    if (PUMP_SOFT_START_MS > 0) {
+        err = ledc_fade_func_install(0);
+        if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) return err; // INVALID_STATE = już zainstalowane
+    }
+
+    if (xTaskCreate(pump_evt_task, "pump_evt", PUMP_EVT_STACK, NULL, PUMP_EVT_PRIO, NULL) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "Strefy: %d, jednocześnie max %d, łagodny start %d ms", PUMP_ZONE_COUNT, PUMP_MAX_ACTIVE, PUMP_SOFT_START_MS);
+    return ESP_OK;
+}
+
+int pump_ctrl_zone_count(void) {
+    return PUMP_ZONE_COUNT;
+}
+
+esp_err_t pump_ctrl_submit(int zone, pump_prio_t prio, uint32_t duration_ms, uint32_t *job_id, bool *started) {
+    if (zone < 0 || zone >= PUMP_ZONE_COUNT || duration_ms == 0) return ESP_ERR_INVALID_ARG;
+    if (!s_lock) return ESP_ERR_INVALID_STATE;
+
+    pump_zone_t *z = &s_zones[zone];
+    lock();
+
+    // Reguły automatyczne oceniane są co cykl - nie mnożymy zleceń tej samej strefy
+    if (prio == PUMP_PRIO_AUTO) {
+        bool pending = z->running && z->cur.prio == PUMP_PRIO_AUTO;
+        for (int i = 0; i < z->queued; i++) pending |= z->queue[i].prio == PUMP_PRIO_AUTO;
+        if (pending) {
+            unlock();
+            return ESP_ERR_INVALID_STATE;
+        }
+    }
+
+    if (z->queued == PUMP_QUEUE_DEPTH) {
+        pump_job_t *last = &z->queue[PUMP_QUEUE_DEPTH - 1];
+        if (last->prio >= prio) {
+            unlock();
+            return ESP_ERR_NO_MEM;
+        }
+        pump_job_t dropped = *last;
+        z->queued--;
+        emit_locked(PUMP_EVT_DROPPED, z, &dropped, 0);
+    }
+
+    int pos = z->queued;
+    while (pos > 0 && z->queue[pos - 1].prio < prio) pos--;
+    memmove(&z->queue[pos + 1], &z->queue[pos], (size_t)(z->queued - pos) * sizeof(pump_job_t));
+    pump_job_t job = { .id = ++s_next_id, .duration_ms = duration_ms, .prio = prio, .queued_us = esp_timer_get_time() };
+    z->queue[pos] = job;
+    z->queued++;
+    emit_locked(PUMP_EVT_QUEUED, z, &job, 0);
+
+    dispatch_locked();
+    if (job_id) *job_id = job.id;
+    if (started) *started = z->running && z->cur.id == job.id;
+    unlock();
+    return ESP_OK;
+}
+
+int pump_ctrl_stop(int zone) {
+    if (!s_lock || zone >= PUMP_ZONE_COUNT) return 0;
+
+    int stopped = 0;
+    lock();
+    for (int i = 0; i < PUMP_ZONE_COUNT; i++) {
+        if (zone != PUMP_ZONE_ALL && zone != i) continue;
+        pump_zone_t *z = &s_zones[i];
+        while (z->queued) {
+            pump_job_t job = z->queue[--z->queued];
+            emit_locked(PUMP_EVT_CANCELLED, z, &job, 0);
+            stopped++;
+        }
+        if (z->running) {
+            stop_locked(z, PUMP_EVT_CANCELLED);
+            stopped++;
+        }
+    }
+    dispatch_locked(); // zwolnione miejsce dla stref czekających na budżet
+    unlock();
+    return stopped;
+}
+
+void pump_ctrl_abort_all(void) {
+    if (!s_lock) return;
+
+    lock();
+    for (int i = 0; i < PUMP_ZONE_COUNT; i++) {
+        pump_zone_t *z = &s_zones[i];
+        stop_locked(z, PUMP_EVT_ABORTED);
+        while (z->queued) {
+            pump_job_t job = z->queue[--z->queued];
+            emit_locked(PUMP_EVT_SKIPPED, z, &job, 0);
+        }
+    }
+    unlock();
+}
+
+int pump_ctrl_active_count(void) {
+    return s_active;
+}
@@ -0,0 +1,79 @@
+#ifndef PUMP_CTRL_H
+#define PUMP_CTRL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+// Sterownik pomp/zaworów dla CONFIG_PUMP_ZONE_COUNT stref.
+//
+// Każda strefa ma własną kolejkę zleceń (najpierw priorytet, potem FIFO). Koniec podlewania
+// odmierza esp_timer strefy - żaden task nie czeka przez czas podlewania. Jednocześnie pracuje
+// najwyżej CONFIG_PUMP_MAX_ACTIVE pomp (budżet zasilania); zlecenie ręczne wypiera automatyczne
+// (w tej samej strefie albo, gdy brak wolnego miejsca, w dowolnej). Pompa startuje łagodnie:
+// wypełnienie PWM (LEDC) rośnie sprzętowo od 0 do 100% w CONFIG_PUMP_SOFT_START_MS.
+//
+// Zmiany stanu trafiają do kolejki zdarzeń i są przekazywane callbackiem z taska pump_evt,
+// więc wolna publikacja MQTT nie opóźnia wyłączenia pompy.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PUMP_ZONES_MAX     4
+#define PUMP_QUEUE_DEPTH   4  // zleceń oczekujących na strefę
+#define PUMP_ZONE_ALL      -1
+
+typedef enum {
+    PUMP_PRIO_AUTO = 0,
+    PUMP_PRIO_MANUAL,
+} pump_prio_t;
+
+typedef enum {
+    PUMP_EVT_QUEUED = 0,
+    PUMP_EVT_STARTED,
+    PUMP_EVT_FINISHED,
+    PUMP_EVT_CANCELLED,    // pump_ctrl_stop()
+    PUMP_EVT_PREEMPTED,    // wyparte przez zlecenie o wyższym priorytecie
+    PUMP_EVT_DROPPED,      // usunięte z pełnej kolejki przez zlecenie o wyższym priorytecie
+    PUMP_EVT_ABORTED,      // brak wody w trakcie pracy
+    PUMP_EVT_SKIPPED,      // brak wody przed startem
+} pump_event_type_t;
+
+typedef struct {
+    pump_event_type_t type;
+    uint8_t zone;
+    uint8_t queued;       // zleceń w kolejce strefy po zdarzeniu
+    uint8_t active;       // pracujących pomp (wszystkie strefy) po zdarzeniu
+    pump_prio_t prio;
+    uint32_t job_id;
+    uint32_t duration_ms; // zlecony czas
+    uint32_t ran_ms;      // faktyczny czas pracy (zdarzenia kończące)
+} pump_event_t;
+
+// Wywoływane z taska pump_evt - można publikować
+typedef void (*pump_event_cb_t)(const pump_event_t *evt);
+
+// Konfiguruje GPIO/LEDC wszystkich stref (pompy wyłączone) i startuje task zdarzeń
+esp_err_t pump_ctrl_init(pump_event_cb_t cb);
+
+int pump_ctrl_zone_count(void);
+
+// Dodaje zlecenie. ESP_ERR_NO_MEM = kolejka strefy pełna zleceniami o nie niższym priorytecie,
+// ESP_ERR_INVALID_STATE = zlecenie automatyczne dla strefy już pracuje lub czeka.
+// `job_id`, `started` (opcjonalne): numer zlecenia i czy pompa ruszyła od razu.
+esp_err_t pump_ctrl_submit(int zone, pump_prio_t prio, uint32_t duration_ms, uint32_t *job_id, bool *started);
+
+// Zatrzymuje pompę i czyści kolejkę strefy (PUMP_ZONE_ALL = wszystkich). Zwraca liczbę przerwanych zleceń.
+int pump_ctrl_stop(int zone);
+
+// Brak wody: natychmiast wyłącza wszystkie pompy i czyści kolejki
+void pump_ctrl_abort_all(void);
+
+int pump_ctrl_active_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // PUMP_CTRL_H
@@ -0,0 +1,296 @@
+#include "rule_vm.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+    OP_CONST = 1, // + float32 (4 B, little-endian)
+    OP_CONST_I16, // + int16 (2 B, little-endian) - progi całkowite, najczęstszy przypadek
+    OP_LOAD,      // + indeks zmiennej (1 B)
+    OP_NEG,
+    OP_NOT,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_LT,
+    OP_LE,
+    OP_GT,
+    OP_GE,
+    OP_EQ,
+    OP_NE,
+    OP_AND,
+    OP_OR,
+    OP_COUNT
+};
+
+static const char *const k_var_names[RULE_VAR_COUNT] = {
+    [RULE_VAR_SOIL] = "soil",
+    [RULE_VAR_TEMP] = "temp",
+    [RULE_VAR_HUM] = "hum",
+    [RULE_VAR_PRESS] = "press",
+    [RULE_VAR_LIGHT] = "light",
+    [RULE_VAR_TANK_EMPTY] = "tank_empty",
+    [RULE_VAR_HOUR] = "hour",
+    [RULE_VAR_MINUTE] = "minute",
+    [RULE_VAR_WDAY] = "wday",
+    [RULE_VAR_SINCE_WATER] = "since_water",
+};
+
+// Zmiana głębokości stosu po opkodzie
+static int op_stack_delta(uint8_t op) {
+    switch (op) {
+        case OP_CONST:
+        case OP_CONST_I16:
+        case OP_LOAD: return 1;
+        case OP_NEG:
+        case OP_NOT: return 0;
+        default: return -1;
+    }
+}
+
+static size_t op_size(uint8_t op) {
+    return op == OP_CONST ? 5 : op == OP_CONST_I16 ? 3 : op == OP_LOAD ? 2 : 1;
+}
+
+// --- Kompilator (zejście rekurencyjne, emisja w odwrotnej notacji polskiej) ---
+
+typedef struct {
+    const char *src;
+    size_t pos;
+    rule_program_t *out;
+    int depth;
+    int nest;
+    rule_vm_err_t err;
+    size_t err_pos;
+} parser_t;
+
+static bool fail(parser_t *p, rule_vm_err_t err) {
+    if (p->err == RULE_VM_OK) {
+        p->err = err;
+        p->err_pos = p->pos;
+    }
+    return false;
+}
+
+static void skip_ws(parser_t *p) {
+    while (isspace((unsigned char)p->src[p->pos])) p->pos++;
+}
+
+// Zjada `tok`, jeśli jest następny (po białych znakach)
+static bool accept(parser_t *p, const char *tok) {
+    skip_ws(p);
+    size_t n = strlen(tok);
+    if (strncmp(p->src + p->pos, tok, n) != 0) return false;
+    p->pos += n;
+    return true;
+}
+
+static bool emit(parser_t *p, uint8_t op, const void *arg) {
+    size_t n = op_size(op);
+    if (p->out->len + n > RULE_VM_CODE_MAX) return fail(p, RULE_VM_ERR_TOO_LONG);
+    p->out->code[p->out->len] = op;
+    if (n > 1) memcpy(&p->out->code[p->out->len + 1], arg, n - 1);
+    p->out->len += (uint8_t)n;
+
+    p->depth += op_stack_delta(op);
+    if (p->depth > RULE_VM_STACK_MAX) return fail(p, RULE_VM_ERR_TOO_DEEP);
+    if (p->depth > p->out->stack) p->out->stack = (uint8_t)p->depth;
+    return true;
+}
+
+static bool parse_or(parser_t *p);
+
+static bool parse_primary(parser_t *p) {
+    skip_ws(p);
+    const char *s = p->src + p->pos;
+
+    if (*s == '(') {
+        p->pos++;
+        if (++p->nest > RULE_VM_NEST_MAX) return fail(p, RULE_VM_ERR_TOO_DEEP);
+        if (!parse_or(p)) return false;
+        p->nest--;
+        return accept(p, ")") ? true : fail(p, RULE_VM_ERR_SYNTAX);
+    }
+
+    if (isdigit((unsigned char)*s) || *s == '.') {
+        char *end = NULL;
+        float v = strtof(s, &end);
+        if (end == s) return fail(p, RULE_VM_ERR_SYNTAX);
+        p->pos += (size_t)(end - s);
+        if (v >= INT16_MIN && v <= INT16_MAX && v == (float)(int16_t)v) {
+            uint8_t le[2] = { (uint8_t)(int16_t)v, (uint8_t)((uint16_t)(int16_t)v >> 8) };
+            return emit(p, OP_CONST_I16, le);
+        }
+        return emit(p, OP_CONST, &v);
+    }
+
+    if (isalpha((unsigned char)*s) || *s == '_') {
+        size_t n = 0;
+        while (isalnum((unsigned char)s[n]) || s[n] == '_') n++;
+        for (uint8_t i = 0; i < RULE_VAR_COUNT; i++) {
+            if (strlen(k_var_names[i]) == n && strncmp(s, k_var_names[i], n) == 0) {
+                p->pos += n;
+                return emit(p, OP_LOAD, &i);
+            }
+        }
+        return fail(p, RULE_VM_ERR_UNKNOWN_VAR);
+    }
+    return fail(p, RULE_VM_ERR_SYNTAX);
+}
+
+static bool parse_unary(parser_t *p) {
+    uint8_t op;
+    if (accept(p, "-")) op = OP_NEG;
+    else if (accept(p, "!")) op = OP_NOT;
+    else return parse_primary(p);
+
+    if (++p->nest > RULE_VM_NEST_MAX) return fail(p, RULE_VM_ERR_TOO_DEEP);
+    if (!parse_unary(p)) return false;
+    p->nest--;
+    return emit(p, op, NULL);
+}
+
+static bool parse_term(parser_t *p) {
+    if (!parse_unary(p)) return false;
+    while (1) {
+        uint8_t op;
+        if (accept(p, "*")) op = OP_MUL;
+        else if (accept(p, "/")) op = OP_DIV;
+        else return true;
+        if (!parse_unary(p) || !emit(p, op, NULL)) return false;
+    }
+}
+
+static bool parse_sum(parser_t *p) {
+    if (!parse_term(p)) return false;
+    while (1) {
+        uint8_t op;
+        if (accept(p, "+")) op = OP_ADD;
+        else if (accept(p, "-")) op = OP_SUB;
+        else return true;
+        if (!parse_term(p) || !emit(p, op, NULL)) return false;
+    }
+}
+
+static bool parse_cmp(parser_t *p) {
+    if (!parse_sum(p)) return false;
+    uint8_t op;
+    // Dwuznakowe najpierw
+    if (accept(p, "<=")) op = OP_LE;
+    else if (accept(p, ">=")) op = OP_GE;
+    else if (accept(p, "==")) op = OP_EQ;
+    else if (accept(p, "!=")) op = OP_NE;
+    else if (accept(p, "<")) op = OP_LT;
+    else if (accept(p, ">")) op = OP_GT;
+    else return true;
+    return parse_sum(p) && emit(p, op, NULL);
+}
+
+static bool parse_and(parser_t *p) {
+    if (!parse_cmp(p)) return false;
+    while (accept(p, "&&")) {
+        if (!parse_cmp(p) || !emit(p, OP_AND, NULL)) return false;
+    }
+    return true;
+}
+
+static bool parse_or(parser_t *p) {
+    if (!parse_and(p)) return false;
+    while (accept(p, "||")) {
+        if (!parse_and(p) || !emit(p, OP_OR, NULL)) return false;
+    }
+    return true;
+}
+
+rule_vm_err_t rule_vm_compile(const char *src, rule_program_t *out, size_t *err_pos) {
+    parser_t p = { .src = src, .out = out };
+    memset(out, 0, sizeof(*out));
+
+    if (parse_or(&p)) {
+        skip_ws(&p);
+        if (p.src[p.pos] != '\0') fail(&p, RULE_VM_ERR_SYNTAX);
+    }
+    if (err_pos) *err_pos = p.err_pos;
+    return p.err;
+}
+
+rule_vm_err_t rule_vm_verify(const rule_program_t *prog) {
+    if (prog->len == 0 || prog->len > RULE_VM_CODE_MAX || prog->stack > RULE_VM_STACK_MAX) return RULE_VM_ERR_BAD_CODE;
+
+    int depth = 0;
+    for (size_t pc = 0; pc < prog->len; pc += op_size(prog->code[pc])) {
+        uint8_t op = prog->code[pc];
+        if (op == 0 || op >= OP_COUNT || pc + op_size(op) > prog->len) return RULE_VM_ERR_BAD_CODE;
+        if (op == OP_LOAD && prog->code[pc + 1] >= RULE_VAR_COUNT) return RULE_VM_ERR_BAD_CODE;
+        // Operator unarny potrzebuje 1 argumentu na stosie, binarny 2
+        int need = op_stack_delta(op) > 0 ? 0 : op_stack_delta(op) == 0 ? 1 : 2;
+        if (depth < need) return RULE_VM_ERR_BAD_CODE;
+        depth += op_stack_delta(op);
+        if (depth > prog->stack) return RULE_VM_ERR_BAD_CODE;
+    }
+    return depth == 1 ? RULE_VM_OK : RULE_VM_ERR_BAD_CODE;
+}
+
+static inline bool truth(float v) {
+    return v != 0.0f && v == v; // NaN => fałsz
+}
+
+bool rule_vm_eval(const rule_program_t *prog, const float vars[RULE_VAR_COUNT]) {
+    float st[RULE_VM_STACK_MAX];
+    int sp = 0;
+    const uint8_t *code = prog->code;
+
+    for (size_t pc = 0; pc < prog->len;) {
+        uint8_t op = code[pc++];
+        switch (op) {
+            case OP_CONST:
+                memcpy(&st[sp++], &code[pc], sizeof(float));
+                pc += sizeof(float);
+                continue;
+            case OP_CONST_I16:
+                st[sp++] = (float)(int16_t)(code[pc] | code[pc + 1] << 8);
+                pc += 2;
+                continue;
+            case OP_LOAD:
+                st[sp++] = vars[code[pc++]];
+                continue;
+            case OP_NEG: st[sp - 1] = -st[sp - 1]; continue;
+            case OP_NOT: st[sp - 1] = truth(st[sp - 1]) ? 0.0f : 1.0f; continue;
+            default: break;
+        }
+
+        float b = st[--sp];
+        float a = st[sp - 1];
+        float r;
+        switch (op) {
+            case OP_ADD: r = a + b; break;
+            case OP_SUB: r = a - b; break;
+            case OP_MUL: r = a * b; break;
+            case OP_DIV: r = a / b; break;
+            case OP_LT: r = a < b; break;
+            case OP_LE: r = a <= b; break;
+            case OP_GT: r = a > b; break;
+            case OP_GE: r = a >= b; break;
+            case OP_EQ: r = a == b; break;
+            case OP_NE: r = a == a && b == b && a != b; break; // NaN - też fałsz
+            case OP_AND: r = truth(a) && truth(b); break;
+            default: r = truth(a) || truth(b); break; // OP_OR
+        }
+        st[sp - 1] = r;
+    }
+    return truth(st[0]);
+}
+
+const char *rule_vm_strerror(rule_vm_err_t err) {
+    switch (err) {
+        case RULE_VM_OK: return "ok";
+        case RULE_VM_ERR_SYNTAX: return "syntax";
+        case RULE_VM_ERR_UNKNOWN_VAR: return "unknown_variable";
+        case RULE_VM_ERR_TOO_LONG: return "too_long";
+        case RULE_VM_ERR_TOO_DEEP: return "too_deep";
+        case RULE_VM_ERR_BAD_CODE: return "bad_code";
+    }
+    return "unknown";
+}
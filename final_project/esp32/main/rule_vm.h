@@ -0,0 +1,70 @@
+#ifndef RULE_VM_H
+#define RULE_VM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Warunki automatyzacji jako wyrażenia kompilowane do bajtkodu maszyny stosowej.
+//
+// Składnia: liczby, zmienne (rule_vm_var_t, np. soil, light, hour), nawiasy, + - * /, minus unarny,
+// porównania < <= > >= == !=, logiczne ! && ||. Przykład: "soil < 30 && light < 2000 && hour >= 19".
+// Zmienna niedostępna (NaN) daje fałsz w każdym porównaniu.
+//
+// Bajtkod nie ma skoków, więc liczba kroków = długość programu (<= RULE_VM_CODE_MAX), a głębokość
+// stosu jest znana po kompilacji. Program z NVS sprawdza rule_vm_verify(), potem rule_vm_eval()
+// działa bez kontroli granic. Bez zależności od ESP-IDF.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RULE_VM_CODE_MAX  64
+#define RULE_VM_STACK_MAX 8
+#define RULE_VM_NEST_MAX  8 // zagnieżdżenie nawiasów/operatorów unarnych przy kompilacji
+
+typedef enum {
+    RULE_VAR_SOIL = 0,    // soil - wilgotność gleby %
+    RULE_VAR_TEMP,        // temp - degC
+    RULE_VAR_HUM,         // hum - %RH
+    RULE_VAR_PRESS,       // press - hPa
+    RULE_VAR_LIGHT,       // light - lux
+    RULE_VAR_TANK_EMPTY,  // tank_empty - 1 = brak wody
+    RULE_VAR_HOUR,        // hour - 0..23 (czas lokalny; NaN przed synchronizacją SNTP)
+    RULE_VAR_MINUTE,      // minute - 0..59
+    RULE_VAR_WDAY,        // wday - 0 = niedziela
+    RULE_VAR_SINCE_WATER, // since_water - minuty od ostatniego podlewania (INFINITY = nie było)
+    RULE_VAR_COUNT
+} rule_vm_var_t;
+
+typedef enum {
+    RULE_VM_OK = 0,
+    RULE_VM_ERR_SYNTAX,
+    RULE_VM_ERR_UNKNOWN_VAR,
+    RULE_VM_ERR_TOO_LONG,  // bajtkod > RULE_VM_CODE_MAX
+    RULE_VM_ERR_TOO_DEEP,  // stos > RULE_VM_STACK_MAX albo zagnieżdżenie > RULE_VM_NEST_MAX
+    RULE_VM_ERR_BAD_CODE,  // rule_vm_verify: uszkodzony program
+} rule_vm_err_t;
+
+typedef struct {
+    uint8_t len;   // bajty w code
+    uint8_t stack; // maks. głębokość stosu
+    uint8_t code[RULE_VM_CODE_MAX];
+} rule_program_t;
+
+// `err_pos` (opcjonalny) = pozycja w `src`, przy której wykryto błąd
+rule_vm_err_t rule_vm_compile(const char *src, rule_program_t *out, size_t *err_pos);
+
+// Sprawdza opkody, argumenty i stos (program z zewnątrz, np. z NVS)
+rule_vm_err_t rule_vm_verify(const rule_program_t *prog);
+
+// Wynik programu zweryfikowanego przez rule_vm_compile()/rule_vm_verify(); NaN => fałsz
+bool rule_vm_eval(const rule_program_t *prog, const float vars[RULE_VAR_COUNT]);
+
+const char *rule_vm_strerror(rule_vm_err_t err);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // RULE_VM_H
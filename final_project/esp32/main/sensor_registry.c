@@ -0,0 +1,276 @@
+#include "sensor_registry.h"
+
+#include <math.h>
+#include <string.h>
+#include <sys/time.h>
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "SENSOR_REG";
+
+// Czujniki z terminem w tym oknie próbkujemy razem z najbliższym (mniej wybudzeń)
+#define SENSOR_SCHED_COALESCE_MS 500
+#define SENSOR_SCHED_STACK 4096
+#define SENSOR_SCHED_PRIO 3
+
+typedef struct {
+    const sensor_driver_t *drv;
+    bool present;         // init OK
+    bool ok;              // ostatni collect OK
+    int64_t last_us;      // esp_timer_get_time() ostatniej próbki, 0 = brak
+    int64_t deadline_us;  // w trakcie odczytu: kiedy wynik będzie gotowy
+} sensor_entry_t;
+
+static sensor_entry_t s_entries[SENSOR_REGISTRY_MAX];
+static size_t s_count = 0;
+
+// Potok odczytu nie może się przeplatać (publisher_task, command_worker, scheduler)
+static SemaphoreHandle_t s_lock = NULL;
+static telemetry_data_t s_latest; // ostatnie wartości wszystkich pól (pod s_lock)
+static sensors_timing_t s_timing;
+
+static esp_timer_handle_t s_sched_timer = NULL;
+static TaskHandle_t s_sched_task = NULL;
+
+static void set_unavailable(telemetry_data_t *data, telemetry_fields_mask_t fields) {
+    if (fields & TELEMETRY_FIELD_SOIL) data->soil_moisture = -1;
+    if (fields & TELEMETRY_FIELD_TEMP) data->temp = NAN;
+    if (fields & TELEMETRY_FIELD_HUM) data->humidity = NAN;
+    if (fields & TELEMETRY_FIELD_PRESS) data->pressure = NAN;
+    if (fields & (TELEMETRY_FIELD_TEMP | TELEMETRY_FIELD_HUM | TELEMETRY_FIELD_PRESS)) data->bme_raw_pending = false;
+    if (fields & TELEMETRY_FIELD_LIGHT) data->light_lux = NAN;
+    if (fields & TELEMETRY_FIELD_WATER) data->water_ok = -1;
+}
+
+// Czeka (oddając CPU) do chwili `deadline_us` (esp_timer_get_time). vTaskDelay(n) może skończyć się
+// do jednego ticka wcześniej, więc czekamy w pętli; spóźnienie < 1 tick.
+static void wait_until(int64_t deadline_us) {
+    const int64_t tick_us = (int64_t)portTICK_PERIOD_MS * 1000;
+    int64_t remaining_us;
+    while ((remaining_us = deadline_us - esp_timer_get_time()) > 0) {
+        vTaskDelay((TickType_t)((remaining_us + tick_us - 1) / tick_us));
+    }
+}
+
+// Nastawia timer schedulera na najbliższy termin (s_lock trzymany)
+static void sched_rearm(void) {
+    if (!s_sched_timer) return;
+
+    int64_t next = INT64_MAX;
+    for (size_t i = 0; i < s_count; i++) {
+        const sensor_entry_t *e = &s_entries[i];
+        if (!e->present || e->drv->period_ms == 0) continue;
+        int64_t due = e->last_us + (int64_t)e->drv->period_ms * 1000;
+        if (due < next) next = due;
+    }
+    esp_timer_stop(s_sched_timer);
+    if (next == INT64_MAX) return;
+
+    int64_t in_us = next - esp_timer_get_time();
+    if (in_us < 1000) in_us = 1000;
+    esp_timer_start_once(s_sched_timer, (uint64_t)in_us);
+}
+
+// Potok dla czujników z maską bitową `sel` (s_lock trzymany): start wszystkich, collect w kolejności gotowości
+static void sample_locked(uint32_t sel) {
+    memset(&s_timing, 0, sizeof(s_timing));
+    int64_t t0 = esp_timer_get_time();
+
+    for (size_t i = 0; i < s_count; i++) {
+        if (!(sel & (1u << i))) continue;
+        sensor_entry_t *e = &s_entries[i];
+        sensor_stage_timing_t *st = &s_timing.stage[i];
+        st->name = e->drv->name;
+        st->start_us = (uint32_t)(esp_timer_get_time() - t0);
+
+        uint32_t ready_in_us = 0;
+        esp_err_t err = e->drv->start ? e->drv->start(&ready_in_us) : ESP_OK;
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "%s: start nieudany: %s", e->drv->name, esp_err_to_name(err));
+            if (e->drv->power_down) e->drv->power_down();
+            set_unavailable(&s_latest, e->drv->fields);
+            e->ok = false;
+            e->last_us = esp_timer_get_time();
+            st->end_us = (uint32_t)(e->last_us - t0);
+            sel &= ~(1u << i);
+            continue;
+        }
+        e->deadline_us = esp_timer_get_time() + ready_in_us;
+    }
+    s_timing.count = (uint8_t)s_count;
+
+    while (sel) {
+        size_t next = 0;
+        int64_t best = INT64_MAX;
+        for (size_t i = 0; i < s_count; i++) {
+            if ((sel & (1u << i)) && s_entries[i].deadline_us < best) {
+                best = s_entries[i].deadline_us;
+                next = i;
+            }
+        }
+        sel &= ~(1u << next);
+
+        sensor_entry_t *e = &s_entries[next];
+        wait_until(e->deadline_us);
+        esp_err_t err = e->drv->collect ? e->drv->collect(&s_latest) : ESP_OK;
+        if (e->drv->power_down) e->drv->power_down();
+        e->ok = (err == ESP_OK);
+        e->last_us = esp_timer_get_time();
+        s_timing.stage[next].end_us = (uint32_t)(e->last_us - t0);
+    }
+
+    s_timing.total_us = (uint32_t)(esp_timer_get_time() - t0);
+    sched_rearm();
+}
+
+static void sched_timer_cb(void *arg) {
+    if (s_sched_task) xTaskNotifyGive(s_sched_task);
+}
+
+static void sensor_sched_task(void *arg) {
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        int64_t horizon = esp_timer_get_time() + SENSOR_SCHED_COALESCE_MS * 1000LL;
+        uint32_t due = 0;
+        for (size_t i = 0; i < s_count; i++) {
+            const sensor_entry_t *e = &s_entries[i];
+            if (!e->present || e->drv->period_ms == 0) continue;
+            if (e->last_us + (int64_t)e->drv->period_ms * 1000 <= horizon) due |= 1u << i;
+        }
+        if (due) {
+            sample_locked(due);
+        } else {
+            sched_rearm();
+        }
+        xSemaphoreGive(s_lock);
+    }
+}
+
+esp_err_t sensor_registry_register(const sensor_driver_t *drv) {
+    if (!drv || !drv->name) return ESP_ERR_INVALID_ARG;
+    if (s_count >= SENSOR_REGISTRY_MAX) return ESP_ERR_NO_MEM;
+
+    s_entries[s_count++] = (sensor_entry_t){ .drv = drv };
+    return ESP_OK;
+}
+
+esp_err_t sensor_registry_init_all(void) {
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+
+    set_unavailable(&s_latest, TELEMETRY_FIELDS_ALL);
+
+    bool scheduled = false;
+    for (size_t i = 0; i < s_count; i++) {
+        sensor_entry_t *e = &s_entries[i];
+        esp_err_t err = e->drv->init ? e->drv->init() : ESP_OK;
+        e->present = (err == ESP_OK);
+        e->ok = e->present;
+        if (!e->present) {
+            ESP_LOGW(TAG, "%s: brak czujnika (%s)", e->drv->name, esp_err_to_name(err));
+            continue;
+        }
+        if (e->drv->period_ms > 0) scheduled = true;
+        ESP_LOGI(TAG, "%s: okres %lu ms%s", e->drv->name, (unsigned long)e->drv->period_ms,
+                 e->drv->period_ms ? "" : " (cykl telemetrii)");
+    }
+
+    if (!scheduled) return ESP_OK;
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = sched_timer_cb,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "sensor_sched",
+    };
+    if (xTaskCreate(sensor_sched_task, "sensor_sched", SENSOR_SCHED_STACK, NULL, SENSOR_SCHED_PRIO, &s_sched_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_err_t err = esp_timer_create(&timer_args, &s_sched_timer);
+    if (err != ESP_OK) return err;
+
+    // Pierwsze próbki od razu (last_us == 0 => termin minął)
+    xTaskNotifyGive(s_sched_task);
+    return ESP_OK;
+}
+
+// Najmniejszy dopuszczalny wiek (us) spośród pól `fields`
+static int64_t max_age_us(const sensor_read_request_t *req, telemetry_fields_mask_t fields) {
+    int64_t age = INT64_MAX;
+    for (int i = 0; i < TELEMETRY_FIELD_COUNT; i++) {
+        if ((fields & (1u << i)) && (int64_t)req->max_age_ms[i] * 1000 < age) age = (int64_t)req->max_age_ms[i] * 1000;
+    }
+    return age;
+}
+
+void sensor_registry_read_fresh(const sensor_read_request_t *req, telemetry_data_t *out, uint32_t *age_ms) {
+    // Trwający odczyt (scheduler, cykl telemetrii, poprzednia komenda) trzyma s_lock - czekamy na niego
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    int64_t now = esp_timer_get_time();
+    uint32_t sel = 0;
+    for (size_t i = 0; i < s_count; i++) {
+        const sensor_entry_t *e = &s_entries[i];
+        telemetry_fields_mask_t f = e->drv->fields & req->fields;
+        if (!e->present || !f) continue;
+        bool joined = e->last_us >= req->requested_us;
+        if (e->last_us == 0 || (!joined && now - e->last_us > max_age_us(req, f))) sel |= 1u << i;
+    }
+    if (sel) sample_locked(sel);
+
+    now = esp_timer_get_time();
+    int64_t oldest = now;
+    for (size_t i = 0; i < s_count; i++) {
+        const sensor_entry_t *e = &s_entries[i];
+        if (e->present && (e->drv->fields & req->fields) && e->last_us < oldest) oldest = e->last_us;
+    }
+    *out = s_latest;
+    xSemaphoreGive(s_lock);
+
+    uint32_t age = (uint32_t)((now - oldest) / 1000);
+    if (age_ms) *age_ms = age;
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    out->timestamp = (int64_t)tv.tv_sec * 1000 + (tv.tv_usec / 1000) - age;
+}
+
+void sensor_registry_read(bool all, telemetry_data_t *out) {
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    int64_t now = esp_timer_get_time();
+    uint32_t sel = 0;
+    for (size_t i = 0; i < s_count; i++) {
+        const sensor_entry_t *e = &s_entries[i];
+        if (!e->present) continue;
+        bool stale = e->last_us == 0 || now - e->last_us >= (int64_t)e->drv->period_ms * 1000;
+        if (all || e->drv->period_ms == 0 || stale) sel |= 1u << i;
+    }
+    if (sel) sample_locked(sel);
+
+    *out = s_latest;
+    xSemaphoreGive(s_lock);
+
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    out->timestamp = (int64_t)tv.tv_sec * 1000 + (tv.tv_usec / 1000);
+}
+
+telemetry_fields_mask_t sensor_registry_available_fields(void) {
+    telemetry_fields_mask_t mask = 0;
+    for (size_t i = 0; i < s_count; i++) {
+        if (s_entries[i].present && s_entries[i].ok) mask |= s_entries[i].drv->fields;
+    }
+    return mask;
+}
+
+void sensor_registry_get_last_timing(sensors_timing_t *out) {
+    if (!out) return;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_timing;
+    xSemaphoreGive(s_lock);
+}
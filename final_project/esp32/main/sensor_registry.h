@@ -0,0 +1,84 @@
+#ifndef SENSOR_REGISTRY_H
+#define SENSOR_REGISTRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "common_defs.h"
+
+// Rejestr sterowników czujników z własnymi okresami próbkowania.
+//
+// Każdy sterownik opisuje swoje pola telemetrii i callbacki init/start/collect/power_down.
+// Odczyt działa jak potok: najpierw start() wszystkich wybranych czujników (wolne konwersje
+// ruszają naraz), potem collect() w kolejności gotowości i power_down().
+//
+// Czujniki z `period_ms` > 0 próbkuje w tle scheduler (jednorazowy esp_timer nastawiany na
+// najbliższy termin + task), a cykl telemetrii bierze ich ostatnią wartość z pamięci.
+// Czujniki z `period_ms` == 0 są odczytywane w każdym cyklu telemetrii.
+//
+// Dodanie czujnika = sterownik + sensor_registry_register(), bez zmian w potoku.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SENSOR_REGISTRY_MAX 8
+
+typedef struct {
+    const char *name;
+    telemetry_fields_mask_t fields;
+    uint32_t period_ms; // 0 = razem z cyklem telemetrii
+
+    // Wszystkie callbacki opcjonalne (NULL = brak kroku).
+    esp_err_t (*init)(void);                      // błąd => czujnik nieobecny
+    esp_err_t (*start)(uint32_t *ready_in_us);    // start konwersji; czas do gotowości wyniku
+    esp_err_t (*collect)(telemetry_data_t *data); // wpisuje swoje pola (niedostępne przy błędzie)
+    void (*power_down)(void);
+} sensor_driver_t;
+
+// Czasy ostatniego odczytu względem jego początku (us); etapy nakładają się w czasie.
+typedef struct {
+    const char *name;
+    uint32_t start_us;
+    uint32_t end_us;
+} sensor_stage_timing_t;
+
+typedef struct {
+    uint32_t total_us;
+    uint8_t count;
+    sensor_stage_timing_t stage[SENSOR_REGISTRY_MAX];
+} sensors_timing_t;
+
+// Rejestracja przed sensor_registry_init_all(); `drv` musi żyć cały czas działania programu.
+esp_err_t sensor_registry_register(const sensor_driver_t *drv);
+
+// Inicjalizuje zarejestrowane czujniki i uruchamia scheduler (jeśli któryś ma period_ms > 0).
+esp_err_t sensor_registry_init_all(void);
+
+// Odczyt do `out`: `all` = świeży odczyt wszystkich czujników; inaczej tylko czujniki
+// z period_ms == 0 i te, których ostatnia próbka jest starsza niż ich okres (reszta z pamięci).
+void sensor_registry_read(bool all, telemetry_data_t *out);
+
+// Odczyt na żądanie z limitem wieku próbki per pole (bit i maski => max_age_ms[i]).
+typedef struct {
+    telemetry_fields_mask_t fields;
+    uint32_t max_age_ms[TELEMETRY_FIELD_COUNT];
+    int64_t requested_us; // esp_timer_get_time() przyjęcia żądania
+} sensor_read_request_t;
+
+// Odczyt tylko tych czujników z `req->fields`, których próbka jest starsza niż dopuszcza żądanie.
+// Żądania w trakcie trwającego odczytu czekają na niego i biorą jego wynik (próbka zakończona po
+// `requested_us` jest dobra niezależnie od max_age_ms), zamiast mierzyć drugi raz.
+// `age_ms` = wiek najstarszej próbki wśród żądanych pól; out->timestamp = czas tej próbki.
+void sensor_registry_read_fresh(const sensor_read_request_t *req, telemetry_data_t *out, uint32_t *age_ms);
+
+// Pola obecnych czujników (init OK i ostatni odczyt OK)
+telemetry_fields_mask_t sensor_registry_available_fields(void);
+
+void sensor_registry_get_last_timing(sensors_timing_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SENSOR_REGISTRY_H
@@ -4,16 +4,24 @@
 #include "esp_log.h"
 #include "driver/gpio.h"
 #include "esp_adc/adc_oneshot.h"
+#include "esp_adc/adc_cali.h"
+#include "esp_adc/adc_cali_scheme.h"
 #include "i2cdev.h"
 #include "bmp280.h"
+#include "bmp280_ext.h"
 #include "veml7700.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
 #include "esp_rom_sys.h" 
+#include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>    
 
 #include "mqtt_app.h"
 #include "alert_limiter.h"
+#include "sensor_registry.h"
+#include "water_monitor.h"
 
 static const char *TAG = "SENSORS";
 
@@ -23,30 +31,49 @@ static const char *TAG = "SENSORS";
 #define I2C_MASTER_NUM              I2C_NUM_0
 #define I2C_MASTER_FREQ_HZ          100000
 
-#define WATER_LEVEL_GPIO            GPIO_NUM_18
-
 // --- NOWA KONFIGURACJA DLA POWER SAVE ---
 #define SOIL_POWER_GPIO             GPIO_NUM_27  
 #define SOIL_ADC_CHANNEL            ADC_CHANNEL_6
 #define SOIL_DRY_VAL                2800            
 #define SOIL_WET_VAL                1200            
+// Te same punkty sondy po kalibracji ADC (mV, tłumienie 12 dB) - przenośne między egzemplarzami ESP32
+#define SOIL_DRY_MV                 2300
+#define SOIL_WET_MV                 1000
+
+// Seria próbek w jednym oknie zasilania sondy; próbki dalej od mediany niż K * MAD są odrzucane
+#define SOIL_OVERSAMPLE_COUNT       CONFIG_SOIL_OVERSAMPLE_COUNT
+#define SOIL_OUTLIER_MAD_K          3
 
 // Czas stabilizacji czujnika po włączeniu zasilania (ms)
 #define SENSOR_POWER_UP_DELAY_MS    50 
 
+// Maks. czas dodatkowego czekania na BME280 po czasie z datasheetu (odpytywanie statusu)
+#define BME280_STATUS_POLL_TIMEOUT_US 5000
+
+// Flagi progów VEML7700 (brak pinu INT - odczyt rejestru statusu)
+#define LIGHT_INT_POLL_MS           CONFIG_SENSOR_LIGHT_INT_POLL_MS
+#define LIGHT_INT_TASK_STACK        4096 // alert publikowany synchronicznie (cJSON + esp-mqtt), jak w publisher_task
+#define LIGHT_INT_TASK_PRIO         4
+
 // Zmienne globalne modułu (statyczne)
 static veml7700_handle_t veml_sensor;
+static SemaphoreHandle_t s_veml_lock = NULL; // konfiguracja VEML7700: collect (auto-range) vs light_int
+static bool s_veml_ready = false;
+static TaskHandle_t s_light_int_task = NULL;
+static sensors_light_threshold_cb_t s_light_cb = NULL;
 static bmp280_t bme280_dev;
+static bmp280_params_t s_bme_params;
+static bmp280_calib_t s_bme_calib;           // kopia kalibracji dla sensors_resolve_raw()
+static bool s_bme_calib_valid = false;
+static volatile bool s_bme_raw_capture = false;
 static adc_oneshot_unit_handle_t adc1_handle;
-
-static bool s_has_veml7700 = false;
-static bool s_has_bme280 = false;
-static bool s_has_soil = true;
-static bool s_has_water = true;
+static adc_cali_handle_t s_soil_cali = NULL; // NULL = brak kalibracji (surowe wartości ADC)
+static bool s_i2c_ready = false;
 
 static bool s_prev_soil_ok = true;
-static bool s_prev_bme_ok = true;
-static bool s_prev_veml_ok = true;
+
+static sensors_soil_stats_t s_soil_stats = { .moisture_pct = -1 };
+static portMUX_TYPE s_soil_stats_mux = portMUX_INITIALIZER_UNLOCKED;
 
 static long map_val(long x, long in_min, long in_max, long out_min, long out_max) {
     return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
@@ -86,18 +113,12 @@ static void i2c_bus_reset(void) {
     ESP_LOGI(TAG, "Reset magistrali I2C zakończony.");
 }
 
-static void water_sensor_init(void) {
-    gpio_reset_pin(WATER_LEVEL_GPIO);
-    gpio_set_direction(WATER_LEVEL_GPIO, GPIO_MODE_INPUT);
-    
-    // Domyślnie wyłączamy Pull-Up, żeby nie pobierać prądu
-    // Włączymy go tylko na moment odczytu.
-    gpio_set_pull_mode(WATER_LEVEL_GPIO, GPIO_FLOATING);
-    
-    ESP_LOGI(TAG, "Zainicjalizowano czujnik wody na GPIO %d (tryb Power Save)", WATER_LEVEL_GPIO);
+static esp_err_t water_sensor_init(void) {
+    // Pływak obsługuje water_monitor (przerwanie w czasie pracy pompy, rzadkie próbkowanie poza nią)
+    return water_monitor_start();
 }
 
-static void soil_sensor_init(void) {
+static esp_err_t soil_sensor_init(void) {
     // 1. Konfiguracja pinu zasilającego
     gpio_reset_pin(SOIL_POWER_GPIO);
     gpio_set_direction(SOIL_POWER_GPIO, GPIO_MODE_OUTPUT);
@@ -115,14 +136,41 @@ static void soil_sensor_init(void) {
     };
     ESP_ERROR_CHECK(adc_oneshot_config_channel(adc1_handle, SOIL_ADC_CHANNEL, &config));
 
-    ESP_LOGI(TAG, "Zainicjalizowano czujnik gleby (ADC Oneshot: CH%d, PowerPin: %d)", SOIL_ADC_CHANNEL, SOIL_POWER_GPIO);
+    // 3. Kalibracja ADC (charakterystyka z eFuse): curve fitting tam gdzie jest, na ESP32 line fitting
+    esp_err_t cali_err = ESP_ERR_NOT_SUPPORTED;
+#if ADC_CALI_SCHEME_CURVE_FITTING_SUPPORTED
+    adc_cali_curve_fitting_config_t cali_cfg = {
+        .unit_id = ADC_UNIT_1,
+        .chan = SOIL_ADC_CHANNEL,
+        .atten = ADC_ATTEN_DB_12,
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+    };
+    cali_err = adc_cali_create_scheme_curve_fitting(&cali_cfg, &s_soil_cali);
+#elif ADC_CALI_SCHEME_LINE_FITTING_SUPPORTED
+    adc_cali_line_fitting_config_t cali_cfg = {
+        .unit_id = ADC_UNIT_1,
+        .atten = ADC_ATTEN_DB_12,
+        .bitwidth = ADC_BITWIDTH_DEFAULT,
+    };
+    cali_err = adc_cali_create_scheme_line_fitting(&cali_cfg, &s_soil_cali);
+#endif
+    if (cali_err != ESP_OK) {
+        s_soil_cali = NULL;
+        ESP_LOGW(TAG, "Brak kalibracji ADC (%s) - gleba liczona z surowych wartości", esp_err_to_name(cali_err));
+    }
+
+    ESP_LOGI(TAG, "Zainicjalizowano czujnik gleby (ADC Oneshot: CH%d, PowerPin: %d, próbek: %d, kalibracja: %s)",
+             SOIL_ADC_CHANNEL, SOIL_POWER_GPIO, SOIL_OVERSAMPLE_COUNT, s_soil_cali ? "tak" : "nie");
+    return ESP_OK;
 }
 
 static esp_err_t bme280_sensor_init(void)
 {
-    bmp280_params_t params;
-    bmp280_init_default_params(&params); 
-    params.mode = BMP280_MODE_FORCED;
+    if (!s_i2c_ready) return ESP_ERR_INVALID_STATE;
+
+    bmp280_params_t *params = &s_bme_params;
+    bmp280_init_default_params(params); 
+    params->mode = BMP280_MODE_FORCED;
 
     esp_err_t err = bmp280_init_desc(&bme280_dev, BMP280_I2C_ADDRESS_0, I2C_MASTER_NUM, 
                                       I2C_MASTER_SDA_IO, I2C_MASTER_SCL_IO);
@@ -130,104 +178,106 @@ static esp_err_t bme280_sensor_init(void)
         ESP_LOGE(TAG, "Błąd inicjalizacji deskryptora BME280: %s", esp_err_to_name(err));
         return err;
     }
-    return bmp280_init(&bme280_dev, &params);
-}
-
-esp_err_t sensors_init(void) {
-    esp_err_t res = ESP_OK;
-
-    // 1. Inicjalizacja GPIO i ADC
-    water_sensor_init();
-    soil_sensor_init();
-
-    // Reset I2C przed sterownikiem
-    i2c_bus_reset();
-
-    // 2. I2C (i2cdev library init)
-    ESP_ERROR_CHECK(i2cdev_init()); 
-
-    // 3. VEML7700
-    res = veml7700_init_desc(&veml_sensor, I2C_MASTER_NUM, I2C_MASTER_SDA_IO, I2C_MASTER_SCL_IO);
-    if (res == ESP_OK) {
-        res = veml7700_init(&veml_sensor);
-        if (res == ESP_OK) {
-            s_has_veml7700 = true;
-            veml7700_set_config(&veml_sensor, VEML7700_GAIN_2, VEML7700_IT_100MS, VEML7700_PERS_1);
-            veml7700_set_power_saving(&veml_sensor, true, VEML7700_PSM_MODE_4);
-            ESP_LOGI(TAG, "VEML7700 skonfigurowany (PSM włączone)!");
-        } else {
-            s_has_veml7700 = false;
-             ESP_LOGE(TAG, "VEML7700 błąd init: %s", esp_err_to_name(res));
-        }
+    err = bmp280_init(&bme280_dev, params);
+    if (err == ESP_OK) {
+        bmp280_get_calib(&bme280_dev, &s_bme_calib);
+        s_bme_calib_valid = true;
+        ESP_LOGI(TAG, "BME280 zainicjowany pomyślnie (Tryb FORCED, pomiar %lu us)!",
+                 (unsigned long)bmp280_forced_measurement_time_us(&bme280_dev, params));
     } else {
-        s_has_veml7700 = false;
-        ESP_LOGE(TAG, "VEML7700 błąd deskryptora: %s", esp_err_to_name(res));
-    }
-
-    // 4. BME280
-    if (bme280_sensor_init() == ESP_OK) {
-        s_has_bme280 = true;
-        ESP_LOGI(TAG, "BME280 zainicjowany pomyślnie (Tryb FORCED)!");
-    } else {
-        s_has_bme280 = false;
         ESP_LOGW(TAG, "BME280 problem z inicjalizacją");
     }
-
-    return ESP_OK;
+    return err;
 }
 
-telemetry_fields_mask_t sensors_get_available_fields_mask(void) {
-    telemetry_fields_mask_t mask = 0;
-
-    if (s_has_soil) mask |= TELEMETRY_FIELD_SOIL;
-    if (s_has_bme280) mask |= (TELEMETRY_FIELD_TEMP | TELEMETRY_FIELD_HUM | TELEMETRY_FIELD_PRESS);
-    if (s_has_veml7700) mask |= TELEMETRY_FIELD_LIGHT;
-    if (s_has_water) mask |= TELEMETRY_FIELD_WATER;
+void sensors_get_water_status(int *water_ok) {
+    // Stan potwierdzony przez water_monitor - bez przełączania pull-upu i czekania
+    *water_ok = water_monitor_is_empty() ? 1 : 0;
+}
 
-    return mask;
+static void sort_ints(int *v, int n) {
+    for (int i = 1; i < n; i++) {
+        int x = v[i];
+        int j = i - 1;
+        while (j >= 0 && v[j] > x) {
+            v[j + 1] = v[j];
+            j--;
+        }
+        v[j + 1] = x;
+    }
 }
 
-void sensors_get_water_status(int *water_ok) {
-    // Włączenie Pull-Up (tylko na czas odczytu)
-    gpio_set_pull_mode(WATER_LEVEL_GPIO, GPIO_PULLUP_ONLY);
-    
-    // Krótkie opóźnienie dla stabilizacji sygnału
-    esp_rom_delay_us(50); 
+// Mediana + odrzucenie odstających (|x - mediana| > K * MAD), potem średnia i wariancja pozostałych.
+// `v` zostaje posortowane; `tmp` to bufor roboczy tej samej długości.
+static void soil_filter(int *v, int *tmp, int n, sensors_soil_stats_t *out) {
+    sort_ints(v, n);
+    int median = (n % 2) ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+
+    for (int i = 0; i < n; i++) tmp[i] = abs(v[i] - median);
+    sort_ints(tmp, n);
+    int mad = tmp[n / 2];
+    int limit = SOIL_OUTLIER_MAD_K * (mad > 0 ? mad : 1);
+
+    int64_t sum = 0;
+    int kept = 0;
+    for (int i = 0; i < n; i++) {
+        if (abs(v[i] - median) > limit) continue;
+        sum += v[i];
+        kept++;
+    }
+    // kept >= 1: mediana (lub obie środkowe próbki) zawsze mieści się w limicie
+    float mean = (float)sum / kept;
+    float var = 0.0f;
+    for (int i = 0; i < n; i++) {
+        if (abs(v[i] - median) > limit) continue;
+        float d = v[i] - mean;
+        var += d * d;
+    }
 
-    int pin_level = gpio_get_level(WATER_LEVEL_GPIO);
+    out->value = (int)lroundf(mean);
+    out->variance = kept > 1 ? var / (kept - 1) : 0.0f;
+    out->samples = (uint16_t)kept;
+    out->rejected = (uint16_t)(n - kept);
+}
 
-    // Wyłączenie Pull-Up (oszczędzanie energii)
-    gpio_set_pull_mode(WATER_LEVEL_GPIO, GPIO_FLOATING);
-    if (pin_level == 0) {
-        *water_ok = 0; 
-    } else {
-        *water_ok = 1;
+// Seria odczytów ADC gleby (zasilanie czujnika włączone w soil_start, wyłączane w soil_power_down).
+// Odczyty oneshot trwają po kilkadziesiąt us, więc cała seria wydłuża okno zasilania o < 1 ms.
+static esp_err_t soil_collect(telemetry_data_t *data) {
+    int samples[SOIL_OVERSAMPLE_COUNT];
+    int tmp[SOIL_OVERSAMPLE_COUNT];
+    int n = 0;
+    esp_err_t soil_err = ESP_OK;
+
+    for (int i = 0; i < SOIL_OVERSAMPLE_COUNT; i++) {
+        int raw_adc = 0;
+        esp_err_t err = adc_oneshot_read(adc1_handle, SOIL_ADC_CHANNEL, &raw_adc);
+        if (err != ESP_OK) {
+            soil_err = err;
+            continue;
+        }
+        if (s_soil_cali) {
+            int mv = 0;
+            if (adc_cali_raw_to_voltage(s_soil_cali, raw_adc, &mv) != ESP_OK) continue;
+            raw_adc = mv;
+        }
+        samples[n++] = raw_adc;
     }
-}
 
-void sensors_read(telemetry_data_t *data) {
-    // sekwencja:  Power Up -> Read -> Power Down
-    int raw_adc = 0;
-    
-    // Włączanie zasilania czujnika
-    gpio_set_level(SOIL_POWER_GPIO, 1);
-    
-    // Czekaj na ustabilizowanie się elektroniki czujnika (50-100ms zazwyczaj wystarcza)
-    vTaskDelay(pdMS_TO_TICKS(SENSOR_POWER_UP_DELAY_MS));
+    sensors_soil_stats_t stats = { .moisture_pct = -1, .calibrated = (s_soil_cali != NULL) };
 
-    // Odczyt
-    esp_err_t soil_err = adc_oneshot_read(adc1_handle, SOIL_ADC_CHANNEL, &raw_adc);
-    
-    // Wyłączenie zasilania czujnika
-    gpio_set_level(SOIL_POWER_GPIO, 0);
+    if (n > 0) {
+        soil_filter(samples, tmp, n, &stats);
+        stats.rejected += (uint16_t)(SOIL_OVERSAMPLE_COUNT - n);
 
-    if (soil_err == ESP_OK) {
-        int percentage = map_val(raw_adc, SOIL_DRY_VAL, SOIL_WET_VAL, 0, 100);
+        int percentage = s_soil_cali ? map_val(stats.value, SOIL_DRY_MV, SOIL_WET_MV, 0, 100)
+                                     : map_val(stats.value, SOIL_DRY_VAL, SOIL_WET_VAL, 0, 100);
         if (percentage < 0) percentage = 0;
         if (percentage > 100) percentage = 100;
         data->soil_moisture = percentage;
-        ESP_LOGD(TAG, "[GLEBA] ADC: %d, Wilgotność: %d %%", raw_adc, percentage);
-        s_has_soil = true;
+        stats.moisture_pct = percentage;
+        ESP_LOGD(TAG, "[GLEBA] %s: %d (war. %.1f, próbek %u, odrzuconych %u), Wilgotność: %d %%",
+                 s_soil_cali ? "mV" : "ADC", stats.value, stats.variance,
+                 stats.samples, stats.rejected, percentage);
 
         if (!s_prev_soil_ok) {
             if (alert_limiter_allow("sensor.soil_recovered", esp_log_timestamp(), 60 * 1000, NULL)) {
@@ -236,8 +286,8 @@ void sensors_read(telemetry_data_t *data) {
         }
         s_prev_soil_ok = true;
     } else {
+        if (soil_err == ESP_OK) soil_err = ESP_FAIL; // odczyty OK, ale kalibracja zawiodła
         data->soil_moisture = -1;
-        s_has_soil = false;
         ESP_LOGW(TAG, "[GLEBA] ADC read failed: %s", esp_err_to_name(soil_err));
 
         if (s_prev_soil_ok) {
@@ -250,61 +300,278 @@ void sensors_read(telemetry_data_t *data) {
         }
         s_prev_soil_ok = false;
     }
-    
-    // BME280
-    if (s_has_bme280) {
-        bool bme_ok = false;
-        esp_err_t force_err = bmp280_force_measurement(&bme280_dev);
-        if (force_err == ESP_OK) {
-
-            vTaskDelay(pdMS_TO_TICKS(50));
-            float bme_temp = 0, bme_press = 0, bme_hum = 0;
-            esp_err_t read_err = bmp280_read_float(&bme280_dev, &bme_temp, &bme_press, &bme_hum);
-            if (read_err == ESP_OK) {
-                data->temp = bme_temp;
-                data->pressure = bme_press / 100.0f;
-                data->humidity = bme_hum;
-                bme_ok = true;
-            } else {
-                data->temp = NAN; data->pressure = NAN; data->humidity = NAN;
-            }
-        } else {
-            data->temp = NAN; data->pressure = NAN; data->humidity = NAN;
-        }
-        s_prev_bme_ok = bme_ok;
+
+    portENTER_CRITICAL(&s_soil_stats_mux);
+    s_soil_stats = stats;
+    portEXIT_CRITICAL(&s_soil_stats_mux);
+    return n > 0 ? ESP_OK : soil_err;
+}
+
+// Odczyt wyniku pomiaru BME280 (pomiar wyzwolony w bme280_start, minął czas z datasheetu).
+// W trybie surowym tylko 8 bajtów rejestrów - kompensacja dopiero przy wysyłce.
+static esp_err_t bme280_collect(telemetry_data_t *data) {
+    float bme_temp = 0, bme_press = 0, bme_hum = 0;
+    bool raw = s_bme_raw_capture && s_bme_calib_valid;
+    esp_err_t read_err = bmp280_wait_measurement_done(&bme280_dev, BME280_STATUS_POLL_TIMEOUT_US);
+    if (read_err == ESP_OK) {
+        read_err = raw ? bmp280_read_raw(&bme280_dev, data->bme_raw)
+                       : bmp280_read_scaled(&bme280_dev, &bme_temp, &bme_press, &bme_hum);
+    }
+    if (read_err == ESP_OK && !raw) {
+        data->temp = bme_temp;
+        data->pressure = bme_press;
+        data->humidity = bme_hum;
     } else {
         data->temp = NAN; data->pressure = NAN; data->humidity = NAN;
     }
+    data->bme_raw_pending = (read_err == ESP_OK && raw);
+    return read_err;
+}
 
-    // VEML7700
-    if (s_has_veml7700) {
-        double lux_val = 0.0;
-        bool veml_ok = false;
-        // W trybie PSM odczyt może chwilę trwać lub zwrócić ostatnią wartość.
-        // Auto-adjust gain może wybudzić czujnik na dłużej, ale jest potrzebny dla dokładności.
-        veml7700_auto_adjust_gain(&veml_sensor);
-        if (veml7700_read_lux(&veml_sensor, &lux_val) == ESP_OK) {
-            data->light_lux = (float)lux_val;
-            veml_ok = true;
+void sensors_set_bme_raw_capture(bool enable) {
+    s_bme_raw_capture = enable;
+}
+
+void sensors_resolve_raw(telemetry_data_t *recs, size_t n) {
+    uint8_t raw[BMP280_BATCH_CHUNK * BMP280_RAW_SAMPLE_SIZE];
+    float t[BMP280_BATCH_CHUNK], p[BMP280_BATCH_CHUNK], h[BMP280_BATCH_CHUNK];
+    size_t idx[BMP280_BATCH_CHUNK];
+
+    size_t i = 0;
+    while (i < n) {
+        // Zbieramy do BMP280_BATCH_CHUNK rekordów z surowym BME280 i liczymy je jednym wywołaniem
+        size_t m = 0;
+        for (; i < n && m < BMP280_BATCH_CHUNK; i++) {
+            if (!recs[i].bme_raw_pending) continue;
+            memcpy(&raw[m * BMP280_RAW_SAMPLE_SIZE], recs[i].bme_raw, BMP280_RAW_SAMPLE_SIZE);
+            idx[m++] = i;
+        }
+        if (m == 0) break;
+
+        bmp280_compensate_batch(&s_bme_calib, raw, m, t, p, h);
+        for (size_t k = 0; k < m; k++) {
+            telemetry_data_t *r = &recs[idx[k]];
+            r->temp = t[k];
+            r->pressure = p[k];
+            r->humidity = s_bme_calib.has_humidity ? h[k] : NAN;
+            r->bme_raw_pending = false;
+        }
+    }
+}
+
+static esp_err_t veml7700_collect(telemetry_data_t *data) {
+    // Jeden odczyt, gdy zakres się nie zmienił; przy zmianie światła dobór gain/IT i ponowny pomiar
+    // w tym samym wywołaniu (zamiast wyniku "uncertain" do następnego cyklu).
+    veml7700_auto_result_t res;
+    xSemaphoreTake(s_veml_lock, portMAX_DELAY);
+    esp_err_t err = veml7700_read_lux_auto(&veml_sensor, &res);
+    xSemaphoreGive(s_veml_lock);
+    if (err == ESP_OK && !res.confident) {
+        ESP_LOGW(TAG, "VEML7700: niepewny odczyt (raw=%u, nasycenie lub zakres nieustalony)", (unsigned)res.raw);
+    }
+    data->light_lux = (err == ESP_OK) ? (float)res.lux : NAN;
+    return err;
+}
+
+// --- Sterowniki dla rejestru (sensor_registry) ---
+
+static esp_err_t soil_start(uint32_t *ready_in_us) {
+    // Stabilizacja elektroniki sondy po włączeniu zasilania
+    gpio_set_level(SOIL_POWER_GPIO, 1);
+    *ready_in_us = SENSOR_POWER_UP_DELAY_MS * 1000;
+    return ESP_OK;
+}
+
+static void soil_power_down(void) {
+    gpio_set_level(SOIL_POWER_GPIO, 0);
+}
+
+static esp_err_t bme280_start(uint32_t *ready_in_us) {
+    esp_err_t err = bmp280_force_measurement(&bme280_dev);
+    *ready_in_us = bmp280_forced_measurement_time_us(&bme280_dev, &s_bme_params);
+    return err;
+}
+
+static esp_err_t veml7700_sensor_init(void) {
+    if (!s_i2c_ready) return ESP_ERR_INVALID_STATE;
+
+    esp_err_t res = veml7700_init_desc(&veml_sensor, I2C_MASTER_NUM, I2C_MASTER_SDA_IO, I2C_MASTER_SCL_IO);
+    if (res != ESP_OK) {
+        ESP_LOGE(TAG, "VEML7700 błąd deskryptora: %s", esp_err_to_name(res));
+        return res;
+    }
+    res = veml7700_init(&veml_sensor);
+    if (res != ESP_OK) {
+        ESP_LOGE(TAG, "VEML7700 błąd init: %s", esp_err_to_name(res));
+        return res;
+    }
+    s_veml_lock = xSemaphoreCreateMutex();
+    if (!s_veml_lock) return ESP_ERR_NO_MEM;
+    veml7700_set_config(&veml_sensor, VEML7700_GAIN_2, VEML7700_IT_100MS, VEML7700_PERS_1);
+    veml7700_set_power_saving(&veml_sensor, true, VEML7700_PSM_MODE_4);
+    s_veml_ready = true;
+    ESP_LOGI(TAG, "VEML7700 skonfigurowany (PSM włączone)!");
+    return ESP_OK;
+}
+
+// Odczyt zatrzaśniętych flag progów; czujnik porównuje sam po każdym pomiarze, więc rzadkie
+// odpytywanie niczego nie gubi. Lux liczony tylko przy zdarzeniu (do treści alertu).
+// Odczyt statusu kasuje flagi w czujniku - przy nieudanym odczycie ALS zdarzenie czeka na kolejny obieg.
+static void light_int_task(void *arg) {
+    bool pending_high = false, pending_low = false;
+    while (1) {
+        vTaskDelay(pdMS_TO_TICKS(LIGHT_INT_POLL_MS));
+
+        veml7700_interrupt_status_t st = { 0 };
+        uint16_t raw = 0;
+        float lux = NAN;
+        xSemaphoreTake(s_veml_lock, portMAX_DELAY);
+        esp_err_t err = ESP_OK, als_err = ESP_OK;
+        if (veml_sensor.lux_thresholds) {
+            err = veml7700_get_interrupt_status(&veml_sensor, &st);
+            pending_high |= err == ESP_OK && st.was_high_threshold;
+            pending_low |= err == ESP_OK && st.was_low_threshold;
+            if ((pending_high || pending_low) && (als_err = veml7700_read_als_raw(&veml_sensor, &raw)) == ESP_OK) {
+                lux = veml7700_raw_to_lux_f(raw, veml_sensor.gain, veml_sensor.integration_time);
+            }
         } else {
-            data->light_lux = NAN;
+            pending_high = pending_low = false; // progi wyłączone - stare zdarzenia nieaktualne
         }
-        s_prev_veml_ok = veml_ok;
-    } else {
-        data->light_lux = NAN;
+        sensors_light_threshold_cb_t cb = s_light_cb;
+        xSemaphoreGive(s_veml_lock);
+
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "VEML7700: odczyt statusu progów nieudany: %s", esp_err_to_name(err));
+            continue;
+        }
+        if (als_err != ESP_OK) {
+            ESP_LOGW(TAG, "VEML7700: odczyt ALS po przekroczeniu progu nieudany: %s", esp_err_to_name(als_err));
+            continue;
+        }
+        if (isnan(lux)) continue; // brak zdarzenia
+        if (cb && pending_high) cb(true, lux);
+        if (cb && pending_low) cb(false, lux);
+        pending_high = pending_low = false;
+    }
+}
+
+esp_err_t sensors_set_light_thresholds(float lux_min, float lux_max, sensors_light_threshold_cb_t cb) {
+    if (!s_veml_ready) return ESP_ERR_INVALID_STATE;
+
+    bool enable = !isinf(lux_min) || !isinf(lux_max);
+    xSemaphoreTake(s_veml_lock, portMAX_DELAY);
+    s_light_cb = cb;
+    esp_err_t err = veml7700_set_lux_thresholds(&veml_sensor, enable, lux_min, lux_max);
+    if (err == ESP_OK && enable) {
+        // Flagi zatrzaśnięte przy starych progach nie dotyczą nowych
+        veml7700_interrupt_status_t stale;
+        veml7700_get_interrupt_status(&veml_sensor, &stale);
     }
+    xSemaphoreGive(s_veml_lock);
+    if (err != ESP_OK) return err;
 
-    // Woda 
+    if (enable && !s_light_int_task &&
+        xTaskCreate(light_int_task, "light_int", LIGHT_INT_TASK_STACK, NULL, LIGHT_INT_TASK_PRIO, &s_light_int_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    ESP_LOGI(TAG, "VEML7700: progi sprzętowe %s (%.1f..%.1f lx)", enable ? "aktywne" : "wyłączone", lux_min, lux_max);
+    return ESP_OK;
+}
+
+static esp_err_t water_collect(telemetry_data_t *data) {
     int w_val = 0;
-    sensors_get_water_status(&w_val); // zarządzanie Pull-Upem
+    sensors_get_water_status(&w_val);
     data->water_ok = (int16_t)w_val;
-    
-    // 5. Timestamp
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    data->timestamp = (int64_t)tv.tv_sec * 1000 + (tv.tv_usec / 1000);
-    
-    ESP_LOGI(TAG, "Odczyt: T:%.1f H:%.1f P:%.0f L:%.1f S:%d W:%d", 
+    return ESP_OK;
+}
+
+// Kolejność rejestracji = kolejność startu w potoku: najpierw wolne konwersje (gleba, BME280),
+// potem odczyty synchroniczne wykonywane w czasie ich trwania.
+static const sensor_driver_t k_soil_driver = {
+    .name = "soil",
+    .fields = TELEMETRY_FIELD_SOIL,
+    .period_ms = CONFIG_SENSOR_SOIL_PERIOD_SEC * 1000,
+    .init = soil_sensor_init,
+    .start = soil_start,
+    .collect = soil_collect,
+    .power_down = soil_power_down,
+};
+
+static const sensor_driver_t k_bme280_driver = {
+    .name = "bme280",
+    .fields = TELEMETRY_FIELD_TEMP | TELEMETRY_FIELD_HUM | TELEMETRY_FIELD_PRESS,
+    .period_ms = CONFIG_SENSOR_BME280_PERIOD_SEC * 1000,
+    .init = bme280_sensor_init,
+    .start = bme280_start,
+    .collect = bme280_collect,
+};
+
+static const sensor_driver_t k_water_driver = {
+    .name = "water",
+    .fields = TELEMETRY_FIELD_WATER,
+    .period_ms = CONFIG_SENSOR_WATER_PERIOD_SEC * 1000,
+    .init = water_sensor_init,
+    .collect = water_collect,
+};
+
+static const sensor_driver_t k_veml7700_driver = {
+    .name = "veml7700",
+    .fields = TELEMETRY_FIELD_LIGHT,
+    .period_ms = CONFIG_SENSOR_VEML7700_PERIOD_SEC * 1000,
+    .init = veml7700_sensor_init,
+    .collect = veml7700_collect,
+};
+
+esp_err_t sensors_init(void) {
+    // Reset I2C przed sterownikiem
+    i2c_bus_reset();
+
+    // I2C (i2cdev library init) - wspólne dla BME280 i VEML7700
+    ESP_ERROR_CHECK(i2cdev_init()); 
+    s_i2c_ready = true;
+
+    sensor_registry_register(&k_soil_driver);
+    sensor_registry_register(&k_bme280_driver);
+    sensor_registry_register(&k_water_driver);
+    sensor_registry_register(&k_veml7700_driver);
+
+    return sensor_registry_init_all();
+}
+
+telemetry_fields_mask_t sensors_get_available_fields_mask(void) {
+    return sensor_registry_available_fields();
+}
+
+static void log_reading(const telemetry_data_t *data) {
+    sensors_timing_t timing;
+    sensor_registry_get_last_timing(&timing);
+    ESP_LOGI(TAG, "Odczyt: T:%.1f H:%.1f P:%.0f L:%.1f S:%d W:%d (%lu us)", 
              data->temp, data->humidity, data->pressure, data->light_lux, 
-             data->soil_moisture, data->water_ok);
-}
\ No newline at end of file
+             data->soil_moisture, data->water_ok, (unsigned long)timing.total_us);
+}
+
+void sensors_read(telemetry_data_t *data) {
+    sensor_registry_read(true, data);
+    log_reading(data);
+}
+
+void sensors_read_fresh(const sensor_read_request_t *req, telemetry_data_t *data, uint32_t *age_ms) {
+    sensor_registry_read_fresh(req, data, age_ms);
+    log_reading(data);
+}
+
+void sensors_read_scheduled(telemetry_data_t *data) {
+    sensor_registry_read(false, data);
+    log_reading(data);
+}
+
+void sensors_get_last_timing(sensors_timing_t *out) {
+    sensor_registry_get_last_timing(out);
+}
+
+void sensors_get_last_soil(sensors_soil_stats_t *out) {
+    if (!out) return;
+    portENTER_CRITICAL(&s_soil_stats_mux);
+    *out = s_soil_stats;
+    portEXIT_CRITICAL(&s_soil_stats_mux);
+}
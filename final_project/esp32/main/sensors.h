@@ -1,19 +1,64 @@
 #ifndef SENSORS_H
 #define SENSORS_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "esp_err.h"
 #include "common_defs.h"
+#include "sensor_registry.h"
 
 // Inicjalizacja wszystkich czujników
 esp_err_t sensors_init(void);
 
-// Odczyt wszystkich danych do struktury telemetrycznej
+// Wynik ostatniego pomiaru gleby: seria CONFIG_SOIL_OVERSAMPLE_COUNT próbek w jednym oknie zasilania
+// sondy, odrzucone próbki odstające od mediany, średnia i wariancja pozostałych.
+typedef struct {
+    int moisture_pct;   // -1 = błąd odczytu
+    int value;          // mV (calibrated) albo surowe ADC
+    float variance;     // wariancja próbek (jednostka value^2)
+    uint16_t samples;   // próbek użytych do średniej
+    uint16_t rejected;  // odstających i nieudanych odczytów
+    bool calibrated;
+} sensors_soil_stats_t;
+
+// Świeży odczyt wszystkich czujników do struktury telemetrycznej
 void sensors_read(telemetry_data_t *data);
 
-// Pomocnicza funkcja do odczytu stanu wody
+// Odczyt na cykl telemetrii: czujniki z własnym okresem (CONFIG_SENSOR_*_PERIOD_SEC) podają
+// ostatnią próbkę schedulera, pozostałe są odczytywane teraz.
+void sensors_read_scheduled(telemetry_data_t *data);
+
+// Odczyt na żądanie (/command/read): czujnik jest mierzony tylko, gdy jego próbka jest starsza niż
+// dopuszcza `req`, a żądania nakładające się na trwający odczyt biorą jego wynik.
+void sensors_read_fresh(const sensor_read_request_t *req, telemetry_data_t *data, uint32_t *age_ms);
+
+// Czasy etapów ostatniego odczytu (również próbkowania w tle)
+void sensors_get_last_timing(sensors_timing_t *out);
+
+// Szczegóły pomiaru gleby z ostatniego sensors_read()
+void sensors_get_last_soil(sensors_soil_stats_t *out);
+
+// Stan zbiornika (1 = brak wody), ostatni potwierdzony przez water_monitor
 void sensors_get_water_status(int *water_ok);
 
 // Zwraca maskę pól, które są faktycznie mierzone (czujniki dostępne)
 telemetry_fields_mask_t sensors_get_available_fields_mask(void);
 
+// Tryb surowy BME280 (offline): collect zapisuje tylko rejestry 0xF7..0xFE (bme_raw_pending),
+// bez kompensacji w pętli pomiarowej.
+void sensors_set_bme_raw_capture(bool enable);
+
+// Kompensacja hurtem rekordów z bme_raw_pending (kalibracja z pamięci); pozostałe bez zmian.
+void sensors_resolve_raw(telemetry_data_t *recs, size_t n);
+
+// Przekroczenie progu światła zgłoszone przez VEML7700 (`high` = powyżej max); `lux` z bieżącego RAW.
+// Wywoływane z taska light_int.
+typedef void (*sensors_light_threshold_cb_t)(bool high, float lux);
+
+// Progi światła liczone przez sam czujnik (rejestry ALS_WH/ALS_WL); -INFINITY/INFINITY = brak progu.
+// Zdarzenia idą do `cb` - bez odczytu lux w każdym cyklu tylko po to, by porównać go z progiem.
+// ESP_ERR_INVALID_STATE gdy VEML7700 nieobecny (wtedy progi trzeba sprawdzać programowo).
+esp_err_t sensors_set_light_thresholds(float lux_min, float lux_max, sensors_light_threshold_cb_t cb);
+
 #endif // SENSORS_H
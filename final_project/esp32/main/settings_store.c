@@ -0,0 +1,268 @@
+#include "settings_store.h"
+
+#include <string.h>
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+static const char *TAG = "SETTINGS";
+
+#define NVS_NAMESPACE      "storage"
+#define STORE_MAGIC        0x5347 // "SG"
+#define STORE_MAX_BYTES    256
+#define COMMIT_DELAY_US    ((int64_t)CONFIG_SETTINGS_COMMIT_DELAY_MS * 1000)
+#define COMMIT_MAX_DELAY_US ((int64_t)CONFIG_SETTINGS_COMMIT_MAX_DELAY_MS * 1000)
+
+typedef struct __attribute__((packed)) {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t count; // pól w treści
+    uint16_t len;  // bajtów treści
+    uint32_t crc;  // CRC32 nagłówka (bez crc) i treści
+} store_hdr_t;
+
+static const settings_store_config_t *s_cfg = NULL;
+static SemaphoreHandle_t s_lock = NULL;        // stan (s_dirty, statystyki)
+static SemaphoreHandle_t s_commit_lock = NULL; // jeden zapis w NVS naraz
+static esp_timer_handle_t s_timer = NULL;
+static bool s_dirty = false;
+static int64_t s_dirty_since_us = 0;
+static uint32_t s_last_crc = 0; // ostatnio zapisany/wczytany obraz
+static settings_store_stats_t s_stats;
+
+static uint32_t record_crc(const store_hdr_t *h, const uint8_t *body) {
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)h, offsetof(store_hdr_t, crc));
+    return esp_rom_crc32_le(crc, body, h->len);
+}
+
+// Obraz rekordu ze struktury w RAM; zwraca długość
+static size_t encode(uint8_t *buf) {
+    store_hdr_t h = { .magic = STORE_MAGIC, .version = s_cfg->version };
+    uint8_t *body = buf + sizeof(h);
+    size_t off = 0;
+    for (size_t i = 0; i < s_cfg->field_count; i++) {
+        const settings_field_t *f = &s_cfg->fields[i];
+        if (sizeof(h) + off + 2 + f->size > STORE_MAX_BYTES) {
+            ESP_LOGE(TAG, "Ustawienia > %d B - pole %u i dalsze niezapisane", STORE_MAX_BYTES, f->tag);
+            break;
+        }
+        body[off++] = f->tag;
+        body[off++] = f->size;
+        memcpy(&body[off], (const uint8_t *)s_cfg->data + f->offset, f->size);
+        off += f->size;
+        h.count++;
+    }
+    h.len = (uint16_t)off;
+    h.crc = record_crc(&h, body);
+    memcpy(buf, &h, sizeof(h));
+    return sizeof(h) + off;
+}
+
+static const settings_field_t *field_by_tag(uint8_t tag) {
+    for (size_t i = 0; i < s_cfg->field_count; i++) {
+        if (s_cfg->fields[i].tag == tag) return &s_cfg->fields[i];
+    }
+    return NULL;
+}
+
+static esp_err_t decode(const uint8_t *buf, size_t len) {
+    store_hdr_t h;
+    if (len < sizeof(h)) return ESP_ERR_INVALID_SIZE;
+    memcpy(&h, buf, sizeof(h));
+    const uint8_t *body = buf + sizeof(h);
+    if (h.magic != STORE_MAGIC || sizeof(h) + h.len > len) return ESP_ERR_INVALID_SIZE;
+    if (h.crc != record_crc(&h, body)) return ESP_ERR_INVALID_CRC;
+
+    size_t off = 0, known = 0;
+    for (unsigned i = 0; i < h.count && off + 2 <= h.len; i++) {
+        uint8_t tag = body[off], size = body[off + 1];
+        off += 2;
+        if (off + size > h.len) return ESP_ERR_INVALID_SIZE;
+
+        const settings_field_t *f = field_by_tag(tag);
+        if (f && (size == f->size || (f->flags & SETTINGS_FIELD_ARRAY))) {
+            memcpy((uint8_t *)s_cfg->data + f->offset, &body[off], size < f->size ? size : f->size);
+            known++;
+        } else {
+            ESP_LOGW(TAG, "Pole %u (%u B) pominięte - %s", tag, size, f ? "inny rozmiar" : "nieznany tag");
+        }
+        off += size;
+    }
+    s_stats.loaded_version = h.version;
+    ESP_LOGI(TAG, "Wczytano ustawienia: schemat v%u (firmware v%u), pól %u/%u", h.version, s_cfg->version,
+             (unsigned)known, (unsigned)s_cfg->field_count);
+    return ESP_OK;
+}
+
+// Stary format: surowa struktura, nowe pola zawsze dopisywane na końcu - bierzemy pola mieszczące się w blobie
+static bool migrate_legacy(nvs_handle_t h) {
+    if (!s_cfg->legacy_key) return false;
+
+    uint8_t buf[STORE_MAX_BYTES];
+    size_t len = sizeof(buf);
+    if (nvs_get_blob(h, s_cfg->legacy_key, buf, &len) != ESP_OK) return false;
+
+    size_t known = 0;
+    for (size_t i = 0; i < s_cfg->field_count; i++) {
+        const settings_field_t *f = &s_cfg->fields[i];
+        if (f->offset + f->size > len) continue;
+        memcpy((uint8_t *)s_cfg->data + f->offset, &buf[f->offset], f->size);
+        known++;
+    }
+    ESP_LOGW(TAG, "Migracja starego zapisu '%s' (%u B): pól %u/%u", s_cfg->legacy_key, (unsigned)len,
+             (unsigned)known, (unsigned)s_cfg->field_count);
+    return true;
+}
+
+static esp_err_t write_blob(const uint8_t *buf, size_t len) {
+    nvs_handle_t h;
+    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &h);
+    if (err != ESP_OK) return err;
+    err = nvs_set_blob(h, s_cfg->key, buf, len);
+    if (err == ESP_OK) err = nvs_commit(h);
+    // Po udanym zapisie nowego formatu stary nie jest potrzebny
+    if (err == ESP_OK && s_cfg->legacy_key && nvs_erase_key(h, s_cfg->legacy_key) == ESP_OK) nvs_commit(h);
+    nvs_close(h);
+    return err;
+}
+
+// Zapis, dopóki są niezapisane zmiany (zmiana w trakcie zapisu = kolejny obieg).
+// s_commit_lock: flush przy restarcie czeka na zapis trwający w tasku esp_timer.
+static esp_err_t commit(void) {
+    uint8_t buf[STORE_MAX_BYTES];
+    esp_err_t err = ESP_OK;
+
+    xSemaphoreTake(s_commit_lock, portMAX_DELAY);
+    while (err == ESP_OK) {
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        if (!s_dirty) {
+            xSemaphoreGive(s_lock);
+            break;
+        }
+        s_dirty = false;
+        esp_timer_stop(s_timer);
+        xSemaphoreGive(s_lock);
+
+        // Zmiana po wyczyszczeniu s_dirty ustawia go ponownie - kolejny obieg zapisze ją osobno
+        SemaphoreHandle_t data_lock = s_cfg->lock ? *s_cfg->lock : NULL;
+        if (data_lock) xSemaphoreTake(data_lock, portMAX_DELAY);
+        size_t len = encode(buf);
+        if (data_lock) xSemaphoreGive(data_lock);
+        uint32_t crc = ((const store_hdr_t *)buf)->crc;
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        // Np. te same ustawienia wysłane ponownie albo zmiana cofnięta przed zapisem
+        bool same = (crc == s_last_crc);
+        if (same) s_stats.writes_avoided++;
+        xSemaphoreGive(s_lock);
+        if (same) continue;
+
+        err = write_blob(buf, len);
+
+        xSemaphoreTake(s_lock, portMAX_DELAY);
+        if (err == ESP_OK) {
+            s_last_crc = crc;
+            s_stats.writes++;
+            ESP_LOGI(TAG, "Ustawienia zapisane w NVS (%u B, zapisów %lu, unikniętych %lu)", (unsigned)len,
+                     (unsigned long)s_stats.writes, (unsigned long)s_stats.writes_avoided);
+        } else {
+            ESP_LOGE(TAG, "Zapis ustawień w NVS nieudany: %s", esp_err_to_name(err));
+            s_dirty = true; // ponowna próba przy następnej zmianie albo przy restarcie
+        }
+        xSemaphoreGive(s_lock);
+    }
+    xSemaphoreGive(s_commit_lock);
+    return err;
+}
+
+static void commit_timer_cb(void *arg) {
+    commit();
+}
+
+static void shutdown_handler(void) {
+    settings_store_flush();
+}
+
+esp_err_t settings_store_init(const settings_store_config_t *cfg) {
+    if (s_cfg) return ESP_ERR_INVALID_STATE;
+
+    s_lock = xSemaphoreCreateMutex();
+    s_commit_lock = xSemaphoreCreateMutex();
+    if (!s_lock || !s_commit_lock) return ESP_ERR_NO_MEM;
+    const esp_timer_create_args_t timer_args = {
+        .callback = commit_timer_cb,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "settings_commit",
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &s_timer);
+    if (err != ESP_OK) return err;
+    s_cfg = cfg;
+    esp_register_shutdown_handler(shutdown_handler);
+
+    nvs_handle_t h;
+    err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &h);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Brak NVS (%s) - ustawienia domyślne", esp_err_to_name(err));
+        return err;
+    }
+
+    uint8_t buf[STORE_MAX_BYTES];
+    size_t len = sizeof(buf);
+    err = nvs_get_blob(h, cfg->key, buf, &len);
+    if (err == ESP_OK) {
+        err = decode(buf, len);
+        if (err == ESP_OK) {
+            s_last_crc = ((const store_hdr_t *)buf)->crc;
+        } else {
+            ESP_LOGE(TAG, "Zapis ustawień uszkodzony (%s) - ustawienia domyślne", esp_err_to_name(err));
+        }
+    } else if (migrate_legacy(h)) {
+        s_dirty = true; // przepisanie w nowym formacie (i usunięcie starego) od razu
+        err = ESP_OK;
+    } else {
+        ESP_LOGW(TAG, "Brak zapisanych ustawień - domyślne");
+    }
+    nvs_close(h);
+
+    if (s_dirty) commit();
+    return err;
+}
+
+void settings_store_mark_dirty(void) {
+    if (!s_cfg) return;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    if (s_dirty) {
+        s_stats.writes_avoided++; // złączone z oczekującym zapisem
+    } else {
+        s_dirty = true;
+        s_dirty_since_us = now;
+    }
+    // Każda zmiana odsuwa zapis o okres ciszy, ale nie dalej niż COMMIT_MAX_DELAY_US od pierwszej
+    int64_t due = now + COMMIT_DELAY_US;
+    if (due > s_dirty_since_us + COMMIT_MAX_DELAY_US) due = s_dirty_since_us + COMMIT_MAX_DELAY_US;
+    int64_t in_us = due - now;
+    esp_timer_stop(s_timer);
+    esp_timer_start_once(s_timer, (uint64_t)(in_us > 0 ? in_us : 1));
+    xSemaphoreGive(s_lock);
+}
+
+esp_err_t settings_store_flush(void) {
+    if (!s_cfg) return ESP_ERR_INVALID_STATE;
+    return commit();
+}
+
+void settings_store_get_stats(settings_store_stats_t *out) {
+    if (!s_lock) {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *out = s_stats;
+    xSemaphoreGive(s_lock);
+}
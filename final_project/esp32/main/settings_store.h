@@ -0,0 +1,72 @@
+#ifndef SETTINGS_STORE_H
+#define SETTINGS_STORE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+// Trwały zapis struktury ustawień w NVS.
+//
+// Format: nagłówek (magic, wersja schematu, liczba pól, długość, CRC32) + pola jako
+// [tag, rozmiar, bajty]. Odczyt idzie po tagach, więc zmiana układu struktury w RAM nie psuje
+// ustawień: pole bez zapisu zostaje domyślne, nieznany tag (nowszy firmware) jest pomijany,
+// tablica o innej długości kopiowana jest w części wspólnej. Tagów nie używa się ponownie -
+// pole o zmienionym znaczeniu/typie dostaje nowy tag.
+//
+// Stary zapis (surowa struktura pod `legacy_key`) jest migrowany po offsetach pól przy pierwszym starcie.
+//
+// settings_store_mark_dirty() niczego nie zapisuje od razu: commit w NVS idzie po
+// CONFIG_SETTINGS_COMMIT_DELAY_MS ciszy (najpóźniej CONFIG_SETTINGS_COMMIT_MAX_DELAY_MS od pierwszej
+// zmiany) i przy esp_restart(). Zapis identyczny z ostatnim też jest pomijany.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SETTINGS_FIELD_ARRAY 0x01 // inny rozmiar w zapisie = kopiujemy część wspólną
+
+typedef struct {
+    uint8_t tag;     // stały identyfikator w NVS (1..255)
+    uint8_t flags;   // SETTINGS_FIELD_*
+    uint8_t size;
+    uint16_t offset; // w strukturze w RAM
+} settings_field_t;
+
+#define SETTINGS_FIELD(tag, type, member, flags) \
+    { (tag), (flags), (uint8_t)sizeof(((type *)0)->member), (uint16_t)offsetof(type, member) }
+
+typedef struct {
+    const char *key;        // klucz NVS (namespace "storage")
+    const char *legacy_key; // surowa struktura starego formatu albo NULL
+    uint8_t version;        // wersja schematu (zapisywana, do diagnostyki i przyszłych migracji)
+    void *data;             // struktura w RAM (wartości domyślne przed settings_store_init)
+    SemaphoreHandle_t *lock; // mutex, pod którym aplikacja zmienia data (kopia do zapisu też go bierze) albo NULL
+    const settings_field_t *fields;
+    size_t field_count;
+} settings_store_config_t;
+
+typedef struct {
+    uint32_t writes;         // commitów w NVS od startu
+    uint32_t writes_avoided; // zmian złączonych z innymi albo identycznych z zapisem
+    uint8_t loaded_version;  // wersja schematu wczytanego zapisu, 0 = brak/stary format
+} settings_store_stats_t;
+
+// Wczytuje ustawienia do cfg->data (konfiguracja musi żyć do końca działania programu)
+esp_err_t settings_store_init(const settings_store_config_t *cfg);
+
+// Struktura w RAM zmieniona - zapis po okresie ciszy
+void settings_store_mark_dirty(void);
+
+// Zapis od razu, jeśli są niezapisane zmiany
+esp_err_t settings_store_flush(void);
+
+void settings_store_get_stats(settings_store_stats_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SETTINGS_STORE_H
@@ -0,0 +1,61 @@
+#include "telemetry_codec.h"
+
+#include <math.h>
+
+static uint8_t *put_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    return p + 2;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t v) {
+    p = put_u16(p, (uint16_t)v);
+    return put_u16(p, (uint16_t)(v >> 16));
+}
+
+static uint8_t *put_u64(uint8_t *p, uint64_t v) {
+    p = put_u32(p, (uint32_t)v);
+    return put_u32(p, (uint32_t)(v >> 32));
+}
+
+// Wartość * 100 z zaokrągleniem jak round2() w JSON, obcięta do zakresu typu
+static int64_t centi(float v, int64_t lo, int64_t hi) {
+    int64_t c = llroundf(v * 100.0f);
+    if (c < lo) return lo;
+    if (c > hi) return hi;
+    return c;
+}
+
+size_t telemetry_codec_begin(uint8_t *buf, size_t cap) {
+    if (cap < TELEMETRY_CODEC_HEADER_SIZE) return 0;
+    buf[0] = TELEMETRY_CODEC_VERSION;
+    buf[1] = 0;
+    return TELEMETRY_CODEC_HEADER_SIZE;
+}
+
+size_t telemetry_codec_append(uint8_t *buf, size_t cap, size_t len, const telemetry_data_t *data, telemetry_fields_mask_t fields) {
+    if (len < TELEMETRY_CODEC_HEADER_SIZE || buf[1] >= TELEMETRY_CODEC_MAX_RECORDS) return 0;
+    if (cap - len < TELEMETRY_CODEC_RECORD_MAX_SIZE) return 0;
+
+    // Te same reguły "niedostępne" co w JSON (NaN/Inf => null)
+    if (data->soil_moisture < 0) fields &= ~TELEMETRY_FIELD_SOIL;
+    if (!isfinite(data->temp)) fields &= ~TELEMETRY_FIELD_TEMP;
+    if (!isfinite(data->humidity)) fields &= ~TELEMETRY_FIELD_HUM;
+    if (!isfinite(data->pressure)) fields &= ~TELEMETRY_FIELD_PRESS;
+    if (!isfinite(data->light_lux)) fields &= ~TELEMETRY_FIELD_LIGHT;
+
+    uint8_t flags = (uint8_t)(fields & TELEMETRY_FIELDS_ALL);
+    if ((fields & TELEMETRY_FIELD_WATER) && data->water_ok == 0) flags |= TELEMETRY_CODEC_FLAG_WATER_OK;
+
+    uint8_t *p = buf + len;
+    p = put_u64(p, (uint64_t)data->timestamp);
+    *p++ = flags;
+    if (flags & TELEMETRY_FIELD_SOIL) *p++ = (uint8_t)(data->soil_moisture > 255 ? 255 : data->soil_moisture);
+    if (flags & TELEMETRY_FIELD_TEMP) p = put_u16(p, (uint16_t)(int16_t)centi(data->temp, INT16_MIN, INT16_MAX));
+    if (flags & TELEMETRY_FIELD_HUM) p = put_u16(p, (uint16_t)centi(data->humidity, 0, UINT16_MAX));
+    if (flags & TELEMETRY_FIELD_PRESS) p = put_u32(p, (uint32_t)centi(data->pressure, 0, UINT32_MAX));
+    if (flags & TELEMETRY_FIELD_LIGHT) p = put_u32(p, (uint32_t)centi(data->light_lux, 0, UINT32_MAX));
+
+    buf[1]++;
+    return (size_t)(p - buf);
+}
@@ -0,0 +1,46 @@
+#ifndef TELEMETRY_CODEC_H
+#define TELEMETRY_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common_defs.h"
+
+// Binarne kodowanie telemetrii (alternatywa dla JSON, topic garden/{user}/{device}/telemetry/bin).
+//
+// Ramka (little-endian):
+//   u8  version (TELEMETRY_CODEC_VERSION)
+//   u8  liczba rekordów N
+//   N x rekord:
+//     i64 timestamp [ms]
+//     u8  flagi: bity 0-5 = pola obecne (TELEMETRY_FIELD_*), bit 7 = water_tank_ok
+//     u8  soil_moisture_pct           (jeśli TELEMETRY_FIELD_SOIL)
+//     i16 air_temperature_c * 100     (jeśli TELEMETRY_FIELD_TEMP)
+//     u16 air_humidity_pct * 100      (jeśli TELEMETRY_FIELD_HUM)
+//     u32 pressure_hpa * 100          (jeśli TELEMETRY_FIELD_PRESS)
+//     u32 light_lux * 100             (jeśli TELEMETRY_FIELD_LIGHT)
+// Pole nieobecne odpowiada null w JSON. device/user wynikają z topicu.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TELEMETRY_CODEC_VERSION 1
+#define TELEMETRY_CODEC_CONTENT_TYPE "application/vnd.smartgarden.telemetry.v1"
+#define TELEMETRY_CODEC_HEADER_SIZE 2
+#define TELEMETRY_CODEC_RECORD_MAX_SIZE 22
+#define TELEMETRY_CODEC_MAX_RECORDS 255
+
+#define TELEMETRY_CODEC_FLAG_WATER_OK (1u << 7)
+
+// Zapisuje nagłówek ramki z licznikiem 0. Zwraca liczbę bajtów lub 0 gdy brak miejsca.
+size_t telemetry_codec_begin(uint8_t *buf, size_t cap);
+
+// Dopisuje rekord na pozycji `len`; `fields` = pola do wysłania (już po uwzględnieniu dostępności czujników).
+// Zwraca nową długość ramki lub 0 gdy rekord się nie mieści / ramka jest pełna.
+size_t telemetry_codec_append(uint8_t *buf, size_t cap, size_t len, const telemetry_data_t *data, telemetry_fields_mask_t fields);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRY_CODEC_H
@@ -0,0 +1,575 @@
+#include "telemetry_log.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "telemetry_tsz.h"
+
+static const char *TAG = "TLM_LOG";
+
+#define TLOG_SECTOR_SIZE    4096
+#define TLOG_MAGIC          0x324C5453u // "STL2" (bloki skompresowane)
+#define TLOG_ERASED_WORD    0xFFFFFFFFu
+
+#define TLOG_BLOCK_MAX_RECORDS  CONFIG_TELEMETRY_LOG_BLOCK_RECORDS
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sector_seq;   // rośnie o 1 przy każdym otwarciu nowego sektora
+    uint32_t erase_count;
+    uint32_t crc;          // CRC z magic/sector_seq/erase_count
+    uint32_t consumed;     // TLOG_ERASED_WORD = zawiera niewysłane rekordy
+    uint32_t reserved[3];
+} tlog_sector_hdr_t;
+
+// Wpis w sektorze: nagłówek + `len` bajtów bloku telemetry_tsz (wyrównane do 4).
+// Dane zapisywane są przed nagłówkiem, więc wpis bez nagłówka nie jest widoczny.
+typedef struct {
+    uint16_t len;
+    uint16_t count;
+    uint32_t seq;
+    uint32_t crc;          // CRC z len/count/seq + dane
+    uint32_t consumed[2];  // bit i wyzerowany = rekord i wysłany (zerowane po kolei)
+} tlog_entry_hdr_t;
+
+#define TLOG_ENTRY_WRITE_LEN offsetof(tlog_entry_hdr_t, consumed)
+#define TLOG_FIRST_ENTRY     sizeof(tlog_sector_hdr_t)
+
+_Static_assert(sizeof(tlog_sector_hdr_t) % 4 == 0, "header must be word aligned");
+_Static_assert(sizeof(tlog_entry_hdr_t) % 4 == 0, "entry header must be word aligned");
+_Static_assert(TLOG_BLOCK_MAX_RECORDS <= 64, "consumed bitmap holds 64 records");
+_Static_assert(TLOG_FIRST_ENTRY + sizeof(tlog_entry_hdr_t) + TELEMETRY_LOG_BLOCK_MAX_BYTES <= TLOG_SECTOR_SIZE,
+               "block must fit a sector");
+
+typedef enum {
+    ENTRY_OK,
+    ENTRY_END, // wolne miejsce / koniec sektora
+    ENTRY_BAD, // przerwany zapis - reszta sektora jest nieużywalna
+} entry_status_t;
+
+// Pozycja w logu + zdekodowany wpis z niewysłanymi rekordami
+typedef struct {
+    bool valid;            // wskazuje na wpis z niewysłanymi rekordami
+    uint32_t sector;
+    uint32_t sector_seq;
+    uint32_t off;
+    uint32_t first;        // pozycja (absolutna) pierwszego niewysłanego rekordu wpisu
+    tlog_entry_hdr_t hdr;
+    uint16_t sent;
+    uint8_t raw[TELEMETRY_LOG_BLOCK_MAX_BYTES];
+    telemetry_data_t recs[TLOG_BLOCK_MAX_RECORDS];
+} tlog_cursor_t;
+
+static const esp_partition_t *s_part = NULL;
+static SemaphoreHandle_t s_lock = NULL;
+static uint32_t s_sector_count = 0;
+
+// Pozycja zapisu (head)
+static uint32_t s_head_sector = 0;
+static uint32_t s_head_off = TLOG_FIRST_ENTRY;
+static uint32_t s_head_sector_seq = 0;
+static uint32_t s_next_block_seq = 1;
+
+// Odczyt: tail (najstarszy niewysłany rekord) i kursor odczytu z wyprzedzeniem
+static tlog_cursor_t s_tail;
+static tlog_cursor_t s_ahead;
+static uint32_t s_tail_pos = 0; // pozycja absolutna najstarszego niewysłanego rekordu (liczona od startu)
+
+// Otwarty blok (jeszcze nie zapisany na flashu)
+static telemetry_tsz_encoder_t s_open;
+static uint8_t s_open_buf[TELEMETRY_LOG_BLOCK_MAX_BYTES];
+
+static uint8_t s_io_buf[TELEMETRY_LOG_BLOCK_MAX_BYTES];
+
+static uint32_t s_pending = 0;   // niewysłane rekordy na flashu
+static uint32_t s_dropped = 0;
+
+// Statystyka kompresji (do szacowania pojemności)
+static uint32_t s_stat_bytes = 0;
+static uint32_t s_stat_records = 0;
+
+static size_t sector_addr(uint32_t sector) {
+    return (size_t)sector * TLOG_SECTOR_SIZE;
+}
+
+static uint32_t entry_size(uint16_t len) {
+    return sizeof(tlog_entry_hdr_t) + (((uint32_t)len + 3u) & ~3u);
+}
+
+static uint32_t hdr_crc(const tlog_sector_hdr_t *h) {
+    return esp_rom_crc32_le(0, (const uint8_t *)h, offsetof(tlog_sector_hdr_t, crc));
+}
+
+static uint32_t entry_crc(const tlog_entry_hdr_t *h, const uint8_t *data) {
+    uint32_t crc = esp_rom_crc32_le(0, (const uint8_t *)h, offsetof(tlog_entry_hdr_t, crc));
+    return esp_rom_crc32_le(crc, data, h->len);
+}
+
+// Liczba rekordów wpisu już oznaczonych jako wysłane. Zwalniany jest zawsze prefiks rekordów,
+// więc liczy się najwyższy wyzerowany bit: przerwany zapis bitmapy zeruje tylko część bitów zakresu
+// (popcount przesunąłby wtedy pozycje i pominął rekordy jeszcze niewysłane).
+static uint16_t entry_sent(const tlog_entry_hdr_t *h) {
+    uint32_t hi = ~h->consumed[1], lo = ~h->consumed[0];
+    uint16_t sent = hi ? (uint16_t)(64 - __builtin_clz(hi)) : lo ? (uint16_t)(32 - __builtin_clz(lo)) : 0;
+    return sent > h->count ? h->count : sent;
+}
+
+static bool read_hdr(uint32_t sector, tlog_sector_hdr_t *h) {
+    if (esp_partition_read(s_part, sector_addr(sector), h, sizeof(*h)) != ESP_OK) return false;
+    return h->magic == TLOG_MAGIC && h->crc == hdr_crc(h);
+}
+
+// Czyta nagłówek wpisu i dane bloku do `data`, sprawdza CRC.
+static entry_status_t read_entry(uint32_t sector, uint32_t off, tlog_entry_hdr_t *h, uint8_t *data) {
+    if (off + sizeof(*h) > TLOG_SECTOR_SIZE) return ENTRY_END;
+    if (esp_partition_read(s_part, sector_addr(sector) + off, h, sizeof(*h)) != ESP_OK) return ENTRY_BAD;
+
+    if (h->len == 0xFFFF && h->count == 0xFFFF && h->seq == TLOG_ERASED_WORD && h->crc == TLOG_ERASED_WORD) {
+        return ENTRY_END;
+    }
+    if (h->len == 0 || h->len > TELEMETRY_LOG_BLOCK_MAX_BYTES || h->count == 0 || h->count > TLOG_BLOCK_MAX_RECORDS ||
+        off + entry_size(h->len) > TLOG_SECTOR_SIZE) {
+        return ENTRY_BAD;
+    }
+    if (esp_partition_read(s_part, sector_addr(sector) + off + sizeof(*h), data, h->len) != ESP_OK) return ENTRY_BAD;
+    return h->crc == entry_crc(h, data) ? ENTRY_OK : ENTRY_BAD;
+}
+
+// Niewysłane rekordy w sektorze od pozycji `off`
+static uint32_t sector_pending(uint32_t sector, uint32_t off, uint32_t end) {
+    uint32_t n = 0;
+    tlog_entry_hdr_t h;
+    while (off < end && read_entry(sector, off, &h, s_io_buf) == ENTRY_OK) {
+        n += h.count - entry_sent(&h);
+        off += entry_size(h.len);
+    }
+    return n;
+}
+
+static bool range_erased(uint32_t sector, uint32_t off) {
+    while (off < TLOG_SECTOR_SIZE) {
+        uint32_t chunk = TLOG_SECTOR_SIZE - off;
+        if (chunk > sizeof(s_io_buf)) chunk = sizeof(s_io_buf);
+        if (esp_partition_read(s_part, sector_addr(sector) + off, s_io_buf, chunk) != ESP_OK) return false;
+        for (uint32_t i = 0; i < chunk; i++) {
+            if (s_io_buf[i] != 0xFF) return false;
+        }
+        off += chunk;
+    }
+    return true;
+}
+
+static esp_err_t open_sector(uint32_t sector, uint32_t sector_seq) {
+    tlog_sector_hdr_t old;
+    uint32_t erase_count = read_hdr(sector, &old) ? old.erase_count + 1 : 1;
+
+    esp_err_t err = esp_partition_erase_range(s_part, sector_addr(sector), TLOG_SECTOR_SIZE);
+    if (err != ESP_OK) return err;
+
+    tlog_sector_hdr_t h;
+    memset(&h, 0xFF, sizeof(h));
+    h.magic = TLOG_MAGIC;
+    h.sector_seq = sector_seq;
+    h.erase_count = erase_count;
+    h.crc = hdr_crc(&h);
+    return esp_partition_write(s_part, sector_addr(sector), &h, offsetof(tlog_sector_hdr_t, consumed));
+}
+
+static void mark_sector_consumed(uint32_t sector) {
+    const uint32_t zero = 0;
+    (void)esp_partition_write(s_part, sector_addr(sector) + offsetof(tlog_sector_hdr_t, consumed), &zero, sizeof(zero));
+}
+
+static void cursor_next_sector(tlog_cursor_t *c) {
+    c->sector = (c->sector + 1) % s_sector_count;
+    c->sector_seq++;
+    c->off = TLOG_FIRST_ENTRY;
+    c->valid = false;
+}
+
+// Ustawia kursor na pierwszy wpis z niewysłanymi rekordami od jego bieżącej pozycji i dekoduje go.
+// Dla tail-a w pełni wysłane sektory są oznaczane na flashu. false = brak dalszych wpisów na flashu.
+static bool cursor_seek(tlog_cursor_t *c, bool is_tail) {
+    if (c->valid) return true;
+
+    for (;;) {
+        bool in_head = (c->sector_seq == s_head_sector_seq);
+        if (in_head && c->off >= s_head_off) return false;
+
+        entry_status_t st = read_entry(c->sector, c->off, &c->hdr, c->raw);
+        if (st == ENTRY_OK) {
+            uint16_t sent = entry_sent(&c->hdr);
+            if (sent < c->hdr.count) {
+                telemetry_tsz_decoder_t dec;
+                telemetry_tsz_decoder_init(&dec, c->raw, c->hdr.len);
+                bool ok = true;
+                for (uint16_t i = 0; i < c->hdr.count && ok; i++) {
+                    ok = telemetry_tsz_next(&dec, &c->recs[i]);
+                }
+                if (ok) {
+                    c->sent = sent;
+                    c->valid = true;
+                    return true;
+                }
+                // Pozycje rekordów zostają zachowane; tail liczy je jako utracone
+                uint16_t lost = (uint16_t)(c->hdr.count - sent);
+                ESP_LOGE(TAG, "Nie można zdekodować bloku %lu - pominięto", (unsigned long)c->hdr.seq);
+                c->first += lost;
+                if (is_tail) {
+                    s_pending -= lost;
+                    s_tail_pos += lost;
+                    s_dropped += lost;
+                }
+            }
+            c->off += entry_size(c->hdr.len);
+            continue;
+        }
+
+        // Koniec sektora (lub przerwany zapis) - przechodzimy do następnego
+        if (in_head) return false;
+        if (is_tail) mark_sector_consumed(c->sector);
+        cursor_next_sector(c);
+    }
+}
+
+static uint16_t cursor_remaining(const tlog_cursor_t *c) {
+    return (uint16_t)(c->hdr.count - c->sent);
+}
+
+// Kursor na następny wpis za bieżącym (tylko pozycja)
+static void cursor_step(tlog_cursor_t *c) {
+    c->first += cursor_remaining(c);
+    c->off += entry_size(c->hdr.len);
+    c->valid = false;
+}
+
+// Oznacza `n` najstarszych rekordów bieżącego wpisu tail jako wysłane.
+static esp_err_t tail_consume(uint16_t n) {
+    uint32_t words[2] = {s_tail.hdr.consumed[0], s_tail.hdr.consumed[1]};
+    uint16_t upto = s_tail.sent + n;
+    for (uint16_t i = s_tail.sent; i < upto; i++) {
+        words[i / 32] &= ~(1u << (i % 32));
+    }
+    esp_err_t err = esp_partition_write(s_part,
+                                        sector_addr(s_tail.sector) + s_tail.off + offsetof(tlog_entry_hdr_t, consumed),
+                                        words, sizeof(words));
+    s_tail.hdr.consumed[0] = words[0];
+    s_tail.hdr.consumed[1] = words[1];
+    s_tail.sent = upto;
+    s_tail.first += n;
+    s_tail_pos += n;
+    s_pending -= n;
+
+    if (s_tail.sent >= s_tail.hdr.count) {
+        s_tail.off += entry_size(s_tail.hdr.len);
+        s_tail.valid = false;
+    }
+    return err;
+}
+
+// Przechodzi do nowego sektora; gdy pierścień jest pełny, zwalnia najstarszy sektor (drop-oldest).
+static esp_err_t head_next_sector(void) {
+    uint32_t next = (s_head_sector + 1) % s_sector_count;
+
+    if (next == s_tail.sector && s_tail.sector_seq != s_head_sector_seq) {
+        uint32_t lost = sector_pending(s_tail.sector, s_tail.off, TLOG_SECTOR_SIZE);
+        s_dropped += lost;
+        s_pending -= lost;
+        s_tail_pos += lost;
+        cursor_next_sector(&s_tail);
+        s_tail.first = s_tail_pos;
+        s_ahead.valid = false;
+        s_ahead.sector_seq = 0; // wymusza ponowne ustawienie od tail
+    }
+
+    esp_err_t err = open_sector(next, s_head_sector_seq + 1);
+    if (err != ESP_OK) return err;
+
+    s_head_sector = next;
+    s_head_sector_seq++;
+    s_head_off = TLOG_FIRST_ENTRY;
+    return ESP_OK;
+}
+
+// Zapisuje otwarty blok na flash (dane, potem nagłówek).
+static esp_err_t seal_open_block(void) {
+    if (s_open.count == 0) return ESP_OK;
+
+    tlog_entry_hdr_t h;
+    memset(&h, 0xFF, sizeof(h));
+    h.len = (uint16_t)telemetry_tsz_size(&s_open);
+    h.count = s_open.count;
+    h.seq = s_next_block_seq;
+    h.crc = entry_crc(&h, s_open_buf);
+
+    esp_err_t err = ESP_OK;
+    if (s_head_off + entry_size(h.len) > TLOG_SECTOR_SIZE) {
+        err = head_next_sector();
+    }
+
+    if (err == ESP_OK) {
+        size_t addr = sector_addr(s_head_sector) + s_head_off;
+        err = esp_partition_write(s_part, addr + sizeof(h), s_open_buf, h.len);
+        if (err == ESP_OK) err = esp_partition_write(s_part, addr, &h, TLOG_ENTRY_WRITE_LEN);
+        // Nawet przy błędzie przesuwamy head - wpis może być częściowo zapisany (odrzuci go CRC).
+        s_head_off += entry_size(h.len);
+        s_next_block_seq++;
+        if (err == ESP_OK) {
+            s_pending += h.count;
+            s_stat_bytes += entry_size(h.len);
+            s_stat_records += h.count;
+            ESP_LOGD(TAG, "Blok %lu: %u rekordów w %u B", (unsigned long)h.seq, h.count, h.len);
+        }
+    }
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Zapis bloku nie powiódł się: %s (utracono %u rekordów)", esp_err_to_name(err), s_open.count);
+    }
+    telemetry_tsz_encoder_init(&s_open, s_open_buf, sizeof(s_open_buf));
+    return err;
+}
+
+// Wpis zawierający rekord o pozycji `pos` (pos >= s_tail_pos); zapisuje otwarty blok, gdy trzeba.
+static tlog_cursor_t *locate(uint32_t pos, uint16_t *index) {
+    if (pos < s_tail_pos) return NULL;
+    if (pos - s_tail_pos >= s_pending) {
+        if (s_open.count == 0 || pos - s_tail_pos >= s_pending + s_open.count) return NULL;
+        (void)seal_open_block();
+    }
+
+    if (!cursor_seek(&s_tail, true)) return NULL;
+    if (pos < s_tail.first + cursor_remaining(&s_tail)) {
+        *index = (uint16_t)(s_tail.sent + (pos - s_tail.first));
+        return &s_tail;
+    }
+
+    // Kursor z wyprzedzeniem: kontynuujemy od ostatniej pozycji, jeśli nadal jest przed `pos`
+    tlog_cursor_t *c = &s_ahead;
+    bool usable = c->sector_seq != 0 && c->first > s_tail.first && c->first <= pos &&
+                  (c->sector_seq > s_tail.sector_seq || (c->sector_seq == s_tail.sector_seq && c->off > s_tail.off));
+    if (!usable) {
+        c->sector = s_tail.sector;
+        c->sector_seq = s_tail.sector_seq;
+        c->off = s_tail.off;
+        c->first = s_tail.first;
+        c->hdr = s_tail.hdr;
+        c->sent = s_tail.sent;
+        cursor_step(c);
+    }
+
+    for (;;) {
+        if (!cursor_seek(c, false)) return NULL;
+        if (pos < c->first + cursor_remaining(c)) {
+            *index = (uint16_t)(c->sent + (pos - c->first));
+            return c;
+        }
+        cursor_step(c);
+    }
+}
+
+// Odtwarza stan z nagłówków sektorów i wpisów (czas ograniczony rozmiarem partycji).
+static esp_err_t recover(void) {
+    bool found = false;
+    uint32_t best_seq = 0;
+    tlog_sector_hdr_t h;
+
+    memset(&s_tail, 0, sizeof(s_tail));
+    memset(&s_ahead, 0, sizeof(s_ahead));
+    s_tail.off = TLOG_FIRST_ENTRY;
+
+    for (uint32_t i = 0; i < s_sector_count; i++) {
+        if (read_hdr(i, &h) && (!found || h.sector_seq > best_seq)) {
+            found = true;
+            best_seq = h.sector_seq;
+            s_head_sector = i;
+        }
+    }
+
+    if (!found) {
+        ESP_LOGI(TAG, "Pusta partycja - inicjalizacja bufora");
+        s_head_sector = s_tail.sector = 0;
+        s_head_sector_seq = s_tail.sector_seq = 1;
+        s_head_off = TLOG_FIRST_ENTRY;
+        return open_sector(0, 1);
+    }
+    s_head_sector_seq = best_seq;
+
+    // Head: koniec ostatniego poprawnego wpisu w najnowszym sektorze
+    tlog_entry_hdr_t e;
+    uint32_t off = TLOG_FIRST_ENTRY;
+    for (;;) {
+        entry_status_t st = read_entry(s_head_sector, off, &e, s_io_buf);
+        if (st == ENTRY_OK) {
+            if (e.seq >= s_next_block_seq) s_next_block_seq = e.seq + 1;
+            off += entry_size(e.len);
+            continue;
+        }
+        // Dane zapisane bez nagłówka lub przerwany nagłówek - sektora nie dopisujemy dalej
+        if (st == ENTRY_BAD || !range_erased(s_head_sector, off)) off = TLOG_SECTOR_SIZE;
+        break;
+    }
+    s_head_off = off;
+
+    // Tail: najstarszy sektor (idąc fizycznie za head-em), który ma jeszcze niewysłane rekordy
+    s_tail.sector = s_head_sector;
+    s_tail.sector_seq = s_head_sector_seq;
+    for (uint32_t k = 1; k <= s_sector_count; k++) {
+        uint32_t sector = (s_head_sector + k) % s_sector_count;
+        if (!read_hdr(sector, &h)) continue;
+        if (h.consumed != TLOG_ERASED_WORD) continue;
+        if (h.sector_seq > s_head_sector_seq || s_head_sector_seq - h.sector_seq >= s_sector_count) continue;
+        s_tail.sector = sector;
+        s_tail.sector_seq = h.sector_seq;
+        break;
+    }
+
+    // Liczba niewysłanych rekordów: skan wpisów od tail do head
+    s_pending = 0;
+    for (uint32_t seq = s_tail.sector_seq; seq <= s_head_sector_seq; seq++) {
+        uint32_t sector = (s_tail.sector + (seq - s_tail.sector_seq)) % s_sector_count;
+        if (seq != s_head_sector_seq && (!read_hdr(sector, &h) || h.sector_seq != seq)) continue;
+        s_pending += sector_pending(sector, TLOG_FIRST_ENTRY, seq == s_head_sector_seq ? s_head_off : TLOG_SECTOR_SIZE);
+    }
+
+    (void)cursor_seek(&s_tail, true);
+    return ESP_OK;
+}
+
+esp_err_t telemetry_log_init(void) {
+    if (s_part) return ESP_OK;
+
+    const esp_partition_t *part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                           TELEMETRY_LOG_PARTITION_LABEL);
+    if (!part) {
+        ESP_LOGW(TAG, "Brak partycji '%s' - bufor offline tylko w RAM", TELEMETRY_LOG_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (part->size / TLOG_SECTOR_SIZE < 2) {
+        ESP_LOGE(TAG, "Partycja '%s' za mała (%lu B)", TELEMETRY_LOG_PARTITION_LABEL, (unsigned long)part->size);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    s_lock = xSemaphoreCreateMutex();
+    if (!s_lock) return ESP_ERR_NO_MEM;
+
+    s_part = part;
+    s_sector_count = part->size / TLOG_SECTOR_SIZE;
+    telemetry_tsz_encoder_init(&s_open, s_open_buf, sizeof(s_open_buf));
+
+    esp_err_t err = recover();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Odtwarzanie bufora nie powiodło się: %s", esp_err_to_name(err));
+        s_part = NULL;
+        return err;
+    }
+
+    ESP_LOGI(TAG, "Bufor telemetrii: %lu sektorów, %lu rekordów oczekuje",
+             (unsigned long)s_sector_count, (unsigned long)s_pending);
+    return ESP_OK;
+}
+
+bool telemetry_log_is_ready(void) {
+    return s_part != NULL;
+}
+
+esp_err_t telemetry_log_append(const telemetry_data_t *rec) {
+    if (!s_part) return ESP_ERR_INVALID_STATE;
+    if (!rec) return ESP_ERR_INVALID_ARG;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    esp_err_t err = ESP_OK;
+    if (!telemetry_tsz_append(&s_open, rec)) {
+        // Blok pełny (bajty) - zapisujemy i zaczynamy nowy
+        err = seal_open_block();
+        if (!telemetry_tsz_append(&s_open, rec)) err = ESP_ERR_INVALID_SIZE;
+    }
+    if (s_open.count >= TLOG_BLOCK_MAX_RECORDS) {
+        esp_err_t seal_err = seal_open_block();
+        if (err == ESP_OK) err = seal_err;
+    }
+
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+uint32_t telemetry_log_first(void) {
+    if (!s_part) return 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t pos = s_tail_pos;
+    xSemaphoreGive(s_lock);
+    return pos;
+}
+
+bool telemetry_log_read(uint32_t pos, telemetry_data_t *out) {
+    if (!s_part || !out) return false;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint16_t index = 0;
+    tlog_cursor_t *c = locate(pos, &index);
+    if (c) *out = c->recs[index];
+    xSemaphoreGive(s_lock);
+    return c != NULL;
+}
+
+size_t telemetry_log_read_block(uint32_t pos, uint8_t *buf, size_t cap, uint16_t *count, uint16_t *skip) {
+    if (!s_part || !buf || !count || !skip) return 0;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    size_t len = 0;
+    uint16_t index = 0;
+    tlog_cursor_t *c = locate(pos, &index);
+    if (c && c->hdr.len <= cap) {
+        memcpy(buf, c->raw, c->hdr.len);
+        len = c->hdr.len;
+        *count = c->hdr.count;
+        *skip = index;
+    }
+    xSemaphoreGive(s_lock);
+    return len;
+}
+
+esp_err_t telemetry_log_release(uint32_t upto) {
+    if (!s_part) return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    esp_err_t err = ESP_OK;
+    while (s_tail_pos < upto && s_pending > 0 && cursor_seek(&s_tail, true)) {
+        uint32_t n = upto - s_tail_pos;
+        if (n > cursor_remaining(&s_tail)) n = cursor_remaining(&s_tail);
+        esp_err_t e = tail_consume((uint16_t)n);
+        if (err == ESP_OK) err = e;
+    }
+    xSemaphoreGive(s_lock);
+    return err;
+}
+
+uint32_t telemetry_log_count(void) {
+    if (!s_part) return 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t n = s_pending + s_open.count;
+    xSemaphoreGive(s_lock);
+    return n;
+}
+
+uint32_t telemetry_log_capacity(void) {
+    if (!s_part) return 0;
+    // Szacunek z bieżącego współczynnika kompresji (przed pierwszym blokiem: bez kompresji)
+    uint64_t usable = (uint64_t)(s_sector_count - 1) * (TLOG_SECTOR_SIZE - TLOG_FIRST_ENTRY);
+    if (s_stat_records == 0) return (uint32_t)(usable / sizeof(telemetry_data_t));
+    return (uint32_t)(usable * s_stat_records / s_stat_bytes);
+}
+
+uint32_t telemetry_log_take_dropped(void) {
+    if (!s_part) return 0;
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    uint32_t n = s_dropped;
+    s_dropped = 0;
+    xSemaphoreGive(s_lock);
+    return n;
+}
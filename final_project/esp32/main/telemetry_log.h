@@ -0,0 +1,69 @@
+#ifndef TELEMETRY_LOG_H
+#define TELEMETRY_LOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "common_defs.h"
+
+// Trwały bufor telemetrii offline (log-structured ring buffer) na partycji danych "tlmlog".
+//
+// - Partycja dzielona jest na sektory 4 KB: nagłówek (magic, numer sekwencyjny sektora,
+//   licznik kasowań, CRC, flaga "sektor wysłany") + wpisy zmiennej długości.
+// - Wpis to blok rekordów skompresowany telemetry_tsz (delta-of-delta / XOR / RLE),
+//   z CRC i bitmapą "wysłane" (bity zerowane po kolei, bez kasowania sektora).
+// - Rekordy zbierane są w otwartym bloku w RAM; blok trafia na flash po
+//   CONFIG_TELEMETRY_LOG_BLOCK_RECORDS rekordach, gdy jest pełny lub gdy zaczyna się wysyłanie.
+//   Zanik zasilania traci tylko otwarty blok.
+// - Sektory zapisywane są po kolei w pierścieniu, więc każdy jest kasowany raz na obieg (równomierne zużycie).
+// - Przerwany zapis zostawia wpis z błędnym CRC / bez nagłówka, który jest pomijany.
+// - Gdy bufor jest pełny, najstarszy sektor jest nadpisywany (licznik w telemetry_log_take_dropped()).
+//
+// Funkcje są bezpieczne do wołania z wielu tasków.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TELEMETRY_LOG_PARTITION_LABEL "tlmlog"
+// Maksymalny rozmiar skompresowanego bloku (bufor dla telemetry_log_read_block())
+#define TELEMETRY_LOG_BLOCK_MAX_BYTES 512
+
+esp_err_t telemetry_log_init(void);
+
+// true jeśli partycja została znaleziona i bufor jest gotowy
+bool telemetry_log_is_ready(void);
+
+esp_err_t telemetry_log_append(const telemetry_data_t *rec);
+
+// Odczyt odbywa się po pozycjach absolutnych rekordów (liczonych od startu urządzenia),
+// dzięki czemu wysyłający może mieć w locie kilka fragmentów logu, a zwalnia je dopiero po potwierdzeniu.
+// Pozycje < telemetry_log_first() są już wysłane lub nadpisane.
+
+// Pozycja najstarszego niewysłanego rekordu
+uint32_t telemetry_log_first(void);
+
+// Rekord o pozycji `pos` (bez usuwania). Zwraca false gdy takiego rekordu nie ma (jeszcze lub już).
+bool telemetry_log_read(uint32_t pos, telemetry_data_t *out);
+
+// Blok zawierający rekord `pos` w postaci skompresowanej (do wysłania bez dekodowania).
+// Zwraca długość bloku (0 gdy brak lub nie mieści się w `cap`); `skip` = indeks rekordu `pos` w bloku,
+// więc blok kończy się na pozycji pos + count - skip.
+size_t telemetry_log_read_block(uint32_t pos, uint8_t *buf, size_t cap, uint16_t *count, uint16_t *skip);
+
+// Oznacza wszystkie rekordy o pozycjach < `upto` jako wysłane (już zwolnione / nadpisane są pomijane).
+esp_err_t telemetry_log_release(uint32_t upto);
+
+uint32_t telemetry_log_count(void);
+// Szacowana pojemność w rekordach (wg dotychczasowego współczynnika kompresji)
+uint32_t telemetry_log_capacity(void);
+
+// Liczba rekordów nadpisanych z powodu braku miejsca od ostatniego wywołania (licznik jest zerowany).
+uint32_t telemetry_log_take_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRY_LOG_H
@@ -0,0 +1,55 @@
+#include "telemetry_raw.h"
+
+#include <math.h>
+#include <string.h>
+
+_Static_assert(sizeof(telemetry_raw_rec_t) <= 24, "compact backlog record grew");
+
+static bool available(float v) {
+    return !isnan(v) && !isinf(v);
+}
+
+void telemetry_raw_pack(const telemetry_data_t *in, telemetry_raw_rec_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->timestamp = in->timestamp;
+    out->light_lux = in->light_lux;
+    out->soil_moisture = (int8_t)in->soil_moisture;
+    out->water_ok = (int8_t)in->water_ok;
+
+    if (in->bme_raw_pending) {
+        out->bme_kind = TELEMETRY_RAW_BME_RAW;
+        memcpy(out->bme.raw, in->bme_raw, sizeof(out->bme.raw));
+    } else if (available(in->temp) || available(in->humidity) || available(in->pressure)) {
+        out->bme_kind = TELEMETRY_RAW_BME_FIXED;
+        out->bme.fixed.temp_c100 = available(in->temp) ? (int16_t)lroundf(in->temp * 100.0f) : TELEMETRY_RAW_FIXED_NA_I16;
+        out->bme.fixed.hum_c100 = available(in->humidity) ? (uint16_t)lroundf(in->humidity * 100.0f) : TELEMETRY_RAW_FIXED_NA_U16;
+        out->bme.fixed.press_hpa100 = available(in->pressure) ? (uint32_t)lroundf(in->pressure * 100.0f) : TELEMETRY_RAW_FIXED_NA_U32;
+    } else {
+        out->bme_kind = TELEMETRY_RAW_BME_NONE;
+    }
+}
+
+void telemetry_raw_unpack(const telemetry_raw_rec_t *in, telemetry_data_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->timestamp = in->timestamp;
+    out->light_lux = in->light_lux;
+    out->soil_moisture = in->soil_moisture;
+    out->water_ok = in->water_ok;
+    out->temp = NAN;
+    out->humidity = NAN;
+    out->pressure = NAN;
+
+    switch (in->bme_kind) {
+        case TELEMETRY_RAW_BME_RAW:
+            out->bme_raw_pending = true;
+            memcpy(out->bme_raw, in->bme.raw, sizeof(out->bme_raw));
+            break;
+        case TELEMETRY_RAW_BME_FIXED:
+            if (in->bme.fixed.temp_c100 != TELEMETRY_RAW_FIXED_NA_I16) out->temp = in->bme.fixed.temp_c100 * 0.01f;
+            if (in->bme.fixed.hum_c100 != TELEMETRY_RAW_FIXED_NA_U16) out->humidity = in->bme.fixed.hum_c100 * 0.01f;
+            if (in->bme.fixed.press_hpa100 != TELEMETRY_RAW_FIXED_NA_U32) out->pressure = in->bme.fixed.press_hpa100 * 0.01f;
+            break;
+        default:
+            break;
+    }
+}
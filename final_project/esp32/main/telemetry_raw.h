@@ -0,0 +1,54 @@
+#ifndef TELEMETRY_RAW_H
+#define TELEMETRY_RAW_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "common_defs.h"
+
+// Zwarty rekord backlogu offline z surowym wynikiem BME280.
+//
+// Offline BME280 zapisuje tylko 8 bajtów z rejestrów 0xF7..0xFE (telemetry_data_t.bme_raw_pending),
+// a kompensacja liczona jest hurtem dopiero przy wysyłce (sensors_resolve_raw()). Rekord ma 24 B
+// zamiast sizeof(telemetry_data_t); wartości już obliczone (rekord złapany online, wysłany offline)
+// trzymane są w stałym przecinku z dokładnością telemetrii (0.01).
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    TELEMETRY_RAW_BME_NONE = 0, // brak danych BME280
+    TELEMETRY_RAW_BME_RAW,      // bme.raw - do kompensacji
+    TELEMETRY_RAW_BME_FIXED,    // bme.fixed - wartości * 100
+} telemetry_raw_bme_kind_t;
+
+#define TELEMETRY_RAW_FIXED_NA_I16 INT16_MIN
+#define TELEMETRY_RAW_FIXED_NA_U16 UINT16_MAX
+#define TELEMETRY_RAW_FIXED_NA_U32 UINT32_MAX
+
+typedef struct {
+    int64_t timestamp;
+    float light_lux;
+    union {
+        uint8_t raw[TELEMETRY_BME_RAW_SIZE];
+        struct {
+            int16_t temp_c100;
+            uint16_t hum_c100;
+            uint32_t press_hpa100;
+        } fixed;
+    } bme;
+    int8_t soil_moisture; // -1 = niedostępne
+    int8_t water_ok;
+    uint8_t bme_kind;     // telemetry_raw_bme_kind_t
+} telemetry_raw_rec_t;
+
+void telemetry_raw_pack(const telemetry_data_t *in, telemetry_raw_rec_t *out);
+
+// Rekordy z surowym BME280 wychodzą z bme_raw_pending = true (do sensors_resolve_raw()).
+void telemetry_raw_unpack(const telemetry_raw_rec_t *in, telemetry_data_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRY_RAW_H
@@ -0,0 +1,231 @@
+#include "telemetry_tsz.h"
+
+#include <string.h>
+
+static bool put_bits(telemetry_tsz_encoder_t *e, uint64_t v, unsigned n) {
+    if (e->bitpos + n > e->cap * 8) return false;
+    while (n > 0) {
+        size_t byte = e->bitpos >> 3;
+        unsigned room = 8 - (unsigned)(e->bitpos & 7);
+        unsigned take = n < room ? n : room;
+        uint8_t mask = (uint8_t)(((1u << take) - 1) << (room - take));
+        uint8_t bits = (uint8_t)(((v >> (n - take)) << (room - take)) & mask);
+        // Bity są przypisywane (nie OR), więc wycofanie rekordu = cofnięcie bitpos
+        e->buf[byte] = (uint8_t)((e->buf[byte] & ~mask) | bits);
+        e->bitpos += take;
+        n -= take;
+    }
+    return true;
+}
+
+static bool get_bits(telemetry_tsz_decoder_t *d, unsigned n, uint64_t *out) {
+    if (d->bitpos + n > d->len * 8) return false;
+    uint64_t v = 0;
+    while (n > 0) {
+        size_t byte = d->bitpos >> 3;
+        unsigned room = 8 - (unsigned)(d->bitpos & 7);
+        unsigned take = n < room ? n : room;
+        uint8_t bits = (uint8_t)((d->buf[byte] >> (room - take)) & ((1u << take) - 1));
+        v = (v << take) | bits;
+        d->bitpos += take;
+        n -= take;
+    }
+    *out = v;
+    return true;
+}
+
+static uint32_t float_bits(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    return u;
+}
+
+static float bits_float(uint32_t u) {
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static uint8_t soil_code(int soil) {
+    if (soil < 0) return 0;
+    if (soil > 254) return 255;
+    return (uint8_t)(soil + 1);
+}
+
+static bool put_timestamp(telemetry_tsz_encoder_t *e, int64_t ts) {
+    int64_t delta = (int64_t)((uint64_t)ts - (uint64_t)e->st.ts);
+    int64_t dod = (int64_t)((uint64_t)delta - (uint64_t)e->st.delta);
+    e->st.ts = ts;
+    e->st.delta = delta;
+
+    if (dod == 0) return put_bits(e, 0x0, 1);
+    if (dod >= -63 && dod <= 64) return put_bits(e, 0x2, 2) && put_bits(e, (uint64_t)(dod + 63), 7);
+    if (dod >= -255 && dod <= 256) return put_bits(e, 0x6, 3) && put_bits(e, (uint64_t)(dod + 255), 9);
+    if (dod >= -2047 && dod <= 2048) return put_bits(e, 0xE, 4) && put_bits(e, (uint64_t)(dod + 2047), 12);
+    return put_bits(e, 0xF, 4) && put_bits(e, (uint64_t)dod, 64);
+}
+
+static bool put_float(telemetry_tsz_encoder_t *e, int i, float value) {
+    uint32_t bits = float_bits(value);
+    uint32_t x = bits ^ e->st.f[i];
+    e->st.f[i] = bits;
+    if (x == 0) return put_bits(e, 0x0, 1);
+
+    unsigned lead = (unsigned)__builtin_clz(x);
+    unsigned trail = (unsigned)__builtin_ctz(x);
+    unsigned win_lead = e->st.lead[i];
+    unsigned win_len = e->st.len[i];
+
+    // Bity znaczące mieszczą się w poprzednim oknie
+    if (win_len > 0 && lead >= win_lead && trail >= 32 - win_lead - win_len) {
+        return put_bits(e, 0x2, 2) && put_bits(e, x >> (32 - win_lead - win_len), win_len);
+    }
+
+    unsigned len = 32 - lead - trail;
+    e->st.lead[i] = (uint8_t)lead;
+    e->st.len[i] = (uint8_t)len;
+    return put_bits(e, 0x3, 2) && put_bits(e, lead, 5) && put_bits(e, len - 1, 5) && put_bits(e, x >> trail, len);
+}
+
+void telemetry_tsz_encoder_init(telemetry_tsz_encoder_t *enc, uint8_t *buf, size_t cap) {
+    memset(enc, 0, sizeof(*enc));
+    enc->buf = buf;
+    enc->cap = cap;
+}
+
+bool telemetry_tsz_append(telemetry_tsz_encoder_t *enc, const telemetry_data_t *rec) {
+    telemetry_tsz_encoder_t saved = *enc;
+    const float values[4] = {rec->temp, rec->humidity, rec->pressure, rec->light_lux};
+    uint8_t soil = soil_code(rec->soil_moisture);
+    uint8_t water = rec->water_ok != 0;
+    bool ok = true;
+
+    if (enc->count == 0) {
+        ok = put_bits(enc, (uint64_t)rec->timestamp, 64);
+        enc->st.ts = rec->timestamp;
+        for (int i = 0; i < 4 && ok; i++) {
+            enc->st.f[i] = float_bits(values[i]);
+            ok = put_bits(enc, enc->st.f[i], 32);
+        }
+        ok = ok && put_bits(enc, soil, 8) && put_bits(enc, water, 1);
+    } else {
+        ok = put_timestamp(enc, rec->timestamp);
+        for (int i = 0; i < 4 && ok; i++) {
+            ok = put_float(enc, i, values[i]);
+        }
+        if (ok) ok = (soil == enc->st.soil) ? put_bits(enc, 0x0, 1) : (put_bits(enc, 0x1, 1) && put_bits(enc, soil, 8));
+        // Dla 1-bitowej wartości '1' oznacza zmianę stanu
+        if (ok) ok = put_bits(enc, water != enc->st.water, 1);
+    }
+
+    if (!ok || enc->count == UINT16_MAX) {
+        *enc = saved;
+        return false;
+    }
+    enc->st.soil = soil;
+    enc->st.water = water;
+    enc->count++;
+    return true;
+}
+
+size_t telemetry_tsz_size(const telemetry_tsz_encoder_t *enc) {
+    return (enc->bitpos + 7) / 8;
+}
+
+void telemetry_tsz_decoder_init(telemetry_tsz_decoder_t *dec, const uint8_t *buf, size_t len) {
+    memset(dec, 0, sizeof(*dec));
+    dec->buf = buf;
+    dec->len = len;
+}
+
+static bool get_timestamp(telemetry_tsz_decoder_t *d) {
+    uint64_t b = 0, v = 0;
+    int64_t dod;
+    if (!get_bits(d, 1, &b)) return false;
+    if (b == 0) {
+        dod = 0;
+    } else {
+        if (!get_bits(d, 1, &b)) return false;
+        if (b == 0) {
+            if (!get_bits(d, 7, &v)) return false;
+            dod = (int64_t)v - 63;
+        } else {
+            if (!get_bits(d, 1, &b)) return false;
+            if (b == 0) {
+                if (!get_bits(d, 9, &v)) return false;
+                dod = (int64_t)v - 255;
+            } else {
+                if (!get_bits(d, 1, &b)) return false;
+                if (b == 0) {
+                    if (!get_bits(d, 12, &v)) return false;
+                    dod = (int64_t)v - 2047;
+                } else {
+                    if (!get_bits(d, 64, &v)) return false;
+                    dod = (int64_t)v;
+                }
+            }
+        }
+    }
+    d->st.delta = (int64_t)((uint64_t)d->st.delta + (uint64_t)dod);
+    d->st.ts = (int64_t)((uint64_t)d->st.ts + (uint64_t)d->st.delta);
+    return true;
+}
+
+static bool get_float(telemetry_tsz_decoder_t *d, int i) {
+    uint64_t b = 0, v = 0;
+    if (!get_bits(d, 1, &b)) return false;
+    if (b == 0) return true;
+    if (!get_bits(d, 1, &b)) return false;
+    if (b == 1) {
+        uint64_t lead = 0, len = 0;
+        if (!get_bits(d, 5, &lead) || !get_bits(d, 5, &len)) return false;
+        d->st.lead[i] = (uint8_t)lead;
+        d->st.len[i] = (uint8_t)(len + 1);
+        if (d->st.lead[i] + d->st.len[i] > 32) return false;
+    } else if (d->st.len[i] == 0) {
+        return false;
+    }
+    if (!get_bits(d, d->st.len[i], &v)) return false;
+    d->st.f[i] ^= (uint32_t)v << (32 - d->st.lead[i] - d->st.len[i]);
+    return true;
+}
+
+bool telemetry_tsz_next(telemetry_tsz_decoder_t *dec, telemetry_data_t *out) {
+    uint64_t v = 0;
+
+    if (dec->index == 0) {
+        if (!get_bits(dec, 64, &v)) return false;
+        dec->st.ts = (int64_t)v;
+        for (int i = 0; i < 4; i++) {
+            if (!get_bits(dec, 32, &v)) return false;
+            dec->st.f[i] = (uint32_t)v;
+        }
+        if (!get_bits(dec, 8, &v)) return false;
+        dec->st.soil = (uint8_t)v;
+        if (!get_bits(dec, 1, &v)) return false;
+        dec->st.water = (uint8_t)v;
+    } else {
+        if (!get_timestamp(dec)) return false;
+        for (int i = 0; i < 4; i++) {
+            if (!get_float(dec, i)) return false;
+        }
+        if (!get_bits(dec, 1, &v)) return false;
+        if (v) {
+            if (!get_bits(dec, 8, &v)) return false;
+            dec->st.soil = (uint8_t)v;
+        }
+        if (!get_bits(dec, 1, &v)) return false;
+        if (v) dec->st.water ^= 1;
+    }
+
+    out->timestamp = dec->st.ts;
+    out->temp = bits_float(dec->st.f[0]);
+    out->humidity = bits_float(dec->st.f[1]);
+    out->pressure = bits_float(dec->st.f[2]);
+    out->light_lux = bits_float(dec->st.f[3]);
+    out->soil_moisture = (int)dec->st.soil - 1;
+    out->water_ok = dec->st.water;
+    out->bme_raw_pending = false; // w logu tylko wartości po kompensacji
+    dec->index++;
+    return true;
+}
@@ -0,0 +1,76 @@
+#ifndef TELEMETRY_TSZ_H
+#define TELEMETRY_TSZ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "common_defs.h"
+
+// Kompresja bloków telemetrii w stylu Gorilla (strumień bitów, MSB first).
+//
+// Pierwszy rekord bloku zapisywany jest w całości (ts 64 b, 4x float 32 b, soil 8 b, water 1 b).
+// Kolejne rekordy:
+// - timestamp: delta-of-delta: '0' | '10'+7 b | '110'+9 b | '1110'+12 b | '1111'+64 b
+// - temp/hum/press/lux: XOR z poprzednią wartością: '0' (bez zmian) |
+//   '10' + bity znaczące w poprzednim oknie | '11' + 5 b leading zeros + 5 b (długość-1) + bity
+// - soil: '0' = powtórzenie poprzedniej wartości (run-length), '1' + nowa wartość (8 b)
+// - water_ok: '0' = bez zmian, '1' = zmiana stanu
+//
+// Dekoder w backendzie: TelemetryTszDecoder.java (ten sam format).
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TELEMETRY_TSZ_VERSION 1
+#define TELEMETRY_TSZ_CONTENT_TYPE "application/vnd.smartgarden.telemetry-tsz.v1"
+
+// Nagłówek ramki MQTT (topic /telemetry/tsz): u8 version, u8 skip, u16 count (LE), u8 fields, potem bajty bloku.
+// `skip` = liczba początkowych rekordów bloku już wysłanych wcześniej (do pominięcia przez backend),
+// `fields` = pola mierzone przez urządzenie (TELEMETRY_FIELD_*); pozostałe backend traktuje jak null.
+#define TELEMETRY_TSZ_FRAME_HEADER_SIZE 5
+
+typedef struct {
+    int64_t ts;
+    int64_t delta;
+    uint32_t f[4];     // temp, humidity, pressure, light_lux (bity float)
+    uint8_t lead[4];   // okno bitów znaczących ostatniego XOR-a
+    uint8_t len[4];    // 0 = brak okna
+    uint8_t soil;      // soil_moisture + 1 (0 = niedostępne)
+    uint8_t water;
+} telemetry_tsz_state_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t bitpos;
+    uint16_t count;
+    telemetry_tsz_state_t st;
+} telemetry_tsz_encoder_t;
+
+typedef struct {
+    const uint8_t *buf;
+    size_t len;
+    size_t bitpos;
+    uint16_t index;
+    telemetry_tsz_state_t st;
+} telemetry_tsz_decoder_t;
+
+void telemetry_tsz_encoder_init(telemetry_tsz_encoder_t *enc, uint8_t *buf, size_t cap);
+
+// Dopisuje rekord; false gdy nie mieści się w buforze (enkoder pozostaje bez zmian).
+bool telemetry_tsz_append(telemetry_tsz_encoder_t *enc, const telemetry_data_t *rec);
+
+// Liczba zajętych bajtów bloku
+size_t telemetry_tsz_size(const telemetry_tsz_encoder_t *enc);
+
+void telemetry_tsz_decoder_init(telemetry_tsz_decoder_t *dec, const uint8_t *buf, size_t len);
+
+// Dekoduje kolejny rekord (wywołujący pilnuje liczby rekordów w bloku). false przy uszkodzonym bloku.
+bool telemetry_tsz_next(telemetry_tsz_decoder_t *dec, telemetry_data_t *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TELEMETRY_TSZ_H
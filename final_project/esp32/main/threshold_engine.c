@@ -0,0 +1,70 @@
+#include "threshold_engine.h"
+
+#include <math.h>
+#include <string.h>
+
+void threshold_engine_init(threshold_engine_t *eng, const threshold_rule_t *rules, threshold_state_t *state, size_t count) {
+    eng->rules = rules;
+    eng->state = state;
+    eng->count = count;
+    memset(state, 0, count * sizeof(*state));
+}
+
+size_t threshold_engine_eval(threshold_engine_t *eng, const float values[TELEMETRY_FIELD_COUNT], uint32_t now_ms,
+                             threshold_fire_cb_t cb, void *ctx) {
+    size_t fired = 0;
+    for (size_t i = 0; i < eng->count; i++) {
+        const threshold_rule_t *r = &eng->rules[i];
+        threshold_state_t *st = &eng->state[i];
+        float v = values[r->field];
+
+        // NaN w wartości albo limicie: porównania fałszywe - ani alert, ani powrót
+        bool gt = r->cmp == THRESHOLD_CMP_GT;
+        bool beyond = gt ? v > r->limit : v < r->limit;
+        bool back = gt ? v <= r->limit - r->hysteresis : v >= r->limit + r->hysteresis;
+
+        switch (st->phase) {
+            case THRESHOLD_ACTIVE:
+                if (back) st->phase = THRESHOLD_IDLE;
+                break;
+            case THRESHOLD_PENDING:
+                if (!beyond) {
+                    st->phase = THRESHOLD_IDLE;
+                    break;
+                }
+                // fall through
+            default:
+                if (!beyond || (r->flags & THRESHOLD_RULE_EXTERNAL)) break;
+                if (st->phase == THRESHOLD_IDLE) {
+                    st->phase = THRESHOLD_PENDING;
+                    st->since_ms = now_ms;
+                }
+                if (now_ms - st->since_ms >= r->dwell_ms) {
+                    st->phase = THRESHOLD_ACTIVE;
+                    fired++;
+                    if (cb) cb(r, v, ctx);
+                }
+                break;
+        }
+    }
+    return fired;
+}
+
+void threshold_engine_values(const telemetry_data_t *data, float values[TELEMETRY_FIELD_COUNT]) {
+    values[0] = data->soil_moisture >= 0 ? (float)data->soil_moisture : NAN; // TELEMETRY_FIELD_SOIL
+    values[1] = data->temp;                                                  // TELEMETRY_FIELD_TEMP
+    values[2] = data->humidity;                                              // TELEMETRY_FIELD_HUM
+    values[3] = data->pressure;                                              // TELEMETRY_FIELD_PRESS
+    values[4] = data->light_lux;                                             // TELEMETRY_FIELD_LIGHT
+    values[5] = data->water_ok >= 0 ? (float)data->water_ok : NAN;           // TELEMETRY_FIELD_WATER
+}
+
+bool threshold_engine_trigger(threshold_engine_t *eng, size_t rule) {
+    if (rule >= eng->count || eng->state[rule].phase == THRESHOLD_ACTIVE) return false;
+    eng->state[rule].phase = THRESHOLD_ACTIVE;
+    return true;
+}
+
+void threshold_engine_clear(threshold_engine_t *eng, size_t rule) {
+    if (rule < eng->count) eng->state[rule].phase = THRESHOLD_IDLE;
+}
@@ -0,0 +1,81 @@
+#ifndef THRESHOLD_ENGINE_H
+#define THRESHOLD_ENGINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "common_defs.h"
+
+// Progi telemetrii jako tabela reguł (pole, porównanie, limit, histereza, czas utrzymania, kod alertu).
+//
+// Reguła przechodzi w stan aktywny (jeden alert), gdy wartość jest za limitem nieprzerwanie przez
+// `dwell_ms`, a wraca do spoczynku dopiero, gdy cofnie się za limit o `hysteresis`. Wartość krążąca
+// wokół limitu daje więc jeden alert, a nie serię. Stan reguł to osobna, zwarta tablica
+// (threshold_state_t), ewaluowana jedną pętlą; komunikat alertu składany jest tylko przy zdarzeniu.
+//
+// Bez zależności od ESP-IDF; synchronizacja po stronie wywołującego.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    THRESHOLD_CMP_LT = 0, // alert gdy wartość < limit
+    THRESHOLD_CMP_GT,     // alert gdy wartość > limit
+} threshold_cmp_t;
+
+// Reguła z porównaniem w czujniku (np. progi VEML7700): próbki tylko kasują stan,
+// aktywuje ją threshold_engine_trigger()
+#define THRESHOLD_RULE_EXTERNAL (1u << 0)
+
+typedef struct {
+    uint8_t field;       // indeks bitu TELEMETRY_FIELD_*
+    uint8_t cmp;         // threshold_cmp_t
+    uint8_t flags;       // THRESHOLD_RULE_*
+    float limit;         // +-INFINITY/NaN = reguła wyłączona
+    float hysteresis;    // >= 0, w jednostkach pola
+    uint32_t dwell_ms;
+    const char *code;    // kod alertu (stała)
+    const char *fmt;     // komunikat: printf z (wartość, limit) jako double
+} threshold_rule_t;
+
+typedef enum {
+    THRESHOLD_IDLE = 0,
+    THRESHOLD_PENDING, // za limitem, czeka na dwell_ms
+    THRESHOLD_ACTIVE,  // alert wysłany
+} threshold_phase_t;
+
+typedef struct {
+    uint32_t since_ms; // początek PENDING
+    uint8_t phase;     // threshold_phase_t
+} threshold_state_t;
+
+typedef struct {
+    const threshold_rule_t *rules;
+    threshold_state_t *state;
+    size_t count;
+} threshold_engine_t;
+
+// Wołane przy przejściu reguły w stan aktywny
+typedef void (*threshold_fire_cb_t)(const threshold_rule_t *rule, float value, void *ctx);
+
+void threshold_engine_init(threshold_engine_t *eng, const threshold_rule_t *rules, threshold_state_t *state, size_t count);
+
+// Wartości pól (indeks = bit TELEMETRY_FIELD_*); NaN = niedostępne (reguła zachowuje stan aktywny,
+// kasuje tylko oczekiwanie). Zwraca liczbę alertów.
+size_t threshold_engine_eval(threshold_engine_t *eng, const float values[TELEMETRY_FIELD_COUNT], uint32_t now_ms,
+                             threshold_fire_cb_t cb, void *ctx);
+
+// Wartości pól z rekordu telemetrii (-1 dla gleby/wody => NaN)
+void threshold_engine_values(const telemetry_data_t *data, float values[TELEMETRY_FIELD_COUNT]);
+
+// Aktywacja z zewnątrz (zdarzenie z czujnika); true gdy reguła nie była aktywna (należy wysłać alert)
+bool threshold_engine_trigger(threshold_engine_t *eng, size_t rule);
+
+void threshold_engine_clear(threshold_engine_t *eng, size_t rule);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // THRESHOLD_ENGINE_H
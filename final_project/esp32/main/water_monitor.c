@@ -0,0 +1,125 @@
+#include "water_monitor.h"
+
+#include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_rom_sys.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+static const char *TAG = "WATER_MON";
+
+#define WATER_LEVEL_GPIO        GPIO_NUM_18
+#define WATER_SETTLE_US         50    // stabilizacja po włączeniu pull-upu
+#define WATER_DEBOUNCE_MS       CONFIG_WATER_DEBOUNCE_MS
+#define WATER_DEBOUNCE_STEP_MS  5
+#define WATER_DEBOUNCE_MAX_MS   (10 * WATER_DEBOUNCE_MS) // drgania dłuższe niż to: zostaje stary stan
+#define WATER_STROBE_PERIOD_MS  CONFIG_WATER_STROBE_PERIOD_MS
+#define WATER_TASK_STACK        4096  // alert publikowany synchronicznie (cJSON + esp-mqtt)
+#define WATER_TASK_PRIO         6     // wyżej niż pump_evt - odcięcie pompy ma pierwszeństwo
+
+static TaskHandle_t s_task = NULL;
+static volatile bool s_armed = false;
+static volatile bool s_empty = false;
+static volatile water_monitor_cb_t s_cb = NULL;
+
+static void IRAM_ATTR water_isr(void *arg) {
+    // Jedno powiadomienie na serię zboczy; przerwanie wraca po debounce
+    gpio_intr_disable(WATER_LEVEL_GPIO);
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(s_task, &woken);
+    portYIELD_FROM_ISR(woken);
+}
+
+static void pullup_on(void) {
+    gpio_set_pull_mode(WATER_LEVEL_GPIO, GPIO_PULLUP_ONLY);
+    esp_rom_delay_us(WATER_SETTLE_US);
+}
+
+static void pullup_off(void) {
+    gpio_set_pull_mode(WATER_LEVEL_GPIO, GPIO_FLOATING);
+}
+
+// Czy poziom `level` utrzymuje się przez WATER_DEBOUNCE_MS (pull-up włączony)
+static bool debounce_confirm(int level) {
+    const TickType_t step = pdMS_TO_TICKS(WATER_DEBOUNCE_STEP_MS) ? pdMS_TO_TICKS(WATER_DEBOUNCE_STEP_MS) : 1;
+    int64_t start = esp_timer_get_time();
+    int64_t stable_since = start;
+    while (1) {
+        int64_t now = esp_timer_get_time();
+        if (gpio_get_level(WATER_LEVEL_GPIO) != level) {
+            stable_since = now;
+        } else if (now - stable_since >= WATER_DEBOUNCE_MS * 1000LL) {
+            return true;
+        }
+        if (now - start >= WATER_DEBOUNCE_MAX_MS * 1000LL) return false;
+        vTaskDelay(step);
+    }
+}
+
+static void water_monitor_task(void *arg) {
+    while (1) {
+        bool armed = s_armed;
+        if (armed) {
+            pullup_on(); // pozostaje włączony
+            gpio_intr_enable(WATER_LEVEL_GPIO);
+            // Zmiana w czasie, gdy przerwanie było wyłączone, nie da już zbocza
+            if ((gpio_get_level(WATER_LEVEL_GPIO) == 1) != s_empty) xTaskNotifyGive(s_task);
+        }
+        // Wybudzenie: zbocze, zmiana trybu albo kolejna próbka w czuwaniu
+        ulTaskNotifyTake(pdTRUE, armed ? portMAX_DELAY : pdMS_TO_TICKS(WATER_STROBE_PERIOD_MS));
+        gpio_intr_disable(WATER_LEVEL_GPIO);
+
+        if (!s_armed) pullup_on();
+        int level = gpio_get_level(WATER_LEVEL_GPIO);
+        bool empty = (level == 1);
+        if (empty != s_empty && debounce_confirm(level)) {
+            s_empty = empty;
+            ESP_LOGW(TAG, "Zbiornik: %s", empty ? "PUSTY" : "woda OK");
+            water_monitor_cb_t cb = s_cb;
+            if (cb) cb(empty);
+        }
+        if (!s_armed) pullup_off();
+    }
+}
+
+esp_err_t water_monitor_start(void) {
+    if (s_task) return ESP_OK;
+
+    gpio_reset_pin(WATER_LEVEL_GPIO);
+    gpio_set_direction(WATER_LEVEL_GPIO, GPIO_MODE_INPUT);
+    gpio_set_intr_type(WATER_LEVEL_GPIO, GPIO_INTR_ANYEDGE);
+    gpio_intr_disable(WATER_LEVEL_GPIO);
+
+    // Stan początkowy (z debounce), zanim ktokolwiek zapyta
+    pullup_on();
+    int level = gpio_get_level(WATER_LEVEL_GPIO);
+    if (debounce_confirm(level)) s_empty = (level == 1);
+    pullup_off();
+
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) return err; // INVALID_STATE = już zainstalowany
+
+    if (xTaskCreate(water_monitor_task, "water_mon", WATER_TASK_STACK, NULL, WATER_TASK_PRIO, &s_task) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+    err = gpio_isr_handler_add(WATER_LEVEL_GPIO, water_isr, NULL);
+    if (err != ESP_OK) return err;
+
+    ESP_LOGI(TAG, "Monitor wody na GPIO %d (debounce %d ms, próbkowanie co %d ms), stan: %s",
+             WATER_LEVEL_GPIO, WATER_DEBOUNCE_MS, WATER_STROBE_PERIOD_MS, s_empty ? "PUSTY" : "OK");
+    return ESP_OK;
+}
+
+void water_monitor_set_callback(water_monitor_cb_t cb) {
+    s_cb = cb;
+}
+
+void water_monitor_set_armed(bool armed) {
+    s_armed = armed;
+    if (s_task) xTaskNotifyGive(s_task);
+}
+
+bool water_monitor_is_empty(void) {
+    return s_empty;
+}
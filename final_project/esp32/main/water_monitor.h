@@ -0,0 +1,39 @@
+#ifndef WATER_MONITOR_H
+#define WATER_MONITOR_H
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+// Monitor poziomu wody w zbiorniku (pływak na GPIO, pull-up wewnętrzny; 1 = brak wody).
+//
+// Dwa tryby:
+// - czuwanie (pompa wyłączona): pull-up włączany tylko na ~50 us co CONFIG_WATER_STROBE_PERIOD_MS,
+//   reszta czasu bez prądu przez pull-up;
+// - uzbrojony (pompa pracuje, water_monitor_set_armed(true)): pull-up na stałe i przerwanie na
+//   obu zboczach, więc opróżnienie zbiornika jest widoczne po czasie debounce, a nie po cyklu pomiarów.
+//
+// Każda zmiana stanu jest potwierdzana programowo (poziom stabilny przez CONFIG_WATER_DEBOUNCE_MS)
+// i zgłaszana callbackiem z taska water_mon.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// `empty` = nowy, potwierdzony stan zbiornika. Wywoływane z taska water_mon - bez długich operacji.
+typedef void (*water_monitor_cb_t)(bool empty);
+
+esp_err_t water_monitor_start(void);
+
+void water_monitor_set_callback(water_monitor_cb_t cb);
+
+// Uzbrojenie na czas pracy pompy (pull-up + przerwanie), rozbrojenie wraca do próbkowania
+void water_monitor_set_armed(bool armed);
+
+// Ostatni potwierdzony stan (bez dostępu do GPIO)
+bool water_monitor_is_empty(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WATER_MONITOR_H
@@ -0,0 +1,169 @@
+// Mikrobenchmark (host) kompensacji BME280: próbka po próbce, jak bmp280_read_fixed() +
+// bmp280_scale_*() w pętli pomiarowej, kontra bmp280_compensate_batch() na buforze surowych próbek.
+//
+// Sprawdza też zgodność: wyniki obu wersji muszą być identyczne bit w bit. Kod wyjścia != 0 przy różnicy.
+//
+// Budowanie i uruchomienie (z katalogu final_project/esp32):
+//   cc -O2 -Imain -o /tmp/bench_bme280_batch tools/bench_bme280_batch.c main/bmp280_comp.c
+//   /tmp/bench_bme280_batch
+//
+// Na x86 wynik w cyklach TSC, na innych hostach w ns. Kalibracja z przykładu w datasheecie BMP280
+// (wilgotność - typowe wartości BME280).
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "bmp280_comp.h"
+#include "bmp280_scale.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+static inline uint64_t bench_now(void) { return __rdtsc(); }
+#else
+#define BENCH_UNIT "ns"
+static inline uint64_t bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+#define BENCH_ROUNDS 32
+#define N_SAMPLES 4096
+
+// Kopiowane do s_cal w czasie działania - współczynniki nie mogą być stałymi kompilacji (na urządzeniu
+// też nie są), inaczej kompilator zwija je w wersji próbka po próbce.
+static const bmp280_calib_t k_cal = {
+    .T1 = 27504, .T2 = 26435, .T3 = -1000,
+    .P1 = 36477, .P2 = -10685, .P3 = 3024, .P4 = 2855, .P5 = 140, .P6 = -7, .P7 = 15500, .P8 = -14600, .P9 = 6000,
+    .H1 = 75, .H2 = 362, .H3 = 0, .H4 = 313, .H5 = 50, .H6 = 30,
+    .has_humidity = true,
+};
+
+static bmp280_calib_t s_cal;
+static uint8_t s_raw[N_SAMPLES * BMP280_RAW_SAMPLE_SIZE];
+static float s_ref_t[N_SAMPLES], s_ref_p[N_SAMPLES], s_ref_h[N_SAMPLES];
+static float s_new_t[N_SAMPLES], s_new_p[N_SAMPLES], s_new_h[N_SAMPLES];
+
+// --- Wersja próbka po próbce (skopiowana z esp-idf-lib bmp280.c) ---
+
+static int32_t ref_compensate_temperature(const bmp280_calib_t *dev, int32_t adc_temp, int32_t *fine_temp) {
+    int32_t var1, var2;
+    var1 = ((((adc_temp >> 3) - ((int32_t)dev->T1 << 1))) * (int32_t)dev->T2) >> 11;
+    var2 = (((((adc_temp >> 4) - (int32_t)dev->T1) * ((adc_temp >> 4) - (int32_t)dev->T1)) >> 12) * (int32_t)dev->T3) >> 14;
+    *fine_temp = var1 + var2;
+    return (*fine_temp * 5 + 128) >> 8;
+}
+
+static uint32_t ref_compensate_pressure(const bmp280_calib_t *dev, int32_t adc_press, int32_t fine_temp) {
+    int64_t var1, var2, p;
+    var1 = (int64_t)fine_temp - 128000;
+    var2 = var1 * var1 * (int64_t)dev->P6;
+    var2 = var2 + ((var1 * (int64_t)dev->P5) << 17);
+    var2 = var2 + (((int64_t)dev->P4) << 35);
+    var1 = ((var1 * var1 * (int64_t)dev->P3) >> 8) + ((var1 * (int64_t)dev->P2) << 12);
+    var1 = (((int64_t)1 << 47) + var1) * ((int64_t)dev->P1) >> 33;
+    if (var1 == 0) return 0;
+    p = 1048576 - adc_press;
+    p = (((p << 31) - var2) * 3125) / var1;
+    var1 = ((int64_t)dev->P9 * (p >> 13) * (p >> 13)) >> 25;
+    var2 = ((int64_t)dev->P8 * p) >> 19;
+    p = ((p + var1 + var2) >> 8) + ((int64_t)dev->P7 << 4);
+    return p;
+}
+
+static uint32_t ref_compensate_humidity(const bmp280_calib_t *dev, int32_t adc_hum, int32_t fine_temp) {
+    int32_t v;
+    v = fine_temp - (int32_t)76800;
+    v = ((((adc_hum << 14) - ((int32_t)dev->H4 << 20) - ((int32_t)dev->H5 * v)) + (int32_t)16384) >> 15) *
+        (((((((v * (int32_t)dev->H6) >> 10) * (((v * (int32_t)dev->H3) >> 11) + (int32_t)32768)) >> 10) + (int32_t)2097152) *
+              (int32_t)dev->H2 + 8192) >> 14);
+    v = v - (((((v >> 15) * (v >> 15)) >> 7) * (int32_t)dev->H1) >> 4);
+    v = v < 0 ? 0 : v;
+    v = v > 419430400 ? 419430400 : v;
+    return v >> 12;
+}
+
+// Osobne wywołanie na próbkę, jak bmp280_read_fixed() w pętli pomiarowej
+__attribute__((noinline)) static void ref_compensate_one(const bmp280_calib_t *cal, const uint8_t *data, float *t, float *p, float *h) {
+    int32_t adc_pressure = data[0] << 12 | data[1] << 4 | data[2] >> 4;
+    int32_t adc_temp = data[3] << 12 | data[4] << 4 | data[5] >> 4;
+    int32_t fine_temp;
+    int32_t t_fixed = ref_compensate_temperature(cal, adc_temp, &fine_temp);
+    uint32_t p_fixed = ref_compensate_pressure(cal, adc_pressure, fine_temp);
+    uint32_t h_fixed = ref_compensate_humidity(cal, data[6] << 8 | data[7], fine_temp);
+    *t = bmp280_scale_temperature_c(t_fixed);
+    *p = bmp280_scale_pressure_hpa(p_fixed);
+    *h = bmp280_scale_humidity(h_fixed);
+}
+
+static void ref_compensate_all(void) {
+    for (size_t i = 0; i < N_SAMPLES; i++) {
+        ref_compensate_one(&s_cal, &s_raw[i * BMP280_RAW_SAMPLE_SIZE], &s_ref_t[i], &s_ref_p[i], &s_ref_h[i]);
+    }
+}
+
+static void new_compensate_all(void) {
+    bmp280_compensate_batch(&s_cal, s_raw, N_SAMPLES, s_new_t, s_new_p, s_new_h);
+}
+
+// Próbki z zakresu pracy czujnika (ok. -10..45 degC, 850..1100 hPa, cała skala wilgotności)
+static void fill_samples(void) {
+    uint32_t x = 12345;
+    for (size_t i = 0; i < N_SAMPLES; i++) {
+        x = x * 1664525u + 1013904223u;
+        uint32_t adc_t = 480000 + (x >> 8) % 90000;
+        x = x * 1664525u + 1013904223u;
+        uint32_t adc_p = 300000 + (x >> 8) % 200000;
+        x = x * 1664525u + 1013904223u;
+        uint32_t adc_h = (x >> 8) & 0xFFFF;
+        uint8_t *r = &s_raw[i * BMP280_RAW_SAMPLE_SIZE];
+        r[0] = (uint8_t)(adc_p >> 12); r[1] = (uint8_t)(adc_p >> 4); r[2] = (uint8_t)(adc_p << 4);
+        r[3] = (uint8_t)(adc_t >> 12); r[4] = (uint8_t)(adc_t >> 4); r[5] = (uint8_t)(adc_t << 4);
+        r[6] = (uint8_t)(adc_h >> 8);  r[7] = (uint8_t)adc_h;
+    }
+}
+
+static int check_equal(void) {
+    ref_compensate_all();
+    new_compensate_all();
+    size_t diff = 0;
+    for (size_t i = 0; i < N_SAMPLES; i++) {
+        if (memcmp(&s_ref_t[i], &s_new_t[i], sizeof(float)) || memcmp(&s_ref_p[i], &s_new_p[i], sizeof(float)) ||
+            memcmp(&s_ref_h[i], &s_new_h[i], sizeof(float))) {
+            if (diff++ == 0) {
+                printf("sample %zu: ref %.2f/%.4f/%.3f batch %.2f/%.4f/%.3f\n", i, s_ref_t[i], s_ref_p[i], s_ref_h[i],
+                       s_new_t[i], s_new_p[i], s_new_h[i]);
+            }
+        }
+    }
+    printf("bme280 batch vs per-sample: %zu of %d samples differ\n", diff, N_SAMPLES);
+    return diff != 0;
+}
+
+static double bench(void (*fn)(void)) {
+    uint64_t best = UINT64_MAX;
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint64_t t0 = bench_now();
+        fn();
+        uint64_t dt = bench_now() - t0;
+        if (dt < best) best = dt;
+    }
+    return (double)best / N_SAMPLES;
+}
+
+int main(void) {
+    s_cal = k_cal;
+    fill_samples();
+    int failed = check_equal();
+
+    double ref = bench(ref_compensate_all);
+    double batch = bench(new_compensate_all);
+
+    printf("\n%-32s %10s %10s %8s\n", "compensation [" BENCH_UNIT "/sample]", "per-sample", "batch", "speedup");
+    printf("%-32s %10.1f %10.1f %7.2fx\n", "bme280 raw -> degC/hPa/%RH", ref, batch, ref / batch);
+    return failed;
+}
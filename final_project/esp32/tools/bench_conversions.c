@@ -0,0 +1,193 @@
+// Mikrobenchmark (host) konwersji VEML7700 RAW -> lux i skalowania BME280: wersja poprzednia
+// (double + pow(), dzielenia float) kontra kernel float z veml7700_lux.h i bmp280_scale.h.
+//
+// Sprawdza też zgodność: dla wszystkich RAW x gain x IT względna różnica lux <= 1e-6,
+// skalowanie BME280 bit w bit jak poprzednio. Kod wyjścia != 0 przy przekroczeniu.
+//
+// Budowanie i uruchomienie (z katalogu final_project/esp32):
+//   cc -O2 -Icomponents/veml7700/include -Imain -o /tmp/bench_conversions tools/bench_conversions.c -lm
+//   /tmp/bench_conversions
+//
+// Na x86 wynik w cyklach TSC, na innych hostach w ns. Host ma sprzętowe double, więc zysk
+// jest tu mniejszy niż na ESP32 (double emulowany programowo) - liczby służą do porównania wersji.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "veml7700_lux.h"
+#include "bmp280_scale.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+static inline uint64_t bench_now(void) { return __rdtsc(); }
+#else
+#define BENCH_UNIT "ns"
+static inline uint64_t bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+#define BENCH_ROUNDS 8
+#define LUX_REL_TOLERANCE 1e-6
+
+static const veml7700_gain_t k_gains[] = { VEML7700_GAIN_1, VEML7700_GAIN_2, VEML7700_GAIN_1_8, VEML7700_GAIN_1_4 };
+static const veml7700_it_t k_its[] = { VEML7700_IT_25MS, VEML7700_IT_50MS, VEML7700_IT_100MS,
+                                       VEML7700_IT_200MS, VEML7700_IT_400MS, VEML7700_IT_800MS };
+#define N_GAINS (sizeof(k_gains) / sizeof(k_gains[0]))
+#define N_ITS (sizeof(k_its) / sizeof(k_its[0]))
+
+static volatile float s_sink_f;
+static volatile double s_sink_d;
+
+// --- Wersja poprzednia (skopiowana z veml7700.c / sensors.c przed zmianą) ---
+
+static double ref_get_resolution(veml7700_gain_t gain, veml7700_it_t it) {
+    double gain_factor = 1.0;
+    switch (gain) {
+        case VEML7700_GAIN_2:   gain_factor = 2.0;   break;
+        case VEML7700_GAIN_1:   gain_factor = 1.0;   break;
+        case VEML7700_GAIN_1_4: gain_factor = 0.25;  break;
+        case VEML7700_GAIN_1_8: gain_factor = 0.125; break;
+    }
+    double it_ms = 100.0;
+    switch (it) {
+        case VEML7700_IT_25MS:  it_ms = 25.0;  break;
+        case VEML7700_IT_50MS:  it_ms = 50.0;  break;
+        case VEML7700_IT_100MS: it_ms = 100.0; break;
+        case VEML7700_IT_200MS: it_ms = 200.0; break;
+        case VEML7700_IT_400MS: it_ms = 400.0; break;
+        case VEML7700_IT_800MS: it_ms = 800.0; break;
+    }
+    return 0.0042 * (800.0 / it_ms) * (2.0 / gain_factor);
+}
+
+static double ref_raw_to_lux(uint16_t raw, veml7700_gain_t gain, veml7700_it_t it) {
+    double lux_linear = raw * ref_get_resolution(gain, it);
+    return (6.0135e-13 * pow(lux_linear, 4)) + (-9.3924e-9 * pow(lux_linear, 3)) +
+           (8.1488e-5 * pow(lux_linear, 2)) + (1.0023 * lux_linear);
+}
+
+static void ref_bme_scale(int32_t t, uint32_t p, uint32_t h, float *tc, float *phpa, float *rh) {
+    float pressure = (float)p / 256;
+    *tc = (float)t / 100;
+    *phpa = pressure / 100.0f;
+    *rh = (float)h / 1024;
+}
+
+static void new_bme_scale(int32_t t, uint32_t p, uint32_t h, float *tc, float *phpa, float *rh) {
+    *tc = bmp280_scale_temperature_c(t);
+    *phpa = bmp280_scale_pressure_hpa(p);
+    *rh = bmp280_scale_humidity(h);
+}
+
+static int ulp_diff(float a, float b) {
+    if (a == b) return 0;
+    union { float f; int32_t i; } ua = { a }, ub = { b };
+    int32_t d = ua.i - ub.i;
+    return d < 0 ? -d : d;
+}
+
+// --- Zgodność ---
+
+static int check_veml(void) {
+    double worst = 0.0;
+    for (size_t g = 0; g < N_GAINS; g++) {
+        for (size_t i = 0; i < N_ITS; i++) {
+            for (uint32_t raw = 1; raw <= 0xFFFF; raw++) {
+                double ref = ref_raw_to_lux((uint16_t)raw, k_gains[g], k_its[i]);
+                double fast = veml7700_raw_to_lux_f((uint16_t)raw, k_gains[g], k_its[i]);
+                double rel = fabs(fast - ref) / ref;
+                if (rel > worst) worst = rel;
+            }
+        }
+    }
+    printf("veml7700 lux: max relative error %.3g (limit %.0e)\n", worst, LUX_REL_TOLERANCE);
+    return worst <= LUX_REL_TOLERANCE ? 0 : 1;
+}
+
+static int check_bme(void) {
+    int worst = 0;
+    // Zakresy typowe dla wyników kompensacji: -40..85 degC, 300..1100 hPa, 0..100 %RH
+    for (int32_t k = 0; k < 1000000; k++) {
+        int32_t t = -4000 + (int32_t)(k % 12501);
+        uint32_t p = 30000u * 256u + (uint32_t)k * 21u;
+        uint32_t h = (uint32_t)(k % 102401);
+        float rt, rp, rh, nt, np, nh;
+        ref_bme_scale(t, p, h, &rt, &rp, &rh);
+        new_bme_scale(t, p, h, &nt, &np, &nh);
+        int d = ulp_diff(rt, nt);
+        if (ulp_diff(rp, np) > d) d = ulp_diff(rp, np);
+        if (ulp_diff(rh, nh) > d) d = ulp_diff(rh, nh);
+        if (d > worst) worst = d;
+    }
+    printf("bme280 scale: max difference %d ULP (limit 0)\n", worst);
+    return worst == 0 ? 0 : 1;
+}
+
+// --- Czas ---
+
+static double bench_veml_ref(void) {
+    uint64_t best = UINT64_MAX;
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint64_t t0 = bench_now();
+        for (size_t g = 0; g < N_GAINS; g++) {
+            for (size_t i = 0; i < N_ITS; i++) {
+                for (uint32_t raw = 0; raw <= 0xFFFF; raw += 7) s_sink_d = ref_raw_to_lux((uint16_t)raw, k_gains[g], k_its[i]);
+            }
+        }
+        uint64_t dt = bench_now() - t0;
+        if (dt < best) best = dt;
+    }
+    return (double)best / (N_GAINS * N_ITS * (0xFFFF / 7 + 1));
+}
+
+static double bench_veml_fast(void) {
+    uint64_t best = UINT64_MAX;
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint64_t t0 = bench_now();
+        for (size_t g = 0; g < N_GAINS; g++) {
+            for (size_t i = 0; i < N_ITS; i++) {
+                for (uint32_t raw = 0; raw <= 0xFFFF; raw += 7) s_sink_f = veml7700_raw_to_lux_f((uint16_t)raw, k_gains[g], k_its[i]);
+            }
+        }
+        uint64_t dt = bench_now() - t0;
+        if (dt < best) best = dt;
+    }
+    return (double)best / (N_GAINS * N_ITS * (0xFFFF / 7 + 1));
+}
+
+#define BME_ITERS 1000000
+
+static double bench_bme(void (*scale)(int32_t, uint32_t, uint32_t, float *, float *, float *)) {
+    uint64_t best = UINT64_MAX;
+    float t, p, h;
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint64_t t0 = bench_now();
+        for (int32_t k = 0; k < BME_ITERS; k++) {
+            scale(2000 + (k & 1023), 25600000u + (uint32_t)k, 40960u + (uint32_t)(k & 4095), &t, &p, &h);
+            s_sink_f = t + p + h;
+        }
+        uint64_t dt = bench_now() - t0;
+        if (dt < best) best = dt;
+    }
+    return (double)best / BME_ITERS;
+}
+
+int main(void) {
+    int failed = check_veml() | check_bme();
+
+    double veml_ref = bench_veml_ref();
+    double veml_fast = bench_veml_fast();
+    double bme_ref = bench_bme(ref_bme_scale);
+    double bme_fast = bench_bme(new_bme_scale);
+
+    printf("\n%-32s %10s %10s %8s\n", "conversion [" BENCH_UNIT "/call]", "before", "after", "speedup");
+    printf("%-32s %10.1f %10.1f %7.1fx\n", "veml7700 raw -> lux", veml_ref, veml_fast, veml_ref / veml_fast);
+    printf("%-32s %10.1f %10.1f %7.1fx\n", "bme280 fixed -> degC/hPa/%RH", bme_ref, bme_fast, bme_ref / bme_fast);
+    return failed;
+}
@@ -0,0 +1,377 @@
+// Mikrobenchmark (host) serializacji JSON w ścieżkach publikacji: drzewo cJSON + cJSON_PrintUnformatted
+// (wersja poprzednia) kontra json_writer do bufora na stosie. Trzy wiadomości jak w mqtt_app.c:
+// telemetria, capabilities i alert z `details`.
+//
+// Sprawdza też zgodność: wynik obu wersji musi być identyczny bajt w bajt. Kod wyjścia != 0 przy różnicy.
+// Sterta cJSON liczona przez cJSON_InitHooks: alokacje na wiadomość i szczytowe zajęcie (bez nagłówków
+// alokatora). json_writer nie używa sterty - tylko bufor na stosie o rozmiarze jak w mqtt_app.c.
+//
+// Budowanie i uruchomienie (z katalogu final_project/esp32, cJSON z ESP-IDF - komponent json):
+//   C=$IDF_PATH/components/json/cJSON
+//   cc -O2 -Imain -I$C -o /tmp/bench_json_writer tools/bench_json_writer.c main/json_writer.c $C/cJSON.c -lm
+//   /tmp/bench_json_writer
+//
+// Na x86 wynik w cyklach TSC, na innych hostach w ns. malloc hosta jest szybszy niż heap_caps na ESP32,
+// więc zysk na urządzeniu jest większy niż tutaj - liczby służą do porównania wersji.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cJSON.h"
+#include "json_writer.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+static inline uint64_t bench_now(void) { return __rdtsc(); }
+#else
+#define BENCH_UNIT "ns"
+static inline uint64_t bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+#define BENCH_ROUNDS 8
+#define BENCH_ITERS 20000
+
+// Rozmiary buforów jak w mqtt_app.c
+#define TELEMETRY_JSON_BUF_SIZE 384
+#define CAPABILITIES_JSON_BUF_SIZE 896
+#define ALERT_JSON_BUF_SIZE 1024
+
+static volatile size_t s_sink;
+
+// --- Licznik sterty (hooki cJSON) ---
+
+typedef struct {
+    size_t size;
+    size_t pad; // wyrównanie danych do 16 B
+} alloc_hdr_t;
+
+static size_t s_heap_now, s_heap_peak, s_allocs;
+
+static void *count_malloc(size_t size) {
+    alloc_hdr_t *h = malloc(sizeof(*h) + size);
+    if (!h) return NULL;
+    h->size = size;
+    s_heap_now += size;
+    if (s_heap_now > s_heap_peak) s_heap_peak = s_heap_now;
+    s_allocs++;
+    return h + 1;
+}
+
+static void count_free(void *p) {
+    if (!p) return;
+    alloc_hdr_t *h = (alloc_hdr_t *)p - 1;
+    s_heap_now -= h->size;
+    free(h);
+}
+
+static void heap_reset(void) {
+    s_heap_now = 0;
+    s_heap_peak = 0;
+    s_allocs = 0;
+}
+
+// --- Dane wejściowe (typowe wartości z urządzenia) ---
+
+typedef struct {
+    int64_t timestamp;
+    int soil;
+    double temp, humidity, pressure, lux;
+    bool water_ok;
+} sample_t;
+
+#define N_SAMPLES 64
+static sample_t s_samples[N_SAMPLES];
+
+static const char *k_device = "A1B2C3D4E5F6";
+static const char *k_user = "3f6c2a8e-4b1d-4c7e-9a0f-5d2e8b7c1a94";
+static const char *k_alert_details = "{\"requested\":120,\"used\":60,\"suppressed\":3,\"zone\":0,\"source\":\"manual\"}";
+
+static double round2(double v) {
+    return round(v * 100.0) / 100.0;
+}
+
+static void make_samples(void) {
+    for (int i = 0; i < N_SAMPLES; i++) {
+        s_samples[i] = (sample_t){
+            .timestamp = 1760000000000LL + (int64_t)i * 60000,
+            .soil = 35 + (i % 7),
+            .temp = 21.0 + 0.173 * (i % 11),
+            .humidity = 48.0 + 0.61 * (i % 13),
+            .pressure = 1013.25 - 0.07 * i,
+            .lux = 12000.0 + 37.5 * i,
+            .water_ok = (i % 17) != 0,
+        };
+    }
+}
+
+// --- Wersja poprzednia (cJSON, jak w mqtt_app.c przed zmianą) ---
+
+static char *ref_telemetry(const sample_t *s) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "device", k_device);
+    cJSON_AddStringToObject(root, "user", k_user);
+    cJSON_AddNumberToObject(root, "timestamp", (double)s->timestamp);
+
+    cJSON *sensors = cJSON_CreateObject();
+    cJSON_AddNumberToObject(sensors, "soil_moisture_pct", s->soil);
+    cJSON_AddNumberToObject(sensors, "air_temperature_c", round2(s->temp));
+    cJSON_AddNumberToObject(sensors, "air_humidity_pct", round2(s->humidity));
+    cJSON_AddNumberToObject(sensors, "pressure_hpa", round2(s->pressure));
+    cJSON_AddNumberToObject(sensors, "light_lux", round2(s->lux));
+    cJSON_AddBoolToObject(sensors, "water_tank_ok", s->water_ok);
+    cJSON_AddItemToObject(root, "sensors", sensors);
+
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json;
+}
+
+static char *ref_capabilities(int64_t ts) {
+    static const char *const fields[] = { "soil_moisture_pct", "air_temperature_c", "air_humidity_pct",
+                                          "pressure_hpa", "light_lux", "water_tank_ok" };
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "device", k_device);
+    cJSON_AddStringToObject(root, "user", k_user);
+    cJSON_AddNumberToObject(root, "timestamp", (double)ts);
+
+    cJSON *arr = cJSON_CreateArray();
+    for (int i = 0; i < 6; i++) cJSON_AddItemToArray(arr, cJSON_CreateString(fields[i]));
+    cJSON_AddItemToObject(root, "fields", arr);
+
+    cJSON *measured = cJSON_CreateObject();
+    for (int i = 0; i < 6; i++) cJSON_AddBoolToObject(measured, fields[i], i != 3);
+    cJSON_AddItemToObject(root, "measured", measured);
+
+    cJSON *enc = cJSON_CreateArray();
+    cJSON_AddItemToArray(enc, cJSON_CreateString("json"));
+    cJSON_AddItemToArray(enc, cJSON_CreateString("binary"));
+    cJSON_AddItemToArray(enc, cJSON_CreateString("tsz"));
+    cJSON_AddItemToObject(root, "encodings", enc);
+    cJSON_AddStringToObject(root, "telemetry_encoding", "json");
+    cJSON_AddStringToObject(root, "telemetry_content_type", "application/json");
+
+    cJSON *stats = cJSON_CreateObject();
+    cJSON_AddNumberToObject(stats, "messages", 18231);
+    cJSON_AddNumberToObject(stats, "payload_bytes", 4093112);
+    cJSON_AddNumberToObject(stats, "topic_bytes", 731904);
+    cJSON_AddNumberToObject(stats, "alias_saved_bytes", 0);
+    cJSON_AddItemToObject(root, "mqtt_stats", stats);
+
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json;
+}
+
+static char *ref_alert(int64_t ts) {
+    cJSON *root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "device", k_device);
+    cJSON_AddStringToObject(root, "user", k_user);
+    cJSON_AddNumberToObject(root, "timestamp", (double)ts);
+    cJSON_AddStringToObject(root, "type", "command.watering_duration_clamped");
+    cJSON_AddStringToObject(root, "msg", "Watering duration clamped");
+    cJSON_AddStringToObject(root, "code", "command.watering_duration_clamped");
+    cJSON_AddStringToObject(root, "severity", "warning");
+    cJSON_AddStringToObject(root, "subsystem", "command");
+    cJSON_AddStringToObject(root, "message", "Watering duration clamped");
+
+    cJSON *details = cJSON_Parse(k_alert_details);
+    if (cJSON_IsObject(details)) {
+        cJSON_AddItemToObject(root, "details", details);
+    } else {
+        if (details) cJSON_Delete(details);
+        cJSON_AddNullToObject(root, "details");
+    }
+
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+    return json;
+}
+
+// --- Wersja nowa (json_writer, jak w mqtt_app.c) ---
+
+static size_t new_telemetry(const sample_t *s, char *buf, size_t cap) {
+    json_writer_t w;
+    json_writer_init(&w, buf, cap);
+    json_writer_begin_object(&w, NULL);
+    json_writer_string(&w, "device", k_device);
+    json_writer_string(&w, "user", k_user);
+    json_writer_int64(&w, "timestamp", s->timestamp);
+
+    json_writer_begin_object(&w, "sensors");
+    json_writer_int64(&w, "soil_moisture_pct", s->soil);
+    json_writer_number(&w, "air_temperature_c", round2(s->temp));
+    json_writer_number(&w, "air_humidity_pct", round2(s->humidity));
+    json_writer_number(&w, "pressure_hpa", round2(s->pressure));
+    json_writer_number(&w, "light_lux", round2(s->lux));
+    json_writer_bool(&w, "water_tank_ok", s->water_ok);
+    json_writer_end_object(&w);
+    json_writer_end_object(&w);
+
+    size_t len = 0;
+    return json_writer_finish(&w, &len) ? len : 0;
+}
+
+static size_t new_capabilities(int64_t ts, char *buf, size_t cap) {
+    static const char *const fields[] = { "soil_moisture_pct", "air_temperature_c", "air_humidity_pct",
+                                          "pressure_hpa", "light_lux", "water_tank_ok" };
+    json_writer_t w;
+    json_writer_init(&w, buf, cap);
+    json_writer_begin_object(&w, NULL);
+    json_writer_string(&w, "device", k_device);
+    json_writer_string(&w, "user", k_user);
+    json_writer_int64(&w, "timestamp", ts);
+
+    json_writer_begin_array(&w, "fields");
+    for (int i = 0; i < 6; i++) json_writer_string(&w, NULL, fields[i]);
+    json_writer_end_array(&w);
+
+    json_writer_begin_object(&w, "measured");
+    for (int i = 0; i < 6; i++) json_writer_bool(&w, fields[i], i != 3);
+    json_writer_end_object(&w);
+
+    json_writer_begin_array(&w, "encodings");
+    json_writer_string(&w, NULL, "json");
+    json_writer_string(&w, NULL, "binary");
+    json_writer_string(&w, NULL, "tsz");
+    json_writer_end_array(&w);
+    json_writer_string(&w, "telemetry_encoding", "json");
+    json_writer_string(&w, "telemetry_content_type", "application/json");
+
+    json_writer_begin_object(&w, "mqtt_stats");
+    json_writer_int64(&w, "messages", 18231);
+    json_writer_int64(&w, "payload_bytes", 4093112);
+    json_writer_int64(&w, "topic_bytes", 731904);
+    json_writer_int64(&w, "alias_saved_bytes", 0);
+    json_writer_end_object(&w);
+    json_writer_end_object(&w);
+
+    size_t len = 0;
+    return json_writer_finish(&w, &len) ? len : 0;
+}
+
+static size_t new_alert(int64_t ts, char *buf, size_t cap) {
+    json_writer_t w;
+    json_writer_init(&w, buf, cap);
+    json_writer_begin_object(&w, NULL);
+    json_writer_string(&w, "device", k_device);
+    json_writer_string(&w, "user", k_user);
+    json_writer_int64(&w, "timestamp", ts);
+    json_writer_string(&w, "type", "command.watering_duration_clamped");
+    json_writer_string(&w, "msg", "Watering duration clamped");
+    json_writer_string(&w, "code", "command.watering_duration_clamped");
+    json_writer_string(&w, "severity", "warning");
+    json_writer_string(&w, "subsystem", "command");
+    json_writer_string(&w, "message", "Watering duration clamped");
+    json_writer_raw_object(&w, "details", k_alert_details);
+    json_writer_end_object(&w);
+
+    size_t len = 0;
+    return json_writer_finish(&w, &len) ? len : 0;
+}
+
+// --- Zgodność ---
+
+static int check_same(const char *name, char *ref, const char *buf, size_t len) {
+    int bad = !ref || strlen(ref) != len || memcmp(ref, buf, len) != 0;
+    if (bad) printf("%s: MISMATCH\n  cJSON:       %s\n  json_writer: %.*s\n", name, ref ? ref : "(null)", (int)len, buf);
+    cJSON_free(ref);
+    return bad;
+}
+
+static int check_outputs(void) {
+    int failed = 0;
+    char buf[ALERT_JSON_BUF_SIZE];
+    for (int i = 0; i < N_SAMPLES; i++) {
+        size_t len = new_telemetry(&s_samples[i], buf, TELEMETRY_JSON_BUF_SIZE);
+        failed |= check_same("telemetry", ref_telemetry(&s_samples[i]), buf, len);
+    }
+    size_t len = new_capabilities(s_samples[0].timestamp, buf, CAPABILITIES_JSON_BUF_SIZE);
+    failed |= check_same("capabilities", ref_capabilities(s_samples[0].timestamp), buf, len);
+    len = new_alert(s_samples[0].timestamp, buf, ALERT_JSON_BUF_SIZE);
+    failed |= check_same("alert", ref_alert(s_samples[0].timestamp), buf, len);
+    printf("output: %s\n", failed ? "DIFFERENT" : "byte-identical (telemetry x64, capabilities, alert)");
+    return failed;
+}
+
+// --- Czas i sterta ---
+
+typedef enum { MSG_TELEMETRY, MSG_CAPABILITIES, MSG_ALERT, MSG_COUNT } msg_t;
+
+static const char *const k_msg_names[MSG_COUNT] = { "telemetry", "capabilities", "alert (details)" };
+static const size_t k_msg_buf[MSG_COUNT] = { TELEMETRY_JSON_BUF_SIZE, CAPABILITIES_JSON_BUF_SIZE, ALERT_JSON_BUF_SIZE };
+
+typedef struct {
+    double per_call;
+    size_t allocs;
+    size_t peak;
+} result_t;
+
+static void run_ref(msg_t m, int k) {
+    char *json = NULL;
+    const sample_t *s = &s_samples[k % N_SAMPLES];
+    switch (m) {
+        case MSG_TELEMETRY: json = ref_telemetry(s); break;
+        case MSG_CAPABILITIES: json = ref_capabilities(s->timestamp); break;
+        default: json = ref_alert(s->timestamp); break;
+    }
+    s_sink = strlen(json);
+    cJSON_free(json);
+}
+
+static void run_new(msg_t m, int k) {
+    char buf[ALERT_JSON_BUF_SIZE];
+    const sample_t *s = &s_samples[k % N_SAMPLES];
+    switch (m) {
+        case MSG_TELEMETRY: s_sink = new_telemetry(s, buf, k_msg_buf[m]); break;
+        case MSG_CAPABILITIES: s_sink = new_capabilities(s->timestamp, buf, k_msg_buf[m]); break;
+        default: s_sink = new_alert(s->timestamp, buf, k_msg_buf[m]); break;
+    }
+}
+
+static result_t bench(void (*run)(msg_t, int), msg_t m) {
+    result_t r = { .per_call = 0 };
+    heap_reset();
+    run(m, 0);
+    r.allocs = s_allocs;
+    r.peak = s_heap_peak;
+
+    uint64_t best = UINT64_MAX;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t t0 = bench_now();
+        for (int k = 0; k < BENCH_ITERS; k++) run(m, k);
+        uint64_t dt = bench_now() - t0;
+        if (dt < best) best = dt;
+    }
+    r.per_call = (double)best / BENCH_ITERS;
+    return r;
+}
+
+int main(void) {
+    cJSON_Hooks hooks = { .malloc_fn = count_malloc, .free_fn = count_free };
+    cJSON_InitHooks(&hooks);
+    make_samples();
+
+    int failed = check_outputs();
+
+    printf("\n%-18s %12s %12s %8s %14s %14s\n", "message", "cJSON", "json_writer", "speedup", "cJSON allocs", "cJSON peak B");
+    printf("%-18s %12s %12s %8s %14s %14s\n", "", "[" BENCH_UNIT "]", "[" BENCH_UNIT "]", "", "", "");
+    for (int m = 0; m < MSG_COUNT; m++) {
+        result_t ref = bench(run_ref, (msg_t)m);
+        result_t fast = bench(run_new, (msg_t)m);
+        printf("%-18s %12.0f %12.0f %7.1fx %14zu %14zu\n", k_msg_names[m], ref.per_call, fast.per_call,
+               ref.per_call / fast.per_call, ref.allocs, ref.peak);
+    }
+    printf("\njson_writer stack buffers: telemetry %d B, capabilities %d B, alert %d B\n",
+           TELEMETRY_JSON_BUF_SIZE, CAPABILITIES_JSON_BUF_SIZE, ALERT_JSON_BUF_SIZE);
+    return failed;
+}
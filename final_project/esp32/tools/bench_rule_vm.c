@@ -0,0 +1,174 @@
+// Mikrobenchmark (host) maszyny rule_vm: ewaluacje na sekundę dla przykładowych reguł automatyzacji
+// i koszt względem tego samego warunku napisanego w C.
+//
+// Sprawdza też poprawność: wynik VM == wynik C dla wszystkich próbek, a błędne wyrażenia
+// dają oczekiwany kod błędu. Kod wyjścia != 0 przy niezgodności.
+//
+// Budowanie i uruchomienie (z katalogu final_project/esp32):
+//   cc -O2 -Imain -o /tmp/bench_rule_vm tools/bench_rule_vm.c main/rule_vm.c
+//   /tmp/bench_rule_vm
+//
+// Na x86 wynik w cyklach TSC, na innych hostach w ns. Na ESP32 (240 MHz, bez FPU double - tu tylko
+// float) koszt jednej ewaluacji jest rzędu kilku us, przy cyklu telemetrii co >= 5 s.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "rule_vm.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+static inline uint64_t bench_now(void) { return __rdtsc(); }
+#else
+#define BENCH_UNIT "ns"
+static inline uint64_t bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+#define BENCH_ROUNDS 16
+#define N_SAMPLES 4096
+
+static float s_vars[N_SAMPLES][RULE_VAR_COUNT];
+static volatile int s_sink;
+
+typedef struct {
+    const char *src;
+    bool (*native)(const float *v);
+} bench_rule_t;
+
+static bool native_evening(const float *v) {
+    return v[RULE_VAR_SOIL] < 30 && v[RULE_VAR_LIGHT] < 2000 && v[RULE_VAR_HOUR] >= 19;
+}
+
+static bool native_complex(const float *v) {
+    return (v[RULE_VAR_SOIL] < 25 || (v[RULE_VAR_SOIL] < 35 && v[RULE_VAR_TEMP] - 2 * v[RULE_VAR_HUM] / 10 > 20)) &&
+           !(v[RULE_VAR_TANK_EMPTY] == 1) && v[RULE_VAR_SINCE_WATER] >= 60 && (v[RULE_VAR_HOUR] < 9 || v[RULE_VAR_HOUR] >= 19);
+}
+
+static const bench_rule_t k_rules[] = {
+    { "soil < 30 && light < 2000 && hour >= 19", native_evening },
+    { "(soil < 25 || (soil < 35 && temp - 2 * hum / 10 > 20)) && !(tank_empty == 1) && since_water >= 60 && (hour < 9 || hour >= 19)",
+      native_complex },
+};
+#define N_RULES (sizeof(k_rules) / sizeof(k_rules[0]))
+
+static void fill_samples(void) {
+    uint32_t x = 12345;
+    for (size_t i = 0; i < N_SAMPLES; i++) {
+        float *v = s_vars[i];
+        for (int k = 0; k < RULE_VAR_COUNT; k++) {
+            x = x * 1664525u + 1013904223u;
+            v[k] = (float)((x >> 8) % 1000) / 10.0f; // 0..99.9
+        }
+        v[RULE_VAR_LIGHT] *= 40.0f;
+        v[RULE_VAR_HOUR] = (float)((int)v[RULE_VAR_HOUR] % 24);
+        v[RULE_VAR_TANK_EMPTY] = (float)((int)v[RULE_VAR_TANK_EMPTY] & 1);
+        if (i % 64 == 0) v[RULE_VAR_SOIL] = NAN; // niedostępny czujnik
+    }
+}
+
+static int check_errors(void) {
+    static const struct {
+        const char *src;
+        rule_vm_err_t err;
+    } cases[] = {
+        { "soil <", RULE_VM_ERR_SYNTAX },
+        { "soil < 30 &&", RULE_VM_ERR_SYNTAX },
+        { "(soil < 30", RULE_VM_ERR_SYNTAX },
+        { "soil < 30 < 40", RULE_VM_ERR_SYNTAX },
+        { "moisture < 30", RULE_VM_ERR_UNKNOWN_VAR },
+        { "((((((((((soil))))))))))", RULE_VM_ERR_TOO_DEEP },
+        { "1+(1+(1+(1+(1+(1+(1+(1+1)))))))", RULE_VM_ERR_TOO_DEEP },
+        { "soil+soil+soil+soil+soil+soil+soil+soil+soil+soil+soil+soil+soil+soil+soil+soil+soil+soil+soil+soil+soil+soil+soil",
+          RULE_VM_ERR_TOO_LONG },
+        { "soil < 30 && !(hour >= 7 && hour < 19)", RULE_VM_OK },
+    };
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        rule_program_t prog;
+        size_t pos = 0;
+        rule_vm_err_t err = rule_vm_compile(cases[i].src, &prog, &pos);
+        if (err != cases[i].err) {
+            printf("compile \"%s\": %s (pos %zu), expected %s\n", cases[i].src, rule_vm_strerror(err), pos,
+                   rule_vm_strerror(cases[i].err));
+            failed = 1;
+        }
+        if (err == RULE_VM_OK && rule_vm_verify(&prog) != RULE_VM_OK) {
+            printf("verify \"%s\" failed\n", cases[i].src);
+            failed = 1;
+        }
+    }
+    return failed;
+}
+
+static double bench_vm(const rule_program_t *prog) {
+    uint64_t best = UINT64_MAX;
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint64_t t0 = bench_now();
+        int hits = 0;
+        for (size_t i = 0; i < N_SAMPLES; i++) hits += rule_vm_eval(prog, s_vars[i]);
+        s_sink = hits;
+        uint64_t dt = bench_now() - t0;
+        if (dt < best) best = dt;
+    }
+    return (double)best / N_SAMPLES;
+}
+
+static double bench_native(bool (*fn)(const float *)) {
+    uint64_t best = UINT64_MAX;
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint64_t t0 = bench_now();
+        int hits = 0;
+        for (size_t i = 0; i < N_SAMPLES; i++) hits += fn(s_vars[i]);
+        s_sink = hits;
+        uint64_t dt = bench_now() - t0;
+        if (dt < best) best = dt;
+    }
+    return (double)best / N_SAMPLES;
+}
+
+static double evals_per_sec(const rule_program_t *prog) {
+    const int iters = 2000000;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int hits = 0;
+    for (int i = 0; i < iters; i++) hits += rule_vm_eval(prog, s_vars[i % N_SAMPLES]);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    s_sink = hits;
+    double sec = (double)(t1.tv_sec - t0.tv_sec) + (double)(t1.tv_nsec - t0.tv_nsec) * 1e-9;
+    return iters / sec;
+}
+
+int main(void) {
+    fill_samples();
+    int failed = check_errors();
+
+    printf("%-6s %5s %5s %12s %12s %14s\n", "rule", "bytes", "stack", "vm [" BENCH_UNIT "]", "C [" BENCH_UNIT "]", "evals/s");
+    for (size_t r = 0; r < N_RULES; r++) {
+        rule_program_t prog;
+        size_t pos = 0;
+        rule_vm_err_t err = rule_vm_compile(k_rules[r].src, &prog, &pos);
+        if (err != RULE_VM_OK) {
+            printf("rule %zu: %s at %zu\n", r, rule_vm_strerror(err), pos);
+            failed = 1;
+            continue;
+        }
+
+        size_t diff = 0;
+        for (size_t i = 0; i < N_SAMPLES; i++) diff += rule_vm_eval(&prog, s_vars[i]) != k_rules[r].native(s_vars[i]);
+        if (diff) {
+            printf("rule %zu: %zu of %d samples differ from C\n", r, diff, N_SAMPLES);
+            failed = 1;
+        }
+
+        printf("%-6zu %5u %5u %12.1f %12.1f %14.0f\n", r, prog.len, prog.stack, bench_vm(&prog),
+               bench_native(k_rules[r].native), evals_per_sec(&prog));
+    }
+    return failed;
+}
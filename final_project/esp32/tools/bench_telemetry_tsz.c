@@ -0,0 +1,285 @@
+// Benchmark (host) kompresji telemetry_tsz: stopień kompresji bloków logu offline oraz
+// przepustowość kodowania i dekodowania.
+//
+// Przebiegi:
+// - "gladki": syntetyczny dzień (sinusoidy) z rozdzielczością czujników, co 60 s bez jittera,
+// - "szum": błądzenie losowe + szum pomiaru (najgorszy realistyczny przypadek dla XOR),
+// - "urzadzenie": jak z publisher_task - wartości z całkowitych wyników BME280/VEML7700/ADC,
+//   timestamp z zegara ściennego z jitterem, przerwy (restart), brak wilgotności (BMP280),
+// - opcjonalnie plik CSV z zapisanego przebiegu: timestamp_ms,soil,temp,hum,press,lux,water_ok
+//   (puste pole / "nan" = brak wartości).
+// Bloki jak w telemetry_log: CONFIG_TELEMETRY_LOG_BLOCK_RECORDS rekordów lub 512 B.
+// Sprawdza też, że dekodowanie odtwarza rekordy bit w bit. Kod wyjścia != 0 przy niezgodności.
+//
+// Budowanie i uruchomienie (z katalogu final_project/esp32):
+//   cc -O2 -Imain -o /tmp/bench_telemetry_tsz tools/bench_telemetry_tsz.c main/telemetry_tsz.c -lm
+//   /tmp/bench_telemetry_tsz [przebieg.csv]
+//
+// Na x86 czas w cyklach TSC, na innych hostach w ns. Stopień kompresji liczony względem 32 B
+// na rekord (poprzedni format logu na flashu).
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "telemetry_tsz.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_UNIT "cycles"
+static inline uint64_t bench_now(void) { return __rdtsc(); }
+#else
+#define BENCH_UNIT "ns"
+static inline uint64_t bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+#endif
+
+#ifndef CONFIG_TELEMETRY_LOG_BLOCK_RECORDS
+#define CONFIG_TELEMETRY_LOG_BLOCK_RECORDS 32
+#endif
+
+#define BENCH_ROUNDS 16
+#define N_RECORDS 32768
+#define BLOCK_RECORDS CONFIG_TELEMETRY_LOG_BLOCK_RECORDS
+#define BLOCK_BYTES 512 // TELEMETRY_LOG_BLOCK_MAX_BYTES
+#define RAW_RECORD_BYTES 32
+#define MAX_BLOCKS N_RECORDS // blok ma co najmniej 1 rekord
+
+static telemetry_data_t s_in[N_RECORDS];
+static telemetry_data_t s_out[N_RECORDS];
+static uint8_t s_blocks[MAX_BLOCKS][BLOCK_BYTES];
+static uint16_t s_block_len[MAX_BLOCKS];
+static uint16_t s_block_count[MAX_BLOCKS];
+static size_t s_nblocks;
+
+static uint64_t s_rng = 0x2545F4914F6CDD1Dull;
+
+static double rnd_unit(void) {
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (double)(s_rng >> 11) / 9007199254740992.0;
+}
+
+static double rnd_gauss(void) {
+    double u = rnd_unit() + 1e-12, v = rnd_unit();
+    return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+static float quant(double v, double step) {
+    return (float)(round(v / step) * step);
+}
+
+#define TS0 1767225600000LL // 2026-01-01 00:00 UTC
+#define DAY_S 86400.0
+
+static double sun_level(double t_s) {
+    double x = sin(2.0 * M_PI * (fmod(t_s, DAY_S) / DAY_S - 0.25));
+    return x > 0 ? x : 0;
+}
+
+static size_t gen_smooth(void) {
+    for (size_t i = 0; i < N_RECORDS; i++) {
+        double t = (double)i * 60.0;
+        double day = 2.0 * M_PI * t / DAY_S;
+        telemetry_data_t *r = &s_in[i];
+        memset(r, 0, sizeof(*r));
+        r->timestamp = TS0 + (int64_t)i * 60000;
+        r->temp = quant(20.0 + 5.0 * sin(day), 0.01);
+        r->humidity = quant(60.0 - 15.0 * sin(day), 1.0 / 1024);
+        r->pressure = quant(1013.0 + 4.0 * sin(day / 7.0), 1.0 / 256 / 100);
+        r->light_lux = quant(20000.0 * sun_level(t), 0.0576);
+        r->soil_moisture = 70 - (int)((i % 1440) / 48); // podlewanie raz na dobę
+        r->water_ok = 0;
+    }
+    return N_RECORDS;
+}
+
+static size_t gen_noisy(void) {
+    double temp = 21.0, hum = 55.0, press = 1010.0, lux = 300.0;
+    for (size_t i = 0; i < N_RECORDS; i++) {
+        telemetry_data_t *r = &s_in[i];
+        memset(r, 0, sizeof(*r));
+        temp += 0.05 * rnd_gauss();
+        hum += 0.2 * rnd_gauss();
+        press += 0.02 * rnd_gauss();
+        lux = fabs(lux + 40.0 * rnd_gauss());
+        r->timestamp = TS0 + (int64_t)i * 60000;
+        r->temp = quant(temp + 0.02 * rnd_gauss(), 0.01);
+        r->humidity = quant(hum + 0.1 * rnd_gauss(), 1.0 / 1024);
+        r->pressure = quant(press + 0.01 * rnd_gauss(), 1.0 / 256 / 100);
+        r->light_lux = quant(lux, 0.0576);
+        r->soil_moisture = 40 + (int)(rnd_unit() * 20);
+        r->water_ok = rnd_unit() < 0.01;
+    }
+    return N_RECORDS;
+}
+
+// Ścieżka jak na urządzeniu: wyniki całkowite czujników -> float (bmp280_scale / veml7700_lux / ADC w %).
+static size_t gen_device(void) {
+    int64_t ts = TS0;
+    for (size_t i = 0; i < N_RECORDS; i++) {
+        double t = (double)(ts - TS0) / 1000.0;
+        double day = 2.0 * M_PI * t / DAY_S;
+        telemetry_data_t *r = &s_in[i];
+        memset(r, 0, sizeof(*r));
+
+        int32_t t_centi = (int32_t)lround((19.0 + 6.0 * sin(day) + 0.03 * rnd_gauss()) * 100.0);
+        uint32_t p_q24_8 = (uint32_t)lround((100900.0 + 300.0 * sin(day / 5.0) + 2.0 * rnd_gauss()) * 256.0);
+        uint16_t lux_raw = (uint16_t)fmin(65535.0, fmax(0.0, 28000.0 * sun_level(t) * (0.8 + 0.2 * rnd_unit())));
+
+        r->timestamp = ts;
+        r->temp = (float)t_centi / 100;
+        r->humidity = NAN; // BMP280 bez wilgotności
+        r->pressure = (float)p_q24_8 / 256 / 100.0f;
+        r->light_lux = (float)lux_raw * 0.0576f;
+        r->soil_moisture = 55 - (int)((i % 720) / 30) + (int)lround(rnd_gauss());
+        r->water_ok = (i / 5000) % 2;
+
+        // Cykl 60 s z timera + jitter taska; co jakiś czas restart (przerwa)
+        ts += 60000 + (int64_t)(rnd_unit() * 30);
+        if (rnd_unit() < 0.0005) ts += (int64_t)(rnd_unit() * 3600000);
+    }
+    return N_RECORDS;
+}
+
+static float parse_float(const char *s) {
+    if (*s == '\0' || *s == ',' || *s == '\n' || strncmp(s, "nan", 3) == 0) return NAN;
+    return strtof(s, NULL);
+}
+
+static const char *next_field(const char *s) {
+    const char *c = strchr(s, ',');
+    return c ? c + 1 : s + strlen(s);
+}
+
+static size_t load_csv(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return 0;
+    }
+    char line[256];
+    size_t n = 0;
+    while (n < N_RECORDS && fgets(line, sizeof(line), f)) {
+        if (line[0] < '0' || line[0] > '9') continue; // nagłówek / komentarz
+        telemetry_data_t *r = &s_in[n];
+        memset(r, 0, sizeof(*r));
+        const char *p = line;
+        r->timestamp = strtoll(p, NULL, 10);
+        p = next_field(p);
+        r->soil_moisture = (*p == ',' || *p == '\0') ? -1 : atoi(p);
+        p = next_field(p);
+        r->temp = parse_float(p);
+        p = next_field(p);
+        r->humidity = parse_float(p);
+        p = next_field(p);
+        r->pressure = parse_float(p);
+        p = next_field(p);
+        r->light_lux = parse_float(p);
+        p = next_field(p);
+        r->water_ok = (int16_t)(atoi(p) != 0);
+        n++;
+    }
+    fclose(f);
+    return n;
+}
+
+static void encode_all(size_t n) {
+    telemetry_tsz_encoder_t enc;
+    s_nblocks = 0;
+    telemetry_tsz_encoder_init(&enc, s_blocks[0], BLOCK_BYTES);
+    for (size_t i = 0; i < n; i++) {
+        if (enc.count == BLOCK_RECORDS || !telemetry_tsz_append(&enc, &s_in[i])) {
+            s_block_len[s_nblocks] = (uint16_t)telemetry_tsz_size(&enc);
+            s_block_count[s_nblocks] = enc.count;
+            s_nblocks++;
+            telemetry_tsz_encoder_init(&enc, s_blocks[s_nblocks], BLOCK_BYTES);
+            (void)telemetry_tsz_append(&enc, &s_in[i]);
+        }
+    }
+    if (enc.count > 0) {
+        s_block_len[s_nblocks] = (uint16_t)telemetry_tsz_size(&enc);
+        s_block_count[s_nblocks] = enc.count;
+        s_nblocks++;
+    }
+}
+
+static size_t decode_all(void) {
+    size_t n = 0;
+    for (size_t b = 0; b < s_nblocks; b++) {
+        telemetry_tsz_decoder_t dec;
+        telemetry_tsz_decoder_init(&dec, s_blocks[b], s_block_len[b]);
+        for (uint16_t k = 0; k < s_block_count[b]; k++) {
+            if (!telemetry_tsz_next(&dec, &s_out[n])) return n;
+            n++;
+        }
+    }
+    return n;
+}
+
+static int soil_expected(int soil) {
+    if (soil < 0) return -1;
+    return soil > 254 ? 254 : soil;
+}
+
+static size_t check_roundtrip(size_t n) {
+    size_t bad = 0;
+    for (size_t i = 0; i < n; i++) {
+        const telemetry_data_t *a = &s_in[i], *b = &s_out[i];
+        if (a->timestamp != b->timestamp || soil_expected(a->soil_moisture) != b->soil_moisture ||
+            (a->water_ok != 0) != (b->water_ok != 0) || memcmp(&a->temp, &b->temp, sizeof(float)) != 0 ||
+            memcmp(&a->humidity, &b->humidity, sizeof(float)) != 0 ||
+            memcmp(&a->pressure, &b->pressure, sizeof(float)) != 0 ||
+            memcmp(&a->light_lux, &b->light_lux, sizeof(float)) != 0) {
+            if (bad++ == 0) fprintf(stderr, "  rekord %zu różni się po dekodowaniu\n", i);
+        }
+    }
+    return bad;
+}
+
+static int run_trace(const char *name, size_t n) {
+    uint64_t best_enc = UINT64_MAX, best_dec = UINT64_MAX;
+    size_t decoded = 0;
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        uint64_t t0 = bench_now();
+        encode_all(n);
+        uint64_t t1 = bench_now();
+        decoded = decode_all();
+        uint64_t t2 = bench_now();
+        if (t1 - t0 < best_enc) best_enc = t1 - t0;
+        if (t2 - t1 < best_dec) best_dec = t2 - t1;
+    }
+
+    size_t bytes = 0;
+    for (size_t b = 0; b < s_nblocks; b++) bytes += s_block_len[b];
+    size_t bad = decoded == n ? check_roundtrip(n) : n;
+
+    printf("%-12s %6zu rek. %5zu bloków  %6.1f B/blok  %5.2f B/rek.  %5.2fx   enc %6.1f  dec %6.1f %s/rek.%s\n",
+           name, n, s_nblocks, (double)bytes / (double)s_nblocks, (double)bytes / (double)n,
+           (double)(n * RAW_RECORD_BYTES) / (double)bytes, (double)best_enc / (double)n, (double)best_dec / (double)n,
+           BENCH_UNIT, bad ? "  NIEZGODNE" : "");
+    return bad ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+    int fail = 0;
+    printf("telemetry_tsz: bloki %d rekordów / %d B, stopień względem %d B/rekord\n", BLOCK_RECORDS, BLOCK_BYTES,
+           RAW_RECORD_BYTES);
+
+    fail |= run_trace("gladki", gen_smooth());
+    fail |= run_trace("szum", gen_noisy());
+    fail |= run_trace("urzadzenie", gen_device());
+    if (argc > 1) {
+        size_t n = load_csv(argv[1]);
+        if (n == 0) return 2;
+        fail |= run_trace("plik", n);
+    }
+    return fail;
+}
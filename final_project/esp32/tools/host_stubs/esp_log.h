@@ -0,0 +1,18 @@
+#ifndef HOST_STUB_ESP_LOG_H
+#define HOST_STUB_ESP_LOG_H
+
+#include <stdio.h>
+
+// Logi na stderr tylko z -DHOST_LOG (testy generują ich dużo)
+#ifdef HOST_LOG
+#define HOST_LOG_PRINT(level, tag, fmt, ...) fprintf(stderr, level " (%s) " fmt "\n", tag, ##__VA_ARGS__)
+#else
+#define HOST_LOG_PRINT(level, tag, fmt, ...) do { if (0) fprintf(stderr, fmt, ##__VA_ARGS__); (void)(tag); } while (0)
+#endif
+
+#define ESP_LOGE(tag, fmt, ...) HOST_LOG_PRINT("E", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGW(tag, fmt, ...) HOST_LOG_PRINT("W", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGI(tag, fmt, ...) HOST_LOG_PRINT("I", tag, fmt, ##__VA_ARGS__)
+#define ESP_LOGD(tag, fmt, ...) HOST_LOG_PRINT("D", tag, fmt, ##__VA_ARGS__)
+
+#endif // HOST_STUB_ESP_LOG_H
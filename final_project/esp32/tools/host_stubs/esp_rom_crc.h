@@ -0,0 +1,16 @@
+#ifndef HOST_STUB_ESP_ROM_CRC_H
+#define HOST_STUB_ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+// CRC32 (poly 0xEDB88320) z tą samą semantyką co w ROM: wynik poprzedniego wywołania jako `crc` kontynuuje sumę
+static inline uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (int k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+    return ~crc;
+}
+
+#endif // HOST_STUB_ESP_ROM_CRC_H
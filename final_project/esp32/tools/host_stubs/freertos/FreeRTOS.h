@@ -0,0 +1,14 @@
+#ifndef HOST_STUB_FREERTOS_H
+#define HOST_STUB_FREERTOS_H
+
+#include <stdint.h>
+
+// Testy na hoście są jednowątkowe - blokady są puste
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+
+#define pdTRUE        1
+#define pdFALSE       0
+#define portMAX_DELAY ((TickType_t)0xFFFFFFFFu)
+
+#endif // HOST_STUB_FREERTOS_H
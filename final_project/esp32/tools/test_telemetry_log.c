@@ -0,0 +1,368 @@
+// Test (host) odporności telemetry_log na zanik zasilania: flash partycji "tlmlog" symulowany w RAM,
+// zasilanie odcinane w losowej operacji flash (także w połowie zapisu / kasowania).
+//
+// Każdy "start" urządzenia to proces potomny (fork) na tym samym obrazie flash, więc stan modułu
+// jest odtwarzany wyłącznie z flasha - tak jak po restarcie. Po każdym starcie sprawdzane jest:
+// - rekord zapisany na flashu (blok zamknięty przed zanikiem) i niezwolniony jest odczytywany,
+// - rekord zwolniony (telemetry_log_release zakończone) nie wraca,
+// - nic nie jest odczytywane dwa razy ani z błędną treścią (CRC odrzuca przerwane wpisy),
+// - kolejność rekordów jest zachowana, a bufor działa dalej (zapis + odczyt po odtworzeniu).
+// Osobny przypadek: przekłamany bit w danych zapisanego bloku.
+// Kod wyjścia != 0 przy pierwszym naruszeniu.
+//
+// Budowanie i uruchomienie (z katalogu final_project/esp32):
+//   cc -O2 -Itools/host_stubs -Imain -DCONFIG_TELEMETRY_LOG_BLOCK_RECORDS=32 -o /tmp/test_telemetry_log
+//      tools/test_telemetry_log.c main/telemetry_tsz.c -lm
+//   /tmp/test_telemetry_log [seeds]
+//
+// Zanik zasilania w trakcie programowania: bity 1->0 z zapisu mogą, ale nie muszą zostać zapisane
+// (pozostałe bez zmian); przerwane kasowanie ustawia losowy podzbiór bitów na 1.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Testowany moduł w całości - test zagląda do otwartego bloku (s_open), żeby wiedzieć, co jest już na flashu
+#include "telemetry_log.c"
+
+#define FLASH_SECTORS  6
+#define FLASH_SIZE     (FLASH_SECTORS * TLOG_SECTOR_SIZE)
+#define MAX_RECORDS    (1u << 20)
+#define BOOTS_PER_SEED 60
+#define MAX_PENDING    150
+
+// Stan rekordu (indeks = kolejny numer dodanego rekordu, zakodowany w timestamp)
+enum {
+    REC_NONE,      // nie dodany albo utracony (otwarty blok) - nie może się pojawić
+    REC_OPEN,      // w otwartym bloku / zapis przerwany - może się pojawić
+    REC_DURABLE,   // na flashu - musi się pojawić
+    REC_RELEASING, // zwalnianie przerwane - może się pojawić
+    REC_RELEASED,  // zwolniony - nie może się pojawić
+};
+
+typedef struct {
+    uint8_t flash[FLASH_SIZE];
+    uint32_t appended;       // następny indeks rekordu
+    uint32_t durable;        // rekordów w stanie REC_DURABLE
+    uint8_t state[MAX_RECORDS];
+} shared_t;
+
+static shared_t *s_sh;
+static esp_partition_t s_host_part = {
+    .type = ESP_PARTITION_TYPE_DATA,
+    .subtype = ESP_PARTITION_SUBTYPE_ANY,
+    .size = FLASH_SIZE,
+    .erase_size = TLOG_SECTOR_SIZE,
+    .label = TELEMETRY_LOG_PARTITION_LABEL,
+};
+
+static uint64_t s_rng;
+static uint32_t s_ops;       // operacji flash od startu
+static uint32_t s_cut_at;    // 0 = bez zaniku zasilania
+static bool s_powered = true;
+
+static uint32_t rnd(void) {
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 7;
+    s_rng ^= s_rng << 17;
+    return (uint32_t)(s_rng >> 16);
+}
+
+// Czy ta operacja jest przerwana zanikiem zasilania
+static bool cut_now(void) {
+    if (!s_powered) return true;
+    if (s_cut_at && ++s_ops >= s_cut_at) {
+        s_powered = false;
+        return true;
+    }
+    return false;
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label) {
+    (void)type;
+    (void)subtype;
+    return strcmp(label, s_host_part.label) == 0 ? &s_host_part : NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *part, size_t src_offset, void *dst, size_t size) {
+    if (src_offset + size > part->size) return ESP_ERR_INVALID_SIZE;
+    memcpy(dst, &s_sh->flash[src_offset], size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *part, size_t dst_offset, const void *src, size_t size) {
+    if (dst_offset + size > part->size) return ESP_ERR_INVALID_SIZE;
+    const uint8_t *p = src;
+    uint8_t *f = &s_sh->flash[dst_offset];
+    if (!s_powered) return ESP_FAIL;
+    if (cut_now()) {
+        // Zapisana część bajtów, w jednym bajcie tylko część bitów
+        size_t done = size ? rnd() % size : 0;
+        for (size_t i = 0; i < done; i++) f[i] &= p[i];
+        if (done < size) f[done] &= (uint8_t)(p[done] | rnd());
+        return ESP_FAIL;
+    }
+    for (size_t i = 0; i < size; i++) f[i] &= p[i]; // NOR: programowanie tylko zeruje bity
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *part, size_t offset, size_t size) {
+    if (offset % TLOG_SECTOR_SIZE || size % TLOG_SECTOR_SIZE || offset + size > part->size) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!s_powered) return ESP_FAIL;
+    if (cut_now()) {
+        for (size_t i = 0; i < size; i++) s_sh->flash[offset + i] |= (uint8_t)rnd();
+        return ESP_FAIL;
+    }
+    memset(&s_sh->flash[offset], 0xFF, size);
+    return ESP_OK;
+}
+
+#define TS0 1700000000000LL
+
+static telemetry_data_t gen_record(uint32_t i) {
+    telemetry_data_t r;
+    memset(&r, 0, sizeof(r));
+    r.timestamp = TS0 + (int64_t)i * 60000;
+    r.temp = 21.0f + 4.0f * sinf((float)i / 240.0f);
+    r.humidity = (i % 97 == 0) ? NAN : 55.0f + (float)(i % 13) * 0.25f;
+    r.pressure = 1013.25f + (float)(i % 7) * 0.01f;
+    r.light_lux = (i / 300) % 2 ? 0.0f : 120.5f * (float)(i % 50);
+    r.soil_moisture = (int)(40 + (i / 25) % 30);
+    r.water_ok = (int16_t)((i / 400) % 2);
+    return r;
+}
+
+static bool same_record(const telemetry_data_t *a, const telemetry_data_t *b) {
+    return a->timestamp == b->timestamp && a->soil_moisture == b->soil_moisture && a->water_ok == b->water_ok &&
+           memcmp(&a->temp, &b->temp, sizeof(float)) == 0 && memcmp(&a->humidity, &b->humidity, sizeof(float)) == 0 &&
+           memcmp(&a->pressure, &b->pressure, sizeof(float)) == 0 &&
+           memcmp(&a->light_lux, &b->light_lux, sizeof(float)) == 0;
+}
+
+#define FAIL(...) do { fprintf(stderr, "FAIL: " __VA_ARGS__); fputc('\n', stderr); _exit(1); } while (0)
+
+// Rekord z pozycji `pos`, sprawdzony z generatorem; zwraca indeks
+static uint32_t read_checked(uint32_t pos) {
+    telemetry_data_t r;
+    if (!telemetry_log_read(pos, &r)) {
+        if (!s_powered) _exit(0); // zanik przy zamykaniu otwartego bloku
+        FAIL("brak rekordu na pozycji %lu", (unsigned long)pos);
+    }
+    int64_t d = r.timestamp - TS0;
+    if (d < 0 || d % 60000 || d / 60000 >= s_sh->appended) {
+        FAIL("pozycja %lu: nieznany rekord ts=%lld", (unsigned long)pos, (long long)r.timestamp);
+    }
+    uint32_t idx = (uint32_t)(d / 60000);
+    telemetry_data_t want = gen_record(idx);
+    if (!same_record(&r, &want)) FAIL("rekord %lu: treść różna od zapisanej", (unsigned long)idx);
+    return idx;
+}
+
+static void set_state(uint32_t idx, uint8_t st) {
+    if (s_sh->state[idx] == REC_DURABLE) s_sh->durable--;
+    if (st == REC_DURABLE) s_sh->durable++;
+    s_sh->state[idx] = st;
+}
+
+// Po starcie: wszystko, co bufor zwraca, porównane z modelem
+static void verify_recovered(void) {
+    uint32_t first = telemetry_log_first();
+    uint32_t n = telemetry_log_count();
+    uint32_t durable_seen = 0;
+    int64_t prev = -1;
+
+    for (uint32_t pos = first; pos < first + n; pos++) {
+        uint32_t idx = read_checked(pos);
+        if ((int64_t)idx <= prev) FAIL("rekord %lu po %lld - zła kolejność / duplikat", (unsigned long)idx, (long long)prev);
+        switch (s_sh->state[idx]) {
+        case REC_NONE: FAIL("rekord %lu utracony wcześniej, a teraz wrócił", (unsigned long)idx);
+        case REC_RELEASED: FAIL("rekord %lu zwolniony, a wrócił", (unsigned long)idx);
+        case REC_DURABLE: durable_seen++; break;
+        default: set_state(idx, REC_DURABLE); durable_seen++; break;
+        }
+        // Pominięte wcześniejsze rekordy, które "mogły być", są już definitywnie utracone/zwolnione
+        for (int64_t j = prev + 1; j < idx; j++) {
+            uint8_t st = s_sh->state[j];
+            if (st == REC_DURABLE) FAIL("utracony rekord %lld zapisany na flashu", (long long)j);
+            if (st == REC_OPEN) set_state((uint32_t)j, REC_NONE);
+            if (st == REC_RELEASING) set_state((uint32_t)j, REC_RELEASED);
+        }
+        prev = idx;
+    }
+    if (durable_seen != s_sh->durable) {
+        FAIL("odczytano %lu z %lu rekordów zapisanych na flashu", (unsigned long)durable_seen,
+             (unsigned long)s_sh->durable);
+    }
+    for (uint32_t j = (uint32_t)(prev + 1); j < s_sh->appended; j++) {
+        if (s_sh->state[j] == REC_OPEN) set_state(j, REC_NONE);
+        if (s_sh->state[j] == REC_RELEASING) set_state(j, REC_RELEASED);
+    }
+    if (telemetry_log_take_dropped() != 0) FAIL("bufor zgłosił utracone rekordy bez przepełnienia");
+}
+
+// Rekordy, których blok właśnie trafił na flash (operacja bez zaniku zasilania)
+static void mark_sealed(void) {
+    uint32_t open_from = s_sh->appended - s_open.count;
+    for (uint32_t j = open_from; j-- > 0 && s_sh->state[j] == REC_OPEN;) set_state(j, REC_DURABLE);
+}
+
+static void drain(uint32_t max) {
+    uint32_t first = telemetry_log_first();
+    uint32_t n = telemetry_log_count();
+    if (n > max) n = max;
+    if (n == 0) return;
+
+    uint32_t idx[MAX_PENDING + 64];
+    for (uint32_t k = 0; k < n; k++) idx[k] = read_checked(first + k);
+    if (!s_powered) return; // odczyt zamknął otwarty blok i zasilanie zanikło w trakcie
+    mark_sealed();
+
+    for (uint32_t k = 0; k < n; k++) set_state(idx[k], REC_RELEASING);
+    esp_err_t err = telemetry_log_release(first + n);
+    if (!s_powered) return;
+    if (err != ESP_OK) FAIL("release: %s", esp_err_to_name(err));
+    for (uint32_t k = 0; k < n; k++) set_state(idx[k], REC_RELEASED);
+}
+
+// Jeden start urządzenia: odtworzenie, sprawdzenie, praca do zaniku zasilania (cut_at = 0: bez zaniku)
+static void boot(uint32_t cut_at, bool check) {
+    s_cut_at = cut_at;
+    esp_err_t err = telemetry_log_init();
+    if (!s_powered) _exit(0); // zanik już przy odtwarzaniu (np. otwarcie pierwszego sektora)
+    if (err != ESP_OK) FAIL("telemetry_log_init: %s", esp_err_to_name(err));
+    if (check) verify_recovered();
+    if (cut_at == 0) return;
+
+    for (;;) {
+        uint32_t op = rnd() % 100;
+        if (op < 75 || telemetry_log_count() == 0) {
+            uint32_t i = s_sh->appended++;
+            if (i >= MAX_RECORDS) FAIL("za mało miejsca w modelu");
+            telemetry_data_t r = gen_record(i);
+            set_state(i, REC_OPEN);
+            esp_err_t err = telemetry_log_append(&r);
+            if (!s_powered) _exit(0);
+            if (err != ESP_OK) FAIL("append: %s", esp_err_to_name(err));
+            mark_sealed();
+        } else {
+            drain(telemetry_log_count() > MAX_PENDING ? MAX_PENDING : 1 + rnd() % 40);
+            if (!s_powered) _exit(0);
+        }
+    }
+}
+
+static void run_child(void (*fn)(uint32_t), uint32_t arg) {
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(2);
+    }
+    if (pid == 0) {
+        fn(arg);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) exit(1);
+}
+
+static void boot_with_cut(uint32_t cut_at) {
+    boot(cut_at, true);
+}
+
+// Po ostatnim zaniku: odtworzenie, a potem zapis i odczyt nowych rekordów
+static void boot_final(uint32_t unused) {
+    (void)unused;
+    boot(0, true);
+    uint32_t start = s_sh->appended;
+    for (uint32_t k = 0; k < 100; k++) {
+        telemetry_data_t r = gen_record(s_sh->appended);
+        set_state(s_sh->appended++, REC_OPEN);
+        if (telemetry_log_append(&r) != ESP_OK) FAIL("append po odtworzeniu");
+        mark_sealed();
+    }
+    uint32_t first = telemetry_log_first(), n = telemetry_log_count();
+    if (n < 100) FAIL("po odtworzeniu tylko %lu rekordów", (unsigned long)n);
+    for (uint32_t k = 0; k < 100; k++) {
+        if (read_checked(first + n - 100 + k) != start + k) FAIL("nowy rekord %lu nie na miejscu", (unsigned long)k);
+    }
+}
+
+// Przekłamany bit w danych drugiego z trzech bloków w sektorze
+static void crc_case(uint32_t phase) {
+    if (phase == 0) {
+        boot(0, false);
+        while (s_next_block_seq <= 3) {
+            telemetry_data_t r = gen_record(s_sh->appended);
+            set_state(s_sh->appended++, REC_OPEN);
+            if (telemetry_log_append(&r) != ESP_OK) FAIL("append");
+            mark_sealed();
+        }
+        return;
+    }
+
+    tlog_entry_hdr_t h;
+    uint32_t off = TLOG_FIRST_ENTRY;
+    memcpy(&h, &s_sh->flash[off], sizeof(h));
+    uint32_t good = h.count;
+    off += entry_size(h.len);
+    memcpy(&h, &s_sh->flash[off], sizeof(h));
+    s_sh->flash[off + sizeof(h) + h.len / 2] ^= 0x10;
+
+    if (telemetry_log_init() != ESP_OK) FAIL("telemetry_log_init");
+    // Pierwszy blok cały, z uszkodzonego ani jednego rekordu
+    uint32_t first = telemetry_log_first(), n = telemetry_log_count();
+    if (n != good) FAIL("po uszkodzeniu %lu rekordów zamiast %lu", (unsigned long)n, (unsigned long)good);
+    for (uint32_t k = 0; k < n; k++) {
+        if (read_checked(first + k) != k) FAIL("rekord %lu", (unsigned long)k);
+    }
+    // Dalszy zapis idzie za uszkodzonym miejscem
+    telemetry_data_t r = gen_record(s_sh->appended++);
+    if (telemetry_log_append(&r) != ESP_OK) FAIL("append po uszkodzeniu");
+    if (read_checked(first + n) != s_sh->appended - 1) FAIL("nowy rekord po uszkodzeniu");
+}
+
+int main(int argc, char **argv) {
+    uint32_t seeds = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : 40;
+
+    s_sh = mmap(NULL, sizeof(*s_sh), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (s_sh == MAP_FAILED) {
+        perror("mmap");
+        return 2;
+    }
+
+    uint64_t boots = 0, records = 0;
+    for (uint32_t seed = 1; seed <= seeds; seed++) {
+        memset(s_sh, 0, sizeof(*s_sh));
+        memset(s_sh->flash, 0xFF, sizeof(s_sh->flash));
+        s_rng = 0x9E3779B97F4A7C15ull * seed;
+
+        for (uint32_t b = 0; b < BOOTS_PER_SEED; b++) {
+            // Różna długość pracy przed zanikiem: od pierwszej operacji do kilku obiegów pierścienia
+            uint32_t cut_at = 1 + rnd() % (b % 4 == 0 ? 8 : 600);
+            s_rng += b; // proces potomny ma kopię generatora - kolejny start dostaje inną sekwencję
+            run_child(boot_with_cut, cut_at);
+            boots++;
+        }
+        run_child(boot_final, 0);
+        records += s_sh->appended;
+    }
+
+    memset(s_sh, 0, sizeof(*s_sh));
+    memset(s_sh->flash, 0xFF, sizeof(s_sh->flash));
+    run_child(crc_case, 0);
+    run_child(crc_case, 1);
+
+    printf("telemetry_log: %lu startów z zanikiem zasilania, %lu rekordów, przekłamany blok odrzucony - OK\n",
+           (unsigned long)boots, (unsigned long)records);
+    return 0;
+}
@@ -5,6 +5,8 @@ import com.fasterxml.jackson.annotation.JsonProperty;
 import com.fasterxml.jackson.annotation.JsonAlias;
 import lombok.Data;
 
+import java.util.Map;
+
 @Data
 @JsonInclude(JsonInclude.Include.NON_NULL)
 public class DeviceSettingsDto {
@@ -40,4 +42,18 @@ public class DeviceSettingsDto {
     @JsonProperty("measurement_interval_sec")
     @JsonAlias("measurementIntervalSeconds")
     private Integer measurementIntervalSeconds;
+
+    // "json" | "binary"
+    @JsonProperty("telemetry_encoding")
+    @JsonAlias("telemetryEncoding")
+    private String telemetryEncoding;
+
+    // Per field (telemetry name, e.g. "air_temperature_c"): alert clears only this far back inside the limit
+    @JsonProperty("hysteresis")
+    private Map<String, Float> hysteresis;
+
+    // Per field: value must stay beyond the limit this long before the alert fires
+    @JsonProperty("dwell_sec")
+    @JsonAlias("dwellSec")
+    private Map<String, Integer> dwellSec;
 }
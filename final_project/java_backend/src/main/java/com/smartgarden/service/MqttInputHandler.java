@@ -8,6 +8,8 @@ import org.springframework.messaging.Message;
 import org.springframework.messaging.MessageHandler;
 import org.springframework.stereotype.Service;
 
+import java.nio.charset.StandardCharsets;
+
 @Service
 @RequiredArgsConstructor
 @Slf4j
@@ -22,17 +24,36 @@ public class MqttInputHandler {
             @Override
             public void handleMessage(Message<?> message) {
                 String topic = (String) message.getHeaders().get("mqtt_receivedTopic");
-                String payload = (String) message.getPayload();
-
-                log.debug("MQTT Rx [{}]: {}", topic, payload);
+                // Payload arrives as bytes (binary telemetry); text topics are decoded as UTF-8
+                byte[] raw = (byte[]) message.getPayload();
 
                 if (topic == null)
                     return;
 
                 // Topic format: garden/{user}/{device}/{type}
-                // types: telemetry, alert, capabilities
+                // types: telemetry, telemetry/batch, telemetry/bin, telemetry/tsz, alert, capabilities,
+                // settings/state, command/response
+
+                if (topic.endsWith("/telemetry/bin") || topic.endsWith("/telemetry/tsz")) {
+                    log.debug("MQTT Rx [{}]: {} bytes", topic, raw.length);
+                    String[] parts = topic.split("/");
+                    if (parts.length < 3) {
+                        return;
+                    }
+                    if (topic.endsWith("/telemetry/tsz")) {
+                        smartGardenService.processTelemetryTsz(parts[1], parts[2], raw);
+                    } else {
+                        smartGardenService.processTelemetryBinary(parts[1], parts[2], raw);
+                    }
+                    return;
+                }
+
+                String payload = new String(raw, StandardCharsets.UTF_8);
+                log.debug("MQTT Rx [{}]: {}", topic, payload);
 
-                if (topic.endsWith("/telemetry")) {
+                if (topic.endsWith("/telemetry/batch")) {
+                    smartGardenService.processTelemetryBatch(payload);
+                } else if (topic.endsWith("/telemetry")) {
                     smartGardenService.processTelemetry(payload);
                 } else if (topic.endsWith("/alert")) {
                     smartGardenService.processAlert(payload);
@@ -44,6 +65,11 @@ public class MqttInputHandler {
                     if (parts.length >= 3) {
                         smartGardenService.processSettingsState(parts[2], payload);
                     }
+                } else if (topic.endsWith("/command/response")) {
+                    String[] parts = topic.split("/");
+                    if (parts.length >= 3) {
+                        smartGardenService.processCommandResponse(parts[2], payload);
+                    }
                 } else {
                     log.debug("Ignored message on topic: {}", topic);
                 }
@@ -52,45 +52,133 @@ public class SmartGardenService {
             device.setOnline(true);
             deviceRepository.save(device);
 
-            Measurement measurement = new Measurement();
-            measurement.setDevice(device);
+            Measurement measurement = toMeasurement(device, root);
+            measurementRepository.save(measurement);
+            log.info("Saved telemetry for device: {}", mac);
 
-            // Use timestamp from payload if available (epoch millis)
-            if (root.has("timestamp")) {
-                long ts = root.get("timestamp").asLong();
-                measurement.setTimestamp(LocalDateTime.ofInstant(Instant.ofEpochMilli(ts), ZoneId.systemDefault()));
-            } else {
-                measurement.setTimestamp(LocalDateTime.now());
+        } catch (JsonProcessingException e) {
+            log.error("Failed to parse telemetry payload", e);
+        }
+    }
+
+    /**
+     * Process a batch of buffered telemetry records sent by the device after a reconnect.
+     * Payload: {"device": ..., "user": ..., "records": [{"timestamp": ..., "sensors": {...}}, ...], "count": N}
+     */
+    @Transactional
+    public void processTelemetryBatch(String payload) {
+        try {
+            JsonNode root = objectMapper.readTree(payload);
+            String mac = root.get("device").asText();
+            String userId = root.has("user") ? root.get("user").asText() : "unknown";
+
+            JsonNode records = root.get("records");
+            if (records == null || !records.isArray()) {
+                log.warn("Telemetry batch from {} has no records array", mac);
+                return;
             }
 
-            if (root.has("sensors")) {
-                JsonNode sensors = root.get("sensors");
-                if (sensors.has("soil_moisture_pct") && !sensors.get("soil_moisture_pct").isNull()) {
-                    measurement.setSoilMoisture(sensors.get("soil_moisture_pct").asInt());
-                }
-                if (sensors.has("air_temperature_c") && !sensors.get("air_temperature_c").isNull()) {
-                    measurement.setTemperature((float) sensors.get("air_temperature_c").asDouble());
-                }
-                if (sensors.has("air_humidity_pct") && !sensors.get("air_humidity_pct").isNull()) {
-                    measurement.setHumidity((float) sensors.get("air_humidity_pct").asDouble());
-                }
-                if (sensors.has("pressure_hpa") && !sensors.get("pressure_hpa").isNull()) {
-                    measurement.setPressure((float) sensors.get("pressure_hpa").asDouble());
-                }
-                if (sensors.has("light_lux") && !sensors.get("light_lux").isNull()) {
-                    measurement.setLightLux((float) sensors.get("light_lux").asDouble());
-                }
-                if (sensors.has("water_tank_ok") && !sensors.get("water_tank_ok").isNull()) {
-                    measurement.setWaterTankOk(sensors.get("water_tank_ok").asBoolean());
-                }
+            Device device = getOrCreateDevice(mac, userId);
+            device.setLastSeen(LocalDateTime.now());
+            device.setOnline(true);
+            deviceRepository.save(device);
+
+            java.util.List<Measurement> measurements = new java.util.ArrayList<>(records.size());
+            for (JsonNode record : records) {
+                measurements.add(toMeasurement(device, record));
             }
 
-            measurementRepository.save(measurement);
-            log.info("Saved telemetry for device: {}", mac);
+            measurementRepository.saveAll(measurements);
+            log.info("Saved {} buffered telemetry records for device: {}", measurements.size(), mac);
 
         } catch (JsonProcessingException e) {
-            log.error("Failed to parse telemetry payload", e);
+            log.error("Failed to parse telemetry batch payload", e);
+        }
+    }
+
+    /**
+     * Process a binary telemetry frame (single reading or buffered batch) from garden/{user}/{mac}/telemetry/bin.
+     * Device and user come from the topic since the frame does not repeat them.
+     */
+    @Transactional
+    public void processTelemetryBinary(String userId, String mac, byte[] payload) {
+        java.util.List<Measurement> measurements;
+        try {
+            measurements = TelemetryBinaryDecoder.decode(payload);
+        } catch (IllegalArgumentException e) {
+            log.error("Failed to decode binary telemetry from {}: {}", mac, e.getMessage());
+            return;
         }
+
+        saveDecodedTelemetry(userId, mac, measurements);
+    }
+
+    /**
+     * Process a compressed backlog block from garden/{user}/{mac}/telemetry/tsz.
+     */
+    @Transactional
+    public void processTelemetryTsz(String userId, String mac, byte[] payload) {
+        java.util.List<Measurement> measurements;
+        try {
+            measurements = TelemetryTszDecoder.decode(payload);
+        } catch (IllegalArgumentException e) {
+            log.error("Failed to decode compressed telemetry block from {}: {}", mac, e.getMessage());
+            return;
+        }
+        saveDecodedTelemetry(userId, mac, measurements);
+    }
+
+    private void saveDecodedTelemetry(String userId, String mac, java.util.List<Measurement> measurements) {
+        Device device = getOrCreateDevice(mac, userId);
+        device.setLastSeen(LocalDateTime.now());
+        device.setOnline(true);
+        deviceRepository.save(device);
+
+        for (Measurement measurement : measurements) {
+            measurement.setDevice(device);
+        }
+        measurementRepository.saveAll(measurements);
+        log.info("Saved {} binary telemetry records for device: {}", measurements.size(), mac);
+    }
+
+    /**
+     * Builds a measurement from a single telemetry record ({"timestamp": ..., "sensors": {...}}).
+     */
+    private Measurement toMeasurement(Device device, JsonNode record) {
+        Measurement measurement = new Measurement();
+        measurement.setDevice(device);
+
+        // Use timestamp from payload if available (epoch millis)
+        if (record.has("timestamp")) {
+            long ts = record.get("timestamp").asLong();
+            measurement.setTimestamp(LocalDateTime.ofInstant(Instant.ofEpochMilli(ts), ZoneId.systemDefault()));
+        } else {
+            measurement.setTimestamp(LocalDateTime.now());
+        }
+
+        if (record.has("sensors")) {
+            JsonNode sensors = record.get("sensors");
+            if (sensors.has("soil_moisture_pct") && !sensors.get("soil_moisture_pct").isNull()) {
+                measurement.setSoilMoisture(sensors.get("soil_moisture_pct").asInt());
+            }
+            if (sensors.has("air_temperature_c") && !sensors.get("air_temperature_c").isNull()) {
+                measurement.setTemperature((float) sensors.get("air_temperature_c").asDouble());
+            }
+            if (sensors.has("air_humidity_pct") && !sensors.get("air_humidity_pct").isNull()) {
+                measurement.setHumidity((float) sensors.get("air_humidity_pct").asDouble());
+            }
+            if (sensors.has("pressure_hpa") && !sensors.get("pressure_hpa").isNull()) {
+                measurement.setPressure((float) sensors.get("pressure_hpa").asDouble());
+            }
+            if (sensors.has("light_lux") && !sensors.get("light_lux").isNull()) {
+                measurement.setLightLux((float) sensors.get("light_lux").asDouble());
+            }
+            if (sensors.has("water_tank_ok") && !sensors.get("water_tank_ok").isNull()) {
+                measurement.setWaterTankOk(sensors.get("water_tank_ok").asBoolean());
+            }
+        }
+
+        return measurement;
     }
 
     /**
@@ -162,38 +250,59 @@ public class SmartGardenService {
         Device device = getOrCreateDevice(mac, "unknown_user");
         String topic = String.format("garden/%s/%s/command/water", device.getUserId(), mac);
 
+        String id = java.util.UUID.randomUUID().toString();
         String payload;
         if (duration != null && duration > 0) {
-            payload = String.format("{\"duration\": %d}", duration);
+            payload = String.format("{\"id\": \"%s\", \"duration\": %d}", id, duration);
         } else {
-            payload = "{}";
+            payload = String.format("{\"id\": \"%s\"}", id);
         }
 
         mqttGateway.sendToMqtt(payload, topic);
-        log.info("Sent WATER command to {} with duration {}", topic, duration);
+        log.info("Sent WATER command {} to {} with duration {}", id, topic, duration);
     }
 
     public void sendMeasureCommand(String mac, java.util.List<String> fields) {
         Device device = getOrCreateDevice(mac, "unknown_user");
         String topic = String.format("garden/%s/%s/command/read", device.getUserId(), mac);
 
+        String id = java.util.UUID.randomUUID().toString();
         String payload;
         try {
+            // Construct {"id": "...", "fields": ["f1", "f2"]}
+            java.util.Map<String, Object> map = new java.util.HashMap<>();
+            map.put("id", id);
             if (fields != null && !fields.isEmpty()) {
-                // Construct {"fields": ["f1", "f2"]}
-                java.util.Map<String, Object> map = new java.util.HashMap<>();
                 map.put("fields", fields);
-                payload = objectMapper.writeValueAsString(map);
-            } else {
-                payload = "{}";
             }
+            payload = objectMapper.writeValueAsString(map);
             mqttGateway.sendToMqtt(payload, topic);
-            log.info("Sent MEASURE command to {} (fields={})", topic, fields);
+            log.info("Sent MEASURE command {} to {} (fields={})", id, topic, fields);
         } catch (JsonProcessingException e) {
             log.error("Failed to construct measure command payload", e);
         }
     }
 
+    /**
+     * Callback for garden/{user}/{device}/command/response. The device executes commands asynchronously
+     * and echoes the {@code id} sent with the command, e.g. {"command":"read","id":"...","status":"done"}.
+     */
+    public void processCommandResponse(String mac, String payload) {
+        try {
+            JsonNode root = objectMapper.readTree(payload);
+            String command = root.path("command").asText("?");
+            String id = root.path("id").asText("-");
+            String status = root.path("status").asText("?");
+            if ("rejected".equals(status) || "busy".equals(status)) {
+                log.warn("Command {} ({}) on {}: {} {}", id, command, mac, status, root.path("result"));
+            } else {
+                log.info("Command {} ({}) on {}: {}", id, command, mac, status);
+            }
+        } catch (JsonProcessingException e) {
+            log.error("Failed to parse command response payload for " + mac, e);
+        }
+    }
+
     // --- Device Authoritative Settings Implementation ---
 
     public DeviceSettingsDto getDeviceSettings(String mac) {
@@ -0,0 +1,90 @@
+package com.smartgarden.service;
+
+import com.smartgarden.entity.Measurement;
+
+import java.nio.BufferUnderflowException;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.time.Instant;
+import java.time.LocalDateTime;
+import java.time.ZoneId;
+import java.util.ArrayList;
+import java.util.List;
+
+/**
+ * Decoder for the compact binary telemetry frames published on garden/{user}/{device}/telemetry/bin
+ * (content type {@value #CONTENT_TYPE}, see esp32/main/telemetry_codec.h).
+ *
+ * Frame (little-endian): u8 version, u8 record count, then per record:
+ * i64 timestamp [ms], u8 flags (bits 0-5 = fields present, bit 7 = water tank ok),
+ * followed by the present fields in bit order: u8 soil %, i16 temperature x100,
+ * u16 humidity x100, u32 pressure x100, u32 light x100. Absent fields map to null.
+ */
+public final class TelemetryBinaryDecoder {
+
+    public static final String CONTENT_TYPE = "application/vnd.smartgarden.telemetry.v1";
+
+    private static final int VERSION = 1;
+
+    private static final int FIELD_SOIL = 1;
+    private static final int FIELD_TEMP = 1 << 1;
+    private static final int FIELD_HUM = 1 << 2;
+    private static final int FIELD_PRESS = 1 << 3;
+    private static final int FIELD_LIGHT = 1 << 4;
+    private static final int FIELD_WATER = 1 << 5;
+    private static final int FLAG_WATER_OK = 1 << 7;
+
+    private TelemetryBinaryDecoder() {
+    }
+
+    /**
+     * Decodes all records of a frame into measurements (without the device set).
+     *
+     * @throws IllegalArgumentException if the frame is truncated or has an unsupported version
+     */
+    public static List<Measurement> decode(byte[] payload) {
+        ByteBuffer buf = ByteBuffer.wrap(payload).order(ByteOrder.LITTLE_ENDIAN);
+        try {
+            int version = Byte.toUnsignedInt(buf.get());
+            if (version != VERSION) {
+                throw new IllegalArgumentException("Unsupported telemetry frame version: " + version);
+            }
+            int count = Byte.toUnsignedInt(buf.get());
+
+            List<Measurement> measurements = new ArrayList<>(count);
+            for (int i = 0; i < count; i++) {
+                measurements.add(decodeRecord(buf));
+            }
+            return measurements;
+        } catch (BufferUnderflowException e) {
+            throw new IllegalArgumentException("Truncated telemetry frame (" + payload.length + " bytes)", e);
+        }
+    }
+
+    private static Measurement decodeRecord(ByteBuffer buf) {
+        Measurement m = new Measurement();
+        long ts = buf.getLong();
+        m.setTimestamp(LocalDateTime.ofInstant(Instant.ofEpochMilli(ts), ZoneId.systemDefault()));
+
+        int flags = Byte.toUnsignedInt(buf.get());
+        if ((flags & FIELD_SOIL) != 0) {
+            m.setSoilMoisture(Byte.toUnsignedInt(buf.get()));
+        }
+        if ((flags & FIELD_TEMP) != 0) {
+            m.setTemperature(buf.getShort() / 100.0f);
+        }
+        if ((flags & FIELD_HUM) != 0) {
+            m.setHumidity(Short.toUnsignedInt(buf.getShort()) / 100.0f);
+        }
+        if ((flags & FIELD_PRESS) != 0) {
+            m.setPressure((float) (Integer.toUnsignedLong(buf.getInt()) / 100.0));
+        }
+        if ((flags & FIELD_LIGHT) != 0) {
+            m.setLightLux((float) (Integer.toUnsignedLong(buf.getInt()) / 100.0));
+        }
+        if ((flags & FIELD_WATER) != 0) {
+            m.setWaterTankOk((flags & FLAG_WATER_OK) != 0);
+        }
+        return m;
+    }
+}
@@ -0,0 +1,181 @@
+package com.smartgarden.service;
+
+import com.smartgarden.entity.Measurement;
+
+import java.time.Instant;
+import java.time.LocalDateTime;
+import java.time.ZoneId;
+import java.util.ArrayList;
+import java.util.List;
+
+/**
+ * Decoder for compressed telemetry backlog blocks published on garden/{user}/{device}/telemetry/tsz
+ * (content type {@value #CONTENT_TYPE}, see esp32/main/telemetry_tsz.h).
+ *
+ * Frame: u8 version, u8 skip, u16 count (little-endian), u8 measured fields mask, then a Gorilla-style
+ * bit stream (MSB first): the first record is stored in full, later records use delta-of-delta timestamps,
+ * XOR-encoded floats and repeat bits for soil moisture / water tank state.
+ * The first {@code skip} records were already delivered earlier and are dropped.
+ */
+public final class TelemetryTszDecoder {
+
+    public static final String CONTENT_TYPE = "application/vnd.smartgarden.telemetry-tsz.v1";
+
+    private static final int VERSION = 1;
+    private static final int HEADER_SIZE = 5;
+
+    private static final int FIELD_SOIL = 1;
+    private static final int FIELD_TEMP = 1 << 1;
+    private static final int FIELD_HUM = 1 << 2;
+    private static final int FIELD_PRESS = 1 << 3;
+    private static final int FIELD_LIGHT = 1 << 4;
+    private static final int FIELD_WATER = 1 << 5;
+
+    private TelemetryTszDecoder() {
+    }
+
+    /**
+     * Decodes the not yet delivered records of a block into measurements (without the device set).
+     *
+     * @throws IllegalArgumentException if the frame is truncated or has an unsupported version
+     */
+    public static List<Measurement> decode(byte[] payload) {
+        if (payload.length < HEADER_SIZE) {
+            throw new IllegalArgumentException("Truncated telemetry block (" + payload.length + " bytes)");
+        }
+        int version = Byte.toUnsignedInt(payload[0]);
+        if (version != VERSION) {
+            throw new IllegalArgumentException("Unsupported telemetry block version: " + version);
+        }
+        int skip = Byte.toUnsignedInt(payload[1]);
+        int count = Byte.toUnsignedInt(payload[2]) | (Byte.toUnsignedInt(payload[3]) << 8);
+        int fields = Byte.toUnsignedInt(payload[4]);
+
+        BitReader in = new BitReader(payload, HEADER_SIZE);
+        long ts = 0;
+        long delta = 0;
+        int[] f = new int[4];
+        int[] lead = new int[4];
+        int[] len = new int[4];
+        int soil = 0;
+        int water = 0;
+
+        List<Measurement> measurements = new ArrayList<>(Math.max(0, count - skip));
+        for (int i = 0; i < count; i++) {
+            if (i == 0) {
+                ts = in.read(64);
+                for (int k = 0; k < 4; k++) {
+                    f[k] = (int) in.read(32);
+                }
+                soil = (int) in.read(8);
+                water = (int) in.read(1);
+            } else {
+                delta += readDeltaOfDelta(in);
+                ts += delta;
+                for (int k = 0; k < 4; k++) {
+                    if (in.read(1) == 0) {
+                        continue;
+                    }
+                    if (in.read(1) == 1) {
+                        lead[k] = (int) in.read(5);
+                        len[k] = (int) in.read(5) + 1;
+                    } else if (len[k] == 0) {
+                        throw new IllegalArgumentException("Corrupted telemetry block (no XOR window)");
+                    }
+                    int shift = 32 - lead[k] - len[k];
+                    if (shift < 0) {
+                        throw new IllegalArgumentException("Corrupted telemetry block (bad XOR window)");
+                    }
+                    f[k] ^= (int) (in.read(len[k]) << shift);
+                }
+                if (in.read(1) == 1) {
+                    soil = (int) in.read(8);
+                }
+                if (in.read(1) == 1) {
+                    water ^= 1;
+                }
+            }
+
+            if (i >= skip) {
+                measurements.add(toMeasurement(ts, f, soil, water, fields));
+            }
+        }
+        return measurements;
+    }
+
+    private static long readDeltaOfDelta(BitReader in) {
+        if (in.read(1) == 0) {
+            return 0;
+        }
+        if (in.read(1) == 0) {
+            return in.read(7) - 63;
+        }
+        if (in.read(1) == 0) {
+            return in.read(9) - 255;
+        }
+        if (in.read(1) == 0) {
+            return in.read(12) - 2047;
+        }
+        return in.read(64);
+    }
+
+    private static Measurement toMeasurement(long ts, int[] f, int soil, int water, int fields) {
+        Measurement m = new Measurement();
+        m.setTimestamp(LocalDateTime.ofInstant(Instant.ofEpochMilli(ts), ZoneId.systemDefault()));
+        if ((fields & FIELD_SOIL) != 0 && soil > 0) {
+            m.setSoilMoisture(soil - 1);
+        }
+        if ((fields & FIELD_TEMP) != 0) {
+            m.setTemperature(toValue(f[0]));
+        }
+        if ((fields & FIELD_HUM) != 0) {
+            m.setHumidity(toValue(f[1]));
+        }
+        if ((fields & FIELD_PRESS) != 0) {
+            m.setPressure(toValue(f[2]));
+        }
+        if ((fields & FIELD_LIGHT) != 0) {
+            m.setLightLux(toValue(f[3]));
+        }
+        if ((fields & FIELD_WATER) != 0) {
+            m.setWaterTankOk(water == 0);
+        }
+        return m;
+    }
+
+    /** Same rounding as the JSON path (2 decimals); NaN/Inf means "not available". */
+    private static Float toValue(int bits) {
+        float v = Float.intBitsToFloat(bits);
+        if (Float.isNaN(v) || Float.isInfinite(v)) {
+            return null;
+        }
+        return (float) (Math.round(v * 100.0) / 100.0);
+    }
+
+    private static final class BitReader {
+        private final byte[] data;
+        private long bitPos;
+
+        BitReader(byte[] data, int offset) {
+            this.data = data;
+            this.bitPos = (long) offset * 8;
+        }
+
+        long read(int n) {
+            if (bitPos + n > (long) data.length * 8) {
+                throw new IllegalArgumentException("Truncated telemetry block");
+            }
+            long v = 0;
+            while (n > 0) {
+                int b = Byte.toUnsignedInt(data[(int) (bitPos >>> 3)]);
+                int room = 8 - (int) (bitPos & 7);
+                int take = Math.min(n, room);
+                int bits = (b >>> (room - take)) & ((1 << take) - 1);
+                v = (v << take) | bits;
+                bitPos += take;
+                n -= take;
+            }
+            return v;
+        }
+    }
+}